@@ -47,6 +47,17 @@ struct drive {
   GptData gpt;
   struct pmbr pmbr;
   int fd;       /* file descriptor */
+
+  /* For MTD character devices, writes go through a one erase block cache so
+   * each block is only erased and rewritten once. erase_size is 0 for block
+   * devices and files, which are written directly, unless CGPT_ERASE_SIZE is
+   * set in the environment; then regular files go through the same cache
+   * with that block size (without the erase), so it can be tested. */
+  uint32_t erase_size;        /* erase block size (in bytes) */
+  int erase_emulated;         /* regular file using erase_size for testing */
+  uint8_t *erase_buf;         /* cached erase block, or NULL */
+  uint64_t erase_buf_offset;  /* offset of erase_buf on the device */
+  int erase_buf_dirty;        /* erase_buf must be written back */
 };
 
 // Opens a block device or file, loads raw GPT data from it.
@@ -60,6 +71,12 @@ struct drive {
 // Returns CGPT_OK if success and information are stored in 'drive'. */
 int DriveOpen(const char *drive_path, struct drive *drive, int mode,
               uint64_t drive_size);
+// Same, but 'sector_bytes' (if not 0) gives the logical sector size. Block
+// devices must already have it; image files are taken to have it. With 0,
+// image files use the size their existing GPT was laid out for, or 512.
+int DriveOpenWithSectorSize(const char *drive_path, struct drive *drive,
+                            int mode, uint64_t drive_size,
+                            uint32_t sector_bytes);
 int DriveClose(struct drive *drive, int update_as_needed);
 int CheckValid(const struct drive *drive);
 
@@ -95,6 +112,18 @@ int Save(struct drive *drive, const uint8_t *buf,
                 const uint64_t sector_bytes,
                 const uint64_t sector_count);
 
+/* Zeroes sectors of 'drive' without writing them, by punching a hole in a
+ * regular file or asking a block device to zero them itself (BLKZEROOUT).
+ *
+ *   drive -- open drive
+ *   sector -- starting sector offset
+ *   sector_count -- number of sectors to zero
+ *
+ * Returns CGPT_OK for successful. Returns CGPT_FAILED if the drive can't do
+ * this, in which case the caller should write zeroes instead.
+ */
+int Discard(struct drive *drive, uint64_t sector, uint64_t sector_count);
+
 
 /* GUID conversion functions. Accepted format:
  *
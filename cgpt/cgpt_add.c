@@ -12,55 +12,57 @@
 #include "utility.h"
 #include "vboot_host.h"
 
-static const char* DumpCgptAddParams(const CgptAddParams *params) {
-  static char buf[256];
+// Describe the params the way they'd be given on the command line, in the
+// caller's buffer.
+static const char* DumpCgptAddParams(const CgptAddParams *params,
+                                     char *buf, size_t bufsize) {
   char tmp[64];
 
   buf[0] = 0;
   snprintf(tmp, sizeof(tmp), "-i %d ", params->partition);
-  StrnAppend(buf, tmp, sizeof(buf));
+  StrnAppend(buf, tmp, bufsize);
   if (params->label) {
     snprintf(tmp, sizeof(tmp), "-l %s ", params->label);
-    StrnAppend(buf, tmp, sizeof(buf));
+    StrnAppend(buf, tmp, bufsize);
   }
   if (params->set_begin) {
     snprintf(tmp, sizeof(tmp), "-b %llu ", (unsigned long long)params->begin);
-    StrnAppend(buf, tmp, sizeof(buf));
+    StrnAppend(buf, tmp, bufsize);
   }
   if (params->set_size) {
     snprintf(tmp, sizeof(tmp), "-s %llu ", (unsigned long long)params->size);
-    StrnAppend(buf, tmp, sizeof(buf));
+    StrnAppend(buf, tmp, bufsize);
   }
   if (params->set_type) {
     GuidToStr(&params->type_guid, tmp, sizeof(tmp));
-    StrnAppend(buf, "-t ", sizeof(buf));
-    StrnAppend(buf, tmp, sizeof(buf));
-    StrnAppend(buf, " ", sizeof(buf));
+    StrnAppend(buf, "-t ", bufsize);
+    StrnAppend(buf, tmp, bufsize);
+    StrnAppend(buf, " ", bufsize);
   }
   if (params->set_unique) {
     GuidToStr(&params->unique_guid, tmp, sizeof(tmp));
-    StrnAppend(buf, "-u ", sizeof(buf));
-    StrnAppend(buf, tmp, sizeof(buf));
-    StrnAppend(buf, " ", sizeof(buf));
+    StrnAppend(buf, "-u ", bufsize);
+    StrnAppend(buf, tmp, bufsize);
+    StrnAppend(buf, " ", bufsize);
   }
   if (params->set_successful) {
     snprintf(tmp, sizeof(tmp), "-S %d ", params->successful);
-    StrnAppend(buf, tmp, sizeof(buf));
+    StrnAppend(buf, tmp, bufsize);
   }
   if (params->set_tries) {
     snprintf(tmp, sizeof(tmp), "-T %d ", params->tries);
-    StrnAppend(buf, tmp, sizeof(buf));
+    StrnAppend(buf, tmp, bufsize);
   }
   if (params->set_priority) {
     snprintf(tmp, sizeof(tmp), "-P %d ", params->priority);
-    StrnAppend(buf, tmp, sizeof(buf));
+    StrnAppend(buf, tmp, bufsize);
   }
   if (params->set_raw) {
     snprintf(tmp, sizeof(tmp), "-A 0x%x ", params->raw_value);
-    StrnAppend(buf, tmp, sizeof(buf));
+    StrnAppend(buf, tmp, bufsize);
   }
 
-  StrnAppend(buf, "\n", sizeof(buf));
+  StrnAppend(buf, "\n", bufsize);
   return buf;
 }
 
@@ -266,6 +268,7 @@ bad:
 
 static int GptAdd(struct drive *drive, CgptAddParams *params, uint32_t index) {
   GptEntry *entry, backup;
+  char desc[256];
   int rv;
 
   entry = GetEntry(&drive->gpt, PRIMARY, index);
@@ -286,7 +289,7 @@ static int GptAdd(struct drive *drive, CgptAddParams *params, uint32_t index) {
     // If the modified entry is illegal, recover it and return error.
     memcpy(entry, &backup, sizeof(*entry));
     Error("%s\n", GptErrorText(rv));
-    Error(DumpCgptAddParams(params));
+    Error("%s", DumpCgptAddParams(params, desc, sizeof(desc)));
     return -1;
   }
 
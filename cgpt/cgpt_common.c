@@ -29,12 +29,19 @@
 #include "crc32.h"
 #include "vboot_host.h"
 
+#ifndef BLKZEROOUT
+#define BLKZEROOUT _IO(0x12, 127)  /* From <linux/fs.h> */
+#endif
+
 static const char kErrorTag[] = "ERROR";
 static const char kWarningTag[] = "WARNING";
 
+// Lock stderr so that the tag and message from one thread stay together.
 static void LogToStderr(const char *tag, const char *format, va_list ap) {
+  flockfile(stderr);
   fprintf(stderr, "%s: ", tag);
   vfprintf(stderr, format, ap);
+  funlockfile(stderr);
 }
 
 void Error(const char *format, ...) {
@@ -60,12 +67,155 @@ int CheckValid(const struct drive *drive) {
   return CGPT_OK;
 }
 
+#ifndef HAVE_MACOS
+/* Write the cached erase block back to an MTD device, if it has changed. */
+static int MtdFlush(struct drive *drive) {
+  struct erase_info_user erase;
+
+  if (!drive->erase_buf_dirty)
+    return CGPT_OK;
+
+  erase.start = drive->erase_buf_offset;
+  erase.length = drive->erase_size;
+  if (!drive->erase_emulated && ioctl(drive->fd, MEMERASE, &erase) < 0) {
+    Error("Can't erase block at 0x%llx: %s\n",
+          (long long unsigned int)drive->erase_buf_offset, strerror(errno));
+    return CGPT_FAILED;
+  }
+  if (pwrite(drive->fd, drive->erase_buf, drive->erase_size,
+             drive->erase_buf_offset) != drive->erase_size) {
+    Error("Can't write block at 0x%llx: %s\n",
+          (long long unsigned int)drive->erase_buf_offset, strerror(errno));
+    return CGPT_FAILED;
+  }
+
+  drive->erase_buf_dirty = 0;
+  return CGPT_OK;
+}
+
+/* Write to an MTD device through the erase block cache. Blocks are only
+ * marked dirty if their contents actually change. */
+static int MtdWrite(struct drive *drive, const uint8_t *buf, uint64_t offset,
+                    uint64_t count) {
+  while (count) {
+    uint64_t block = offset - offset % drive->erase_size;
+    uint64_t skip = offset - block;
+    uint64_t n = drive->erase_size - skip;
+    if (n > count)
+      n = count;
+
+    if (!drive->erase_buf || drive->erase_buf_offset != block) {
+      if (CGPT_OK != MtdFlush(drive))
+        return CGPT_FAILED;
+      if (!drive->erase_buf) {
+        drive->erase_buf = malloc(drive->erase_size);
+        require(drive->erase_buf);
+      }
+      if (pread(drive->fd, drive->erase_buf, drive->erase_size, block) !=
+          drive->erase_size) {
+        free(drive->erase_buf);
+        drive->erase_buf = NULL;
+        return CGPT_FAILED;
+      }
+      drive->erase_buf_offset = block;
+    }
+
+    if (memcmp(drive->erase_buf + skip, buf, n)) {
+      memcpy(drive->erase_buf + skip, buf, n);
+      drive->erase_buf_dirty = 1;
+    }
+    buf += n;
+    offset += n;
+    count -= n;
+  }
+  return CGPT_OK;
+}
+#endif
+
+/* Read 'count' bytes at byte 'offset' of 'drive'. */
+static int ReadBytes(struct drive *drive, void *buf, uint64_t offset,
+                     uint64_t count) {
+#ifndef HAVE_MACOS
+  /* Make sure we read back anything still in the erase block cache. */
+  if (CGPT_OK != MtdFlush(drive))
+    return CGPT_FAILED;
+#endif
+
+  if (-1 == lseek(drive->fd, offset, SEEK_SET)) {
+    Error("Can't seek: %s\n", strerror(errno));
+    return CGPT_FAILED;
+  }
+
+  int nread = read(drive->fd, buf, count);
+  if (nread < (int)count) {
+    Error("Can't read enough: %d, not %d\n", nread, (int)count);
+    return CGPT_FAILED;
+  }
+  return CGPT_OK;
+}
+
+/* Writes of zeroes into holes are skipped this many bytes at a time. */
+#define SPARSE_CHUNK_SIZE 4096
+
+/* Returns non-zero if 'count' bytes at byte 'offset' of 'drive' lie entirely
+ * within a hole of a sparse file, and so already read back as zeroes. */
+static int InHole(struct drive *drive, uint64_t offset, uint64_t count) {
+#ifdef SEEK_DATA
+  off_t end = lseek(drive->fd, 0, SEEK_END);
+  off_t data;
+
+  if (end < 0 || offset + count > (uint64_t)end)
+    return 0;
+  data = lseek(drive->fd, offset, SEEK_DATA);
+  if (data == -1)
+    return errno == ENXIO;  /* No data from 'offset' to the end */
+  return (uint64_t)data >= offset + count;
+#else
+  return 0;
+#endif
+}
+
+static int IsZeroes(const uint8_t *buf, uint64_t count) {
+  return !count || (!buf[0] && !memcmp(buf, buf + 1, count - 1));
+}
+
+/* Write 'count' bytes at byte 'offset' of 'drive'. Zeroes which would land in
+ * a hole aren't written, so sparse image files stay sparse. */
+static int WriteBytes(struct drive *drive, const void *buf, uint64_t offset,
+                      uint64_t count) {
+  const uint8_t *p = buf;
+
+#ifndef HAVE_MACOS
+  if (drive->erase_size)
+    return MtdWrite(drive, buf, offset, count);
+#endif
+
+  while (count) {
+    uint64_t n = SPARSE_CHUNK_SIZE - offset % SPARSE_CHUNK_SIZE;
+    if (n > count)
+      n = count;
+
+    if (!IsZeroes(p, n) || !InHole(drive, offset, n)) {
+      if (-1 == lseek(drive->fd, offset, SEEK_SET))
+        return CGPT_FAILED;
+
+      int nwrote = write(drive->fd, p, n);
+      if (nwrote < (int)n)
+        return CGPT_FAILED;
+    }
+    p += n;
+    offset += n;
+    count -= n;
+  }
+
+  return CGPT_OK;
+}
+
 int Load(struct drive *drive, uint8_t **buf,
                 const uint64_t sector,
                 const uint64_t sector_bytes,
                 const uint64_t sector_count) {
   int count;  /* byte count to read */
-  int nread;
 
   require(buf);
   if (!sector_count || !sector_bytes) {
@@ -83,16 +233,8 @@ int Load(struct drive *drive, uint8_t **buf,
   *buf = malloc(count);
   require(*buf);
 
-  if (-1 == lseek(drive->fd, sector * sector_bytes, SEEK_SET)) {
-    Error("Can't seek: %s\n", strerror(errno));
+  if (CGPT_OK != ReadBytes(drive, *buf, sector * sector_bytes, count))
     goto error_free;
-  }
-
-  nread = read(drive->fd, *buf, count);
-  if (nread < count) {
-    Error("Can't read enough: %d, not %d\n", nread, count);
-    goto error_free;
-  }
 
   return CGPT_OK;
 
@@ -104,45 +246,45 @@ error_free:
 
 
 int ReadPMBR(struct drive *drive) {
-  if (-1 == lseek(drive->fd, 0, SEEK_SET))
-    return CGPT_FAILED;
-
-  int nread = read(drive->fd, &drive->pmbr, sizeof(struct pmbr));
-  if (nread != sizeof(struct pmbr))
-    return CGPT_FAILED;
-
-  return CGPT_OK;
+  return ReadBytes(drive, &drive->pmbr, 0, sizeof(struct pmbr));
 }
 
 int WritePMBR(struct drive *drive) {
-  if (-1 == lseek(drive->fd, 0, SEEK_SET))
-    return CGPT_FAILED;
-
-  int nwrote = write(drive->fd, &drive->pmbr, sizeof(struct pmbr));
-  if (nwrote != sizeof(struct pmbr))
-    return CGPT_FAILED;
-
-  return CGPT_OK;
+  return WriteBytes(drive, &drive->pmbr, 0, sizeof(struct pmbr));
 }
 
 int Save(struct drive *drive, const uint8_t *buf,
                 const uint64_t sector,
                 const uint64_t sector_bytes,
                 const uint64_t sector_count) {
-  int count;  /* byte count to write */
-  int nwrote;
-
   require(buf);
-  count = sector_bytes * sector_count;
+  return WriteBytes(drive, buf, sector * sector_bytes,
+                    sector_bytes * sector_count);
+}
 
-  if (-1 == lseek(drive->fd, sector * sector_bytes, SEEK_SET))
-    return CGPT_FAILED;
+int Discard(struct drive *drive, uint64_t sector, uint64_t sector_count) {
+#ifndef HAVE_MACOS
+  struct stat stat;
+  uint64_t range[2];
 
-  nwrote = write(drive->fd, buf, count);
-  if (nwrote < count)
+  /* MTD devices are only ever written through the erase block cache. */
+  if (drive->erase_size || fstat(drive->fd, &stat) == -1)
     return CGPT_FAILED;
 
-  return CGPT_OK;
+  range[0] = sector * drive->gpt.sector_bytes;
+  range[1] = sector_count * drive->gpt.sector_bytes;
+  if (S_ISREG(stat.st_mode)) {
+    if (fallocate(drive->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                  range[0], range[1]) == 0)
+      return CGPT_OK;
+  } else if (S_ISBLK(stat.st_mode)) {
+    /* Not BLKDISCARD, which doesn't promise to read back zeroes. The kernel
+     * turns this into a discard or WRITE ZEROES where the device allows. */
+    if (ioctl(drive->fd, BLKZEROOUT, range) == 0)
+      return CGPT_OK;
+  }
+#endif
+  return CGPT_FAILED;
 }
 
 static int GptLoad(struct drive *drive, uint32_t sector_bytes) {
@@ -175,11 +317,13 @@ static int GptLoad(struct drive *drive, uint32_t sector_bytes) {
   GptHeader* primary_header = (GptHeader*)drive->gpt.primary_header;
   if (CheckHeader(primary_header, 0, drive->gpt.streaming_drive_sectors,
                   drive->gpt.gpt_drive_sectors,
-                  drive->gpt.flags) == 0) {
+                  drive->gpt.flags,
+                  drive->gpt.sector_bytes) == 0) {
     if (CGPT_OK != Load(drive, &drive->gpt.primary_entries,
                         primary_header->entries_lba,
                         drive->gpt.sector_bytes,
-                        CalculateEntriesSectors(primary_header))) {
+                        CalculateEntriesSectors(primary_header,
+                                                drive->gpt.sector_bytes))) {
       Error("Cannot read primary partition entry array\n");
       return -1;
     }
@@ -189,11 +333,13 @@ static int GptLoad(struct drive *drive, uint32_t sector_bytes) {
   GptHeader* secondary_header = (GptHeader*)drive->gpt.secondary_header;
   if (CheckHeader(secondary_header, 1, drive->gpt.streaming_drive_sectors,
                   drive->gpt.gpt_drive_sectors,
-                  drive->gpt.flags) == 0) {
+                  drive->gpt.flags,
+                  drive->gpt.sector_bytes) == 0) {
     if (CGPT_OK != Load(drive, &drive->gpt.secondary_entries,
                         secondary_header->entries_lba,
                         drive->gpt.sector_bytes,
-                        CalculateEntriesSectors(secondary_header))) {
+                        CalculateEntriesSectors(secondary_header,
+                                                drive->gpt.sector_bytes))) {
       Error("Cannot read secondary partition entry array\n");
       return -1;
     }
@@ -227,7 +373,8 @@ static int GptSave(struct drive *drive) {
     if (CGPT_OK != Save(drive, drive->gpt.primary_entries,
                         primary_header->entries_lba,
                         drive->gpt.sector_bytes,
-                        CalculateEntriesSectors(primary_header))) {
+                        CalculateEntriesSectors(primary_header,
+                                                drive->gpt.sector_bytes))) {
       errors++;
       Error("Cannot write primary entries: %s\n", strerror(errno));
     }
@@ -237,7 +384,8 @@ static int GptSave(struct drive *drive) {
     if (CGPT_OK != Save(drive, drive->gpt.secondary_entries,
                         secondary_header->entries_lba,
                         drive->gpt.sector_bytes,
-                        CalculateEntriesSectors(secondary_header))) {
+                        CalculateEntriesSectors(secondary_header,
+                                                drive->gpt.sector_bytes))) {
       errors++;
       Error("Cannot write secondary entries: %s\n", strerror(errno));
     }
@@ -258,17 +406,49 @@ static int GptSave(struct drive *drive) {
   return errors ? -1 : 0;
 }
 
+// Image files don't know their sector size, so look for a GPT header right
+// after a PMBR of each size we handle. Returns 0 if there isn't one.
+static uint32_t ProbeImageSectorBytes(int fd) {
+  uint32_t sector_bytes;
+  char signature[GPT_HEADER_SIGNATURE_SIZE];
+
+  for (sector_bytes = MIN_SECTOR_BYTES; sector_bytes <= MAX_SECTOR_BYTES;
+       sector_bytes *= 2) {
+    if (pread(fd, signature, sizeof(signature), sector_bytes) !=
+        sizeof(signature))
+      break;
+    if (!memcmp(signature, GPT_HEADER_SIGNATURE, sizeof(signature)) ||
+        !memcmp(signature, GPT_HEADER_SIGNATURE2, sizeof(signature)))
+      return sector_bytes;
+  }
+  return 0;
+}
+
 /*
- * Query drive size and bytes per sector. Return zero on success. On error,
- * -1 is returned and errno is set appropriately.
+ * Query drive size, bytes per sector and, for MTD devices, erase block size.
+ * Regular files get the erase block size in $CGPT_ERASE_SIZE, if any, and
+ * *erase_emulated is set. Return zero on success. On error, -1 is returned and
+ * errno is set appropriately.
  */
-static int ObtainDriveSize(int fd, uint64_t* size, uint32_t* sector_bytes) {
+static int ObtainDriveSize(int fd, uint64_t* size, uint32_t* sector_bytes,
+                           uint32_t* erase_size, int* erase_emulated) {
   struct stat stat;
   if (fstat(fd, &stat) == -1) {
     return -1;
   }
+  *erase_size = 0;
+  *erase_emulated = 0;
 #ifndef HAVE_MACOS
-  if ((stat.st_mode & S_IFMT) != S_IFREG) {
+  struct mtd_info_user mtd_info;
+  if (S_ISCHR(stat.st_mode) && ioctl(fd, MEMGETINFO, &mtd_info) == 0) {
+    if (!mtd_info.erasesize) {
+      errno = EINVAL;
+      return -1;
+    }
+    *sector_bytes = 512;  /* bytes */
+    *size = mtd_info.size;
+    *erase_size = mtd_info.erasesize;
+  } else if ((stat.st_mode & S_IFMT) != S_IFREG) {
     if (ioctl(fd, BLKGETSIZE64, size) < 0) {
       return -1;
     }
@@ -276,11 +456,31 @@ static int ObtainDriveSize(int fd, uint64_t* size, uint32_t* sector_bytes) {
       return -1;
     }
   } else {
-    *sector_bytes = 512;  /* bytes */
+    /* Use what the caller asked for, or what's already there */
+    if (!*sector_bytes)
+      *sector_bytes = ProbeImageSectorBytes(fd);
+    if (!*sector_bytes)
+      *sector_bytes = 512;  /* bytes */
     *size = stat.st_size;
+
+    /* Pretend to be an MTD device, so tests can check the erase block path */
+    const char *erase_env = getenv("CGPT_ERASE_SIZE");
+    if (erase_env && *erase_env) {
+      char *end;
+      unsigned long n = strtoul(erase_env, &end, 0);
+      if (*end || !n || n > UINT32_MAX || *size % n) {
+        errno = EINVAL;
+        return -1;
+      }
+      *erase_size = n;
+      *erase_emulated = 1;
+    }
   }
 #else
-  *sector_bytes = 512;  /* bytes */
+  if (!*sector_bytes)
+    *sector_bytes = ProbeImageSectorBytes(fd);
+  if (!*sector_bytes)
+    *sector_bytes = 512;  /* bytes */
   *size = stat.st_size;
 #endif
   return 0;
@@ -288,6 +488,12 @@ static int ObtainDriveSize(int fd, uint64_t* size, uint32_t* sector_bytes) {
 
 int DriveOpen(const char *drive_path, struct drive *drive, int mode,
               uint64_t drive_size) {
+  return DriveOpenWithSectorSize(drive_path, drive, mode, drive_size, 0);
+}
+
+int DriveOpenWithSectorSize(const char *drive_path, struct drive *drive,
+                            int mode, uint64_t drive_size,
+                            uint32_t want_sector_bytes) {
   uint32_t sector_bytes;
 
   require(drive_path);
@@ -306,13 +512,19 @@ int DriveOpen(const char *drive_path, struct drive *drive, int mode,
     return CGPT_FAILED;
   }
 
-  sector_bytes = 512;
+  sector_bytes = want_sector_bytes;
   uint64_t gpt_drive_size;
-  if (ObtainDriveSize(drive->fd, &gpt_drive_size, &sector_bytes) != 0) {
+  if (ObtainDriveSize(drive->fd, &gpt_drive_size, &sector_bytes,
+                      &drive->erase_size, &drive->erase_emulated) != 0) {
     Error("Can't get drive size and bytes per sector for %s: %s\n",
           drive_path, strerror(errno));
     goto error_close;
   }
+  if (want_sector_bytes && sector_bytes != want_sector_bytes) {
+    Error("%s has %u-byte sectors, not %u\n", drive_path, sector_bytes,
+          want_sector_bytes);
+    goto error_close;
+  }
 
   drive->gpt.gpt_drive_sectors = gpt_drive_size / sector_bytes;
   if (drive_size == 0) {
@@ -346,6 +558,13 @@ int DriveClose(struct drive *drive, int update_as_needed) {
     }
   }
 
+#ifndef HAVE_MACOS
+  if (CGPT_OK != MtdFlush(drive))
+    errors++;
+#endif
+  free(drive->erase_buf);
+  drive->erase_buf = NULL;
+
   // Sync early! Only sync file descriptor here, and leave the whole system sync
   // outside cgpt because whole system sync would trigger tons of disk accesses
   // and timeout tests.
@@ -449,9 +668,27 @@ int UTF16ToUTF8(const uint16_t *utf16, unsigned int maxinput,
 
   maxoutput--;                             /* plan for termination now */
 
-  for (s16idx = s8idx = 0;
-       s16idx < maxinput && utf16[s16idx] && maxoutput;
-       s16idx++) {
+  /* Labels are almost always ASCII, so copy those a word at a time until we
+   * see anything else (including the terminator), then fall back to the full
+   * decoder for the rest. */
+  s16idx = s8idx = 0;
+  while (maxinput - s16idx >= 4 && maxoutput >= 4) {
+    uint64_t units;
+
+    memcpy(&units, utf16 + s16idx, sizeof(units));
+    units = le64toh(units);
+    if ((units & 0xFF80FF80FF80FF80ULL) ||
+        ((units - 0x0001000100010001ULL) & ~units & 0x8000800080008000ULL))
+      break;
+    utf8[s8idx++] = units & 0x7F;
+    utf8[s8idx++] = (units >> 16) & 0x7F;
+    utf8[s8idx++] = (units >> 32) & 0x7F;
+    utf8[s8idx++] = (units >> 48) & 0x7F;
+    s16idx += 4;
+    maxoutput -= 4;
+  }
+
+  for (; s16idx < maxinput && utf16[s16idx] && maxoutput; s16idx++) {
     uint16_t codeunit = le16toh(utf16[s16idx]);
 
     if (code_point_ready) {
@@ -538,9 +775,15 @@ int UTF8ToUTF16(const uint8_t *utf8, uint16_t *utf16, unsigned int maxoutput)
 
   maxoutput--;                             /* plan for termination */
 
+  /* ASCII fast path; anything else goes through the full decoder below. */
   for (s8idx = s16idx = 0;
-       utf8[s8idx] && maxoutput;
+       utf8[s8idx] && utf8[s8idx] <= 0x7F && maxoutput;
        s8idx++) {
+    utf16[s16idx++] = utf8[s8idx];
+    maxoutput--;
+  }
+
+  for (; utf8[s8idx] && maxoutput; s8idx++) {
     uint8_t code_unit;
     code_unit = utf8[s8idx];
 
@@ -950,7 +1193,7 @@ uint8_t RepairHeader(GptData *gpt, const uint32_t valid_headers) {
     secondary_header->my_lba = gpt->gpt_drive_sectors - 1;  /* the last sector */
     secondary_header->alternate_lba = primary_header->my_lba;
     secondary_header->entries_lba = secondary_header->my_lba -
-        CalculateEntriesSectors(primary_header);
+        CalculateEntriesSectors(primary_header, gpt->sector_bytes);
     return GPT_MODIFIED_HEADER2;
   } else if (valid_headers == MASK_SECONDARY) {
     memcpy(primary_header, secondary_header, sizeof(GptHeader));
@@ -21,6 +21,48 @@ static void AllocAndClear(uint8_t **buf, uint64_t size) {
   }
 }
 
+// Clear the GPT regions on the drive without writing them, where possible,
+// and skip writing back anything that is all zeroes anyway. Each region falls
+// back to normal writes if it can't be discarded.
+static void DiscardGptRegions(struct drive *drive, CgptCreateParams *params) {
+  uint64_t drive_sectors = drive->gpt.gpt_drive_sectors;
+  uint64_t primary_start = GPT_PMBR_SECTORS, primary_end;
+  uint64_t secondary_start;
+
+  if (params->zap) {
+    // Headers and entries are all zeroes; clear where a default GPT lives.
+    uint64_t entries_sectors = (MAX_NUMBER_OF_ENTRIES * sizeof(GptEntry) +
+                                drive->gpt.sector_bytes - 1) /
+                               drive->gpt.sector_bytes;
+    uint64_t region = GPT_HEADER_SECTORS + entries_sectors;
+
+    if (GPT_PMBR_SECTORS + params->padding + region * 2 > drive_sectors)
+      return;
+    primary_end = primary_start + params->padding + region;
+    secondary_start = drive_sectors - region;
+  } else {
+    // Header, padding and entries; only the headers need writing.
+    GptHeader *h1 = (GptHeader *)drive->gpt.primary_header;
+    GptHeader *h2 = (GptHeader *)drive->gpt.secondary_header;
+
+    primary_end = h1->entries_lba +
+                  CalculateEntriesSectors(h1, drive->gpt.sector_bytes);
+    secondary_start = h2->entries_lba;
+  }
+
+  if (CGPT_OK == Discard(drive, primary_start, primary_end - primary_start)) {
+    drive->gpt.modified &= ~GPT_MODIFIED_ENTRIES1;
+    if (params->zap)
+      drive->gpt.modified &= ~GPT_MODIFIED_HEADER1;
+  }
+  if (CGPT_OK == Discard(drive, secondary_start,
+                         drive_sectors - secondary_start)) {
+    drive->gpt.modified &= ~GPT_MODIFIED_ENTRIES2;
+    if (params->zap)
+      drive->gpt.modified &= ~GPT_MODIFIED_HEADER2;
+  }
+}
+
 static int GptCreate(struct drive *drive, CgptCreateParams *params) {
   // Allocate and/or erase the data.
   // We cannot assume the GPT headers or entry arrays have been allocated
@@ -80,10 +122,12 @@ static int GptCreate(struct drive *drive, CgptCreateParams *params) {
     /* Then use number of entries to calculate entries_lba. */
     h->entries_lba = h->my_lba + GPT_HEADER_SECTORS;
     if (!(drive->gpt.flags & GPT_FLAG_EXTERNAL)) {
+      size_t entries_sectors =
+          CalculateEntriesSectors(h, drive->gpt.sector_bytes);
       h->entries_lba += params->padding;
-      h->first_usable_lba = h->entries_lba + CalculateEntriesSectors(h);
+      h->first_usable_lba = h->entries_lba + entries_sectors;
       h->last_usable_lba = (drive->gpt.streaming_drive_sectors - GPT_HEADER_SECTORS -
-                            CalculateEntriesSectors(h) - 1);
+                            entries_sectors - 1);
     } else {
       h->first_usable_lba = params->padding;
       h->last_usable_lba = (drive->gpt.streaming_drive_sectors - 1);
@@ -99,6 +143,9 @@ static int GptCreate(struct drive *drive, CgptCreateParams *params) {
     UpdateCrc(&drive->gpt);
   }
 
+  if (params->discard)
+    DiscardGptRegions(drive, params);
+
   return 0;
 }
 
@@ -108,8 +155,9 @@ int CgptCreate(CgptCreateParams *params) {
   if (params == NULL)
     return CGPT_FAILED;
 
-  if (CGPT_OK != DriveOpen(params->drive_name, &drive, O_RDWR,
-                           params->drive_size))
+  if (CGPT_OK != DriveOpenWithSectorSize(params->drive_name, &drive, O_RDWR,
+                                         params->drive_size,
+                                         params->sector_bytes))
     return CGPT_FAILED;
 
   if (GptCreate(&drive, params))
@@ -13,8 +13,6 @@
 #include "vboot_host.h"
 
 #define BUFSIZE 1024
-// FIXME: currently we only support 512-byte sectors.
-#define LBA_SIZE 512
 
 
 // fill comparebuf with the data to be examined, returning true on success.
@@ -47,7 +45,8 @@ static int match_content(CgptFindParams *params, struct drive *drive,
     return 1;
 
   // Ensure that the region we want to match against is inside the partition.
-  part_size = LBA_SIZE * (entry->ending_lba - entry->starting_lba + 1);
+  part_size = drive->gpt.sector_bytes *
+              (entry->ending_lba - entry->starting_lba + 1);
   if (params->matchoffset + params->matchlen > part_size) {
     return 0;
   }
@@ -55,7 +54,8 @@ static int match_content(CgptFindParams *params, struct drive *drive,
   // Read the partition data.
   if (!FillBuffer(params,
                   drive->fd,
-                  (LBA_SIZE * entry->starting_lba) + params->matchoffset,
+                  (drive->gpt.sector_bytes * entry->starting_lba) +
+                  params->matchoffset,
                   params->matchlen)) {
     Error("unable to read partition data\n");
     return 0;
@@ -103,6 +103,29 @@ static void chromeos_mtd_show(CgptFindParams *params, char *filename,
   }
 }
 
+// The label being searched for is converted to UTF-16 once up front by
+// CgptFind(), so that each entry's name can be compared without decoding it. A
+// label which can't be converted (or is too long for a GPT entry) can't match
+// anything, and leaves params->label_utf16 NULL.
+#define NAME_UNITS (sizeof(((GptEntry *)0)->name) / sizeof(uint16_t))
+
+static int label_matches(const CgptFindParams *params, const GptEntry *entry) {
+  const uint16_t *label = params->label_utf16;
+  int i;
+
+  if (!label)
+    return 0;
+
+  for (i = 0; i < NAME_UNITS; i++) {
+    if (le16toh(entry->name[i]) != label[i])
+      return 0;
+    if (!label[i])
+      return 1;
+  }
+  // The name fills the entry with no terminator; so must the label.
+  return !label[i];
+}
+
 // This returns true if a GPT partition matches the search criteria. If a match
 // isn't found (or if the file doesn't contain a GPT), it returns false. The
 // filename and partition number that matched is left in a global, since we
@@ -112,7 +135,6 @@ static int gpt_search(CgptFindParams *params, struct drive *drive,
   int i;
   GptEntry *entry;
   int retval = 0;
-  char partlabel[GPT_PARTNAME_LEN];
 
   if (GPT_SUCCESS != GptSanityCheck(&drive->gpt)) {
     return 0;
@@ -128,15 +150,8 @@ static int gpt_search(CgptFindParams *params, struct drive *drive,
     if ((params->set_unique && GuidEqual(&params->unique_guid, &entry->unique))
         || (params->set_type && GuidEqual(&params->type_guid, &entry->type))) {
       found = 1;
-    } else if (params->set_label) {
-      if (CGPT_OK != UTF16ToUTF8(entry->name,
-                                 sizeof(entry->name) / sizeof(entry->name[0]),
-                                 (uint8_t *)partlabel, sizeof(partlabel))) {
-        Error("The label cannot be converted from UTF16, so abort.\n");
-        return 0;
-      }
-      if (!strncmp(params->label, partlabel, sizeof(partlabel)))
-        found = 1;
+    } else if (params->set_label && label_matches(params, entry)) {
+      found = 1;
     }
     if (found && match_content(params, drive, entry)) {
       params->hits++;
@@ -174,11 +189,10 @@ static const char *devdirs[] = { "/dev", "/devices", "/devfs", 0 };
 
 // Given basename "foo", see if we can find a whole, real device by that name.
 // This is copied from the logic in the linux utility 'findfs', although that
-// does more exhaustive searching.
-static char *is_wholedev(const char *basename) {
+// does more exhaustive searching. The name is returned in pathname[BUFSIZE].
+static char *is_wholedev(const char *basename, char *pathname) {
   int i;
   struct stat statbuf;
-  static char pathname[BUFSIZE];        // we'll return this.
   char tmpname[BUFSIZE];
 
   // It should be a block device under /dev/,
@@ -212,6 +226,7 @@ static char *is_wholedev(const char *basename) {
 static int scan_real_devs(CgptFindParams *params) {
   int found = 0;
   char partname[128];                   // max size for /proc/partition lines?
+  char devname[BUFSIZE];
   FILE *fp;
   char *pathname;
 
@@ -230,7 +245,7 @@ static int scan_real_devs(CgptFindParams *params) {
     if (sscanf(line, " %d %d %llu %127[^\n ]", &ma, &mi, &sz, partname) != 4)
       continue;
 
-    if ((pathname = is_wholedev(partname))) {
+    if ((pathname = is_wholedev(partname, devname))) {
       if (do_search(params, pathname)) {
         found++;
       }
@@ -255,12 +270,22 @@ static int scan_real_devs(CgptFindParams *params) {
       continue;
     if (strcmp(partname, "mtd0") == 0) {
       char temp_dir[] = "/tmp/cgpt_find.XXXXXX";
+      char rw_gpt_mtd[64];
       if (params->drive_size == 0) {
         if (GetMtdSize("/dev/mtd0", &params->drive_size) != 0) {
           perror("GetMtdSize");
           goto cleanup;
         }
       }
+      // Read RW_GPT straight from its own MTD device, if there is one.
+      if (FindMtdByName("RW_GPT", rw_gpt_mtd, sizeof(rw_gpt_mtd)) == 0) {
+        params->show_fn = chromeos_mtd_show;
+        if (do_search(params, rw_gpt_mtd)) {
+          found++;
+        }
+        params->show_fn = NULL;
+        break;
+      }
       if (ReadNorFlash(temp_dir) != 0) {
         perror("ReadNorFlash");
         goto cleanup;
@@ -285,11 +310,24 @@ cleanup:
 
 
 void CgptFind(CgptFindParams *params) {
+  uint16_t label[NAME_UNITS + 2] = {0};
+
   if (params == NULL)
     return;
 
+  // UTF8ToUTF16() truncates silently, so leave room to spot a long label.
+  params->label_utf16 = NULL;
+  if (params->set_label &&
+      CGPT_OK == UTF8ToUTF16((const uint8_t *)params->label, label,
+                             NAME_UNITS + 2) &&
+      !label[NAME_UNITS])
+    params->label_utf16 = label;
+
   if (params->drive_name != NULL)
     do_search(params, params->drive_name);
   else
     scan_real_devs(params);
+
+  // Don't leave it pointing at our stack.
+  params->label_utf16 = NULL;
 }
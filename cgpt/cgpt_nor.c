@@ -46,6 +46,34 @@ int GetMtdSize(const char *mtd_device, uint64_t *size) {
   return ret;
 }
 
+int FindMtdByName(const char *name, char *path, size_t path_size) {
+  FILE *fp = fopen("/proc/mtd", "re");
+  if (fp == NULL) {
+    return 1;
+  }
+  int ret = 1;
+  size_t line_length = 0;
+  char *line = NULL;
+  while (getline(&line, &line_length, fp) != -1) {
+    char dev[65];
+    uint64_t sz;
+    uint32_t erasesz;
+    char mtd_name[128];
+    // dev:  size  erasesize  name
+    if (sscanf(line, "%64[^:]: %" PRIx64 " %x \"%127[^\"]\"",
+               dev, &sz, &erasesz, mtd_name) != 4)
+      continue;
+    if (strcmp(mtd_name, name) == 0) {
+      int len = snprintf(path, path_size, "/dev/%s", dev);
+      ret = (len < 0 || len >= path_size);
+      break;
+    }
+  }
+  free(line);
+  fclose(fp);
+  return ret;
+}
+
 int ForkExecV(const char *cwd, const char *const argv[]) {
   pid_t pid = fork();
   if (pid == -1) {
@@ -3,7 +3,8 @@
  * found in the LICENSE file.
  *
  * This module provides some utility functions to use "flashrom" to read from
- * and write to NOR flash.
+ * and write to NOR flash, or to find the MTD device which exposes the GPT
+ * section of NOR flash directly.
  */
 
 #ifndef VBOOT_REFERCENCE_CGPT_CGPT_NOR_H_
@@ -13,6 +14,11 @@
 // a dev node such as /dev/mtd0. This function returns 0 on success.
 int GetMtdSize(const char *mtd_device, uint64_t *size);
 
+// Find the MTD device named |name| in /proc/mtd (such as "RW_GPT") and store
+// its dev node, such as /dev/mtd2, in |path|. This function returns 0 on
+// success.
+int FindMtdByName(const char *name, char *path, size_t path_size);
+
 // Exec |argv| in |cwd|. Return -1 on error, or exit code on success. |argv|
 // must be terminated with a NULL element as is required by execv().
 int ForkExecV(const char *cwd, const char *const argv[]);
@@ -155,6 +155,143 @@ void EntriesDetails(struct drive *drive, const int secondary, int raw) {
   }
 }
 
+// Print a single field of a partition entry, without a trailing newline.
+static void ShowItem(struct drive *drive, GptEntry *entry, uint32_t index,
+                     char item) {
+  char buf[256];                        // scratch buffer for string conversion
+
+  switch(item) {
+  case 'b':
+    printf("%" PRId64, entry->starting_lba);
+    break;
+  case 's': {
+    uint64_t size = 0;
+    // If these aren't actually defined, don't show anything
+    if (entry->ending_lba || entry->starting_lba)
+      size = entry->ending_lba - entry->starting_lba + 1;
+    printf("%" PRId64, size);
+    break;
+  }
+  case 't':
+    GuidToStr(&entry->type, buf, sizeof(buf));
+    printf("%s", buf);
+    break;
+  case 'u':
+    GuidToStr(&entry->unique, buf, sizeof(buf));
+    printf("%s", buf);
+    break;
+  case 'l':
+    UTF16ToUTF8(entry->name, sizeof(entry->name) / sizeof(entry->name[0]),
+                (uint8_t *)buf, sizeof(buf));
+    printf("%s", buf);
+    break;
+  case 'S':
+    printf("%d", GetSuccessful(drive, ANY_VALID, index));
+    break;
+  case 'T':
+    printf("%d", GetTries(drive, ANY_VALID, index));
+    break;
+  case 'P':
+    printf("%d", GetPriority(drive, ANY_VALID, index));
+    break;
+  case 'A':
+    printf("0x%x", entry->attrs.fields.gpt_att);
+    break;
+  }
+}
+
+// Print a string as a quoted JSON string.
+static void JsonString(const char *s) {
+  printf("\"");
+  for (; *s; s++) {
+    unsigned char c = *s;
+    if (c == '"' || c == '\\')
+      printf("\\%c", c);
+    else if (c < 0x20)
+      printf("\\u%04x", c);
+    else
+      printf("%c", c);
+  }
+  printf("\"");
+}
+
+// Dump the valid GPT header and all used partitions as one JSON object.
+static void GptShowJson(struct drive *drive) {
+  GptHeader *header = (GptHeader *)(drive->gpt.valid_headers & MASK_PRIMARY ?
+                                    drive->gpt.primary_header :
+                                    drive->gpt.secondary_header);
+  char buf[256];                        // scratch buffer for string conversion
+  const char *sep = "";
+  uint32_t i;
+
+  printf("{\n");
+  printf("  \"valid_headers\": {\"primary\": %s, \"secondary\": %s},\n",
+         drive->gpt.valid_headers & MASK_PRIMARY ? "true" : "false",
+         drive->gpt.valid_headers & MASK_SECONDARY ? "true" : "false");
+  printf("  \"valid_entries\": {\"primary\": %s, \"secondary\": %s},\n",
+         drive->gpt.valid_entries & MASK_PRIMARY ? "true" : "false",
+         drive->gpt.valid_entries & MASK_SECONDARY ? "true" : "false");
+  GuidToStr(&header->disk_uuid, buf, sizeof(buf));
+  printf("  \"header\": {\"revision\": %u, \"my_lba\": %" PRIu64
+         ", \"alternate_lba\": %" PRIu64 ", \"first_usable_lba\": %" PRIu64
+         ", \"last_usable_lba\": %" PRIu64 ", \"disk_uuid\": \"%s\""
+         ", \"entries_lba\": %" PRIu64 ", \"number_of_entries\": %u"
+         ", \"size_of_entry\": %u},\n",
+         header->revision, header->my_lba, header->alternate_lba,
+         header->first_usable_lba, header->last_usable_lba, buf,
+         header->entries_lba, header->number_of_entries,
+         header->size_of_entry);
+  printf("  \"partitions\": [");
+  for (i = 0; i < GetNumberOfEntries(drive); ++i) {
+    GptEntry *entry = GetEntry(&drive->gpt, ANY_VALID, i);
+
+    if (GuidIsZero(&entry->type))
+      continue;
+
+    printf("%s\n    {\"number\": %u, \"start\": %" PRIu64
+           ", \"size\": %" PRIu64 ", \"type\": \"",
+           sep, i + 1, entry->starting_lba,
+           entry->ending_lba - entry->starting_lba + 1);
+    sep = ",";
+    GuidToStr(&entry->type, buf, sizeof(buf));
+    printf("%s\", \"type_name\": ", buf);
+    if (CGPT_OK == ResolveType(&entry->type, buf))
+      JsonString(buf);
+    else
+      printf("null");
+    GuidToStr(&entry->unique, buf, sizeof(buf));
+    printf(", \"unique\": \"%s\", \"label\": ", buf);
+    UTF16ToUTF8(entry->name, sizeof(entry->name) / sizeof(entry->name[0]),
+                (uint8_t *)buf, sizeof(buf));
+    JsonString(buf);
+    printf(", \"attributes\": %u, \"priority\": %d, \"tries\": %d"
+           ", \"successful\": %d}",
+           entry->attrs.fields.gpt_att,
+           GetPriority(drive, ANY_VALID, i), GetTries(drive, ANY_VALID, i),
+           GetSuccessful(drive, ANY_VALID, i));
+  }
+  printf("\n  ]\n}\n");
+}
+
+// Write the valid header sector and the valid entry array to stdout, exactly
+// as they are stored on disk.
+static int GptShowBinary(struct drive *drive) {
+  const uint8_t *header = drive->gpt.valid_headers & MASK_PRIMARY ?
+      drive->gpt.primary_header : drive->gpt.secondary_header;
+  const uint8_t *entries = drive->gpt.valid_entries & MASK_PRIMARY ?
+      drive->gpt.primary_entries : drive->gpt.secondary_entries;
+  const GptHeader *h = (const GptHeader *)header;
+  size_t entries_size = (size_t)h->number_of_entries * h->size_of_entry;
+
+  if (fwrite(header, drive->gpt.sector_bytes, 1, stdout) != 1 ||
+      fwrite(entries, entries_size, 1, stdout) != 1 ||
+      fflush(stdout)) {
+    Error("Unable to write binary output\n");
+    return CGPT_FAILED;
+  }
+  return CGPT_OK;
+}
+
 static int GptShow(struct drive *drive, CgptShowParams *params) {
   int gpt_retval;
   if (GPT_SUCCESS != (gpt_retval = GptSanityCheck(&drive->gpt))) {
@@ -163,59 +300,53 @@ static int GptShow(struct drive *drive, CgptShowParams *params) {
     return CGPT_FAILED;
   }
 
-  if (params->partition) {                      // show single partition
-
-    if (params->partition > GetNumberOfEntries(drive)) {
-      Error("invalid partition number: %d\n", params->partition);
+  if (params->json) {
+    GptShowJson(drive);
+  } else if (params->binary) {
+    if (CGPT_OK != GptShowBinary(drive))
       return CGPT_FAILED;
+  } else if (params->partition || params->num_query_partitions) {
+    // show selected partitions
+    uint32_t one_partition = params->partition;
+    const uint32_t *partitions = params->partitions;
+    int num_partitions = params->num_query_partitions;
+    char one_item = params->single_item;
+    const char *items = params->items;
+    int num_items = params->num_items;
+    int i, j;
+
+    if (!num_partitions) {
+      partitions = &one_partition;
+      num_partitions = 1;
+    }
+    if (!num_items) {
+      items = &one_item;
+      num_items = one_item ? 1 : 0;
     }
 
-    uint32_t index = params->partition - 1;
-    GptEntry *entry = GetEntry(&drive->gpt, ANY_VALID, index);
-    char buf[256];                      // scratch buffer for string conversion
-
-    if (params->single_item) {
-      switch(params->single_item) {
-      case 'b':
-        printf("%" PRId64 "\n", entry->starting_lba);
-        break;
-      case 's': {
-        uint64_t size = 0;
-        // If these aren't actually defined, don't show anything
-        if (entry->ending_lba || entry->starting_lba)
-          size = entry->ending_lba - entry->starting_lba + 1;
-        printf("%" PRId64 "\n", size);
-        break;
-      }
-      case 't':
-        GuidToStr(&entry->type, buf, sizeof(buf));
-        printf("%s\n", buf);
-        break;
-      case 'u':
-        GuidToStr(&entry->unique, buf, sizeof(buf));
-        printf("%s\n", buf);
-        break;
-      case 'l':
-        UTF16ToUTF8(entry->name, sizeof(entry->name) / sizeof(entry->name[0]),
-                    (uint8_t *)buf, sizeof(buf));
-        printf("%s\n", buf);
-        break;
-      case 'S':
-        printf("%d\n", GetSuccessful(drive, ANY_VALID, index));
-        break;
-      case 'T':
-        printf("%d\n", GetTries(drive, ANY_VALID, index));
-        break;
-      case 'P':
-        printf("%d\n", GetPriority(drive, ANY_VALID, index));
-        break;
-      case 'A':
-        printf("0x%x\n", entry->attrs.fields.gpt_att);
-        break;
+    for (i = 0; i < num_partitions; ++i) {
+      if (!partitions[i] || partitions[i] > GetNumberOfEntries(drive)) {
+        Error("invalid partition number: %d\n", partitions[i]);
+        return CGPT_FAILED;
       }
-    } else {
+    }
+
+    if (!num_items)
       printf(TITLE_FMT, "start", "size", "part", "contents");
-      EntryDetails(entry, index, params->numeric);
+    for (i = 0; i < num_partitions; ++i) {
+      uint32_t index = partitions[i] - 1;
+      GptEntry *entry = GetEntry(&drive->gpt, ANY_VALID, index);
+
+      if (!num_items) {
+        EntryDetails(entry, index, params->numeric);
+        continue;
+      }
+      for (j = 0; j < num_items; ++j) {
+        if (j)
+          printf(" ");
+        ShowItem(drive, entry, index, items[j]);
+      }
+      printf("\n");
     }
 
   } else if (params->quick) {                   // show all partitions, quickly
@@ -271,7 +402,8 @@ static int GptShow(struct drive *drive, CgptShowParams *params) {
 
     GptHeader* primary_header = (GptHeader*)drive->gpt.primary_header;
     printf(GPT_FMT, (int)primary_header->entries_lba,
-           (int)CalculateEntriesSectors(primary_header),
+           (int)CalculateEntriesSectors(primary_header,
+                                        drive->gpt.sector_bytes),
            drive->gpt.valid_entries & MASK_PRIMARY ? "" : "INVALID",
            "Pri GPT table");
 
@@ -282,7 +414,8 @@ static int GptShow(struct drive *drive, CgptShowParams *params) {
     /****************************** Secondary *************************/
     GptHeader* secondary_header = (GptHeader*)drive->gpt.secondary_header;
     printf(GPT_FMT, (int)secondary_header->entries_lba,
-           (int)CalculateEntriesSectors(secondary_header),
+           (int)CalculateEntriesSectors(secondary_header,
+                                        drive->gpt.sector_bytes),
            drive->gpt.valid_entries & MASK_SECONDARY ? "" : "INVALID",
            "Sec GPT table");
     /* We show secondary table details if any of following is true.
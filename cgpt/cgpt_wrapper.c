@@ -4,7 +4,9 @@
  *
  * This utility wraps around "cgpt" execution to work with NAND. If the target
  * device is an MTD device, this utility will read the GPT structures from
- * FMAP, invokes "cgpt" on that, and writes the result back to NOR flash. */
+ * FMAP, invokes "cgpt" on that, and writes the result back to NOR flash. If
+ * the RW_GPT section of NOR flash is exposed as its own MTD device, "cgpt" is
+ * run on that directly instead. */
 
 #include <err.h>
 #include <errno.h>
@@ -63,62 +65,87 @@ static const char *find_mtd_device(int argc, const char *const argv[]) {
   return NULL;
 }
 
-static int wrap_cgpt(int argc,
-                     const char *const argv[],
-                     const char *mtd_device) {
-  uint8_t *original_hash = NULL;
-  uint8_t *modified_hash = NULL;
-  int ret = 0;
-
-  // Create a temp dir to work in.
-  ret++;
-  char temp_dir[] = "/tmp/cgpt_wrapper.XXXXXX";
-  if (ReadNorFlash(temp_dir) != 0) {
-    return ret;
-  }
-  char rw_gpt_path[PATH_MAX];
-  if (snprintf(rw_gpt_path, sizeof(rw_gpt_path), "%s/rw_gpt", temp_dir) < 0) {
-    goto cleanup;
-  }
-  original_hash = DigestFile(rw_gpt_path, SHA1_DIGEST_ALGORITHM);
-
-  // Obtain the MTD size.
-  ret++;
-  uint64_t drive_size = 0;
-  if (GetMtdSize(mtd_device, &drive_size) != 0) {
-    Error("Cannot get the size of %s.\n", mtd_device);
-    goto cleanup;
-  }
-
-  // Launch cgpt on "rw_gpt" with -D size.
-  ret++;
+// Run real cgpt with |mtd_device| in |argv| replaced by |gpt_path| and
+// "-D |drive_size|" appended. If |replace_process| is true, exec it in place
+// of this process; otherwise, wait for it and return its exit code.
+static int run_cgpt(int argc,
+                    const char *const argv[],
+                    const char *mtd_device,
+                    const char *gpt_path,
+                    uint64_t drive_size,
+                    bool replace_process) {
   const char** my_argv = calloc(argc + 2 + 1, sizeof(char *));
   if (my_argv == NULL) {
     errno = ENOMEM;
-    goto cleanup;
+    return -1;
   }
   memcpy(my_argv, argv, sizeof(char *) * argc);
   char *real_cgpt;
   if (asprintf(&real_cgpt, "%s.bin", argv[0]) == -1) {
     free(my_argv);
-    goto cleanup;
+    return -1;
   }
   my_argv[0] = real_cgpt;
 
   int i;
   for (i = 2; i < argc; ++i) {
     if (strcmp(my_argv[i], mtd_device) == 0) {
-      my_argv[i] = rw_gpt_path;
+      my_argv[i] = gpt_path;
     }
   }
   my_argv[argc] = "-D";
   char size[32];
   snprintf(size, sizeof(size), "%" PRIu64, drive_size);
   my_argv[argc + 1] = size;
+
+  if (replace_process) {
+    execv(my_argv[0], (char * const *)my_argv);
+    err(-2, "execv(%s) failed", real_cgpt);
+  }
   i = ForkExecV(NULL, my_argv);
   free(real_cgpt);
   free(my_argv);
-  if (i != 0) {
+  return i;
+}
+
+static int wrap_cgpt(int argc,
+                     const char *const argv[],
+                     const char *mtd_device) {
+  uint8_t *original_hash = NULL;
+  uint8_t *modified_hash = NULL;
+  int ret = 0;
+
+  // Obtain the MTD size.
+  ret++;
+  uint64_t drive_size = 0;
+  if (GetMtdSize(mtd_device, &drive_size) != 0) {
+    Error("Cannot get the size of %s.\n", mtd_device);
+    return ret;
+  }
+
+  // If the RW_GPT section of NOR flash has its own MTD device, cgpt can
+  // update it directly with erase-block-aware writes, without flashrom or
+  // temp files.
+  char rw_gpt_mtd[PATH_MAX];
+  if (FindMtdByName("RW_GPT", rw_gpt_mtd, sizeof(rw_gpt_mtd)) == 0) {
+    return run_cgpt(argc, argv, mtd_device, rw_gpt_mtd, drive_size, true);
+  }
+
+  // Create a temp dir to work in.
+  ret++;
+  char temp_dir[] = "/tmp/cgpt_wrapper.XXXXXX";
+  if (ReadNorFlash(temp_dir) != 0) {
+    return ret;
+  }
+  char rw_gpt_path[PATH_MAX];
+  if (snprintf(rw_gpt_path, sizeof(rw_gpt_path), "%s/rw_gpt", temp_dir) < 0) {
+    goto cleanup;
+  }
+  original_hash = DigestFile(rw_gpt_path, SHA1_DIGEST_ALGORITHM);
+
+  // Launch cgpt on "rw_gpt" with -D size.
+  ret++;
+  if (run_cgpt(argc, argv, mtd_device, rw_gpt_path, drive_size, false) != 0) {
     Error("Cannot exec cgpt to modify rw_gpt.\n");
     goto cleanup;
   }
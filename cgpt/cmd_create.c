@@ -19,8 +19,13 @@ static void Usage(void)
          "                 default 0, meaning partitions and GPT structs are\n"
          "                 both on DRIVE\n"
          "  -z           Zero the sectors of the GPT table and entries\n"
+         "  -s           Zero the GPT regions by discarding them (punching\n"
+         "                 holes in image files) and only write the headers,\n"
+         "                 so sparse images stay sparse\n"
          "  -p NUM       Size (in blocks) of the disk to pad between the\n"
          "                 primary GPT header and its entries, default 0\n"
+         "  -B NUM       Bytes per sector (512 or 4096) of an image file;\n"
+         "                 block devices always use their own\n"
          "\n", progname);
 }
 
@@ -33,7 +38,7 @@ int cmd_create(int argc, char *argv[]) {
   char *e = 0;
 
   opterr = 0;                     // quiet, you
-  while ((c=getopt(argc, argv, ":hzp:D:")) != -1)
+  while ((c=getopt(argc, argv, ":hzsp:D:B:")) != -1)
   {
     switch (c)
     {
@@ -45,9 +50,21 @@ int cmd_create(int argc, char *argv[]) {
         errorcnt++;
       }
       break;
+    case 'B':
+      params.sector_bytes = (uint32_t)strtoul(optarg, &e, 0);
+      if (!*optarg || (e && *e) ||
+          (params.sector_bytes != 512 && params.sector_bytes != 4096))
+      {
+        Error("invalid argument to -%c: \"%s\"\n", c, optarg);
+        errorcnt++;
+      }
+      break;
     case 'z':
       params.zap = 1;
       break;
+    case 's':
+      params.discard = 1;
+      break;
     case 'p':
       params.padding = strtoull(optarg, &e, 0);
       if (!*optarg || (e && *e))
@@ -23,6 +23,9 @@ static void Usage(void)
          "  -n           Numeric output only\n"
          "  -v           Verbose output\n"
          "  -q           Quick output\n"
+         "  -j           JSON output of the GPT header and all partitions\n"
+         "  -B           Binary output: the valid GPT header sector followed\n"
+         "                 by its partition entry array, as stored on disk\n"
          "  -i NUM       Show specified partition only - pick one of:\n"
          "               -b  beginning sector\n"
          "               -s  partition size\n"
@@ -33,6 +36,9 @@ static void Usage(void)
          "               -T  Tries flag\n"
          "               -P  Priority flag\n"
          "               -A  raw 64-bit attribute value\n"
+         "               -i and the fields above may be repeated; each\n"
+         "               partition is then shown on its own line, with\n"
+         "               its fields separated by spaces, in the order given\n"
          "  -d           Debug output (including invalid headers)\n"
          "\n", progname);
 }
@@ -46,7 +52,7 @@ int cmd_show(int argc, char *argv[]) {
   char *e = 0;
 
   opterr = 0;                     // quiet, you
-  while ((c=getopt(argc, argv, ":hnvqi:bstulSTPAdD:")) != -1)
+  while ((c=getopt(argc, argv, ":hnvqjBi:bstulSTPAdD:")) != -1)
   {
     switch (c)
     {
@@ -67,6 +73,12 @@ int cmd_show(int argc, char *argv[]) {
     case 'q':
       params.quick = 1;
       break;
+    case 'j':
+      params.json = 1;
+      break;
+    case 'B':
+      params.binary = 1;
+      break;
     case 'i':
       params.partition = (uint32_t)strtoul(optarg, &e, 0);
       if (!*optarg || (e && *e))
@@ -74,6 +86,12 @@ int cmd_show(int argc, char *argv[]) {
         Error("invalid argument to -%c: \"%s\"\n", c, optarg);
         errorcnt++;
       }
+      if (params.num_query_partitions == CGPT_SHOW_MAX_PARTITIONS) {
+        Error("too many -%c options\n", c);
+        errorcnt++;
+        break;
+      }
+      params.partitions[params.num_query_partitions++] = params.partition;
       break;
     case 'b':
     case 's':
@@ -85,6 +103,12 @@ int cmd_show(int argc, char *argv[]) {
     case 'P':
     case 'A':
       params.single_item = c;
+      if (params.num_items == CGPT_SHOW_MAX_ITEMS) {
+        Error("too many fields\n");
+        errorcnt++;
+        break;
+      }
+      params.items[params.num_items++] = c;
       break;
 
     case 'd':
@@ -107,6 +131,12 @@ int cmd_show(int argc, char *argv[]) {
       break;
     }
   }
+  if ((params.json && params.binary) ||
+      ((params.json || params.binary) &&
+       (params.quick || params.num_query_partitions))) {
+    Error("-j and -B can't be used with each other, -q or -i\n");
+    errorcnt++;
+  }
   if (errorcnt)
   {
     Usage();
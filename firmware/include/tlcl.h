@@ -7,6 +7,11 @@
  * TPM Lightweight Command Library.
  *
  * A low-level library for interfacing to TPM hardware or an emulator.
+ *
+ * There is one TPM per process.  Each command is sent and its response read
+ * atomically, but the TPM itself has state (sessions, ownership, the
+ * physical presence latch), so callers using it from more than one thread
+ * must serialize whole sequences of Tlcl calls themselves.
  */
 
 #ifndef TPM_LITE_TLCL_H_
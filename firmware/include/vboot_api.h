@@ -229,6 +229,11 @@ typedef struct VbCommonParams {
 #define VB_INIT_FLAG_VIRTUAL_REC_SWITCH  0x00001000
 /* Set when we are calling VbInit() before loading Option ROMs */
 #define VB_INIT_FLAG_BEFORE_OPROM_LOAD   0x00002000
+/*
+ * Caller sets VbSelectAndLoadKernelParams.verify_cache.  Without this, that
+ * field is ignored, so callers built against older headers are unaffected.
+ */
+#define VB_INIT_FLAG_KERNEL_VERIFY_CACHE 0x00004000
 
 /*
  * Output flags for VbInitParams.out_flags.  Used to indicate potential boot
@@ -313,6 +318,41 @@ typedef struct VbSelectFirmwareParams {
  */
 typedef void *VbExDiskHandle_t;
 
+/* Current version of VbKernelVerifyCache */
+#define VB_KERNEL_VERIFY_CACHE_VERSION 1
+
+/* Flags for VbKernelVerifyCache.flags */
+/* Contents changed during this boot; the caller should save them */
+#define VB_KERNEL_VERIFY_CACHE_FLAG_DIRTY 0x00000001
+
+/*
+ * Result of the last kernel verification in normal or developer mode.  If the
+ * vblock (key block and preamble) at the start of the same kernel partition
+ * still matches, LoadKernel() trusts it without checking its RSA signatures,
+ * and checks the kernel body against the saved digest instead of its
+ * signature.  The body is still read and hashed on every boot, and version
+ * checks still apply.
+ *
+ * This is only safe if the caller stores the cache somewhere the OS cannot
+ * modify, such as a TPM NV space or write-protected flash.  The contents
+ * themselves are not signed.
+ */
+typedef struct VbKernelVerifyCache {
+	/* VB_KERNEL_VERIFY_CACHE_VERSION if valid; 0 if empty */
+	uint32_t struct_version;
+	/* Flags; see VB_KERNEL_VERIFY_CACHE_FLAG_* */
+	uint32_t flags;
+	/* Location of the kernel partition, in sectors */
+	uint64_t sector_start;
+	uint64_t sector_count;
+	/* SHA-256 digest of the kernel subkey followed by the vblock */
+	uint8_t vblock_digest[32];
+	/* Size of body_digest in bytes */
+	uint32_t body_digest_size;
+	/* Digest of the kernel body, using the body signature hash algorithm */
+	uint8_t body_digest[64];
+} VbKernelVerifyCache;
+
 /* Data used only by VbSelectAndLoadKernel() */
 typedef struct VbSelectAndLoadKernelParams {
 	/* Inputs to VbSelectAndLoadKernel() */
@@ -320,7 +360,6 @@ typedef struct VbSelectAndLoadKernelParams {
 	void *kernel_buffer;
 	/* Size of kernel buffer in bytes */
 	uint32_t kernel_buffer_size;
-
 	/*
 	 * Outputs from VbSelectAndLoadKernel(); valid only if it returns
 	 * success.
@@ -343,6 +382,19 @@ typedef struct VbSelectAndLoadKernelParams {
 	 * passed as an index instead of a handle.  Is that used anymore now
 	 * that we're passing partition_guid?
 	 */
+
+	/*
+	 * Inputs added since the original interface.  These are at the end so
+	 * the layout above doesn't change, and are only read if VbInit() was
+	 * told the caller sets them.
+	 */
+	/*
+	 * Kernel verification cache, or NULL to always check signatures.
+	 * Only used if VB_INIT_FLAG_KERNEL_VERIFY_CACHE was passed to VbInit().
+	 * If VB_KERNEL_VERIFY_CACHE_FLAG_DIRTY is set on return, the caller
+	 * should save it and clear the flag.
+	 */
+	VbKernelVerifyCache *verify_cache;
 } VbSelectAndLoadKernelParams;
 
 /**
@@ -689,6 +741,24 @@ VbError_t VbExStreamOpen(VbExDiskHandle_t handle, uint64_t lba_start,
  */
 VbError_t VbExStreamRead(VbExStream_t stream, uint32_t bytes, void *buffer);
 
+/**
+ * Hint that data will soon be read from a stream
+ *
+ * @param stream	Stream which will be read
+ * @param bytes		Number of bytes, starting at the current stream
+ *			position, which are likely to be read next
+ *
+ * @return Error code, or VBERROR_SUCCESS.
+ *
+ * This is purely advisory.  It lets the firmware start fetching data in the
+ * background (for example, with DMA) while the caller does other work such as
+ * signature verification, so a following VbExStreamRead() completes sooner.
+ * It must not change the stream position or the data returned by later reads,
+ * and [bytes] may extend past the end of the stream.  Implementations which
+ * can't read ahead may simply return VBERROR_SUCCESS.
+ */
+VbError_t VbExStreamPrefetch(VbExStream_t stream, uint32_t bytes);
+
 /**
  * Close a stream
  *
@@ -830,6 +900,18 @@ uint32_t VbExKeyboardRead(void);
  */
 uint32_t VbExKeyboardReadWithFlags(uint32_t *flags_ptr);
 
+/**
+ * Wait up to <msec> milliseconds for a key press, then return it as
+ * VbExKeyboardRead() would, or 0 if no key was pressed in that time.  A
+ * timeout of 0 is a non-blocking read.
+ *
+ * Firmware which can halt the CPU until a keyboard or timer interrupt should
+ * do so here, and return as soon as a key arrives; the developer screen
+ * spends almost all of its time in this call.  The stub implementation polls
+ * VbExKeyboardRead() at a fixed interval.
+ */
+uint32_t VbExKeyboardWait(uint32_t msec);
+
 /**
  * Return the current state of the switches specified in request_mask
  */
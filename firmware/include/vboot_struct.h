@@ -180,7 +180,16 @@ typedef struct VbFirmwarePreambleHeader {
 /****************************************************************************/
 
 #define KERNEL_PREAMBLE_HEADER_VERSION_MAJOR 2
-#define KERNEL_PREAMBLE_HEADER_VERSION_MINOR 2
+#define KERNEL_PREAMBLE_HEADER_VERSION_MINOR 4
+
+/*
+ * Preambles for compressed kernel bodies have this major version instead.
+ * Firmware which predates compression only accepts major version 2, so it
+ * rejects them rather than trying to boot compressed bytes.  The layout is
+ * the same as 2.x, and the minor version carries on from it (so it's at
+ * least 4).
+ */
+#define KERNEL_PREAMBLE_COMPRESSED_VERSION_MAJOR 3
 
 /* Preamble block for kernel, version 2.0
  *
@@ -217,14 +226,18 @@ typedef struct VbKernelPreambleHeader2_0 {
 
 #define EXPECTED_VBKERNELPREAMBLEHEADER2_0_SIZE 96
 
-/* Preamble block for kernel, version 2.1
+/* Preamble block for kernel, version 2.1 and later
  *
  * This should be followed by:
  *   1) The signature data for the kernel body, pointed to by
  *      body_signature.sig_offset.
- *   2) The signature data for (VBFirmwarePreambleHeader + body signature
- *      data), pointed to by preamble_signature.sig_offset.
- *   3) The 16-bit vmlinuz header, which is used for reconstruction of
+ *   2) For version 2.3 and later, the optional table of body chunk
+ *      digests, pointed to by body_chunk_hashes.sig_offset.  (The body
+ *      itself is compressed in version 3.4 and later.)
+ *   3) The signature data for (VBFirmwarePreambleHeader + body signature
+ *      data + body chunk digests), pointed to by
+ *      preamble_signature.sig_offset.
+ *   4) The 16-bit vmlinuz header, which is used for reconstruction of
  *      vmlinuz image.
  */
 typedef struct VbKernelPreambleHeader {
@@ -267,10 +280,43 @@ typedef struct VbKernelPreambleHeader {
 	 * [1:0]  - Kernel image type (0b00 - CrOS, 0b01 - bootimg)
 	 */
 	uint32_t flags;
+	/*
+	 * Fields added in header version 2.3.  Readers should treat a header
+	 * version < 2.3 as having no body chunk hashes.
+	 *
+	 * The body may also be covered by a table of digests, one for each
+	 * body_chunk_size bytes of it (the last chunk may be shorter), using
+	 * the hash algorithm of the data key.  The table is part of the
+	 * signed preamble data, so chunks can be checked independently and
+	 * in any order instead of checking body_signature.  body_signature is
+	 * still filled in, for readers which don't understand the table.
+	 */
+	/* Size of each body chunk in bytes; 0 if there is no table */
+	uint32_t body_chunk_size;
+	/*
+	 * Table of chunk digests; data_size is the size of the body it
+	 * covers, the same as body_signature.data_size.
+	 */
+	VbSignature body_chunk_hashes;
+	/*
+	 * Fields added in header version 2.4.  Readers should treat a major
+	 * version other than KERNEL_PREAMBLE_COMPRESSED_VERSION_MAJOR as
+	 * having an uncompressed body, whatever these say.
+	 *
+	 * If the body is compressed, body_signature and body_chunk_hashes
+	 * cover the compressed bytes on disk.  The body is only decompressed
+	 * into memory after it has been verified.
+	 */
+	/* Body compression; one of the COMPRESS_* values from vboot_api.h */
+	uint32_t body_compression;
+	/* Size of the body after decompression; 0 if not compressed */
+	uint32_t body_uncompressed_size;
 } __attribute__((packed)) VbKernelPreambleHeader;
 
 #define EXPECTED_VBKERNELPREAMBLEHEADER2_1_SIZE 112
 #define EXPECTED_VBKERNELPREAMBLEHEADER2_2_SIZE 116
+#define EXPECTED_VBKERNELPREAMBLEHEADER2_3_SIZE 144
+#define EXPECTED_VBKERNELPREAMBLEHEADER2_4_SIZE 152
 
 /****************************************************************************/
 
@@ -322,6 +368,8 @@ typedef struct VbKernelPreambleHeader {
 #define VBSD_OPROM_MATTERS               0x00010000
 /* Firmware has loaded the VGA Option ROM */
 #define VBSD_OPROM_LOADED                0x00020000
+/* VbInit() was told the caller passes a kernel verification cache */
+#define VBSD_KERNEL_VERIFY_CACHE         0x00040000
 
 /*
  * Supported flags by header version.  It's ok to add new flags while keeping
@@ -358,6 +406,8 @@ typedef struct VbKernelPreambleHeader {
 
 /* Flags for VbSharedDataKernelPart.flags */
 #define VBSD_LKP_FLAG_KEY_BLOCK_VALID   0x01
+/* Signatures were skipped because the vblock matched the verify cache */
+#define VBSD_LKP_FLAG_VERIFY_CACHE_HIT  0x02
 
 /* Result codes for VbSharedDataKernelPart.check_result */
 #define VBSD_LKP_CHECK_NOT_DONE           0
@@ -384,6 +434,7 @@ typedef struct VbKernelPreambleHeader {
 #define VBSD_LKP_CHECK_READ_DATA          17
 #define VBSD_LKP_CHECK_VERIFY_DATA        18
 #define VBSD_LKP_CHECK_KERNEL_GOOD        19
+#define VBSD_LKP_CHECK_DECOMPRESS         20
 
 /* Information about a single kernel partition check in LoadKernel() */
 typedef struct VbSharedDataKernelPart {
@@ -552,6 +603,20 @@ typedef struct VbSharedDataHeader {
 	 * all the fields it knows about are present.  Newer firmware needs to
 	 * use reasonable defaults when accessing older structs.
 	 */
+
+	/*
+	 * Fields added in version 3.  Before accessing, make sure that
+	 * struct_version >= 3
+	 */
+	/*
+	 * Writes to the TPM firmware and kernel spaces during this boot, by
+	 * RollbackFirmwareWrite(), SetVirtualDevMode() and
+	 * RollbackKernelWrite().  TPM setup and the NV storage backup can
+	 * also write NV spaces; those writes aren't counted.
+	 */
+	uint32_t tpm_rollback_writes;
+	/* Writes those functions skipped since nothing would have changed */
+	uint32_t tpm_rollback_writes_elided;
 } __attribute__((packed)) VbSharedDataHeader;
 
 /*
@@ -562,7 +627,8 @@ typedef struct VbSharedDataHeader {
  */
 #define VB_SHARED_DATA_HEADER_SIZE_V1 1072
 #define VB_SHARED_DATA_HEADER_SIZE_V2 1096
+#define VB_SHARED_DATA_HEADER_SIZE_V3 1104
 
-#define VB_SHARED_DATA_VERSION 2      /* Version for struct_version */
+#define VB_SHARED_DATA_VERSION 3      /* Version for struct_version */
 
 #endif  /* VBOOT_REFERENCE_VBOOT_STRUCT_H_ */
@@ -12,18 +12,18 @@
 #include "gpt_misc.h"
 #include "utility.h"
 
-const static int SECTOR_SIZE = 512;
-
-size_t CalculateEntriesSectors(GptHeader* h) {
+size_t CalculateEntriesSectors(GptHeader* h, uint32_t sector_bytes) {
   size_t bytes = h->number_of_entries * h->size_of_entry;
-  size_t ret = (bytes + SECTOR_SIZE - 1) / SECTOR_SIZE;
+  size_t ret = (bytes + sector_bytes - 1) / sector_bytes;
   return ret;
 }
 
 int CheckParameters(GptData *gpt)
 {
-	/* Currently, we only support 512-byte sectors. */
-	if (gpt->sector_bytes != SECTOR_SIZE)
+	/* Sectors must be a power of 2, from 512 bytes up to 4KiB. */
+	if (gpt->sector_bytes < MIN_SECTOR_BYTES ||
+	    gpt->sector_bytes > MAX_SECTOR_BYTES ||
+	    (gpt->sector_bytes & (gpt->sector_bytes - 1)))
 		return GPT_ERROR_INVALID_SECTOR_SIZE;
 
 	/*
@@ -44,7 +44,7 @@ int CheckParameters(GptData *gpt)
 	 */
 	if (gpt->gpt_drive_sectors <
 		(1 + 2 * (1 + MIN_NUMBER_OF_ENTRIES /
-				(SECTOR_SIZE / sizeof(GptEntry)))))
+				(gpt->sector_bytes / sizeof(GptEntry)))))
 		return GPT_ERROR_INVALID_SECTOR_NUMBER;
 
 	return GPT_SUCCESS;
@@ -65,8 +65,11 @@ uint32_t HeaderCrc(GptHeader *h)
 
 int CheckHeader(GptHeader *h, int is_secondary,
 		uint64_t streaming_drive_sectors,
-		uint64_t gpt_drive_sectors, uint32_t flags)
+		uint64_t gpt_drive_sectors, uint32_t flags,
+		uint32_t sector_bytes)
 {
+	size_t entries_sectors;
+
 	if (!h)
 		return 1;
 
@@ -83,6 +86,8 @@ int CheckHeader(GptHeader *h, int is_secondary,
 		return 1;
 	if (h->size < MIN_SIZE_OF_HEADER || h->size > MAX_SIZE_OF_HEADER)
 		return 1;
+	if (!sector_bytes)
+		return 1;
 
 	/* Check CRC before looking at remaining fields */
 	if (HeaderCrc(h) != h->header_crc32)
@@ -105,6 +110,7 @@ int CheckHeader(GptHeader *h, int is_secondary,
 	    (!(flags & GPT_FLAG_EXTERNAL) &&
 	    h->number_of_entries != MAX_NUMBER_OF_ENTRIES))
 		return 1;
+	entries_sectors = CalculateEntriesSectors(h, sector_bytes);
 
 	/*
 	 * Check locations for the header and its entries.  The primary
@@ -114,7 +120,7 @@ int CheckHeader(GptHeader *h, int is_secondary,
 	if (is_secondary) {
 		if (h->my_lba != gpt_drive_sectors - GPT_HEADER_SECTORS)
 			return 1;
-		if (h->entries_lba != h->my_lba - CalculateEntriesSectors(h))
+		if (h->entries_lba != h->my_lba - entries_sectors)
 			return 1;
 	} else {
 		if (h->my_lba != GPT_PMBR_SECTORS)
@@ -140,10 +146,10 @@ int CheckHeader(GptHeader *h, int is_secondary,
 	 * array.
 	 */
 	/* TODO(namnguyen): Also check for padding between header & entries. */
-	if (h->first_usable_lba < 2 + CalculateEntriesSectors(h))
+	if (h->first_usable_lba < 2 + entries_sectors)
 		return 1;
 	if (h->last_usable_lba >=
-			streaming_drive_sectors - 1 - CalculateEntriesSectors(h))
+			streaming_drive_sectors - 1 - entries_sectors)
 		return 1;
 
 	/* Success */
@@ -252,12 +258,14 @@ int GptSanityCheck(GptData *gpt)
 
 	/* Check both headers; we need at least one valid header. */
 	if (0 == CheckHeader(header1, 0, gpt->streaming_drive_sectors,
-			     gpt->gpt_drive_sectors, gpt->flags)) {
+			     gpt->gpt_drive_sectors, gpt->flags,
+			     gpt->sector_bytes)) {
 		gpt->valid_headers |= MASK_PRIMARY;
 		goodhdr = header1;
 	}
 	if (0 == CheckHeader(header2, 1, gpt->streaming_drive_sectors,
-			     gpt->gpt_drive_sectors, gpt->flags)) {
+			     gpt->gpt_drive_sectors, gpt->flags,
+			     gpt->sector_bytes)) {
 		gpt->valid_headers |= MASK_SECONDARY;
 		if (!goodhdr)
 			goodhdr = header2;
@@ -330,7 +338,8 @@ void GptRepair(GptData *gpt)
 		Memcpy(header2, header1, sizeof(GptHeader));
 		header2->my_lba = gpt->gpt_drive_sectors - GPT_HEADER_SECTORS;
 		header2->alternate_lba = GPT_PMBR_SECTORS;  /* Second sector. */
-		header2->entries_lba = header2->my_lba - CalculateEntriesSectors(header1);
+		header2->entries_lba = header2->my_lba -
+			CalculateEntriesSectors(header1, gpt->sector_bytes);
 		header2->header_crc32 = HeaderCrc(header2);
 		gpt->modified |= GPT_MODIFIED_HEADER2;
 	}
@@ -53,6 +53,9 @@
 #define SIZE_OF_ENTRY_MULTIPLE 8
 #define MIN_NUMBER_OF_ENTRIES 16
 #define MAX_NUMBER_OF_ENTRIES 128
+/* Logical sector sizes we handle (512n/512e and 4Kn drives) */
+#define MIN_SECTOR_BYTES 512
+#define MAX_SECTOR_BYTES 4096
 
 /* Defines GPT sizes */
 #define GPT_PMBR_SECTORS 1  /* size (in sectors) of PMBR */
@@ -87,7 +90,8 @@ int CheckParameters(GptData* gpt);
  */
 int CheckHeader(GptHeader *h, int is_secondary,
                 uint64_t streaming_drive_sectors,
-                uint64_t gpt_drive_sectors, uint32_t flags);
+                uint64_t gpt_drive_sectors, uint32_t flags,
+                uint32_t sector_bytes);
 
 /**
  * Calculate and return the header CRC.
@@ -159,8 +163,9 @@ void GetCurrentKernelUniqueGuid(GptData *gpt, void *dest);
 const char *GptErrorText(int error_code);
 
 /**
- * Return number of 512-byte sectors required to store the entries table.
+ * Return number of [sector_bytes]-byte sectors required to store the entries
+ * table.
  */
-size_t CalculateEntriesSectors(GptHeader* h);
+size_t CalculateEntriesSectors(GptHeader* h, uint32_t sector_bytes);
 
 #endif /* VBOOT_REFERENCE_CGPTLIB_INTERNAL_H_ */
@@ -51,12 +51,12 @@ int AllocAndReadGptData(VbExDiskHandle_t disk_handle, GptData *gptdata)
 	if (0 == CheckHeader(primary_header, 0,
 			gptdata->streaming_drive_sectors,
 			gptdata->gpt_drive_sectors,
-			gptdata->flags)) {
+			gptdata->flags,
+			gptdata->sector_bytes)) {
 		primary_valid = 1;
-		uint64_t entries_bytes = primary_header->number_of_entries
-				* primary_header->size_of_entry;
-		uint64_t entries_sectors = entries_bytes
-					/ gptdata->sector_bytes;
+		uint64_t entries_sectors =
+			CalculateEntriesSectors(primary_header,
+						gptdata->sector_bytes);
 		if (0 != VbExDiskRead(disk_handle,
 				      primary_header->entries_lba,
 				      entries_sectors,
@@ -76,12 +76,12 @@ int AllocAndReadGptData(VbExDiskHandle_t disk_handle, GptData *gptdata)
 	if (0 == CheckHeader(secondary_header, 1,
 			gptdata->streaming_drive_sectors,
 			gptdata->gpt_drive_sectors,
-			gptdata->flags)) {
+			gptdata->flags,
+			gptdata->sector_bytes)) {
 		secondary_valid = 1;
-		uint64_t entries_bytes = secondary_header->number_of_entries
-				* secondary_header->size_of_entry;
-		uint64_t entries_sectors = entries_bytes
-				/ gptdata->sector_bytes;
+		uint64_t entries_sectors =
+			CalculateEntriesSectors(secondary_header,
+						gptdata->sector_bytes);
 		if (0 != VbExDiskRead(disk_handle,
 				      secondary_header->entries_lba,
 				      entries_sectors,
@@ -104,9 +104,8 @@ int WriteAndFreeGptData(VbExDiskHandle_t disk_handle, GptData *gptdata)
 {
 	int legacy = 0;
 	GptHeader *header = (GptHeader *)gptdata->primary_header;
-	uint64_t entries_bytes = header->number_of_entries
-				* header->size_of_entry;
-	uint64_t entries_sectors = entries_bytes / gptdata->sector_bytes;
+	uint64_t entries_sectors = CalculateEntriesSectors(header,
+						gptdata->sector_bytes);
 	int ret = 1;
 
 	/*
@@ -57,6 +57,11 @@ typedef struct LoadKernelParams {
 	 * VbNvSetup() and VbNvTeardown() on the context.
 	 */
 	VbNvContext *nv_context;
+	/*
+	 * Kernel verification cache, or NULL to always check signatures.
+	 * Ignored in recovery mode.
+	 */
+	VbKernelVerifyCache *verify_cache;
 
 	/*
 	 * Outputs from LoadKernel(); valid only if LoadKernel() returns
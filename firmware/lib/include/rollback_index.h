@@ -134,6 +134,13 @@ uint32_t RollbackBackupWrite(uint8_t *raw);
  */
 uint32_t RollbackKernelLock(int recovery_mode);
 
+/**
+ * Return the number of firmware and kernel space writes that
+ * SetVirtualDevMode() and RollbackKernelWrite() issued and skipped as no-ops
+ * since the last call, then reset both counts.
+ */
+void RollbackGetWriteCounts(uint32_t *writes, uint32_t *elided);
+
 /****************************************************************************/
 
 /*
@@ -18,10 +18,17 @@ typedef struct VbAudioContext VbAudioContext;
 VbAudioContext *VbAudioOpen(VbCommonParams *cparams);
 
 /**
- * Caller should loop without extra delay until this returns false.
+ * Caller should loop until this returns false, waiting no longer than
+ * VbAudioNextEventMs() between calls.
  */
 int VbAudioLooping(VbAudioContext *audio);
 
+/**
+ * Return msecs until the next audio event or the end of the delay; 0 means
+ * VbAudioLooping() has work to do now.
+ */
+uint32_t VbAudioNextEventMs(VbAudioContext *audio);
+
 /**
  * Caller should call this prior to booting.
  */
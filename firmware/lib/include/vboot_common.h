@@ -43,6 +43,10 @@ enum {
 	VBOOT_SHARED_DATA_INVALID,
 	/* Kernel Preamble does not contain flags */
 	VBOOT_KERNEL_PREAMBLE_NO_FLAGS,
+	/* Kernel Preamble does not contain body chunk hashes */
+	VBOOT_KERNEL_PREAMBLE_NO_CHUNKS,
+	/* Kernel Preamble uses an unknown body compression */
+	VBOOT_KERNEL_PREAMBLE_BAD_COMPRESSION,
 	VBOOT_ERROR_MAX,
 };
 extern const char *kVbootErrors[VBOOT_ERROR_MAX];
@@ -121,6 +125,15 @@ int VerifyDigest(const uint8_t *digest, const VbSignature *sig,
 int KeyBlockVerify(const VbKeyBlockHeader *block, uint64_t size,
 		   const VbPublicKey *key, int hash_only);
 
+/**
+ * Check the sanity of a key block of size [size] bytes, verifying its
+ * signature with the already-unpacked RSA public key [key].  This is
+ * equivalent to KeyBlockVerify() with hash_only=0, but lets callers which
+ * check several key blocks against the same key unpack it only once.
+ */
+int KeyBlockVerifyRSA(const VbKeyBlockHeader *block, uint64_t size,
+		      const RSAPublicKey *key);
+
 
 /**
  * Check the sanity of a firmware preamble of size [size] bytes, using public
@@ -171,6 +184,39 @@ int VbGetKernelVmlinuzHeader(const VbKernelPreambleHeader *preamble,
  */
 int VbKernelHasFlags(const VbKernelPreambleHeader *preamble);
 
+/**
+ * Get the table of body chunk digests from a kernel preamble which has already
+ * been verified with VerifyKernelPreamble().  The table is only available in
+ * Kernel Preamble Header version >= 2.3, and is optional there.
+ *
+ * The table holds one digest per [*chunk_size] bytes of the body, using the
+ * hash for signature algorithm [algorithm].  On success, stores a pointer to
+ * the first digest in [*hashes].
+ *
+ * Returns VBOOT_SUCCESS if there is a usable table, or
+ * VBOOT_KERNEL_PREAMBLE_NO_CHUNKS if not.
+ */
+int VbKernelGetChunkHashes(const VbKernelPreambleHeader *preamble,
+			   unsigned int algorithm, const uint8_t **hashes,
+			   uint32_t *chunk_size);
+
+/**
+ * Get the compression of the kernel body from a kernel preamble which has
+ * already been verified with VerifyKernelPreamble().  Bodies are only
+ * compressed in Kernel Preamble Header version >= 3.4, whose major version
+ * is KERNEL_PREAMBLE_COMPRESSED_VERSION_MAJOR.
+ *
+ * Stores the COMPRESS_* type in [compression], and the size of the body once
+ * it has been decompressed in [body_size].  For an uncompressed body, those
+ * are COMPRESS_NONE and the size covered by the body signature.
+ *
+ * Returns VBOOT_SUCCESS, or VBOOT_KERNEL_PREAMBLE_BAD_COMPRESSION if the
+ * preamble is for a compressed body, but the compression type is unknown or
+ * none.
+ */
+int VbKernelGetCompression(const VbKernelPreambleHeader *preamble,
+			   uint32_t *compression, uint64_t *body_size);
+
 /**
  * Verify that the Vmlinuz Header is contained inside of the kernel blob.
  *
@@ -69,6 +69,12 @@ uint32_t RollbackKernelLock(int recovery_mode) {
   return TPM_SUCCESS;
 }
 
+
+void RollbackGetWriteCounts(uint32_t *writes, uint32_t *elided) {
+  *writes = 0;
+  *elided = 0;
+}
+
 static uint8_t rollback_backup[BACKUP_NV_SIZE];
 
 uint32_t RollbackBackupRead(uint8_t *raw)
@@ -152,14 +152,33 @@ uint32_t WriteSpaceFirmware(RollbackSpaceFirmware *rsf)
 	return TPM_E_CORRUPTED_STATE;
 }
 
+/*
+ * TPM NV writes are slow and wear-limited, so callers skip writes which
+ * wouldn't change anything.  Count both outcomes of SetVirtualDevMode() and
+ * RollbackKernelWrite() for VbSharedData.  Only functions called from
+ * VbSelectAndLoadKernel() may touch these; earlier stages can't use global
+ * variables.
+ */
+static uint32_t rollback_writes;
+static uint32_t rollback_writes_elided;
+
+void RollbackGetWriteCounts(uint32_t *writes, uint32_t *elided)
+{
+	*writes = rollback_writes;
+	*elided = rollback_writes_elided;
+	rollback_writes = rollback_writes_elided = 0;
+}
+
 uint32_t SetVirtualDevMode(int val)
 {
 	RollbackSpaceFirmware rsf;
+	uint8_t old_flags;
 
 	VBDEBUG(("TPM: Entering %s()\n", __func__));
 	if (TPM_SUCCESS != ReadSpaceFirmware(&rsf))
 		return VBERROR_TPM_FIRMWARE_SETUP;
 
+	old_flags = rsf.flags;
 	VBDEBUG(("TPM: flags were 0x%02x\n", rsf.flags));
 	if (val)
 		rsf.flags |= FLAG_VIRTUAL_DEV_MODE_ON;
@@ -171,8 +190,15 @@ uint32_t SetVirtualDevMode(int val)
 	 */
 	VBDEBUG(("TPM: flags are now 0x%02x\n", rsf.flags));
 
+	if (rsf.flags == old_flags) {
+		VBDEBUG(("TPM: flags unchanged; not writing\n"));
+		rollback_writes_elided++;
+		return VBERROR_SUCCESS;
+	}
+
 	if (TPM_SUCCESS != WriteSpaceFirmware(&rsf))
 		return VBERROR_TPM_SET_BOOT_MODE_STATE;
+	rollback_writes++;
 
 	VBDEBUG(("TPM: Leaving %s()\n", __func__));
 	return VBERROR_SUCCESS;
@@ -597,6 +623,8 @@ uint32_t RollbackFirmwareWrite(uint32_t version)
 	Memcpy(&old_version, &rsf.fw_versions, sizeof(old_version));
 	VBDEBUG(("TPM: RollbackFirmwareWrite %x --> %x\n", (int)old_version,
 		 (int)version));
+	if (old_version == version)
+		return TPM_SUCCESS;
 	Memcpy(&rsf.fw_versions, &version, sizeof(version));
 	return WriteSpaceFirmware(&rsf);
 }
@@ -606,11 +634,20 @@ uint32_t RollbackFirmwareLock(void)
 	return TlclSetGlobalLock();
 }
 
+/*
+ * Kernel space contents as last read or written by RollbackKernel*(), so
+ * RollbackKernelWrite() doesn't have to read the space again.
+ */
+static RollbackSpaceKernel rsk_last;
+static int rsk_last_valid;
+
 uint32_t RollbackKernelRead(uint32_t* version)
 {
 	RollbackSpaceKernel rsk;
 	uint32_t perms, uid;
 
+	rsk_last_valid = 0;
+
 	/*
 	 * Read the kernel space and verify its permissions.  If the kernel
 	 * space has the wrong permission, or it doesn't contain the right
@@ -625,6 +662,9 @@ uint32_t RollbackKernelRead(uint32_t* version)
 	if (TPM_NV_PER_PPWRITE != perms || ROLLBACK_SPACE_KERNEL_UID != uid)
 		return TPM_E_CORRUPTED_STATE;
 
+	Memcpy(&rsk_last, &rsk, sizeof(rsk));
+	rsk_last_valid = 1;
+
 	Memcpy(version, &rsk.kernel_versions, sizeof(*version));
 	VBDEBUG(("TPM: RollbackKernelRead %x\n", (int)*version));
 	return TPM_SUCCESS;
@@ -634,12 +674,26 @@ uint32_t RollbackKernelWrite(uint32_t version)
 {
 	RollbackSpaceKernel rsk;
 	uint32_t old_version;
-	RETURN_ON_FAILURE(ReadSpaceKernel(&rsk));
+
+	if (rsk_last_valid)
+		Memcpy(&rsk, &rsk_last, sizeof(rsk));
+	else
+		RETURN_ON_FAILURE(ReadSpaceKernel(&rsk));
 	Memcpy(&old_version, &rsk.kernel_versions, sizeof(old_version));
 	VBDEBUG(("TPM: RollbackKernelWrite %x --> %x\n",
 		 (int)old_version, (int)version));
+	if (old_version == version) {
+		rollback_writes_elided++;
+		return TPM_SUCCESS;
+	}
 	Memcpy(&rsk.kernel_versions, &version, sizeof(version));
-	return WriteSpaceKernel(&rsk);
+
+	rsk_last_valid = 0;
+	RETURN_ON_FAILURE(WriteSpaceKernel(&rsk));
+	rollback_writes++;
+	Memcpy(&rsk_last, &rsk, sizeof(rsk));
+	rsk_last_valid = 1;
+	return TPM_SUCCESS;
 }
 
 /*
@@ -91,6 +91,9 @@ VbError_t VbSelectFirmware(VbCommonParams *cparams,
 				retval = VBERROR_TPM_WRITE_FIRMWARE;
 				goto VbSelectFirmware_exit;
 			}
+			/* Can't use the rollback counters this early */
+			if (shared->struct_version >= 3)
+				shared->tpm_rollback_writes++;
 		}
 
 		/* Lock firmware versions in TPM */
@@ -86,6 +86,8 @@ VbError_t VbInit(VbCommonParams *cparams, VbInitParams *iparams)
 		shared->flags |= VBSD_OPROM_MATTERS;
 	if (iparams->flags & VB_INIT_FLAG_OPROM_LOADED)
 		shared->flags |= VBSD_OPROM_LOADED;
+	if (iparams->flags & VB_INIT_FLAG_KERNEL_VERIFY_CACHE)
+		shared->flags |= VBSD_KERNEL_VERIFY_CACHE;
 
 	is_s3_resume = (iparams->flags & VB_INIT_FLAG_S3_RESUME ? 1 : 0);
 
@@ -7,6 +7,7 @@
 
 #include "sysincludes.h"
 
+#include "cgptlib_internal.h"
 #include "gbb_access.h"
 #include "gbb_header.h"
 #include "load_kernel_fw.h"
@@ -99,11 +100,15 @@ uint32_t VbTryLoadKernel(VbCommonParams *cparams, LoadKernelParams *p,
 		 * Sanity-check what we can. FWIW, VbTryLoadKernel() is always
 		 * called with only a single bit set in get_info_flags.
 		 *
-		 * Ensure 512-byte sectors and non-trivially sized disk (for
-		 * cgptlib) and that we got a partition with only the flags we
-		 * asked for.
+		 * Ensure power-of-2 sectors of the sizes cgptlib handles
+		 * (512 bytes up to 4Kn), non-trivially sized disk (for
+		 * cgptlib) and that we got a partition with only the flags
+		 * we asked for.
 		 */
-		if (512 != disk_info[i].bytes_per_lba ||
+		if (MIN_SECTOR_BYTES > disk_info[i].bytes_per_lba ||
+		    MAX_SECTOR_BYTES < disk_info[i].bytes_per_lba ||
+		    (disk_info[i].bytes_per_lba &
+		     (disk_info[i].bytes_per_lba - 1)) ||
 		    16 > disk_info[i].lba_count ||
 		    get_info_flags != (disk_info[i].flags & ~VB_DISK_FLAG_EXTERNAL_GPT)) {
 			VBDEBUG(("  skipping: bytes_per_lba=%" PRIu64
@@ -224,6 +229,8 @@ VbError_t VbBootNormal(VbCommonParams *cparams, LoadKernelParams *p)
 	return VbTryLoadKernel(cparams, p, VB_DISK_FLAG_FIXED);
 }
 
+#define DEV_KEY_WAIT_MAX 100  /* Check for shutdown at least every 100ms */
+
 VbError_t VbBootDeveloper(VbCommonParams *cparams, LoadKernelParams *p)
 {
 	GoogleBinaryBlockHeader *gbb = cparams->gbb;
@@ -252,7 +259,7 @@ VbError_t VbBootDeveloper(VbCommonParams *cparams, LoadKernelParams *p)
 
 	/* We'll loop until we finish the delay or are interrupted */
 	do {
-		uint32_t key;
+		uint32_t key, wait_ms;
 
 		if (VbWantShutdown(gbb->flags)) {
 			VBDEBUG(("VbBootDeveloper() - shutdown requested!\n"));
@@ -260,7 +267,14 @@ VbError_t VbBootDeveloper(VbCommonParams *cparams, LoadKernelParams *p)
 			return VBERROR_SHUTDOWN_REQUESTED;
 		}
 
-		key = VbExKeyboardRead();
+		/*
+		 * Sleep until a key arrives, the next note or the end of the
+		 * countdown is due, or it's time to look for shutdown again.
+		 */
+		wait_ms = VbAudioNextEventMs(audio);
+		if (wait_ms > DEV_KEY_WAIT_MAX)
+			wait_ms = DEV_KEY_WAIT_MAX;
+		key = VbExKeyboardWait(wait_ms);
 		switch (key) {
 		case 0:
 			/* nothing pressed */
@@ -1048,6 +1062,9 @@ VbError_t VbSelectAndLoadKernel(VbCommonParams *cparams,
 	 */
 	p.kernel_buffer = kparams->kernel_buffer;
 	p.kernel_buffer_size = kparams->kernel_buffer_size;
+	/* Older callers don't have this field, so only look if told to */
+	if (shared->flags & VBSD_KERNEL_VERIFY_CACHE)
+		p.verify_cache = kparams->verify_cache;
 
 	p.nv_context = &vnc;
 	p.boot_flags = 0;
@@ -1127,10 +1144,14 @@ VbError_t VbSelectAndLoadKernel(VbCommonParams *cparams,
 		} else {
 			/* Not trying a new firmware B. */
 
-			/* See if we need to update the TPM. */
+			/*
+			 * See if we need to update the TPM.  If the version
+			 * hasn't changed, RollbackKernelWrite() skips the
+			 * write without talking to the TPM, and counts that.
+			 */
 			VBDEBUG(("Checking if TPM kernel version needs "
 				 "advancing\n"));
-			if (shared->kernel_version_tpm >
+			if (shared->kernel_version_tpm >=
 			    shared->kernel_version_tpm_start) {
 				tpm_status = RollbackKernelWrite(
 						shared->kernel_version_tpm);
@@ -1176,6 +1197,15 @@ VbError_t VbSelectAndLoadKernel(VbCommonParams *cparams,
 	if (vnc.raw_changed)
 		VbExNvStorageWrite(vnc.raw);
 
+	/* Record TPM NV write activity for telemetry */
+	if (shared->struct_version >= 3) {
+		uint32_t writes, elided;
+
+		RollbackGetWriteCounts(&writes, &elided);
+		shared->tpm_rollback_writes += writes;
+		shared->tpm_rollback_writes_elided += elided;
+	}
+
 	/* Stop timer */
 	shared->timer_vb_select_and_load_kernel_exit = VbExGetTimer();
 
@@ -251,7 +251,8 @@ VbAudioContext *VbAudioOpen(VbCommonParams *cparams)
 }
 
 /**
- * Caller should loop without extra delay until this returns false.
+ * Caller should loop until this returns false, waiting no longer than
+ * VbAudioNextEventMs() between calls.
  */
 int VbAudioLooping(VbAudioContext *audio)
 {
@@ -289,6 +290,25 @@ int VbAudioLooping(VbAudioContext *audio)
 	return looping;
 }
 
+/**
+ * Return the number of msecs until the next note change or the end of the
+ * delay, so the caller can sleep until then instead of spinning.
+ */
+uint32_t VbAudioNextEventMs(VbAudioContext *audio)
+{
+	uint64_t now = VbExGetTimer();
+	uint64_t msecs;
+
+	/* Uncalibrated timer; all we can do is poll */
+	if (!ticks_per_msec || now >= audio->play_until)
+		return 0;
+
+	/* Round up so we don't wake just before the deadline */
+	msecs = (audio->play_until - now + ticks_per_msec - 1) /
+		ticks_per_msec;
+	return msecs > UINT_MAX ? UINT_MAX : (uint32_t)msecs;
+}
+
 /**
  * Caller should call this prior to booting.
  */
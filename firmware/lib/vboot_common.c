@@ -20,7 +20,10 @@ const char *kVbootErrors[VBOOT_ERROR_MAX] = {
 	"Public key invalid.",
 	"Preamble invalid.",
 	"Preamble signature check failed.",
-	"Shared data invalid."
+	"Shared data invalid.",
+	"Kernel preamble does not contain flags.",
+	"Kernel preamble does not contain body chunk hashes.",
+	"Kernel preamble uses an unknown body compression.",
 };
 
 uint64_t OffsetOf(const void *base, const void *ptr)
@@ -184,8 +187,14 @@ int VerifyDigest(const uint8_t *digest, const VbSignature *sig,
 	return 0;
 }
 
-int KeyBlockVerify(const VbKeyBlockHeader *block, uint64_t size,
-                   const VbPublicKey *key, int hash_only)
+/*
+ * Common implementation of KeyBlockVerify() and KeyBlockVerifyRSA().  If
+ * [rsa_key] is non-NULL, it is used to check the signature; otherwise [key]
+ * is unpacked for the duration of the call.
+ */
+static int KeyBlockVerifyInternal(const VbKeyBlockHeader *block,
+				  uint64_t size, const VbPublicKey *key,
+				  const RSAPublicKey *rsa_key, int hash_only)
 {
 	const VbSignature *sig;
 
@@ -206,7 +215,7 @@ int KeyBlockVerify(const VbKeyBlockHeader *block, uint64_t size,
 		VBDEBUG(("Not enough data for key block.\n"));
 		return VBOOT_KEY_BLOCK_INVALID;
 	}
-	if (!hash_only && !key) {
+	if (!hash_only && !key && !rsa_key) {
 		VBDEBUG(("Missing required public key.\n"));
 		return VBOOT_PUBLIC_KEY_INVALID;
 	}
@@ -252,7 +261,7 @@ int KeyBlockVerify(const VbKeyBlockHeader *block, uint64_t size,
 		}
 	} else {
 		/* Check signature */
-		RSAPublicKey *rsa;
+		RSAPublicKey *rsa = NULL;
 		int rv;
 
 		sig = &block->key_block_signature;
@@ -262,22 +271,27 @@ int KeyBlockVerify(const VbKeyBlockHeader *block, uint64_t size,
 			return VBOOT_KEY_BLOCK_INVALID;
 		}
 
-		rsa = PublicKeyToRSA(key);
-		if (!rsa) {
-			VBDEBUG(("Invalid public key\n"));
-			return VBOOT_PUBLIC_KEY_INVALID;
+		if (!rsa_key) {
+			rsa = PublicKeyToRSA(key);
+			if (!rsa) {
+				VBDEBUG(("Invalid public key\n"));
+				return VBOOT_PUBLIC_KEY_INVALID;
+			}
+			rsa_key = rsa;
 		}
 
 		/* Make sure advertised signature data sizes are sane. */
 		if (block->key_block_size < sig->data_size) {
 			VBDEBUG(("Signature calculated past end of block\n"));
-			RSAPublicKeyFree(rsa);
+			if (rsa)
+				RSAPublicKeyFree(rsa);
 			return VBOOT_KEY_BLOCK_INVALID;
 		}
 
 		VBDEBUG(("Checking key block signature...\n"));
-		rv = VerifyData((const uint8_t *)block, size, sig, rsa);
-		RSAPublicKeyFree(rsa);
+		rv = VerifyData((const uint8_t *)block, size, sig, rsa_key);
+		if (rsa)
+			RSAPublicKeyFree(rsa);
 		if (rv) {
 			VBDEBUG(("Invalid key block signature.\n"));
 			return VBOOT_KEY_BLOCK_SIGNATURE;
@@ -305,6 +319,23 @@ int KeyBlockVerify(const VbKeyBlockHeader *block, uint64_t size,
 	return VBOOT_SUCCESS;
 }
 
+int KeyBlockVerify(const VbKeyBlockHeader *block, uint64_t size,
+                   const VbPublicKey *key, int hash_only)
+{
+	return KeyBlockVerifyInternal(block, size, key, NULL, hash_only);
+}
+
+int KeyBlockVerifyRSA(const VbKeyBlockHeader *block, uint64_t size,
+                      const RSAPublicKey *key)
+{
+	if (!key) {
+		VBDEBUG(("Missing required public key.\n"));
+		return VBOOT_PUBLIC_KEY_INVALID;
+	}
+
+	return KeyBlockVerifyInternal(block, size, NULL, key, 0);
+}
+
 int VerifyFirmwarePreamble(const VbFirmwarePreambleHeader *preamble,
                            uint64_t size, const RSAPublicKey *key)
 {
@@ -402,8 +433,16 @@ int VerifyKernelPreamble(const VbKernelPreambleHeader *preamble,
 		VBDEBUG(("Not enough data for preamble header.\n"));
 		return VBOOT_PREAMBLE_INVALID;
 	}
-	if (preamble->header_version_major !=
-	    KERNEL_PREAMBLE_HEADER_VERSION_MAJOR) {
+	if (preamble->header_version_major ==
+	    KERNEL_PREAMBLE_COMPRESSED_VERSION_MAJOR) {
+		/* Only preambles for compressed bodies use this version */
+		if (preamble->header_version_minor < 4 ||
+		    preamble->body_compression == COMPRESS_NONE) {
+			VBDEBUG(("Kernel preamble 3.x is not compressed.\n"));
+			return VBOOT_PREAMBLE_INVALID;
+		}
+	} else if (preamble->header_version_major !=
+		   KERNEL_PREAMBLE_HEADER_VERSION_MAJOR) {
 		VBDEBUG(("Incompatible kernel preamble header version.\n"));
 		return VBOOT_PREAMBLE_INVALID;
 	}
@@ -453,6 +492,15 @@ int VerifyKernelPreamble(const VbKernelPreambleHeader *preamble,
 		}
 	}
 
+	/* Verify the body chunk digests, if any, are inside the signed data */
+	if (preamble->header_version_minor >= 3 &&
+	    preamble->body_chunk_size &&
+	    VerifySignatureInside(preamble, sig->data_size,
+				  &preamble->body_chunk_hashes)) {
+		VBDEBUG(("Kernel body chunk hashes off end of preamble\n"));
+		return VBOOT_PREAMBLE_INVALID;
+	}
+
 	/* Success */
 	return VBOOT_SUCCESS;
 }
@@ -467,8 +515,8 @@ int VbGetKernelVmlinuzHeader(const VbKernelPreambleHeader *preamble,
 		/*
 		 * Set header and size only if the preamble header version is >
 		 * 2.1 as they don't exist in version 2.0 (Note that we don't
-		 * need to check header_version_major; if that's not 2 then
-		 * VerifyKernelPreamble() would have already failed.
+		 * need to check header_version_major; if that's not 2 or 3
+		 * then VerifyKernelPreamble() would have already failed.
 		 */
 		*vmlinuz_header_address = preamble->vmlinuz_header_address;
 		*vmlinuz_header_size = preamble->vmlinuz_header_size;
@@ -484,6 +532,50 @@ int VbKernelHasFlags(const VbKernelPreambleHeader *preamble)
 	return VBOOT_KERNEL_PREAMBLE_NO_FLAGS;
 }
 
+int VbKernelGetChunkHashes(const VbKernelPreambleHeader *preamble,
+			   unsigned int algorithm, const uint8_t **hashes,
+			   uint32_t *chunk_size)
+{
+	const VbSignature *table = &preamble->body_chunk_hashes;
+	uint64_t num_chunks;
+
+	if (preamble->header_version_minor < 3 || !preamble->body_chunk_size ||
+	    algorithm >= (unsigned int)kNumAlgorithms)
+		return VBOOT_KERNEL_PREAMBLE_NO_CHUNKS;
+
+	/* The table must cover the same body, with a digest per chunk */
+	if (table->data_size != preamble->body_signature.data_size)
+		return VBOOT_KERNEL_PREAMBLE_NO_CHUNKS;
+	num_chunks = (table->data_size + preamble->body_chunk_size - 1) /
+		preamble->body_chunk_size;
+	if (num_chunks > table->sig_size / hash_size_map[algorithm])
+		return VBOOT_KERNEL_PREAMBLE_NO_CHUNKS;
+
+	*hashes = GetSignatureDataC(table);
+	*chunk_size = preamble->body_chunk_size;
+	return VBOOT_SUCCESS;
+}
+
+int VbKernelGetCompression(const VbKernelPreambleHeader *preamble,
+			   uint32_t *compression, uint64_t *body_size)
+{
+	*compression = COMPRESS_NONE;
+	*body_size = preamble->body_signature.data_size;
+
+	if (preamble->header_version_major !=
+	    KERNEL_PREAMBLE_COMPRESSED_VERSION_MAJOR)
+		return VBOOT_SUCCESS;
+
+	if (preamble->header_version_minor < 4 ||
+	    preamble->body_compression == COMPRESS_NONE ||
+	    preamble->body_compression >= MAX_COMPRESS)
+		return VBOOT_KERNEL_PREAMBLE_BAD_COMPRESSION;
+
+	*compression = preamble->body_compression;
+	*body_size = preamble->body_uncompressed_size;
+	return VBOOT_SUCCESS;
+}
+
 int VerifyVmlinuzInsideKBlob(uint64_t kblob, uint64_t kblob_size,
 			     uint64_t header, uint64_t header_size)
 {
@@ -20,7 +20,28 @@
 #include "vboot_common.h"
 #include "vboot_kernel.h"
 
-#define KBUF_SIZE 65536  /* Bytes to read at start of kernel partition */
+/*
+ * Bytes to read at the start of each kernel partition.  This only needs to
+ * hold the key block and preamble headers; the rest of the vblock is read
+ * once its size is known.  Must be at least one sector.
+ */
+#ifndef KBUF_HEADER_SIZE
+#define KBUF_HEADER_SIZE 4096
+#endif
+
+/* Largest vblock (key block + preamble) LoadKernel() will read */
+#ifndef KBUF_MAX_SIZE
+#define KBUF_MAX_SIZE (1024 * 1024)
+#endif
+
+/*
+ * Bytes of kernel body to read per VbExStreamRead() call.  Each chunk is
+ * hashed as soon as it arrives, while it is still in cache.
+ */
+#ifndef KBODY_CHUNK_SIZE
+#define KBODY_CHUNK_SIZE (64 * 1024)
+#endif
+
 #define LOWEST_TPM_VERSION 0xffffffff
 
 typedef enum BootMode {
@@ -29,6 +50,347 @@ typedef enum BootMode {
 	kBootDev = 2        /* Developer boot - self-signed kernel ok */
 } BootMode;
 
+/*
+ * Number of unpacked data keys to keep per LoadKernel() call.  A/B kernels
+ * are normally signed with the same data key, so this rarely fills up.
+ */
+#define KEY_CACHE_SIZE 4
+
+typedef struct KeyCacheEntry {
+	uint8_t digest[SHA256_DIGEST_SIZE];  /* Digest of packed key data */
+	uint64_t algorithm;
+	uint64_t key_size;
+	RSAPublicKey *rsa;                   /* Unpacked key, or NULL if unused */
+} KeyCacheEntry;
+
+typedef struct KeyCache {
+	KeyCacheEntry entries[KEY_CACHE_SIZE];
+	uint32_t next_victim;
+} KeyCache;
+
+/**
+ * Return the unpacked RSA key for packed key [key], unpacking it only if an
+ * identical key is not already in [cache].  The returned key is owned by the
+ * cache and remains valid until the next call to KeyCacheGet() or
+ * KeyCacheFree().
+ *
+ * Returns NULL if the key could not be unpacked.
+ */
+static const RSAPublicKey *KeyCacheGet(KeyCache *cache,
+				       const VbPublicKey *key)
+{
+	uint8_t digest[SHA256_DIGEST_SIZE];
+	KeyCacheEntry *e;
+	int i;
+
+	internal_SHA256(GetPublicKeyDataC(key), key->key_size, digest);
+
+	for (i = 0, e = cache->entries; i < KEY_CACHE_SIZE; i++, e++) {
+		if (e->rsa && e->algorithm == key->algorithm &&
+		    e->key_size == key->key_size &&
+		    !SafeMemcmp(e->digest, digest, sizeof(digest))) {
+			VBDEBUG(("Reusing cached data key.\n"));
+			return e->rsa;
+		}
+	}
+
+	/* Not cached; replace entries round-robin once the cache is full */
+	e = cache->entries + cache->next_victim;
+	cache->next_victim = (cache->next_victim + 1) % KEY_CACHE_SIZE;
+	if (e->rsa) {
+		RSAPublicKeyFree(e->rsa);
+		e->rsa = NULL;
+	}
+
+	e->rsa = PublicKeyToRSA(key);
+	if (!e->rsa)
+		return NULL;
+
+	Memcpy(e->digest, digest, sizeof(digest));
+	e->algorithm = key->algorithm;
+	e->key_size = key->key_size;
+	return e->rsa;
+}
+
+/**
+ * Free all keys held by [cache].
+ */
+static void KeyCacheFree(KeyCache *cache)
+{
+	int i;
+
+	for (i = 0; i < KEY_CACHE_SIZE; i++) {
+		if (cache->entries[i].rsa)
+			RSAPublicKeyFree(cache->entries[i].rsa);
+		cache->entries[i].rsa = NULL;
+	}
+}
+
+/*
+ * Buffer for the start of a kernel partition.  It is reused for each
+ * partition and grows as needed, up to KBUF_MAX_SIZE.
+ */
+typedef struct KernelBuf {
+	uint8_t *data;
+	uint32_t alloc_size;  /* Bytes allocated */
+	uint32_t read_size;   /* Bytes read from the current partition */
+} KernelBuf;
+
+/**
+ * Read from [stream] until at least [want] bytes from the start of the
+ * partition are in [kbuf].  Reads are whole [blba]-byte sectors, and stop at
+ * the end of the partition ([part_bytes]) or KBUF_MAX_SIZE, so the caller
+ * must check kbuf->read_size.
+ *
+ * Returns 0 if success, non-zero if error.
+ */
+static int KernelBufRead(KernelBuf *kbuf, VbExStream_t stream, uint64_t want,
+			 uint64_t blba, uint64_t part_bytes)
+{
+	uint64_t max_size = KBUF_MAX_SIZE - KBUF_MAX_SIZE % blba;
+
+	if (want > part_bytes)
+		want = part_bytes;
+	if (want > max_size)
+		want = max_size;
+	want = (want + blba - 1) / blba * blba;
+
+	if (want <= kbuf->read_size)
+		return 0;
+
+	if (want > kbuf->alloc_size) {
+		uint8_t *data = (uint8_t *)VbExMalloc(want);
+
+		if (!data)
+			return 1;
+		if (kbuf->data) {
+			Memcpy(data, kbuf->data, kbuf->read_size);
+			VbExFree(kbuf->data);
+		}
+		kbuf->data = data;
+		kbuf->alloc_size = (uint32_t)want;
+	}
+
+	if (0 != VbExStreamRead(stream, (uint32_t)(want - kbuf->read_size),
+				kbuf->data + kbuf->read_size))
+		return 1;
+
+	kbuf->read_size = (uint32_t)want;
+	return 0;
+}
+
+/**
+ * Read the vblock (key block and preamble) at the start of a kernel partition
+ * into [kbuf].  First reads KBUF_HEADER_SIZE bytes, then uses the sizes in the
+ * headers to read the rest.  Those sizes have not been verified yet; if they
+ * are wrong, the reads are still bounded by KernelBufRead() and verifying the
+ * key block and preamble will fail.
+ *
+ * Returns 0 if success, non-zero if error.
+ */
+static int ReadVblock(KernelBuf *kbuf, VbExStream_t stream, uint64_t blba,
+		      uint64_t part_bytes)
+{
+	const VbKeyBlockHeader *key_block;
+	const VbKernelPreambleHeader *preamble;
+
+	kbuf->read_size = 0;
+	if (KernelBufRead(kbuf, stream, KBUF_HEADER_SIZE, blba, part_bytes))
+		return 1;
+
+	/* Make sure we have the preamble header */
+	key_block = (const VbKeyBlockHeader *)kbuf->data;
+	if (kbuf->read_size < sizeof(VbKeyBlockHeader) ||
+	    key_block->key_block_size > KBUF_MAX_SIZE)
+		return 0;
+	if (KernelBufRead(kbuf, stream, key_block->key_block_size +
+			  sizeof(VbKernelPreambleHeader), blba, part_bytes))
+		return 1;
+
+	/* And the rest of the preamble */
+	key_block = (const VbKeyBlockHeader *)kbuf->data;
+	preamble = (const VbKernelPreambleHeader *)
+		(kbuf->data + key_block->key_block_size);
+	if (kbuf->read_size < key_block->key_block_size +
+	    sizeof(VbKernelPreambleHeader) ||
+	    preamble->preamble_size > KBUF_MAX_SIZE)
+		return 0;
+	return KernelBufRead(kbuf, stream, key_block->key_block_size +
+			     preamble->preamble_size, blba, part_bytes);
+}
+
+/**
+ * Hint to [stream] that the rest of the kernel body, following the vblock
+ * already read into [kbuf], will be read next.  This lets the disk work
+ * while the key block and preamble signatures are checked.  The headers have
+ * not been verified yet, so the size is clamped to the partition size
+ * [part_bytes] and nothing depends on it being correct.
+ */
+static void PrefetchKernelBody(VbExStream_t stream, const KernelBuf *kbuf,
+			       uint64_t part_bytes)
+{
+	const VbKeyBlockHeader *key_block =
+		(const VbKeyBlockHeader *)kbuf->data;
+	const VbKernelPreambleHeader *preamble;
+	uint64_t body_end;
+
+	if (kbuf->read_size < sizeof(VbKeyBlockHeader) ||
+	    key_block->key_block_size >
+	    kbuf->read_size - sizeof(VbKernelPreambleHeader))
+		return;
+	preamble = (const VbKernelPreambleHeader *)
+		(kbuf->data + key_block->key_block_size);
+
+	if (preamble->preamble_size > part_bytes ||
+	    preamble->body_signature.data_size > part_bytes) {
+		body_end = part_bytes;
+	} else {
+		body_end = key_block->key_block_size +
+			preamble->preamble_size +
+			preamble->body_signature.data_size;
+		if (body_end > part_bytes)
+			body_end = part_bytes;
+	}
+
+	if (body_end <= kbuf->read_size)
+		return;
+	body_end -= kbuf->read_size;
+	if (body_end > UINT32_MAX)
+		body_end = UINT32_MAX;
+
+	VbExStreamPrefetch(stream, (uint32_t)body_end);
+}
+
+/**
+ * Calculate the SHA-256 digest of [subkey] followed by the vblock in [kbuf],
+ * for comparing against the kernel verification cache.
+ *
+ * Returns 0 if success, non-zero if the vblock is not all in [kbuf].
+ */
+static int VblockDigest(const VbPublicKey *subkey, const KernelBuf *kbuf,
+			uint8_t *digest)
+{
+	const VbKeyBlockHeader *key_block =
+		(const VbKeyBlockHeader *)kbuf->data;
+	const VbKernelPreambleHeader *preamble;
+	VB_SHA256_CTX ctx;
+
+	if (kbuf->read_size < sizeof(VbKeyBlockHeader) ||
+	    key_block->key_block_size >
+	    kbuf->read_size - sizeof(VbKernelPreambleHeader))
+		return 1;
+	preamble = (const VbKernelPreambleHeader *)
+		(kbuf->data + key_block->key_block_size);
+	if (preamble->preamble_size >
+	    kbuf->read_size - key_block->key_block_size)
+		return 1;
+
+	SHA256_init(&ctx);
+	SHA256_update(&ctx, (const uint8_t *)subkey, sizeof(*subkey));
+	SHA256_update(&ctx, GetPublicKeyDataC(subkey),
+		      (uint32_t)subkey->key_size);
+	SHA256_update(&ctx, kbuf->data, (uint32_t)(key_block->key_block_size +
+						  preamble->preamble_size));
+	Memcpy(digest, SHA256_final(&ctx), SHA256_DIGEST_SIZE);
+	return 0;
+}
+
+/**
+ * Read the [size]-byte kernel body at [body_offset] in the partition straight
+ * into [dest], hashing it as it arrives using the digest for signature
+ * algorithm [algorithm].  [body_offset] must be a multiple of [blba].
+ *
+ * Normally the vblock ends at or after everything already in [kbuf], so the
+ * body is streamed directly to its destination.  Only a vblock smaller than
+ * KBUF_HEADER_SIZE leaves the start of the body in [kbuf]; that part is
+ * copied.
+ *
+ * On success, stores the body digest in [digest]; the caller must free it
+ * with VbExFree().  Returns 0 if success, non-zero if error.
+ */
+static int ReadKernelBody(VbExStream_t stream, const KernelBuf *kbuf,
+			  uint64_t body_offset, uint8_t *dest, uint32_t size,
+			  uint64_t blba, int algorithm, uint8_t **digest)
+{
+	uint32_t chunk_size = KBODY_CHUNK_SIZE - KBODY_CHUNK_SIZE % blba;
+	DigestContext ctx;
+	uint32_t n;
+
+	DigestInit(&ctx, algorithm);
+
+	if (body_offset < kbuf->read_size) {
+		n = kbuf->read_size - body_offset;
+		if (n > size)
+			n = size;
+		Memcpy(dest, kbuf->data + body_offset, n);
+		DigestUpdate(&ctx, dest, n);
+		dest += n;
+		size -= n;
+	}
+
+	while (size) {
+		n = size < chunk_size ? size : chunk_size;
+		if (0 != VbExStreamRead(stream, n, dest)) {
+			VbExFree(DigestFinal(&ctx));
+			return 1;
+		}
+		DigestUpdate(&ctx, dest, n);
+		dest += n;
+		size -= n;
+	}
+
+	*digest = DigestFinal(&ctx);
+	return 0;
+}
+
+/**
+ * Like ReadKernelBody(), but checks each [chunk_size] bytes of the body
+ * against its digest in [hashes] as soon as it arrives, so a bad kernel fails
+ * at the first bad chunk.  [chunk_size] must be a multiple of [blba].
+ *
+ * Returns VBOOT_SUCCESS if all the chunks match, VBOOT_PREAMBLE_SIGNATURE if
+ * one doesn't, or another non-zero value if the body can't be read.
+ */
+static int ReadKernelBodyChunks(VbExStream_t stream, const KernelBuf *kbuf,
+				uint64_t body_offset, uint8_t *dest,
+				uint32_t size, int algorithm,
+				const uint8_t *hashes, uint32_t chunk_size)
+{
+	int digest_size = hash_size_map[algorithm];
+	uint32_t copied = 0;
+	uint32_t offset, n, skip;
+	uint8_t *digest;
+	int rv;
+
+	if (body_offset < kbuf->read_size) {
+		copied = kbuf->read_size - body_offset;
+		if (copied > size)
+			copied = size;
+		Memcpy(dest, kbuf->data + body_offset, copied);
+	}
+
+	for (offset = 0; offset < size; offset += n, hashes += digest_size) {
+		n = size - offset < chunk_size ? size - offset : chunk_size;
+
+		/* Read whatever part of the chunk we don't already have */
+		skip = copied > offset ? copied - offset : 0;
+		if (skip < n && 0 != VbExStreamRead(stream, n - skip,
+						    dest + offset + skip))
+			return VBOOT_PREAMBLE_INVALID;
+
+		digest = DigestBuf(dest + offset, n, algorithm);
+		rv = SafeMemcmp(digest, hashes, digest_size);
+		VbExFree(digest);
+		if (rv) {
+			VBDEBUG(("Kernel body chunk at 0x%x is bad.\n",
+				 offset));
+			return VBOOT_PREAMBLE_SIGNATURE;
+		}
+	}
+
+	return VBOOT_SUCCESS;
+}
+
 VbError_t LoadKernel(LoadKernelParams *params, VbCommonParams *cparams)
 {
 	VbSharedDataHeader *shared =
@@ -37,11 +399,13 @@ VbError_t LoadKernel(LoadKernelParams *params, VbCommonParams *cparams)
 	VbNvContext* vnc = params->nv_context;
 	VbPublicKey* kernel_subkey = NULL;
 	int free_kernel_subkey = 0;
+	RSAPublicKey *kernel_subkey_rsa = NULL;
+	int kernel_subkey_unpacked = 0;
+	KeyCache data_keys;
 	GptData gpt;
 	uint64_t part_start, part_size;
 	uint64_t blba;
-	uint64_t kbuf_sectors;
-	uint8_t* kbuf = NULL;
+	KernelBuf kbuf;
 	int found_partitions = 0;
 	int good_partition = -1;
 	int good_partition_key_block_valid = 0;
@@ -50,11 +414,18 @@ VbError_t LoadKernel(LoadKernelParams *params, VbCommonParams *cparams)
 	BootMode boot_mode;
 	uint32_t require_official_os = 0;
 	uint32_t body_toread;
-	uint8_t *body_readptr;
+	uint8_t *body_digest;
+	const uint8_t *chunk_hashes;
+	uint32_t chunk_size;
+	int rv;
+	VbKernelVerifyCache *verify_cache = NULL;
 
 	VbError_t retval = VBERROR_UNKNOWN;
 	int recovery = VBNV_RECOVERY_LK_UNSPECIFIED;
 
+	Memset(&data_keys, 0, sizeof(data_keys));
+	Memset(&kbuf, 0, sizeof(kbuf));
+
 	/* Sanity Checks */
 	if (!params->bytes_per_lba ||
 	    !params->streaming_lba_count) {
@@ -96,9 +467,9 @@ VbError_t LoadKernel(LoadKernelParams *params, VbCommonParams *cparams)
 
 	/* Initialization */
 	blba = params->bytes_per_lba;
-	kbuf_sectors = KBUF_SIZE / blba;
-	if (0 == kbuf_sectors) {
-		VBDEBUG(("LoadKernel() called with sector size > KBUF_SIZE\n"));
+	if (blba > KBUF_HEADER_SIZE) {
+		VBDEBUG(("LoadKernel() called with sector size > "
+			 "KBUF_HEADER_SIZE\n"));
 		retval = VBERROR_INVALID_PARAMETER;
 		goto LoadKernelExit;
 	}
@@ -112,6 +483,9 @@ VbError_t LoadKernel(LoadKernelParams *params, VbCommonParams *cparams)
 	} else {
 		/* Use the kernel subkey passed from LoadFirmware(). */
 		kernel_subkey = &shared->kernel_subkey;
+
+		/* Recovery boots always check signatures */
+		verify_cache = params->verify_cache;
 	}
 
 	/* Read GPT data */
@@ -133,23 +507,27 @@ VbError_t LoadKernel(LoadKernelParams *params, VbCommonParams *cparams)
 		goto bad_gpt;
 	}
 
-	/* Allocate kernel header buffers */
-	kbuf = (uint8_t*)VbExMalloc(KBUF_SIZE);
-	if (!kbuf)
-		goto bad_gpt;
-
         /* Loop over candidate kernel partitions */
         while (GPT_SUCCESS ==
 	       GptNextKernelEntry(&gpt, &part_start, &part_size)) {
 		VbSharedDataKernelPart *shpart = NULL;
 		VbKeyBlockHeader *key_block;
 		VbKernelPreambleHeader *preamble;
-		RSAPublicKey *data_key = NULL;
+		const RSAPublicKey *data_key = NULL;
 		VbExStream_t stream = NULL;
 		uint64_t key_version;
 		uint32_t combined_version;
 		uint64_t body_offset;
+		uint8_t vblock_digest[SHA256_DIGEST_SIZE];
+		int vblock_digest_valid = 0;
+		int cache_hit = 0;
+		int body_algorithm;
 		int key_block_valid = 1;
+		uint32_t compression;
+		uint64_t body_size;
+		uint8_t *body_dest;
+		uint8_t *compressed_body = NULL;
+		uint32_t out_size;
 
 		VBDEBUG(("Found kernel entry at %" PRIu64 " size %" PRIu64 "\n",
 			 part_start, part_size));
@@ -182,16 +560,50 @@ VbError_t LoadKernel(LoadKernelParams *params, VbCommonParams *cparams)
 			goto bad_kernel;
 		}
 
-		if (0 != VbExStreamRead(stream, KBUF_SIZE, kbuf)) {
+		if (0 != ReadVblock(&kbuf, stream, blba, part_size * blba)) {
 			VBDEBUG(("Unable to read start of partition.\n"));
 			shpart->check_result = VBSD_LKP_CHECK_READ_START;
 			goto bad_kernel;
 		}
 
+		/*
+		 * If this partition may be the one we boot, start fetching
+		 * its body while we verify the headers.
+		 */
+		if (-1 == good_partition)
+			PrefetchKernelBody(stream, &kbuf, part_size * blba);
+
+		/* See if we verified this vblock on a previous boot */
+		key_block = (VbKeyBlockHeader*)kbuf.data;
+		if (verify_cache) {
+			vblock_digest_valid = !VblockDigest(kernel_subkey,
+							    &kbuf,
+							    vblock_digest);
+			cache_hit = vblock_digest_valid &&
+				VB_KERNEL_VERIFY_CACHE_VERSION ==
+				verify_cache->struct_version &&
+				verify_cache->sector_start == part_start &&
+				verify_cache->sector_count == part_size &&
+				key_block->data_key.algorithm < kNumAlgorithms &&
+				!SafeMemcmp(verify_cache->vblock_digest,
+					    vblock_digest, SHA256_DIGEST_SIZE);
+		}
+
+		/*
+		 * Unpack the kernel subkey the first time it's needed, so it
+		 * can be reused for all the remaining partitions.
+		 */
+		if (!cache_hit && !kernel_subkey_unpacked) {
+			kernel_subkey_rsa = PublicKeyToRSA(kernel_subkey);
+			kernel_subkey_unpacked = 1;
+		}
+
 		/* Verify the key block. */
-		key_block = (VbKeyBlockHeader*)kbuf;
-		if (0 != KeyBlockVerify(key_block, KBUF_SIZE,
-					kernel_subkey, 0)) {
+		if (cache_hit) {
+			VBDEBUG(("Vblock matches verify cache.\n"));
+			shpart->flags |= VBSD_LKP_FLAG_VERIFY_CACHE_HIT;
+		} else if (0 != KeyBlockVerifyRSA(key_block, kbuf.read_size,
+						  kernel_subkey_rsa)) {
 			VBDEBUG(("Verifying key block signature failed.\n"));
 			shpart->check_result = VBSD_LKP_CHECK_KEY_BLOCK_SIG;
 			key_block_valid = 0;
@@ -215,7 +627,7 @@ VbError_t LoadKernel(LoadKernelParams *params, VbCommonParams *cparams)
 			 * Allow the kernel if the SHA-512 hash of the key
 			 * block is valid.
 			 */
-			if (0 != KeyBlockVerify(key_block, KBUF_SIZE,
+			if (0 != KeyBlockVerify(key_block, kbuf.read_size,
 						kernel_subkey, 1)) {
 				VBDEBUG(("Verifying key block hash failed.\n"));
 				shpart->check_result =
@@ -268,24 +680,35 @@ VbError_t LoadKernel(LoadKernelParams *params, VbCommonParams *cparams)
 			goto bad_kernel;
 		}
 
-		/* Get key for preamble/data verification from the key block. */
-		data_key = PublicKeyToRSA(&key_block->data_key);
-		if (!data_key) {
-			VBDEBUG(("Data key bad.\n"));
-			shpart->check_result = VBSD_LKP_CHECK_DATA_KEY_PARSE;
-			goto bad_kernel;
-		}
-
-		/* Verify the preamble, which follows the key block */
 		preamble = (VbKernelPreambleHeader *)
-			(kbuf + key_block->key_block_size);
-		if ((0 != VerifyKernelPreamble(
-					preamble,
-					KBUF_SIZE - key_block->key_block_size,
-					data_key))) {
-			VBDEBUG(("Preamble verification failed.\n"));
-			shpart->check_result = VBSD_LKP_CHECK_VERIFY_PREAMBLE;
-			goto bad_kernel;
+			(kbuf.data + key_block->key_block_size);
+
+		if (cache_hit) {
+			/* The data key is only needed to check signatures */
+			body_algorithm = (int)key_block->data_key.algorithm;
+		} else {
+			/* Get key for preamble/data verification */
+			data_key = KeyCacheGet(&data_keys,
+					       &key_block->data_key);
+			if (!data_key) {
+				VBDEBUG(("Data key bad.\n"));
+				shpart->check_result =
+					VBSD_LKP_CHECK_DATA_KEY_PARSE;
+				goto bad_kernel;
+			}
+			body_algorithm = (int)data_key->algorithm;
+
+			/* Verify the preamble, which follows the key block */
+			if ((0 != VerifyKernelPreamble(
+						preamble,
+						kbuf.read_size -
+						key_block->key_block_size,
+						data_key))) {
+				VBDEBUG(("Preamble verification failed.\n"));
+				shpart->check_result =
+					VBSD_LKP_CHECK_VERIFY_PREAMBLE;
+				goto bad_kernel;
+			}
 		}
 
 		/*
@@ -337,27 +760,42 @@ VbError_t LoadKernel(LoadKernelParams *params, VbCommonParams *cparams)
 			preamble->preamble_size;
 
 		/*
-		 * Make sure the kernel starts at or before what we already
-		 * read into kbuf.
-		 *
-		 * We could deal with a larger offset by reading and discarding
-		 * the data in between the vblock and the kernel data.
+		 * Make sure the kernel starts on a sector boundary, at or
+		 * before what we already read into kbuf, so it can be read
+		 * straight into the kernel buffer.  The second check can only
+		 * fail if the vblock is bigger than KBUF_MAX_SIZE.
 		 */
-		if (body_offset > KBUF_SIZE) {
+		if (body_offset % blba) {
 			shpart->check_result = VBSD_LKP_CHECK_BODY_OFFSET;
-			VBDEBUG(("Kernel body offset is %d > 64KB.\n",
+			VBDEBUG(("Kernel body offset %d is not sector aligned.\n",
 				 (int)body_offset));
 			goto bad_kernel;
 		}
+		if (body_offset > kbuf.read_size) {
+			shpart->check_result = VBSD_LKP_CHECK_BODY_OFFSET;
+			VBDEBUG(("Kernel body offset is %d > %d.\n",
+				 (int)body_offset, (int)kbuf.read_size));
+			goto bad_kernel;
+		}
+
+		/*
+		 * A compressed body is read into a temporary buffer, and
+		 * decompressed into the kernel buffer once it's verified.
+		 * It's the decompressed size which has to fit in memory.
+		 */
+		if (VBOOT_SUCCESS != VbKernelGetCompression(
+				preamble, &compression, &body_size)) {
+			VBDEBUG(("Unknown kernel body compression.\n"));
+			shpart->check_result = VBSD_LKP_CHECK_DECOMPRESS;
+			goto bad_kernel;
+		}
 
 		if (!params->kernel_buffer) {
 			/* Get kernel load address and size from the header. */
 			params->kernel_buffer =
 				(void *)((long)preamble->body_load_address);
-			params->kernel_buffer_size =
-				preamble->body_signature.data_size;
-		} else if (preamble->body_signature.data_size >
-			   params->kernel_buffer_size) {
+			params->kernel_buffer_size = body_size;
+		} else if (body_size > params->kernel_buffer_size) {
 			VBDEBUG(("Kernel body doesn't fit in memory.\n"));
 			shpart->check_result = VBSD_LKP_CHECK_BODY_EXCEEDS_MEM;
 			goto bad_kernel;
@@ -370,28 +808,55 @@ VbError_t LoadKernel(LoadKernelParams *params, VbCommonParams *cparams)
 		 * have one that big, we'd simply read too little data and fail
 		 * to verify it.
 		 */
+		if (preamble->body_signature.data_size >
+		    part_size * blba - body_offset) {
+			VBDEBUG(("Kernel body doesn't fit in partition.\n"));
+			shpart->check_result = VBSD_LKP_CHECK_BODY_EXCEEDS_PART;
+			goto bad_kernel;
+		}
 		body_toread = preamble->body_signature.data_size;
-		body_readptr = params->kernel_buffer;
+		body_dest = params->kernel_buffer;
+		if (COMPRESS_NONE != compression) {
+			/* Bigger than it decompresses to means it's bogus */
+			if (body_toread > params->kernel_buffer_size) {
+				VBDEBUG(("Compressed kernel body too big.\n"));
+				shpart->check_result =
+					VBSD_LKP_CHECK_BODY_EXCEEDS_MEM;
+				goto bad_kernel;
+			}
+			compressed_body = VbExMalloc(body_toread);
+			body_dest = compressed_body;
+		}
 
 		/*
-		 * If we've already read part of the kernel, copy that to the
-		 * beginning of the kernel buffer.
+		 * If the preamble has a table of body chunk digests, each
+		 * chunk is checked as it arrives, instead of checking the body
+		 * signature at the end.  The table is part of the preamble we
+		 * just verified.  Chunks which aren't whole sectors can't be
+		 * streamed that way, so those kernels use the body signature.
 		 */
-		if (body_offset < KBUF_SIZE) {
-			uint32_t body_copied = KBUF_SIZE - body_offset;
-
-			/* If the kernel is tiny, don't over-copy */
-			if (body_copied > body_toread)
-				body_copied = body_toread;
-
-			Memcpy(body_readptr, kbuf + body_offset, body_copied);
-			body_toread -= body_copied;
-			body_readptr += body_copied;
-		}
-
-		/* Read the kernel data */
-		if (body_toread &&
-		    0 != VbExStreamRead(stream, body_toread, body_readptr)) {
+		if (VBOOT_SUCCESS != VbKernelGetChunkHashes(
+				preamble, body_algorithm, &chunk_hashes,
+				&chunk_size) || chunk_size % blba)
+			chunk_hashes = NULL;
+
+		/* Read and hash the kernel data */
+		body_digest = NULL;
+		if (chunk_hashes)
+			rv = ReadKernelBodyChunks(stream, &kbuf, body_offset,
+						  body_dest, body_toread,
+						  body_algorithm,
+						  chunk_hashes, chunk_size);
+		else
+			rv = ReadKernelBody(stream, &kbuf, body_offset,
+					    body_dest, body_toread,
+					    blba, body_algorithm,
+					    &body_digest);
+		if (VBOOT_PREAMBLE_SIGNATURE == rv) {
+			VBDEBUG(("Kernel data verification failed.\n"));
+			shpart->check_result = VBSD_LKP_CHECK_VERIFY_DATA;
+			goto bad_kernel;
+		} else if (rv) {
 			VBDEBUG(("Unable to read kernel data.\n"));
 			shpart->check_result = VBSD_LKP_CHECK_READ_DATA;
 			goto bad_kernel;
@@ -401,18 +866,73 @@ VbError_t LoadKernel(LoadKernelParams *params, VbCommonParams *cparams)
 		VbExStreamClose(stream);
 		stream = NULL;
 
-		/* Verify kernel data */
-		if (0 != VerifyData((const uint8_t *)params->kernel_buffer,
-				    params->kernel_buffer_size,
-				    &preamble->body_signature, data_key)) {
+		/*
+		 * Verify kernel data, unless the chunks were already checked.
+		 * The body is no bigger than the kernel buffer, and if the
+		 * signature claims more data than we read, the digest won't
+		 * match.
+		 */
+		if (chunk_hashes) {
+			VBDEBUG(("Kernel body chunks are good.\n"));
+		} else if (cache_hit) {
+			if (verify_cache->body_digest_size !=
+			    hash_size_map[body_algorithm] ||
+			    SafeMemcmp(verify_cache->body_digest, body_digest,
+				       verify_cache->body_digest_size)) {
+				VbExFree(body_digest);
+				VBDEBUG(("Kernel data doesn't match cache.\n"));
+				shpart->check_result =
+					VBSD_LKP_CHECK_VERIFY_DATA;
+				goto bad_kernel;
+			}
+		} else if (0 != VerifyDigest(body_digest,
+					     &preamble->body_signature,
+					     data_key)) {
+			VbExFree(body_digest);
 			VBDEBUG(("Kernel data verification failed.\n"));
 			shpart->check_result = VBSD_LKP_CHECK_VERIFY_DATA;
 			goto bad_kernel;
 		}
 
-		/* Done with the kernel signing key, so can free it now */
-		RSAPublicKeyFree(data_key);
-		data_key = NULL;
+		/* Now that it's verified, decompress the body if needed */
+		if (compressed_body) {
+			out_size = params->kernel_buffer_size;
+			rv = VbExDecompress(compressed_body, body_toread,
+					    compression, params->kernel_buffer,
+					    &out_size);
+			VbExFree(compressed_body);
+			compressed_body = NULL;
+			if (rv || out_size != body_size) {
+				if (body_digest)
+					VbExFree(body_digest);
+				VBDEBUG(("Unable to decompress kernel.\n"));
+				shpart->check_result =
+					VBSD_LKP_CHECK_DECOMPRESS;
+				goto bad_kernel;
+			}
+		}
+
+		/*
+		 * Remember a kernel whose signatures all checked out and
+		 * whose body unpacked, so the next boot can skip the checks.
+		 */
+		if (vblock_digest_valid && !cache_hit && key_block_valid) {
+			verify_cache->struct_version =
+				VB_KERNEL_VERIFY_CACHE_VERSION;
+			verify_cache->flags |= VB_KERNEL_VERIFY_CACHE_FLAG_DIRTY;
+			verify_cache->sector_start = part_start;
+			verify_cache->sector_count = part_size;
+			Memcpy(verify_cache->vblock_digest, vblock_digest,
+			       sizeof(verify_cache->vblock_digest));
+			/* Chunked bodies get checked against the preamble */
+			verify_cache->body_digest_size = body_digest ?
+				hash_size_map[body_algorithm] : 0;
+			if (body_digest)
+				Memcpy(verify_cache->body_digest, body_digest,
+				       verify_cache->body_digest_size);
+		}
+		if (body_digest)
+			VbExFree(body_digest);
 
 		/*
 		 * If we're still here, the kernel is valid.  Save the first
@@ -473,8 +993,8 @@ VbError_t LoadKernel(LoadKernelParams *params, VbCommonParams *cparams)
 		/* Handle errors parsing this kernel */
 		if (NULL != stream)
 			VbExStreamClose(stream);
-		if (NULL != data_key)
-			RSAPublicKeyFree(data_key);
+		if (compressed_body)
+			VbExFree(compressed_body);
 
 		VBDEBUG(("Marking kernel as invalid.\n"));
 		GptUpdateKernelEntry(&gpt, GPT_UPDATE_ENTRY_BAD);
@@ -484,9 +1004,12 @@ VbError_t LoadKernel(LoadKernelParams *params, VbCommonParams *cparams)
 
  bad_gpt:
 
-	/* Free kernel buffer */
-	if (kbuf)
-		VbExFree(kbuf);
+	/* Free kernel buffer and unpacked keys */
+	if (kbuf.data)
+		VbExFree(kbuf.data);
+	if (kernel_subkey_rsa)
+		RSAPublicKeyFree(kernel_subkey_rsa);
+	KeyCacheFree(&data_keys);
 
 	/* Write and free GPT data */
 	WriteAndFreeGptData(params->disk_handle, &gpt);
@@ -84,6 +84,7 @@ int main(void)
 	VerifyData(0, 0, 0, 0);
 	VerifyDigest(0, 0, 0);
 	KeyBlockVerify(0, 0, 0, 0);
+	KeyBlockVerifyRSA(0, 0, 0);
 	VerifyFirmwarePreamble(0, 0, 0);
 	VbGetFirmwarePreambleFlags(0);
 	VerifyKernelPreamble(0, 0, 0);
@@ -16,6 +16,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -40,6 +41,10 @@
 /* The file descriptor for the TPM device.
  */
 static int tpm_fd = -1;
+/* Keeps each command and its response together when several threads share
+ * the device.  Sequences of commands still need the caller to serialize.
+ */
+static pthread_mutex_t tpm_lock = PTHREAD_MUTEX_INITIALIZER;
 /* If the library should exit during an OS-level TPM failure.
  */
 static int exit_on_failure = 1;
@@ -88,17 +93,24 @@ static VbError_t TpmExecute(const uint8_t *in, const uint32_t in_len,
                    "the TPM device was not opened.  " \
                    "Forgot to call TlclLibInit?\n");
   } else {
-    int n = write(tpm_fd, in, in_len);
+    int n, saved_errno;
+    pthread_mutex_lock(&tpm_lock);
+    n = write(tpm_fd, in, in_len);
     if (n != in_len) {
+      saved_errno = errno;
+      pthread_mutex_unlock(&tpm_lock);
       return DoError(TPM_E_WRITE_FAILURE,
-                     "write failure to TPM device: %s\n", strerror(errno));
+                     "write failure to TPM device: %s\n",
+                     strerror(saved_errno));
     }
     n = read(tpm_fd, response, sizeof(response));
+    saved_errno = errno;
+    pthread_mutex_unlock(&tpm_lock);
     if (n == 0) {
       return DoError(TPM_E_READ_EMPTY, "null read from TPM device\n");
     } else if (n < 0) {
       return DoError(TPM_E_READ_FAILURE, "read failure from TPM device: %s\n",
-                     strerror(errno));
+                     strerror(saved_errno));
     } else {
       if (n > *pout_len) {
         return DoError(TPM_E_RESPONSE_TOO_LARGE,
@@ -69,6 +69,23 @@ uint32_t VbExKeyboardReadWithFlags(uint32_t *flags_ptr)
 	return 0;
 }
 
+/* Interval between keyboard polls in VbExKeyboardWait() */
+#define KEY_POLL_MS 10
+
+uint32_t VbExKeyboardWait(uint32_t msec)
+{
+	uint32_t key = VbExKeyboardRead();
+
+	while (!key && msec) {
+		uint32_t step = msec < KEY_POLL_MS ? msec : KEY_POLL_MS;
+
+		VbExSleepMs(step);
+		msec -= step;
+		key = VbExKeyboardRead();
+	}
+	return key;
+}
+
 uint32_t VbExGetSwitches(uint32_t mask)
 {
 	return 0;
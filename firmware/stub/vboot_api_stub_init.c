@@ -17,11 +17,13 @@
 
 #include "vboot_api.h"
 
-/* U-Boot's printf uses '%L' for uint64_t. gcc uses '%l'. */
+/*
+ * U-Boot's printf uses '%L' for uint64_t. gcc uses '%l'. The fixed format goes
+ * in the caller's fmtbuf[MAX_FMT+1], so that threads don't share one.
+ */
 #define MAX_FMT 255
-static char fmtbuf[MAX_FMT+1];
 
-static const char *fixfmt(const char *format)
+static const char *fixfmt(const char *format, char *fmtbuf)
 {
 	int i;
 	for(i=0; i<MAX_FMT && format[i]; i++) {
@@ -37,20 +39,26 @@ static const char *fixfmt(const char *format)
 
 void VbExError(const char *format, ...)
 {
+	char fmtbuf[MAX_FMT+1];
 	va_list ap;
 	va_start(ap, format);
+	flockfile(stderr);
 	fprintf(stderr, "ERROR: ");
-	vfprintf(stderr, fixfmt(format), ap);
+	vfprintf(stderr, fixfmt(format, fmtbuf), ap);
+	funlockfile(stderr);
 	va_end(ap);
 	exit(1);
 }
 
 void VbExDebug(const char *format, ...)
 {
+	char fmtbuf[MAX_FMT+1];
 	va_list ap;
 	va_start(ap, format);
+	flockfile(stderr);
 	fprintf(stderr, "DEBUG: ");
-	vfprintf(stderr, fixfmt(format), ap);
+	vfprintf(stderr, fixfmt(format, fmtbuf), ap);
+	funlockfile(stderr);
 	va_end(ap);
 }
 
@@ -11,8 +11,16 @@
 
 #include "vboot_api.h"
 
-/* The stub implementation assumes 512-byte disk sectors */
-#define LBA_BYTES 512
+/*
+ * Disk sector size used by streams.  Defaults to 512 bytes; hosts emulating a
+ * native 4K-sector drive call vboot_api_stub_set_sector_bytes() first.
+ */
+static uint32_t lba_bytes = 512;
+
+void vboot_api_stub_set_sector_bytes(uint32_t bytes)
+{
+	lba_bytes = bytes;
+}
 
 /* Internal struct to simulate a stream for sector-based disks */
 struct disk_stream {
@@ -24,6 +32,9 @@ struct disk_stream {
 
 	/* Number of sectors left in partition */
 	uint64_t sectors_left;
+
+	/* Sector size in bytes, latched when the stream is opened */
+	uint32_t sector_bytes;
 };
 
 VbError_t VbExStreamOpen(VbExDiskHandle_t handle, uint64_t lba_start,
@@ -40,6 +51,7 @@ VbError_t VbExStreamOpen(VbExDiskHandle_t handle, uint64_t lba_start,
 	s->handle = handle;
 	s->sector = lba_start;
 	s->sectors_left = lba_count;
+	s->sector_bytes = lba_bytes;
 
 	*stream = (void *)s;
 
@@ -56,11 +68,11 @@ VbError_t VbExStreamRead(VbExStream_t stream, uint32_t bytes, void *buffer)
 		return VBERROR_UNKNOWN;
 
 	/* For now, require reads to be a multiple of the LBA size */
-	if (bytes % LBA_BYTES)
+	if (bytes % s->sector_bytes)
 		return VBERROR_UNKNOWN;
 
 	/* Fail on overflow */
-	sectors = bytes / LBA_BYTES;
+	sectors = bytes / s->sector_bytes;
 	if (sectors > s->sectors_left)
 		return VBERROR_UNKNOWN;
 
@@ -74,6 +86,15 @@ VbError_t VbExStreamRead(VbExStream_t stream, uint32_t bytes, void *buffer)
 	return VBERROR_SUCCESS;
 }
 
+VbError_t VbExStreamPrefetch(VbExStream_t stream, uint32_t bytes)
+{
+	/* Reads are synchronous, so there's nothing to do ahead of time */
+	if (!stream)
+		return VBERROR_UNKNOWN;
+
+	return VBERROR_SUCCESS;
+}
+
 void VbExStreamClose(VbExStream_t stream)
 {
 	struct disk_stream *s = (struct disk_stream *)stream;
@@ -0,0 +1,298 @@
+/*
+ * Copyright 2015 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Look at (and patch in place) files in an ext2/3/4 filesystem, which may be
+ * inside a partition of a disk image, without mounting anything.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "extfs.h"
+#include "futility.h"
+#include "gpt.h"
+#include "host_common.h"
+
+/* Local structure for args, etc. */
+static struct local_data_s {
+	uint32_t partition;
+} option;
+
+/*
+ * Find where GPT partition <partnum> (1-based) starts.  The GPT header is in
+ * LBA 1, which tells us whether this is a 512-byte or 4K-sector image.
+ */
+static int find_partition(int fd, uint32_t partnum, uint64_t *offset)
+{
+	uint32_t sector_bytes;
+	GptHeader header;
+	GptEntry entry;
+
+	for (sector_bytes = 512; sector_bytes <= 4096; sector_bytes *= 2) {
+		if (pread(fd, &header, sizeof(header), sector_bytes) !=
+		    sizeof(header))
+			continue;
+		if (!memcmp(header.signature, GPT_HEADER_SIGNATURE,
+			    GPT_HEADER_SIGNATURE_SIZE) ||
+		    !memcmp(header.signature, GPT_HEADER_SIGNATURE2,
+			    GPT_HEADER_SIGNATURE_SIZE))
+			break;
+	}
+	if (sector_bytes > 4096) {
+		fprintf(stderr, "No GPT header found\n");
+		return 1;
+	}
+
+	if (partnum > header.number_of_entries ||
+	    header.size_of_entry < sizeof(entry)) {
+		fprintf(stderr, "No partition %u in the GPT\n", partnum);
+		return 1;
+	}
+
+	if (pread(fd, &entry, sizeof(entry),
+		  header.entries_lba * sector_bytes +
+		  (uint64_t)(partnum - 1) * header.size_of_entry) !=
+	    sizeof(entry)) {
+		fprintf(stderr, "Can't read partition %u: %s\n", partnum,
+			strerror(errno));
+		return 1;
+	}
+	if (!entry.starting_lba || entry.ending_lba < entry.starting_lba) {
+		fprintf(stderr, "Partition %u is unused\n", partnum);
+		return 1;
+	}
+
+	*offset = entry.starting_lba * sector_bytes;
+	Debug("partition %u starts at 0x%" PRIx64 "\n", partnum, *offset);
+	return 0;
+}
+
+static int do_cat(struct extfs *fs, int argc, char *argv[])
+{
+	uint64_t size;
+	uint8_t *data;
+	int rv;
+
+	if (argc != 1) {
+		fprintf(stderr, "cat needs one PATH\n");
+		return 1;
+	}
+
+	rv = extfs_read_file(fs, argv[0], &data, &size);
+	if (rv) {
+		fprintf(stderr, "%s: %s\n", argv[0], extfs_strerror(rv));
+		return 1;
+	}
+	if (fwrite(data, 1, size, stdout) != size) {
+		fprintf(stderr, "Can't write to stdout: %s\n",
+			strerror(errno));
+		rv = 1;
+	}
+	free(data);
+	return rv;
+}
+
+static int print_entry(const char *name, const struct extfs_stat *st,
+		       void *arg)
+{
+	printf("%06o %10" PRIu64 " %s\n", st->mode, st->size, name);
+	return 0;
+}
+
+static int do_ls(struct extfs *fs, int argc, char *argv[])
+{
+	struct extfs_stat st;
+	int rv;
+
+	if (argc != 1) {
+		fprintf(stderr, "ls needs one PATH\n");
+		return 1;
+	}
+
+	rv = extfs_stat(fs, argv[0], &st);
+	if (!rv) {
+		if (S_ISDIR(st.mode))
+			rv = extfs_list_dir(fs, argv[0], print_entry, NULL);
+		else
+			rv = print_entry(argv[0], &st, NULL);
+	}
+	if (rv) {
+		fprintf(stderr, "%s: %s\n", argv[0], extfs_strerror(rv));
+		return 1;
+	}
+	return 0;
+}
+
+static int do_replace(struct extfs *fs, int argc, char *argv[])
+{
+	uint64_t size;
+	uint8_t *data;
+	int rv;
+
+	if (argc != 2) {
+		fprintf(stderr, "replace needs a PATH and a FILE\n");
+		return 1;
+	}
+
+	data = ReadFile(argv[1], &size);
+	if (!data)
+		return 1;
+
+	rv = extfs_write_file(fs, argv[0], data, size);
+	free(data);
+	if (rv) {
+		fprintf(stderr, "%s: %s\n", argv[0], extfs_strerror(rv));
+		return 1;
+	}
+	return 0;
+}
+
+static const struct {
+	const char *name;
+	int (*handler)(struct extfs *fs, int argc, char *argv[]);
+	int writes;
+} commands[] = {
+	{"cat", do_cat, 0},
+	{"ls", do_ls, 0},
+	{"replace", do_replace, 1},
+};
+
+static const char usage[] = "\n"
+	"Usage:  " MYNAME " %s [OPTIONS] IMAGE COMMAND PATH [FILE]\n"
+	"\n"
+	"Reads files in an ext2/3/4 filesystem without mounting it. IMAGE is\n"
+	"the filesystem itself, or a disk image if --partition is given.\n"
+	"Symlinks are followed as if the filesystem were mounted at /.\n"
+	"\n"
+	"Commands:\n"
+	"  cat PATH                      Copy a file to stdout\n"
+	"  ls PATH                       List a directory, showing the octal\n"
+	"                                  mode, size and name of each entry\n"
+	"  replace PATH FILE             Overwrite a file in place with the\n"
+	"                                  contents of FILE, which must be the\n"
+	"                                  same size\n"
+	"\n"
+	"Options:\n"
+	"  -p|--partition  NUM           Use GPT partition NUM of IMAGE\n"
+	"\n";
+
+static void print_help(const char *prog)
+{
+	printf(usage, prog);
+}
+
+static const struct option long_opts[] = {
+	/* name    hasarg *flag val */
+	{"partition",   1, NULL, 'p'},
+	{"debug",       0, &debugging_enabled, 1},
+	{NULL, 0, NULL, 0},
+};
+static char *short_opts = ":p:";
+
+static int do_extfs(int argc, char *argv[])
+{
+	struct extfs *fs;
+	uint64_t offset = 0;
+	int errorcnt = 0;
+	int cmd = -1;
+	char *e = 0;
+	int fd;
+	int i;
+
+	opterr = 0;		/* quiet, you */
+	while ((i = getopt_long(argc, argv, short_opts, long_opts, 0)) != -1) {
+		switch (i) {
+		case 'p':
+			option.partition = strtoul(optarg, &e, 0);
+			if (!*optarg || (e && *e) || !option.partition) {
+				fprintf(stderr, "Invalid --partition \"%s\"\n",
+					optarg);
+				errorcnt++;
+			}
+			break;
+
+		case '?':
+			if (optopt)
+				fprintf(stderr, "Unrecognized option: -%c\n",
+					optopt);
+			else
+				fprintf(stderr, "Unrecognized option\n");
+			errorcnt++;
+			break;
+		case ':':
+			fprintf(stderr, "Missing argument to -%c\n", optopt);
+			errorcnt++;
+			break;
+		case 0:				/* handled option */
+			break;
+		default:
+			DIE;
+		}
+	}
+
+	if (!errorcnt && argc - optind < 3) {
+		fprintf(stderr, "Need an IMAGE, a COMMAND and a PATH\n");
+		errorcnt++;
+	}
+	if (!errorcnt) {
+		for (i = 0; i < ARRAY_SIZE(commands); i++)
+			if (!strcmp(argv[optind + 1], commands[i].name))
+				cmd = i;
+		if (cmd < 0) {
+			fprintf(stderr, "Unknown command \"%s\"\n",
+				argv[optind + 1]);
+			errorcnt++;
+		}
+	}
+
+	if (errorcnt) {
+		print_help(argv[0]);
+		return 1;
+	}
+
+	fd = open(argv[optind], commands[cmd].writes ? O_RDWR : O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "Can't open %s: %s\n", argv[optind],
+			strerror(errno));
+		return 1;
+	}
+
+	if (option.partition &&
+	    find_partition(fd, option.partition, &offset)) {
+		close(fd);
+		return 1;
+	}
+
+	i = extfs_open(&fs, fd, offset, commands[cmd].writes);
+	if (i) {
+		fprintf(stderr, "%s: %s\n", argv[optind], extfs_strerror(i));
+		close(fd);
+		return 1;
+	}
+
+	errorcnt = commands[cmd].handler(fs, argc - optind - 2,
+					 argv + optind + 2);
+
+	extfs_close(fs);
+	if (close(fd)) {
+		fprintf(stderr, "Can't close %s: %s\n", argv[optind],
+			strerror(errno));
+		errorcnt++;
+	}
+	return !!errorcnt;
+}
+
+DECLARE_FUTIL_COMMAND(extfs, do_extfs,
+		      VBOOT_VERSION_ALL,
+		      "Read or patch files in an ext2/3/4 filesystem image",
+		      print_help);
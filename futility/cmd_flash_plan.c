@@ -0,0 +1,420 @@
+/*
+ * Copyright 2015 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Work out which erase blocks of the flash actually change between two BIOS
+ * images, so an update only has to erase and write those.
+ */
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "fmap.h"
+#include "futility.h"
+
+#define DEFAULT_ERASE_BLOCK 4096
+
+/* Local structure for args, etc. */
+static struct local_data_s {
+	uint32_t erase_block;
+	int ab_order;
+	char *outfile;
+} option = {
+	.erase_block = DEFAULT_ERASE_BLOCK,
+};
+
+/* One contiguous run of erase blocks that need rewriting */
+struct region_s {
+	uint32_t start;
+	uint32_t end;				/* inclusive */
+	FmapAreaHeader *ah;			/* smallest area, or NULL */
+	int rank;				/* for --ab_order */
+	int instance;				/* to make names unique */
+};
+
+/*
+ * Areas that belong to one of the RW firmware slots. With --ab_order, each
+ * slot's VBLOCK is written after the rest of that slot, so an interrupted
+ * update leaves the slot with a stale signature that won't verify instead
+ * of a valid signature over half-written firmware. flashrom writes all the
+ * regions it's given in one run in address order, and VBLOCK_A is below
+ * FW_MAIN_A, so each step has to be a separate run.
+ */
+static const struct {
+	const char * const name;
+	int slot;				/* 1 for A, 2 for B */
+	int is_vblock;
+} slot_area[] = {
+	{"RW_SECTION_A",    1, 0},
+	{"FW_MAIN_A",       1, 0},
+	{"VBLOCK_A",        1, 1},
+	{"RW_SECTION_B",    2, 0},
+	{"FW_MAIN_B",       2, 0},
+	{"VBLOCK_B",        2, 1},
+	/* Really old BIOS images */
+	{"Firmware A Data", 1, 0},
+	{"Firmware A Key",  1, 1},
+	{"Firmware B Data", 2, 0},
+	{"Firmware B Key",  2, 1},
+};
+
+static FmapAreaHeader *fmap_areas(FmapHeader *fmap)
+{
+	return (FmapAreaHeader *)((uint8_t *)fmap + sizeof(FmapHeader));
+}
+
+static int area_contains(FmapAreaHeader *ah, uint32_t len, uint32_t offset)
+{
+	/* Ignore areas that don't fit in the image */
+	if (ah->area_offset > len || ah->area_size > len - ah->area_offset)
+		return 0;
+	return offset >= ah->area_offset &&
+		offset - ah->area_offset < ah->area_size;
+}
+
+/* Find the smallest FMAP area that this offset is in */
+static FmapAreaHeader *find_area(FmapHeader *fmap, uint32_t len,
+				 uint32_t offset)
+{
+	FmapAreaHeader *ah = fmap_areas(fmap);
+	FmapAreaHeader *best = NULL;
+	int i;
+
+	for (i = 0; i < fmap->fmap_nareas; i++)
+		if (area_contains(&ah[i], len, offset) &&
+		    (!best || ah[i].area_size < best->area_size))
+			best = &ah[i];
+
+	return best;
+}
+
+/*
+ * Where does this offset go in the --ab_order ordering? Things outside the
+ * RW slots come first, then slot A and its VBLOCK, then slot B and its VBLOCK.
+ */
+static int find_rank(FmapHeader *fmap, uint32_t len, uint32_t offset)
+{
+	FmapAreaHeader *ah = fmap_areas(fmap);
+	int slot = 0, is_vblock = 0;
+	int i, j;
+
+	for (i = 0; i < fmap->fmap_nareas; i++) {
+		if (!area_contains(&ah[i], len, offset))
+			continue;
+		for (j = 0; j < ARRAY_SIZE(slot_area); j++)
+			if (!strncmp(ah[i].area_name, slot_area[j].name,
+				     FMAP_NAMELEN)) {
+				slot = slot_area[j].slot;
+				is_vblock |= slot_area[j].is_vblock;
+			}
+	}
+
+	return slot ? (slot - 1) * 2 + 1 + is_vblock : 0;
+}
+
+static int cmp_rank(const void *a, const void *b)
+{
+	const struct region_s *ra = a, *rb = b;
+
+	if (ra->rank != rb->rank)
+		return ra->rank < rb->rank ? -1 : 1;
+	return ra->start < rb->start ? -1 : ra->start > rb->start;
+}
+
+/* flashrom region names can't have spaces and such in them */
+static void print_name(FILE *fp, const struct region_s *r)
+{
+	const char *s;
+	int i;
+
+	if (!r->ah) {
+		fprintf(fp, "UNMAPPED");
+	} else {
+		s = r->ah->area_name;
+		for (i = 0; i < FMAP_NAMELEN && s[i]; i++)
+			fputc(isalnum((unsigned char)s[i]) ? s[i] : '_', fp);
+	}
+	if (r->instance)
+		fprintf(fp, "_%d", r->instance);
+}
+
+/*
+ * Compare the images one erase block at a time, and collect the runs of
+ * changed blocks. A run is split where the area it's in changes, so that
+ * each region has a sensible name and can be ordered on its own.
+ */
+static int plan_regions(uint8_t *old_buf, uint8_t *new_buf, uint32_t len,
+			FmapHeader *fmap, struct region_s *region,
+			uint32_t *changed_blocks)
+{
+	FmapAreaHeader *ah;
+	uint32_t offset, size;
+	int count = 0;
+	int rank;
+	int i, j, n;
+
+	*changed_blocks = 0;
+	for (offset = 0; offset < len; offset += size) {
+		size = option.erase_block;
+		if (size > len - offset)
+			size = len - offset;
+		if (!memcmp(old_buf + offset, new_buf + offset, size))
+			continue;
+
+		(*changed_blocks)++;
+		ah = find_area(fmap, len, offset);
+		rank = find_rank(fmap, len, offset);
+		if (count &&
+		    region[count - 1].end + 1 == offset &&
+		    region[count - 1].ah == ah &&
+		    region[count - 1].rank == rank) {
+			region[count - 1].end = offset + size - 1;
+			continue;
+		}
+
+		region[count].start = offset;
+		region[count].end = offset + size - 1;
+		region[count].ah = ah;
+		region[count].rank = rank;
+		region[count].instance = 0;
+		count++;
+	}
+
+	/* Number the regions that would otherwise have the same name */
+	for (i = 0; i < count; i++) {
+		if (region[i].instance)
+			continue;
+		n = 1;
+		for (j = i + 1; j < count; j++)
+			if (region[j].ah == region[i].ah)
+				region[j].instance = ++n;
+		if (n > 1)
+			region[i].instance = 1;
+	}
+
+	return count;
+}
+
+static const char usage[] = "\n"
+	"Usage:  " MYNAME " %s [OPTIONS] OLD_IMAGE NEW_IMAGE\n"
+	"\n"
+	"Finds the flash erase blocks that differ between two BIOS images of\n"
+	"the same size, and prints them as a flashrom layout file, so that an\n"
+	"update only rewrites what has changed. Each region is named after the\n"
+	"smallest FMAP area (in NEW_IMAGE) that it starts in.\n"
+	"\n"
+	"Options:\n"
+	"  -b|--erase_block  NUM         Erase block size (default 0x%x)\n"
+	"  -a|--ab_order                 Split the update into steps that\n"
+	"                                  must be written one at a time, in\n"
+	"                                  order: everything outside the RW\n"
+	"                                  slots, then each slot with its\n"
+	"                                  VBLOCK last. Needs --output.\n"
+	"  -o|--output       FILE        Write the layout to FILE, and print\n"
+	"                                  a summary\n"
+	"\n"
+	"flashrom writes all the regions it's given in one run in address\n"
+	"order, whatever order the layout lists them in. So with --ab_order,\n"
+	"each step is printed as a line of \"-i REGION\" arguments, and each\n"
+	"needs its own flashrom run, finishing before the next one starts:\n"
+	"\n"
+	"  flashrom -l FILE -i REGION [-i REGION...] -w NEW_IMAGE\n"
+	"\n";
+
+static void print_help(const char *prog)
+{
+	printf(usage, prog, DEFAULT_ERASE_BLOCK);
+}
+
+static const struct option long_opts[] = {
+	/* name    hasarg *flag val */
+	{"erase_block", 1, NULL, 'b'},
+	{"ab_order",    0, NULL, 'a'},
+	{"output",      1, NULL, 'o'},
+	{"debug",       0, &debugging_enabled, 1},
+	{NULL, 0, NULL, 0},
+};
+static char *short_opts = ":ab:o:";
+
+static int do_flash_plan(int argc, char *argv[])
+{
+	uint8_t *buf[2] = {0, 0};
+	uint32_t len[2] = {0, 0};
+	int fd[2] = {-1, -1};
+	struct region_s *region = 0;
+	uint32_t changed_blocks, changed_bytes;
+	FmapHeader *fmap;
+	FILE *fp = stdout;
+	int errorcnt = 0;
+	int count;
+	int step = 0;
+	char *e = 0;
+	int i;
+
+	opterr = 0;		/* quiet, you */
+	while ((i = getopt_long(argc, argv, short_opts, long_opts, 0)) != -1) {
+		switch (i) {
+		case 'a':
+			option.ab_order = 1;
+			break;
+		case 'b':
+			option.erase_block = strtoul(optarg, &e, 0);
+			if (!*optarg || (e && *e) || !option.erase_block ||
+			    (option.erase_block & (option.erase_block - 1))) {
+				fprintf(stderr,
+					"Invalid --erase_block \"%s\"\n",
+					optarg);
+				errorcnt++;
+			}
+			break;
+		case 'o':
+			option.outfile = optarg;
+			break;
+
+		case '?':
+			if (optopt)
+				fprintf(stderr, "Unrecognized option: -%c\n",
+					optopt);
+			else
+				fprintf(stderr, "Unrecognized option\n");
+			errorcnt++;
+			break;
+		case ':':
+			fprintf(stderr, "Missing argument to -%c\n", optopt);
+			errorcnt++;
+			break;
+		case 0:				/* handled option */
+			break;
+		default:
+			DIE;
+		}
+	}
+
+	if (!errorcnt && argc - optind != 2) {
+		fprintf(stderr, "Need an OLD_IMAGE and a NEW_IMAGE\n");
+		errorcnt++;
+	}
+
+	if (!errorcnt && option.ab_order && !option.outfile) {
+		fprintf(stderr, "--ab_order needs --output\n");
+		errorcnt++;
+	}
+
+	if (errorcnt) {
+		print_help(argv[0]);
+		return 1;
+	}
+
+	for (i = 0; i < 2; i++) {
+		fd[i] = open(argv[optind + i], O_RDONLY);
+		if (fd[i] < 0) {
+			fprintf(stderr, "Can't open %s: %s\n",
+				argv[optind + i], strerror(errno));
+			errorcnt++;
+			goto done;
+		}
+		if (futil_map_file(fd[i], MAP_RO, &buf[i], &len[i])) {
+			buf[i] = 0;
+			errorcnt++;
+			goto done;
+		}
+	}
+
+	if (len[0] != len[1]) {
+		fprintf(stderr, "The images are different sizes (0x%x, 0x%x)\n",
+			len[0], len[1]);
+		errorcnt++;
+		goto done;
+	}
+
+	fmap = fmap_find(buf[1], len[1]);
+	if (!fmap) {
+		fprintf(stderr, "Can't find an FMAP in %s\n", argv[optind + 1]);
+		errorcnt++;
+		goto done;
+	}
+
+	region = malloc((len[1] / option.erase_block + 1) * sizeof(*region));
+	if (!region) {
+		fprintf(stderr, "Can't allocate memory\n");
+		errorcnt++;
+		goto done;
+	}
+
+	count = plan_regions(buf[0], buf[1], len[1], fmap, region,
+			     &changed_blocks);
+	if (option.ab_order)
+		qsort(region, count, sizeof(*region), cmp_rank);
+
+	if (option.outfile) {
+		fp = fopen(option.outfile, "w");
+		if (!fp) {
+			fprintf(stderr, "Can't open %s for writing: %s\n",
+				option.outfile, strerror(errno));
+			errorcnt++;
+			goto done;
+		}
+	}
+
+	changed_bytes = 0;
+	for (i = 0; i < count; i++) {
+		fprintf(fp, "%08x:%08x ", region[i].start, region[i].end);
+		print_name(fp, &region[i]);
+		fprintf(fp, "\n");
+		changed_bytes += region[i].end - region[i].start + 1;
+	}
+
+	if (option.outfile) {
+		if (fclose(fp)) {
+			fprintf(stderr, "Error writing %s: %s\n",
+				option.outfile, strerror(errno));
+			errorcnt++;
+			goto done;
+		}
+		printf("%u of %u erase blocks (0x%x of 0x%x bytes) changed,"
+		       " in %d regions\n",
+		       changed_blocks,
+		       (len[1] + option.erase_block - 1) / option.erase_block,
+		       changed_bytes, len[1], count);
+	}
+
+	/* One flashrom run per step; regions of a step share a rank */
+	for (i = 0; option.ab_order && i < count; i++) {
+		if (!i || region[i].rank != region[i - 1].rank)
+			printf("%sstep %d:", i ? "\n" : "", ++step);
+		printf(" -i ");
+		print_name(stdout, &region[i]);
+		if (i == count - 1)
+			printf("\n");
+	}
+
+done:
+	free(region);
+	for (i = 0; i < 2; i++) {
+		if (buf[i])
+			errorcnt |= futil_unmap_file(fd[i], MAP_RO,
+						     buf[i], len[i]);
+		if (fd[i] >= 0 && close(fd[i])) {
+			fprintf(stderr, "Error closing %s: %s\n",
+				argv[optind + i], strerror(errno));
+			errorcnt++;
+		}
+	}
+
+	return !!errorcnt;
+}
+
+DECLARE_FUTIL_COMMAND(flash_plan, do_flash_plan,
+		      VBOOT_VERSION_ALL,
+		      "Find the flash erase blocks that differ between images",
+		      print_help);
@@ -4,6 +4,7 @@
  * found in the LICENSE file.
  */
 #include <errno.h>
+#include <fcntl.h>
 #include <getopt.h>
 #include <inttypes.h>
 #include <stddef.h>
@@ -347,6 +348,167 @@ done_close:
 	return r;
 }
 
+/* Apply the requested changes to [gbb], which must be in writable memory */
+static void patch_gbb(GoogleBinaryBlockHeader *gbb, const char *opt_hwid,
+		      const char *opt_flags, const char *opt_rootkey,
+		      const char *opt_bmpfv, const char *opt_recoverykey)
+{
+	uint8_t *gbb_base = (uint8_t *) gbb;
+
+	if (opt_hwid) {
+		if (strlen(opt_hwid) + 1 > gbb->hwid_size) {
+			fprintf(stderr,
+				"ERROR: null-terminated HWID"
+				" exceeds capacity (%d)\n",
+				gbb->hwid_size);
+			errorcnt++;
+		} else {
+			/* Wipe data before writing new value. */
+			memset(gbb_base + gbb->hwid_offset, 0,
+			       gbb->hwid_size);
+			strcpy((char *)(gbb_base + gbb->hwid_offset),
+			       opt_hwid);
+			update_hwid_digest(gbb);
+		}
+	}
+
+	if (opt_flags) {
+		char *e = NULL;
+		uint32_t val;
+		val = (uint32_t) strtoul(opt_flags, &e, 0);
+		if (e && *e) {
+			fprintf(stderr,
+				"ERROR: invalid flags value: %s\n",
+				opt_flags);
+			errorcnt++;
+		} else {
+			gbb->flags = val;
+		}
+	}
+
+	if (opt_rootkey)
+		read_from_file("root_key", opt_rootkey,
+			       gbb_base + gbb->rootkey_offset,
+			       gbb->rootkey_size);
+	if (opt_bmpfv)
+		read_from_file("bmp_fv", opt_bmpfv,
+			       gbb_base + gbb->bmpfv_offset,
+			       gbb->bmpfv_size);
+	if (opt_recoverykey)
+		read_from_file("recovery_key", opt_recoverykey,
+			       gbb_base + gbb->recovery_key_offset,
+			       gbb->recovery_key_size);
+}
+
+/*
+ * Update the GBB in [filename] in place.  Only the GBB is read into memory
+ * and patched, and it's only written back if there are no problems, so the
+ * rest of the image is never touched.
+ */
+static void set_gbb_in_file(const char *filename, const char *opt_hwid,
+			    const char *opt_flags, const char *opt_rootkey,
+			    const char *opt_bmpfv, const char *opt_recoverykey)
+{
+	int fd;
+	uint8_t *buf;
+	uint32_t len;
+	GoogleBinaryBlockHeader *gbb;
+	uint8_t *gbb_copy;
+	uint32_t gbb_size;
+
+	fd = open(filename, O_RDWR);
+	if (fd < 0) {
+		fprintf(stderr, "ERROR: Unable to open %s for writing: %s\n",
+			filename, strerror(errno));
+		errorcnt++;
+		return;
+	}
+
+	if (0 != futil_map_file(fd, MAP_RW, &buf, &len)) {
+		errorcnt++;
+		close(fd);
+		return;
+	}
+
+	gbb = FindGbbHeader(buf, len);
+	if (!gbb) {
+		fprintf(stderr, "ERROR: No GBB found in %s\n", filename);
+		goto done;
+	}
+	futil_valid_gbb_header(gbb, len - ((uint8_t *)gbb - buf), &gbb_size);
+
+	gbb_copy = (uint8_t *) malloc(gbb_size);
+	if (!gbb_copy) {
+		errorcnt++;
+		fprintf(stderr, "ERROR: can't malloc %" PRIu32 " bytes: %s\n",
+			gbb_size, strerror(errno));
+		goto done;
+	}
+	memcpy(gbb_copy, gbb, gbb_size);
+
+	patch_gbb((GoogleBinaryBlockHeader *)gbb_copy, opt_hwid, opt_flags,
+		  opt_rootkey, opt_bmpfv, opt_recoverykey);
+
+	/* Write it back if there are no problems. */
+	if (!errorcnt)
+		memcpy(gbb, gbb_copy, gbb_size);
+	free(gbb_copy);
+
+done:
+	if (0 != futil_unmap_file(fd, MAP_RW, buf, len))
+		errorcnt++;
+	if (0 != close(fd)) {
+		fprintf(stderr, "ERROR: Unable to close %s: %s\n",
+			filename, strerror(errno));
+		errorcnt++;
+	}
+}
+
+/*
+ * Copy [infile] to a new temporary file next to [outfile], so that [outfile]
+ * can be atomically replaced once the copy has been updated.  The copy gets
+ * the mode of [outfile] if it exists, or else of [infile].  Returns the name
+ * of the temporary file, which the caller must free, or NULL if error.
+ */
+static char *copy_to_temp_file(const char *infile, const char *outfile)
+{
+	struct stat sb;
+	char *tmpfile;
+	int fd;
+
+	if (0 != stat(outfile, &sb) && 0 != stat(infile, &sb)) {
+		fprintf(stderr, "ERROR: can't stat %s: %s\n",
+			infile, strerror(errno));
+		errorcnt++;
+		return NULL;
+	}
+
+	tmpfile = (char *) malloc(strlen(outfile) + sizeof(".XXXXXX"));
+	if (!tmpfile) {
+		fprintf(stderr, "ERROR: can't malloc temp file name: %s\n",
+			strerror(errno));
+		errorcnt++;
+		return NULL;
+	}
+	sprintf(tmpfile, "%s.XXXXXX", outfile);
+
+	fd = mkstemp(tmpfile);
+	if (fd < 0) {
+		fprintf(stderr, "ERROR: Unable to create %s: %s\n",
+			tmpfile, strerror(errno));
+		errorcnt++;
+		free(tmpfile);
+		return NULL;
+	}
+	if (0 != fchmod(fd, sb.st_mode & 07777))
+		fprintf(stderr, "WARNING: Unable to set mode of %s: %s\n",
+			tmpfile, strerror(errno));
+	close(fd);
+
+	futil_copy_file_or_die(infile, tmpfile);
+	return tmpfile;
+}
+
 static int do_gbb_utility(int argc, char *argv[])
 {
 	enum do_what_now { DO_GET, DO_SET, DO_CREATE } mode = DO_GET;
@@ -364,6 +526,7 @@ static int do_gbb_utility(int argc, char *argv[])
 	uint8_t *inbuf = NULL;
 	off_t filesize;
 	uint8_t *outbuf = NULL;
+	char *tmpfile;
 	GoogleBinaryBlockHeader *gbb;
 	uint8_t *gbb_base;
 	int i;
@@ -523,86 +686,36 @@ static int do_gbb_utility(int argc, char *argv[])
 			return 1;
 		}
 
-		/* With no args, we'll either copy it unchanged or do nothing */
-		inbuf = read_entire_file(infile, &filesize);
-		if (!inbuf)
-			break;
-
-		gbb = FindGbbHeader(inbuf, filesize);
-		if (!gbb) {
-			fprintf(stderr, "ERROR: No GBB found in %s\n", infile);
-			break;
-		}
-		gbb_base = (uint8_t *) gbb;
-
-		outbuf = (uint8_t *) malloc(filesize);
-		if (!outbuf) {
-			errorcnt++;
-			fprintf(stderr,
-				"ERROR: can't malloc %" PRIi64 " bytes: %s\n",
-				filesize, strerror(errno));
-			break;
-		}
-
-		/* Switch pointers to outbuf */
-		memcpy(outbuf, inbuf, filesize);
-		gbb = FindGbbHeader(outbuf, filesize);
-		if (!gbb) {
-			fprintf(stderr,
-				"INTERNAL ERROR: No GBB found in outbuf\n");
-			exit(1);
-		}
-		gbb_base = (uint8_t *) gbb;
-
-		if (opt_hwid) {
-			if (strlen(opt_hwid) + 1 > gbb->hwid_size) {
-				fprintf(stderr,
-					"ERROR: null-terminated HWID"
-					" exceeds capacity (%d)\n",
-					gbb->hwid_size);
-				errorcnt++;
-			} else {
-				/* Wipe data before writing new value. */
-				memset(gbb_base + gbb->hwid_offset, 0,
-				       gbb->hwid_size);
-				strcpy((char *)(gbb_base + gbb->hwid_offset),
-				       opt_hwid);
-				update_hwid_digest(gbb);
-			}
-		}
-
-		if (opt_flags) {
-			char *e = NULL;
-			uint32_t val;
-			val = (uint32_t) strtoul(opt_flags, &e, 0);
-			if (e && *e) {
+		/*
+		 * With no args, we'll either copy it unchanged or do nothing.
+		 * A new output file is written under a temporary name and
+		 * renamed into place, so it's never left half-written.
+		 */
+		if (!strcmp(infile, outfile)) {
+			set_gbb_in_file(infile, opt_hwid, opt_flags,
+					opt_rootkey, opt_bmpfv,
+					opt_recoverykey);
+		} else {
+			tmpfile = copy_to_temp_file(infile, outfile);
+			if (!tmpfile)
+				break;
+			set_gbb_in_file(tmpfile, opt_hwid, opt_flags,
+					opt_rootkey, opt_bmpfv,
+					opt_recoverykey);
+			if (!errorcnt && 0 != rename(tmpfile, outfile)) {
 				fprintf(stderr,
-					"ERROR: invalid flags value: %s\n",
-					opt_flags);
+					"ERROR: Unable to rename %s to %s: %s\n",
+					tmpfile, outfile, strerror(errno));
 				errorcnt++;
-			} else {
-				gbb->flags = val;
 			}
+			if (errorcnt)
+				unlink(tmpfile);
+			free(tmpfile);
 		}
 
-		if (opt_rootkey)
-			read_from_file("root_key", opt_rootkey,
-				       gbb_base + gbb->rootkey_offset,
-				       gbb->rootkey_size);
-		if (opt_bmpfv)
-			read_from_file("bmp_fv", opt_bmpfv,
-				       gbb_base + gbb->bmpfv_offset,
-				       gbb->bmpfv_size);
-		if (opt_recoverykey)
-			read_from_file("recovery_key", opt_recoverykey,
-				       gbb_base + gbb->recovery_key_offset,
-				       gbb->recovery_key_size);
-
-		/* Write it out if there are no problems. */
 		if (!errorcnt)
-			write_to_file("successfully saved new image to:",
-				      outfile, outbuf, filesize);
-
+			printf("successfully saved new image to: %s\n",
+			       outfile);
 		break;
 
 	case DO_CREATE:
@@ -0,0 +1,882 @@
+/*
+ * Copyright 2015 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Keeps an on-disk index of the key and rollback versions found in the vboot
+ * objects under one or more directory trees, so that audits don't have to
+ * re-parse every file each time.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "cryptolib.h"
+#include "file_type.h"
+#include "futility.h"
+#include "gbb_header.h"
+#include "host_common.h"
+#include "traversal.h"
+#include "vboot_common.h"
+
+#define INDEX_HEADER "# futility index 1"
+#define SHA1_HEX_SIZE (SHA1_DIGEST_SIZE * 2 + 1)
+
+/* One versioned thing found in a file */
+struct index_component_s {
+	char area[32];			/* FMAP area, or "-" for the file */
+	char kind[16];			/* pubkey, keyblock, firmware, kernel */
+	uint64_t key_version;		/* of the pubkey or keyblock data key */
+	char key_sha1[SHA1_HEX_SIZE];
+	uint64_t keyblock_flags;
+	uint64_t version;		/* firmware or kernel version */
+	uint64_t subkey_version;	/* firmware preamble kernel subkey */
+	char subkey_sha1[SHA1_HEX_SIZE];
+	uint32_t flags;			/* preamble flags */
+};
+
+/* One file, and what it contains */
+struct index_file_s {
+	char *path;
+	uint64_t size;
+	int64_t mtime_ns;
+	int64_t ctime_ns;
+	char sha1[SHA1_HEX_SIZE];
+	char type[32];
+	uint32_t num_components;
+	struct index_component_s *components;
+};
+
+struct index_s {
+	struct index_file_s *files;
+	uint32_t num_files;
+	uint32_t max_files;
+};
+
+/* Local structure for args, etc. */
+static struct local_data_s {
+	const char *index_file;
+	const char *max_kind;
+	int quiet;
+} option = {
+	.index_file = "futility.index",
+};
+
+/* The index as last written, and the one being built. */
+static struct index_s old_index, new_index;
+/* Entries of old_index, sorted by content hash */
+static struct index_file_s **old_by_sha1;
+/* The file being parsed by the traversal callbacks */
+static struct index_file_s *cur_file;
+/* The index file itself, which mustn't be indexed */
+static struct stat index_sb;
+static int have_index_sb;
+
+static uint32_t count_unchanged, count_reused, count_parsed, count_kept;
+static int walk_errors;
+
+static void sha1_hex(const uint8_t *buf, uint64_t len, char *out)
+{
+	uint8_t *digest = DigestBuf(buf, len, SHA1_DIGEST_ALGORITHM);
+	int i;
+
+	for (i = 0; i < SHA1_DIGEST_SIZE; i++)
+		sprintf(out + i * 2, "%02x", digest[i]);
+	free(digest);
+}
+
+static void key_sha1_hex(VbPublicKey *key, char *out)
+{
+	sha1_hex(GetPublicKeyData(key), key->key_size, out);
+}
+
+static struct index_file_s *add_file(struct index_s *index)
+{
+	struct index_file_s *f;
+
+	if (index->num_files == index->max_files) {
+		index->max_files = index->max_files ? index->max_files * 2 : 64;
+		index->files = realloc(index->files,
+				       index->max_files * sizeof(*f));
+		if (!index->files) {
+			fprintf(stderr, "Out of memory\n");
+			exit(1);
+		}
+	}
+	f = &index->files[index->num_files++];
+	memset(f, 0, sizeof(*f));
+	return f;
+}
+
+static struct index_component_s *add_component(struct index_file_s *f,
+					       const char *area,
+					       const char *kind)
+{
+	struct index_component_s *c;
+
+	f->components = realloc(f->components,
+				(f->num_components + 1) * sizeof(*c));
+	if (!f->components) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+	c = &f->components[f->num_components++];
+	memset(c, 0, sizeof(*c));
+	snprintf(c->area, sizeof(c->area), "%s", area);
+	snprintf(c->kind, sizeof(c->kind), "%s", kind);
+	strcpy(c->key_sha1, "-");
+	strcpy(c->subkey_sha1, "-");
+	return c;
+}
+
+static void copy_components(struct index_file_s *to,
+			    const struct index_file_s *from)
+{
+	strcpy(to->type, from->type);
+	to->num_components = from->num_components;
+	to->components = NULL;
+	if (!from->num_components)
+		return;
+	to->components = malloc(from->num_components *
+				sizeof(*from->components));
+	if (!to->components) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+	memcpy(to->components, from->components,
+	       from->num_components * sizeof(*from->components));
+}
+
+static void free_index(struct index_s *index)
+{
+	uint32_t i;
+
+	for (i = 0; i < index->num_files; i++) {
+		free(index->files[i].path);
+		free(index->files[i].components);
+	}
+	free(index->files);
+	memset(index, 0, sizeof(*index));
+}
+
+static int cmp_path(const void *a, const void *b)
+{
+	return strcmp(((const struct index_file_s *)a)->path,
+		      ((const struct index_file_s *)b)->path);
+}
+
+static int cmp_sha1(const void *a, const void *b)
+{
+	return strcmp((*(struct index_file_s * const *)a)->sha1,
+		      (*(struct index_file_s * const *)b)->sha1);
+}
+
+/* Name of the area a traversal callback is looking at */
+static const char *area_name(struct futil_traverse_state_s *state)
+{
+	switch (state->component) {
+	case CB_FMAP_GBB:
+	case CB_FMAP_VBLOCK_A:
+	case CB_FMAP_VBLOCK_B:
+		return state->name;
+	default:
+		return "-";
+	}
+}
+
+/****************************************************************************/
+/* Traversal callbacks. These record what they find in cur_file. */
+
+int futil_cb_index_pubkey(struct futil_traverse_state_s *state)
+{
+	VbPublicKey *pubkey = (VbPublicKey *)state->my_area->buf;
+	struct index_component_s *c;
+
+	if (!PublicKeyLooksOkay(pubkey, state->my_area->len))
+		return 0;
+
+	c = add_component(cur_file, area_name(state), "pubkey");
+	c->key_version = pubkey->key_version;
+	key_sha1_hex(pubkey, c->key_sha1);
+	return 0;
+}
+
+int futil_cb_index_gbb(struct futil_traverse_state_s *state)
+{
+	uint8_t *buf = state->my_area->buf;
+	uint32_t len = state->my_area->len;
+	GoogleBinaryBlockHeader *gbb = (GoogleBinaryBlockHeader *)buf;
+	struct index_component_s *c;
+	VbPublicKey *pubkey;
+
+	if (!len || !futil_valid_gbb_header(gbb, len, NULL))
+		return 0;
+
+	pubkey = (VbPublicKey *)(buf + gbb->rootkey_offset);
+	if (PublicKeyLooksOkay(pubkey, gbb->rootkey_size)) {
+		c = add_component(cur_file, area_name(state), "rootkey");
+		c->key_version = pubkey->key_version;
+		key_sha1_hex(pubkey, c->key_sha1);
+	}
+
+	pubkey = (VbPublicKey *)(buf + gbb->recovery_key_offset);
+	if (PublicKeyLooksOkay(pubkey, gbb->recovery_key_size)) {
+		c = add_component(cur_file, area_name(state), "recovery_key");
+		c->key_version = pubkey->key_version;
+		key_sha1_hex(pubkey, c->key_sha1);
+	}
+	return 0;
+}
+
+int futil_cb_index_keyblock(struct futil_traverse_state_s *state)
+{
+	VbKeyBlockHeader *block = (VbKeyBlockHeader *)state->my_area->buf;
+	struct index_component_s *c;
+
+	if (VBOOT_SUCCESS != KeyBlockVerify(block, state->my_area->len,
+					    NULL, 1))
+		return 0;
+
+	c = add_component(cur_file, area_name(state), "keyblock");
+	c->key_version = block->data_key.key_version;
+	key_sha1_hex(&block->data_key, c->key_sha1);
+	c->keyblock_flags = block->key_block_flags;
+	return 0;
+}
+
+int futil_cb_index_fw_preamble(struct futil_traverse_state_s *state)
+{
+	VbKeyBlockHeader *block = (VbKeyBlockHeader *)state->my_area->buf;
+	uint32_t len = state->my_area->len;
+	VbFirmwarePreambleHeader *preamble;
+	struct index_component_s *c;
+	RSAPublicKey *rsa;
+	int rv;
+
+	if (!len || VBOOT_SUCCESS != KeyBlockVerify(block, len, NULL, 1))
+		return 0;
+
+	rsa = PublicKeyToRSA(&block->data_key);
+	if (!rsa)
+		return 0;
+	preamble = (VbFirmwarePreambleHeader *)
+		(state->my_area->buf + block->key_block_size);
+	rv = VerifyFirmwarePreamble(preamble, len - block->key_block_size,
+				    rsa);
+	RSAPublicKeyFree(rsa);
+	if (VBOOT_SUCCESS != rv)
+		return 0;
+
+	c = add_component(cur_file, area_name(state), "firmware");
+	c->key_version = block->data_key.key_version;
+	key_sha1_hex(&block->data_key, c->key_sha1);
+	c->keyblock_flags = block->key_block_flags;
+	c->version = preamble->firmware_version;
+	c->subkey_version = preamble->kernel_subkey.key_version;
+	key_sha1_hex(&preamble->kernel_subkey, c->subkey_sha1);
+	c->flags = VbGetFirmwarePreambleFlags(preamble);
+	return 0;
+}
+
+int futil_cb_index_kernel_preamble(struct futil_traverse_state_s *state)
+{
+	VbKeyBlockHeader *block = (VbKeyBlockHeader *)state->my_area->buf;
+	uint32_t len = state->my_area->len;
+	VbKernelPreambleHeader *preamble;
+	struct index_component_s *c;
+	RSAPublicKey *rsa;
+	int rv;
+
+	if (VBOOT_SUCCESS != KeyBlockVerify(block, len, NULL, 1))
+		return 0;
+
+	rsa = PublicKeyToRSA(&block->data_key);
+	if (!rsa)
+		return 0;
+	preamble = (VbKernelPreambleHeader *)
+		(state->my_area->buf + block->key_block_size);
+	rv = VerifyKernelPreamble(preamble, len - block->key_block_size, rsa);
+	RSAPublicKeyFree(rsa);
+	if (VBOOT_SUCCESS != rv)
+		return 0;
+
+	c = add_component(cur_file, area_name(state), "kernel");
+	c->key_version = block->data_key.key_version;
+	key_sha1_hex(&block->data_key, c->key_sha1);
+	c->keyblock_flags = block->key_block_flags;
+	c->version = preamble->kernel_version;
+	if (VbKernelHasFlags(preamble) == VBOOT_SUCCESS)
+		c->flags = preamble->flags;
+	return 0;
+}
+
+/****************************************************************************/
+/* Reading and writing the index */
+
+static char *next_field(char **line)
+{
+	char *field = strsep(line, "\t");
+	return field ? field : "";
+}
+
+static int read_index(const char *filename, struct index_s *index)
+{
+	struct index_file_s *f = NULL;
+	char *line = NULL;
+	size_t line_size = 0;
+	ssize_t n;
+	int lineno = 0;
+	FILE *fp;
+
+	fp = fopen(filename, "r");
+	if (!fp) {
+		if (errno == ENOENT)
+			return 0;	/* Start from scratch */
+		fprintf(stderr, "Can't open %s: %s\n",
+			filename, strerror(errno));
+		return 1;
+	}
+
+	while ((n = getline(&line, &line_size, fp)) >= 0) {
+		char *p = line;
+		char *tag;
+
+		lineno++;
+		if (n && line[n - 1] == '\n')
+			line[n - 1] = '\0';
+
+		if (lineno == 1) {
+			if (strcmp(line, INDEX_HEADER))
+				break;
+			continue;
+		}
+
+		tag = next_field(&p);
+		if (!strcmp(tag, "F")) {
+			f = add_file(index);
+			f->path = strdup(next_field(&p));
+			f->size = strtoull(next_field(&p), NULL, 0);
+			f->mtime_ns = strtoll(next_field(&p), NULL, 0);
+			f->ctime_ns = strtoll(next_field(&p), NULL, 0);
+			snprintf(f->sha1, sizeof(f->sha1), "%s",
+				 next_field(&p));
+			snprintf(f->type, sizeof(f->type), "%s",
+				 next_field(&p));
+		} else if (!strcmp(tag, "C") && f) {
+			struct index_component_s *c;
+			char *area = next_field(&p);
+			char *kind = next_field(&p);
+
+			c = add_component(f, area, kind);
+			c->key_version = strtoull(next_field(&p), NULL, 0);
+			snprintf(c->key_sha1, sizeof(c->key_sha1), "%s",
+				 next_field(&p));
+			c->keyblock_flags = strtoull(next_field(&p), NULL, 0);
+			c->version = strtoull(next_field(&p), NULL, 0);
+			c->subkey_version = strtoull(next_field(&p), NULL, 0);
+			snprintf(c->subkey_sha1, sizeof(c->subkey_sha1), "%s",
+				 next_field(&p));
+			c->flags = strtoul(next_field(&p), NULL, 0);
+		} else {
+			break;
+		}
+	}
+	free(line);
+	fclose(fp);
+
+	if (n >= 0) {
+		fprintf(stderr, "%s:%d: not a valid futility index\n",
+			filename, lineno);
+		return 1;
+	}
+	return 0;
+}
+
+static int write_index(const char *filename, struct index_s *index)
+{
+	char *tmpname;
+	uint32_t i, j;
+	FILE *fp;
+
+	if (asprintf(&tmpname, "%s.tmp", filename) < 0) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+
+	fp = fopen(tmpname, "w");
+	if (!fp) {
+		fprintf(stderr, "Can't open %s: %s\n",
+			tmpname, strerror(errno));
+		free(tmpname);
+		return 1;
+	}
+
+	fprintf(fp, "%s\n", INDEX_HEADER);
+	for (i = 0; i < index->num_files; i++) {
+		struct index_file_s *f = &index->files[i];
+
+		fprintf(fp, "F\t%s\t%" PRIu64 "\t%" PRId64 "\t%" PRId64
+			"\t%s\t%s\n", f->path, f->size, f->mtime_ns,
+			f->ctime_ns, f->sha1, f->type);
+		for (j = 0; j < f->num_components; j++) {
+			struct index_component_s *c = &f->components[j];
+
+			fprintf(fp, "C\t%s\t%s\t%" PRIu64 "\t%s\t%" PRIu64
+				"\t%" PRIu64 "\t%" PRIu64 "\t%s\t%" PRIu32
+				"\n", c->area, c->kind, c->key_version,
+				c->key_sha1, c->keyblock_flags, c->version,
+				c->subkey_version, c->subkey_sha1, c->flags);
+		}
+	}
+
+	/* Only replace the old index once the new one is complete */
+	if (fclose(fp) || rename(tmpname, filename)) {
+		fprintf(stderr, "Can't write %s: %s\n",
+			filename, strerror(errno));
+		unlink(tmpname);
+		free(tmpname);
+		return 1;
+	}
+
+	free(tmpname);
+	return 0;
+}
+
+/****************************************************************************/
+/* Walking the directory trees */
+
+/* Hash and parse a new or changed file */
+static int index_contents(const char *path, struct index_file_s *f)
+{
+	struct futil_traverse_state_s state;
+	struct index_file_s key, *keyp = &key, **found;
+	uint8_t *buf;
+	uint32_t len;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "Can't open %s: %s\n", path, strerror(errno));
+		return 1;
+	}
+
+	if (!f->size) {
+		sha1_hex((const uint8_t *)"", 0, f->sha1);
+		strcpy(f->type, futil_file_type_str(FILE_TYPE_UNKNOWN));
+		close(fd);
+		count_parsed++;
+		return 0;
+	}
+
+	if (0 != futil_map_file(fd, MAP_RO, &buf, &len)) {
+		close(fd);
+		return 1;
+	}
+
+	sha1_hex(buf, len, f->sha1);
+
+	/* Same content as something we've already parsed? */
+	strcpy(key.sha1, f->sha1);
+	found = old_by_sha1 ? bsearch(&keyp, old_by_sha1,
+				      old_index.num_files,
+				      sizeof(*old_by_sha1), cmp_sha1) : NULL;
+	if (found) {
+		copy_components(f, *found);
+		count_reused++;
+	} else {
+		memset(&state, 0, sizeof(state));
+		state.in_filename = path;
+		state.op = FUTIL_OP_INDEX;
+		cur_file = f;
+		futil_traverse(buf, len, &state, FILE_TYPE_UNKNOWN);
+		cur_file = NULL;
+		snprintf(f->type, sizeof(f->type), "%s",
+			 futil_file_type_str(state.in_type));
+		count_parsed++;
+	}
+
+	futil_unmap_file(fd, MAP_RO, buf, len);
+	close(fd);
+	return 0;
+}
+
+static int walk_cb(const char *path, const struct stat *sb, int typeflag,
+		   struct FTW *ftwbuf)
+{
+	struct index_file_s key, *old, *f;
+
+	if (typeflag != FTW_F || !S_ISREG(sb->st_mode))
+		return 0;
+
+	/* Don't index the index */
+	if (have_index_sb && sb->st_dev == index_sb.st_dev &&
+	    sb->st_ino == index_sb.st_ino)
+		return 0;
+
+	if (strpbrk(path, "\t\n")) {
+		fprintf(stderr, "Skipping %s: unsupported file name\n", path);
+		return 0;
+	}
+
+	f = add_file(&new_index);
+	f->path = strdup(path);
+	f->size = sb->st_size;
+	f->mtime_ns = sb->st_mtim.tv_sec * 1000000000LL + sb->st_mtim.tv_nsec;
+	f->ctime_ns = sb->st_ctim.tv_sec * 1000000000LL + sb->st_ctim.tv_nsec;
+
+	/* Unchanged since we last looked? */
+	key.path = f->path;
+	old = bsearch(&key, old_index.files, old_index.num_files,
+		      sizeof(*old), cmp_path);
+	if (old && old->size == f->size && old->mtime_ns == f->mtime_ns &&
+	    old->ctime_ns == f->ctime_ns) {
+		strcpy(f->sha1, old->sha1);
+		copy_components(f, old);
+		count_unchanged++;
+		return 0;
+	}
+
+	if (index_contents(path, f)) {
+		/* Leave it out, so it's retried next time */
+		free(f->path);
+		free(f->components);
+		new_index.num_files--;
+		walk_errors++;
+	}
+	return 0;
+}
+
+/* Is <path> <root>, or somewhere under it? Both must be canonical. */
+static int path_under(const char *path, const char *root)
+{
+	size_t len = strlen(root);
+
+	if (strncmp(path, root, len))
+		return 0;
+	return !path[len] || path[len] == '/' || (len && root[len - 1] == '/');
+}
+
+static int under_any(const char *path, char **roots, int num_roots)
+{
+	int i;
+
+	for (i = 0; i < num_roots; i++)
+		if (roots[i] && path_under(path, roots[i]))
+			return 1;
+	return 0;
+}
+
+/*
+ * Canonicalize the DIRs, so that "dir", "./dir" and "/abs/dir" are indexed
+ * as the same files. A DIR inside another one is only walked once.
+ */
+static int get_roots(char **dirs, int num_dirs, char **roots)
+{
+	int errorcnt = 0;
+	int i, j;
+
+	for (i = 0; i < num_dirs; i++) {
+		roots[i] = realpath(dirs[i], NULL);
+		if (!roots[i]) {
+			fprintf(stderr, "Can't find %s: %s\n",
+				dirs[i], strerror(errno));
+			errorcnt++;
+		}
+	}
+
+	for (i = 0; i < num_dirs; i++) {
+		for (j = 0; j < num_dirs && roots[i]; j++) {
+			if (j == i || !roots[j] ||
+			    !path_under(roots[i], roots[j]))
+				continue;
+			/* Keep the first of two identical roots */
+			if (strcmp(roots[i], roots[j]) || j < i) {
+				free(roots[i]);
+				roots[i] = NULL;
+			}
+		}
+	}
+	return errorcnt;
+}
+
+static int update_index(char **dirs, int num_dirs)
+{
+	struct index_file_s *found, *old, *f;
+	uint32_t i, gone = 0;
+	char **roots;
+	int errorcnt = 0;
+
+	have_index_sb = !stat(option.index_file, &index_sb);
+
+	qsort(old_index.files, old_index.num_files,
+	      sizeof(*old_index.files), cmp_path);
+	if (old_index.num_files) {
+		old_by_sha1 = malloc(old_index.num_files *
+				     sizeof(*old_by_sha1));
+		if (!old_by_sha1) {
+			fprintf(stderr, "Out of memory\n");
+			return 1;
+		}
+		for (i = 0; i < old_index.num_files; i++)
+			old_by_sha1[i] = &old_index.files[i];
+		qsort(old_by_sha1, old_index.num_files,
+		      sizeof(*old_by_sha1), cmp_sha1);
+	}
+
+	roots = calloc(num_dirs, sizeof(*roots));
+	if (!roots) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+	errorcnt += get_roots(dirs, num_dirs, roots);
+
+	for (i = 0; i < num_dirs; i++) {
+		if (roots[i] && nftw(roots[i], walk_cb, 16, FTW_PHYS)) {
+			fprintf(stderr, "Can't walk %s: %s\n",
+				dirs[i], strerror(errno));
+			errorcnt++;
+			/* Don't drop what we couldn't look at */
+			free(roots[i]);
+			roots[i] = NULL;
+		}
+	}
+	errorcnt += walk_errors;
+
+	/*
+	 * Files under the DIRs we walked are only still indexed if we found
+	 * them this time. Everything else is kept as it was.
+	 */
+	qsort(new_index.files, new_index.num_files,
+	      sizeof(*new_index.files), cmp_path);
+	for (i = 0; i < old_index.num_files; i++) {
+		old = &old_index.files[i];
+		if (under_any(old->path, roots, num_dirs)) {
+			found = bsearch(old, new_index.files,
+					new_index.num_files, sizeof(*found),
+					cmp_path);
+			if (!found)
+				gone++;
+			continue;
+		}
+		f = add_file(&new_index);
+		f->path = strdup(old->path);
+		f->size = old->size;
+		f->mtime_ns = old->mtime_ns;
+		f->ctime_ns = old->ctime_ns;
+		strcpy(f->sha1, old->sha1);
+		copy_components(f, old);
+		count_kept++;
+	}
+
+	qsort(new_index.files, new_index.num_files,
+	      sizeof(*new_index.files), cmp_path);
+	errorcnt += write_index(option.index_file, &new_index);
+
+	if (!option.quiet)
+		printf("%u files: %u unchanged, %u reused, %u parsed,"
+		       " %u kept, %u gone\n", new_index.num_files,
+		       count_unchanged, count_reused, count_parsed,
+		       count_kept, gone);
+
+	for (i = 0; i < num_dirs; i++)
+		free(roots[i]);
+	free(roots);
+
+	free(old_by_sha1);
+	old_by_sha1 = NULL;
+	free_index(&old_index);
+	old_index = new_index;
+	memset(&new_index, 0, sizeof(new_index));
+	return errorcnt;
+}
+
+/****************************************************************************/
+/* Queries */
+
+struct keyset_s {
+	const char *key_sha1;
+	uint64_t key_version;
+	uint64_t version;
+	uint32_t rollback;
+	const struct index_file_s *file;
+	const struct index_component_s *component;
+};
+
+static int cmp_keyset(const void *a, const void *b)
+{
+	return strcmp(((const struct keyset_s *)a)->key_sha1,
+		      ((const struct keyset_s *)b)->key_sha1);
+}
+
+/* Show the highest versions signed with each data key of the given kind */
+static int show_max(const char *kind)
+{
+	struct keyset_s *sets = NULL;
+	uint32_t num_sets = 0;
+	uint32_t i, j, k;
+
+	for (i = 0; i < old_index.num_files; i++) {
+		const struct index_file_s *f = &old_index.files[i];
+
+		for (j = 0; j < f->num_components; j++) {
+			const struct index_component_s *c = &f->components[j];
+			uint32_t rollback;
+
+			if (strcmp(c->kind, kind))
+				continue;
+
+			/* This is how the TPM stores them */
+			rollback = (uint32_t)(c->key_version << 16 |
+					      (c->version & 0xffff));
+
+			for (k = 0; k < num_sets; k++)
+				if (!strcmp(sets[k].key_sha1, c->key_sha1))
+					break;
+			if (k == num_sets) {
+				sets = realloc(sets, ++num_sets *
+					       sizeof(*sets));
+				if (!sets) {
+					fprintf(stderr, "Out of memory\n");
+					return 1;
+				}
+				memset(&sets[k], 0, sizeof(*sets));
+				sets[k].key_sha1 = c->key_sha1;
+			} else if (rollback <= sets[k].rollback) {
+				continue;
+			}
+			sets[k].key_version = c->key_version;
+			sets[k].version = c->version;
+			sets[k].rollback = rollback;
+			sets[k].file = f;
+			sets[k].component = c;
+		}
+	}
+
+	qsort(sets, num_sets, sizeof(*sets), cmp_keyset);
+	for (k = 0; k < num_sets; k++) {
+		printf("%s\t%s\tkey_version=%" PRIu64 "\tversion=%" PRIu64
+		       "\trollback=0x%08x\t%s", kind, sets[k].key_sha1,
+		       sets[k].key_version, sets[k].version,
+		       sets[k].rollback, sets[k].file->path);
+		if (strcmp(sets[k].component->area, "-"))
+			printf(":%s", sets[k].component->area);
+		printf("\n");
+	}
+
+	free(sets);
+	return 0;
+}
+
+/****************************************************************************/
+
+static const char usage[] = "\n"
+	"Usage:  " MYNAME " %s [OPTIONS] [DIR...]\n"
+	"\n"
+	"Records the keys and versions of the vboot objects (keys, keyblocks,\n"
+	"firmware and kernel vblocks, BIOS images) found under each DIR in an\n"
+	"index file. Updating the index only re-reads files that have\n"
+	"changed, and only re-parses contents it hasn't seen before. Files\n"
+	"are recorded by their absolute path; those outside the DIRs given\n"
+	"are kept as they were, so trees can be indexed one at a time.\n"
+	"\n"
+	"Options:\n"
+	"  -i|--index    FILE            Index file to use (default %s)\n"
+	"  -m|--max      firmware|kernel For each data key, show the highest\n"
+	"                                  versions signed with it\n"
+	"  -q|--quiet                    Don't summarize the update\n"
+	"\n";
+
+static void print_help(const char *prog)
+{
+	printf(usage, prog, option.index_file);
+}
+
+static const struct option long_opts[] = {
+	/* name    hasarg *flag val */
+	{"index",       1, NULL, 'i'},
+	{"max",         1, NULL, 'm'},
+	{"quiet",       0, NULL, 'q'},
+	{"debug",       0, &debugging_enabled, 1},
+	{NULL, 0, NULL, 0},
+};
+static char *short_opts = ":i:m:q";
+
+static int do_index(int argc, char *argv[])
+{
+	int errorcnt = 0;
+	int i;
+
+	opterr = 0;		/* quiet, you */
+	while ((i = getopt_long(argc, argv, short_opts, long_opts, 0)) != -1) {
+		switch (i) {
+		case 'i':
+			option.index_file = optarg;
+			break;
+		case 'm':
+			if (strcmp(optarg, "firmware") &&
+			    strcmp(optarg, "kernel")) {
+				fprintf(stderr, "Invalid --max \"%s\"\n",
+					optarg);
+				errorcnt++;
+			}
+			option.max_kind = optarg;
+			break;
+		case 'q':
+			option.quiet = 1;
+			break;
+
+		case '?':
+			if (optopt)
+				fprintf(stderr, "Unrecognized option: -%c\n",
+					optopt);
+			else
+				fprintf(stderr, "Unrecognized option\n");
+			errorcnt++;
+			break;
+		case ':':
+			fprintf(stderr, "Missing argument to -%c\n", optopt);
+			errorcnt++;
+			break;
+		case 0:				/* handled option */
+			break;
+		default:
+			DIE;
+		}
+	}
+
+	if (!errorcnt && optind == argc && !option.max_kind) {
+		fprintf(stderr, "Nothing to do\n");
+		errorcnt++;
+	}
+
+	if (errorcnt) {
+		print_help(argv[0]);
+		return 1;
+	}
+
+	if (read_index(option.index_file, &old_index))
+		return 1;
+
+	if (optind < argc)
+		errorcnt += update_index(argv + optind, argc - optind);
+
+	if (option.max_kind)
+		errorcnt += show_max(option.max_kind);
+
+	free_index(&old_index);
+	return !!errorcnt;
+}
+
+DECLARE_FUTIL_COMMAND(index, do_index,
+		      VBOOT_VERSION_1_0,
+		      "Index the key and rollback versions under directories",
+		      print_help);
@@ -420,6 +420,11 @@ int futil_cb_show_kernel_preamble(struct futil_traverse_state_s *state)
 	uint64_t vmlinuz_header_size = 0;
 	uint64_t vmlinuz_header_address = 0;
 	uint32_t flags = 0;
+	const uint8_t *chunk_hashes;
+	uint32_t chunk_size;
+	uint32_t compression;
+	uint64_t body_size;
+	uint8_t *body = NULL;
 
 	/* Check the hash... */
 	if (VBOOT_SUCCESS != KeyBlockVerify(key_block, len, NULL, 1)) {
@@ -488,6 +493,24 @@ int futil_cb_show_kernel_preamble(struct futil_traverse_state_s *state)
 		flags = preamble->flags;
 	printf("  Flags:                 0x%" PRIx32 "\n", flags);
 
+	if (VbKernelGetChunkHashes(preamble, key_block->data_key.algorithm,
+				   &chunk_hashes, &chunk_size) ==
+	    VBOOT_SUCCESS)
+		printf("  Body chunk size:       0x%" PRIx32 "\n",
+		       chunk_size);
+	else
+		chunk_hashes = NULL;
+
+	if (VbKernelGetCompression(preamble, &compression, &body_size) !=
+	    VBOOT_SUCCESS) {
+		printf("%s uses an unknown body compression\n", state->name);
+		return 1;
+	}
+	if (compression != COMPRESS_NONE) {
+		printf("  Body compression:      %" PRIu32 "\n", compression);
+		printf("  Uncompressed size:     0x%" PRIx64 "\n", body_size);
+	}
+
 	/* Verify kernel body */
 	if (option.fv) {
 		/* It's in a separate file, which we've already read in */
@@ -510,11 +533,32 @@ int futil_cb_show_kernel_preamble(struct futil_traverse_state_s *state)
 		fprintf(stderr, "Error verifying kernel body.\n");
 		return 1;
 	}
+	if (chunk_hashes &&
+	    0 != VerifyChunkHashes(kernel_blob,
+				   preamble->body_signature.data_size,
+				   chunk_size, key_block->data_key.algorithm,
+				   chunk_hashes)) {
+		fprintf(stderr, "Error verifying kernel body chunks.\n");
+		return 1;
+	}
 
 	printf("Body verification succeeded.\n");
 
+	/* The config is inside the compressed data */
+	if (compression != COMPRESS_NONE) {
+		body = DecompressKernelBlob(kernel_blob,
+					    preamble->body_signature.data_size,
+					    compression, body_size);
+		if (!body) {
+			fprintf(stderr, "Error decompressing kernel body.\n");
+			return 1;
+		}
+		kernel_blob = body;
+	}
+
 	printf("Config:\n%s\n", kernel_blob + KernelCmdLineOffset(preamble));
 
+	free(body);
 	return retval;
 }
 
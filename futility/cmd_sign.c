@@ -55,6 +55,8 @@ static struct local_data_s {
 	int fv_specified;
 	uint32_t kloadaddr;
 	uint32_t padding;
+	uint32_t chunk_size;
+	int chunk_size_specified;
 	int vblockonly;
 	char *outfile;
 	int create_new_outfile;
@@ -219,7 +221,8 @@ int futil_cb_create_kernel_part(struct futil_traverse_state_s *state)
 	vblock_data = SignKernelBlob(kblob_data, kblob_size, option.padding,
 				     option.version, option.kloadaddr,
 				     option.keyblock, option.signprivate,
-				     option.flags, &vblock_size);
+				     option.flags, option.chunk_size,
+				     COMPRESS_NONE, 0, &vblock_size);
 	if (!vblock_data) {
 		fprintf(stderr, "Unable to sign kernel blob\n");
 		free(kblob_data);
@@ -252,12 +255,17 @@ int futil_cb_resign_kernel_part(struct futil_traverse_state_s *state)
 	uint64_t kpart_size, kblob_size, vblock_size;
 	VbKeyBlockHeader *keyblock = NULL;
 	VbKernelPreambleHeader *preamble = NULL;
+	uint32_t compression;
+	uint64_t body_size;
 	int rv = 0;
 
 	kpart_data = state->my_area->buf;
 	kpart_size = state->my_area->len;
 
-	/* Note: This just sets some static pointers. It doesn't malloc. */
+	/*
+	 * Note: This just sets some static pointers. It only mallocs when it
+	 * has to decompress the body, and keeps that buffer itself.
+	 */
 	kblob_data = UnpackKPart(kpart_data, kpart_size, option.padding,
 				 &keyblock, &preamble, &kblob_size);
 
@@ -275,6 +283,13 @@ int futil_cb_resign_kernel_part(struct futil_traverse_state_s *state)
 	 */
 	option.kloadaddr = preamble->body_load_address;
 
+	/* The body is resigned as is, so keep its compression */
+	if (VbKernelGetCompression(preamble, &compression, &body_size) !=
+	    VBOOT_SUCCESS) {
+		fprintf(stderr, "Unknown kernel body compression\n");
+		return 1;
+	}
+
 	/* Replace the config if asked */
 	if (option.config_data &&
 	    0 != UpdateKernelBlobConfig(kblob_data, kblob_size,
@@ -294,6 +309,11 @@ int futil_cb_resign_kernel_part(struct futil_traverse_state_s *state)
 			option.flags = preamble->flags;
 	}
 
+	/* Likewise the body chunk size */
+	if (!option.chunk_size_specified &&
+	    preamble->header_version_minor >= 3)
+		option.chunk_size = preamble->body_chunk_size;
+
 	/* Replace the keyblock if asked */
 	if (option.keyblock)
 		keyblock = option.keyblock;
@@ -302,7 +322,8 @@ int futil_cb_resign_kernel_part(struct futil_traverse_state_s *state)
 	vblock_data = SignKernelBlob(kblob_data, kblob_size, option.padding,
 				     option.version, option.kloadaddr,
 				     keyblock, option.signprivate,
-				     option.flags, &vblock_size);
+				     option.flags, option.chunk_size,
+				     compression, body_size, &vblock_size);
 	if (!vblock_data) {
 		fprintf(stderr, "Unable to sign kernel blob\n");
 		return 1;
@@ -619,7 +640,11 @@ static const char usage_new_kpart[] = "\n"
 	"                                     (default 0x%x)\n"
 	" --vblockonly                      Emit just the vblock (requires a\n"
 	"                                     distinct outfile)\n"
-	"  -f|--flags       NUM             The preamble flags value\n";
+	"  -f|--flags       NUM             The preamble flags value\n"
+	"  --chunksize      NUM             Also sign each NUM bytes of the\n"
+	"                                     kernel blob separately, so they\n"
+	"                                     can be verified as they're read\n"
+	"                                     (a multiple of 512)\n";
 
 static const char usage_old_kpart[] = "\n"
 	"-----------------------------------------------------------------\n"
@@ -642,6 +667,9 @@ static const char usage_old_kpart[] = "\n"
 	"  --vblockonly                     Emit just the vblock (requires a\n"
 	"                                     distinct OUTFILE)\n"
 	"  -f|--flags       NUM             The preamble flags value\n"
+	"  --chunksize      NUM             Also sign each NUM bytes of the\n"
+	"                                     kernel blob separately (0 for\n"
+	"                                     none; default is unchanged)\n"
 	"\n";
 
 static void print_help(const char *prog)
@@ -663,6 +691,7 @@ enum no_short_opts {
 	OPT_ARCH,
 	OPT_KLOADADDR,
 	OPT_PADDING,
+	OPT_CHUNKSIZE,
 	OPT_PEM_SIGNPRIV,
 	OPT_PEM_ALGO,
 	OPT_PEM_EXTERNAL,
@@ -689,6 +718,7 @@ static const struct option long_opts[] = {
 	{"arch",         1, NULL, OPT_ARCH},
 	{"kloadaddr",    1, NULL, OPT_KLOADADDR},
 	{"pad",          1, NULL, OPT_PADDING},
+	{"chunksize",    1, NULL, OPT_CHUNKSIZE},
 	{"pem_signpriv", 1, NULL, OPT_PEM_SIGNPRIV},
 	{"pem_algo",     1, NULL, OPT_PEM_ALGO},
 	{"pem_external", 1, NULL, OPT_PEM_EXTERNAL},
@@ -841,6 +871,15 @@ static int do_sign(int argc, char *argv[])
 				errorcnt++;
 			}
 			break;
+		case OPT_CHUNKSIZE:
+			option.chunk_size_specified = 1;
+			option.chunk_size = strtoul(optarg, &e, 0);
+			if (!*optarg || (e && *e) || option.chunk_size % 512) {
+				fprintf(stderr,
+					"Invalid --chunksize \"%s\"\n", optarg);
+				errorcnt++;
+			}
+			break;
 		case OPT_PEM_SIGNPRIV:
 			option.pem_signpriv = optarg;
 			break;
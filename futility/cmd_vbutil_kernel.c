@@ -41,6 +41,8 @@ static void Fatal(const char *format, ...)
 static int opt_verbose;
 static int opt_vblockonly;
 static uint64_t opt_pad = 65536;
+static uint32_t opt_chunk_size;
+static uint32_t opt_compress = COMPRESS_NONE;
 
 /* Command line options */
 enum {
@@ -64,6 +66,8 @@ enum {
 	OPT_MINVERSION,
 	OPT_VMLINUZ_OUT,
 	OPT_FLAGS,
+	OPT_CHUNKSIZE,
+	OPT_COMPRESS,
 };
 
 static const struct option long_opts[] = {
@@ -88,6 +92,8 @@ static const struct option long_opts[] = {
 	{"debug", 0, &debugging_enabled, 1},
 	{"vmlinuz-out", 1, 0, OPT_VMLINUZ_OUT},
 	{"flags", 1, 0, OPT_FLAGS},
+	{"chunksize", 1, 0, OPT_CHUNKSIZE},
+	{"compress", 1, 0, OPT_COMPRESS},
 	{NULL, 0, 0, 0}
 };
 
@@ -112,6 +118,13 @@ static const char usage[] =
 	"    --pad <number>            Verification padding size in bytes\n"
 	"    --vblockonly              Emit just the verification blob\n"
 	"    --flags NUM               Flags to be passed in the header\n"
+	"    --chunksize <number>      Also sign each <number> bytes of the\n"
+	"                                kernel data separately, so they can\n"
+	"                                be verified as they're read (must be\n"
+	"                                a multiple of 512)\n"
+	"    --compress lzma           Store the kernel data LZMA-compressed;\n"
+	"                                needs firmware which understands\n"
+	"                                kernel preamble 3.4\n"
 	"\nOR\n\n"
 	"Usage:  " MYNAME " %s --repack <file> [PARAMETERS]\n"
 	"\n"
@@ -128,6 +141,8 @@ static const char usage[] =
 	"    --kloadaddr <address>     Assign kernel body load address\n"
 	"    --pad <number>            Verification blob size in bytes\n"
 	"    --vblockonly              Emit just the verification blob\n"
+	"    --chunksize <number>      Also sign each <number> bytes of the\n"
+	"                                kernel data separately\n"
 	"\nOR\n\n"
 	"Usage:  " MYNAME " %s --verify <file> [PARAMETERS]\n"
 	"\n"
@@ -257,6 +272,8 @@ static int do_vbutil_kernel(int argc, char *argv[])
 	uint8_t *vblock_data = NULL;
 	uint64_t vblock_size = 0;
 	uint32_t flags = 0;
+	uint32_t compression;
+	uint64_t body_size;
 	FILE *f;
 
 	while (((i = getopt_long(argc, argv, ":", long_opts, NULL)) != -1) &&
@@ -376,6 +393,27 @@ static int do_vbutil_kernel(int argc, char *argv[])
 				parse_error = 1;
 			}
 			break;
+
+		case OPT_CHUNKSIZE:
+			opt_chunk_size = (uint32_t)strtoul(optarg, &e, 0);
+			if (!*optarg || (e && *e) || !opt_chunk_size ||
+			    opt_chunk_size % 512) {
+				fprintf(stderr, "Invalid --chunksize\n");
+				parse_error = 1;
+			}
+			break;
+
+		case OPT_COMPRESS:
+			if (!strcasecmp(optarg, "lzma"))
+				opt_compress = COMPRESS_LZMA1;
+			else if (!strcasecmp(optarg, "none"))
+				opt_compress = COMPRESS_NONE;
+			else {
+				fprintf(stderr, "Invalid --compress\n");
+				parse_error = 1;
+			}
+			break;
+
 		case OPT_VMLINUZ_OUT:
 			vmlinuz_out_file = optarg;
 		}
@@ -445,10 +483,21 @@ static int do_vbutil_kernel(int argc, char *argv[])
 
 		Debug("kblob_size = 0x%" PRIx64 "\n", kblob_size);
 
+		/* The signature covers the bytes on disk, so compress first */
+		body_size = kblob_size;
+		if (opt_compress != COMPRESS_NONE) {
+			kblob_data = CompressKernelBlob(kblob_data, kblob_size,
+							opt_compress,
+							&kblob_size);
+			if (!kblob_data)
+				Fatal("Unable to compress kernel blob\n");
+		}
+
 		vblock_data = SignKernelBlob(kblob_data, kblob_size, opt_pad,
 					     version, kernel_body_load_address,
 					     t_keyblock, signpriv_key, flags,
-					     &vblock_size);
+					     opt_chunk_size, opt_compress,
+					     body_size, &vblock_size);
 		if (!vblock_data)
 			Fatal("Unable to sign kernel blob\n");
 
@@ -494,6 +543,11 @@ static int do_vbutil_kernel(int argc, char *argv[])
 
 		kernel_body_load_address = preamble->body_load_address;
 
+		/* Keep the body as it is, compressed or not */
+		if (VbKernelGetCompression(preamble, &compression, &body_size)
+		    != VBOOT_SUCCESS)
+			Fatal("Unknown kernel body compression\n");
+
 		/* Update the config if asked */
 		if (config_file) {
 			Debug("Reading %s\n", config_file);
@@ -524,7 +578,9 @@ static int do_vbutil_kernel(int argc, char *argv[])
 		vblock_data = SignKernelBlob(kblob_data, kblob_size, opt_pad,
 					     version, kernel_body_load_address,
 					     t_keyblock ? t_keyblock : keyblock,
-					     signpriv_key, flags, &vblock_size);
+					     signpriv_key, flags,
+					     opt_chunk_size, compression,
+					     body_size, &vblock_size);
 		if (!vblock_data)
 			Fatal("Unable to sign kernel blob\n");
 
@@ -581,6 +637,10 @@ static int do_vbutil_kernel(int argc, char *argv[])
 		if (!kblob_data)
 			Fatal("Unable to unpack kernel partition\n");
 
+		if (VbKernelGetCompression(preamble, &compression, &body_size)
+		    != VBOOT_SUCCESS || compression != COMPRESS_NONE)
+			Fatal("%s has a compressed kernel body\n", filename);
+
 		f = fopen(vmlinuz_out_file, "wb");
 		if (!f) {
 			VbExError("Can't open output file %s\n",
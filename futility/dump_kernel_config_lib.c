@@ -101,6 +101,16 @@ static char *FindKernelConfigFromStream(void *ctx, ReadFullyFn read_fn,
 	}
 	now += preamble.preamble_size;
 
+	/*
+	 * We can't stream through a compressed body to find the config. This
+	 * library doesn't have VbKernelGetCompression(), so check by hand.
+	 */
+	if (preamble.header_version_major ==
+	    KERNEL_PREAMBLE_COMPRESSED_VERSION_MAJOR) {
+		VbExError("kernel body is compressed\n");
+		return NULL;
+	}
+
 	/* Read body_load_address from preamble if no
 	 * kernel_body_load_address */
 	if (kernel_body_load_address == USE_PREAMBLE_LOAD_ADDR)
@@ -17,6 +17,8 @@
 #include "file_type.h"
 #include "futility.h"
 #include "gbb_header.h"
+#include "gpt.h"
+#include "vboot_struct.h"
 
 /* Human-readable strings */
 static const char * const type_strings[] = {
@@ -43,28 +45,70 @@ const char * const futil_file_type_str(enum futil_file_type type)
 	return type_strings[type];
 }
 
-/* Try these in order so we recognize the larger objects first */
-enum futil_file_type (*recognizers[])(uint8_t *buf, uint32_t len) = {
-	&recognize_gpt,
-	&recognize_bios_image,
-	&recognize_gbb,
-	&recognize_vblock1,
-	&recognize_privkey,
-};
+/* Is there a <magic> of <size> bytes at <offset> in the buffer? */
+static int has_magic(uint8_t *buf, uint32_t len, uint32_t offset,
+		     const char *magic, uint32_t size)
+{
+	return offset + size <= len && !memcmp(buf + offset, magic, size);
+}
 
-/* Try to figure out what we're looking at */
-enum futil_file_type futil_file_type_buf(uint8_t *buf, uint32_t len)
+/*
+ * Try to figure out what we're looking at. Most things we know about have a
+ * magic number at a fixed offset, so look at those first and only run the
+ * recognizers that might match. Only if that doesn't work do we search the
+ * whole buffer for an FMAP. The recognizers don't need the magic checks to be
+ * right, they just save time.
+ */
+enum futil_file_type futil_file_type_buf_fmap(uint8_t *buf, uint32_t len,
+					      FmapHeader **fmap_ptr)
 {
-	enum futil_file_type type;
-	int i;
+	enum futil_file_type type = FILE_TYPE_UNKNOWN;
+	int tried_vblock1 = 0;
+	FmapHeader *fmap;
+
+	if (fmap_ptr)
+		*fmap_ptr = NULL;
+
+	/* GPT header is in sector 1 */
+	if (has_magic(buf, len, 512, GPT_HEADER_SIGNATURE,
+		      GPT_HEADER_SIGNATURE_SIZE) ||
+	    has_magic(buf, len, 512, GPT_HEADER_SIGNATURE2,
+		      GPT_HEADER_SIGNATURE_SIZE))
+		type = recognize_gpt(buf, len);
+	else if (has_magic(buf, len, 0, GBB_SIGNATURE, GBB_SIGNATURE_SIZE))
+		type = recognize_gbb(buf, len);
+	else if (has_magic(buf, len, 0, KEY_BLOCK_MAGIC,
+			   KEY_BLOCK_MAGIC_SIZE)) {
+		type = recognize_vblock1(buf, len);
+		tried_vblock1 = 1;
+	}
+	if (type != FILE_TYPE_UNKNOWN)
+		return type;
+
+	/* A BIOS image could start with anything, so look for its FMAP */
+	fmap = fmap_find(buf, len);
+	if (fmap) {
+		type = recognize_bios_fmap(buf, len, fmap);
+		if (type != FILE_TYPE_UNKNOWN) {
+			if (fmap_ptr)
+				*fmap_ptr = fmap;
+			return type;
+		}
+	}
 
-	for (i = 0; i < ARRAY_SIZE(recognizers); i++) {
-		type = recognizers[i](buf, len);
+	/* Keys have no magic, but are quick to rule out */
+	if (!tried_vblock1) {
+		type = recognize_vblock1(buf, len);
 		if (type != FILE_TYPE_UNKNOWN)
 			return type;
 	}
 
-	return FILE_TYPE_UNKNOWN;
+	return recognize_privkey(buf, len);
+}
+
+enum futil_file_type futil_file_type_buf(uint8_t *buf, uint32_t len)
+{
+	return futil_file_type_buf_fmap(buf, len, NULL);
 }
 
 enum futil_file_err futil_file_type(const char *filename,
@@ -6,6 +6,8 @@
 #ifndef VBOOT_REFERENCE_FUTILITY_FILE_TYPE_H_
 #define VBOOT_REFERENCE_FUTILITY_FILE_TYPE_H_
 
+#include "fmap.h"
+
 /* What type of things do I know how to handle? */
 enum futil_file_type {
 	FILE_TYPE_UNKNOWN,
@@ -35,6 +37,13 @@ const char * const futil_file_type_str(enum futil_file_type type);
  */
 enum futil_file_type futil_file_type_buf(uint8_t *buf, uint32_t len);
 
+/*
+ * Same thing, but if the buffer is a BIOS image, also point *fmap_ptr at its
+ * FMAP (otherwise NULL) so the caller doesn't have to search for it again.
+ */
+enum futil_file_type futil_file_type_buf_fmap(uint8_t *buf, uint32_t len,
+					      FmapHeader **fmap_ptr);
+
 /*
  * This opens a file and tries to match it to one of the known file types.
  * It's not an error if it returns FILE_TYPE_UKNOWN.
@@ -44,6 +53,8 @@ enum futil_file_err futil_file_type(const char *filename,
 
 /* Routines to identify particular file types. */
 enum futil_file_type recognize_bios_image(uint8_t *buf, uint32_t len);
+enum futil_file_type recognize_bios_fmap(uint8_t *buf, uint32_t len,
+					FmapHeader *fmap);
 enum futil_file_type recognize_gbb(uint8_t *buf, uint32_t len);
 enum futil_file_type recognize_vblock1(uint8_t *buf, uint32_t len);
 enum futil_file_type recognize_gpt(uint8_t *buf, uint32_t len);
@@ -54,9 +54,30 @@ static int (* const cb_sign_funcs[])(struct futil_traverse_state_s *state) = {
 };
 BUILD_ASSERT(ARRAY_SIZE(cb_sign_funcs) == NUM_CB_COMPONENTS);
 
+/* FUTIL_OP_INDEX */
+static int (* const cb_index_funcs[])(struct futil_traverse_state_s *state) = {
+	NULL,				/* CB_BEGIN_TRAVERSAL */
+	NULL,				/* CB_END_TRAVERSAL */
+	futil_cb_index_gbb,		/* CB_FMAP_GBB */
+	futil_cb_index_fw_preamble,	/* CB_FMAP_VBLOCK_A */
+	futil_cb_index_fw_preamble,	/* CB_FMAP_VBLOCK_B */
+	NULL,				/* CB_FMAP_FW_MAIN_A */
+	NULL,				/* CB_FMAP_FW_MAIN_B */
+	futil_cb_index_pubkey,		/* CB_PUBKEY */
+	futil_cb_index_keyblock,	/* CB_KEYBLOCK */
+	futil_cb_index_gbb,		/* CB_GBB */
+	futil_cb_index_fw_preamble,	/* CB_FW_PREAMBLE */
+	futil_cb_index_kernel_preamble,	/* CB_KERN_PREAMBLE */
+	NULL,				/* CB_RAW_FIRMWARE */
+	NULL,				/* CB_RAW_KERNEL */
+	NULL,				/* CB_PRIVKEY */
+};
+BUILD_ASSERT(ARRAY_SIZE(cb_index_funcs) == NUM_CB_COMPONENTS);
+
 static int (* const * const cb_func[])(struct futil_traverse_state_s *state) = {
 	cb_show_funcs,
 	cb_sign_funcs,
+	cb_index_funcs,
 };
 BUILD_ASSERT(ARRAY_SIZE(cb_func) == NUM_FUTIL_OPS);
 
@@ -124,9 +145,10 @@ static int has_all_areas(uint8_t *buf, uint32_t len, FmapHeader *fmap,
 	return 1;
 }
 
-enum futil_file_type recognize_bios_image(uint8_t *buf, uint32_t len)
+/* For when we've already found the FMAP */
+enum futil_file_type recognize_bios_fmap(uint8_t *buf, uint32_t len,
+					 FmapHeader *fmap)
 {
-	FmapHeader *fmap = fmap_find(buf, len);
 	if (fmap) {
 		if (has_all_areas(buf, len, fmap, bios_area))
 			return FILE_TYPE_BIOS_IMAGE;
@@ -136,6 +158,11 @@ enum futil_file_type recognize_bios_image(uint8_t *buf, uint32_t len)
 	return FILE_TYPE_UNKNOWN;
 }
 
+enum futil_file_type recognize_bios_image(uint8_t *buf, uint32_t len)
+{
+	return recognize_bios_fmap(buf, len, fmap_find(buf, len));
+}
+
 static const char * const futil_cb_component_str[] = {
 	"CB_BEGIN_TRAVERSAL",
 	"CB_END_TRAVERSAL",
@@ -198,7 +225,7 @@ int futil_traverse(uint8_t *buf, uint32_t len,
 		   struct futil_traverse_state_s *state,
 		   enum futil_file_type type)
 {
-	FmapHeader *fmap;
+	FmapHeader *fmap = NULL;
 	FmapAreaHeader *ah = 0;
 	const struct bios_area_s *area;
 	int retval = 0;
@@ -208,8 +235,9 @@ int futil_traverse(uint8_t *buf, uint32_t len,
 		return 1;
 	}
 
+	/* If we have to look, remember where the FMAP is */
 	if (type == FILE_TYPE_UNKNOWN)
-		type = futil_file_type_buf(buf, len);
+		type = futil_file_type_buf_fmap(buf, len, &fmap);
 	state->in_type = type;
 
 	state->errors = retval;
@@ -220,7 +248,8 @@ int futil_traverse(uint8_t *buf, uint32_t len,
 	switch (type) {
 	case FILE_TYPE_BIOS_IMAGE:
 		/* We've already checked, so we know this will work. */
-		fmap = fmap_find(buf, len);
+		if (!fmap)
+			fmap = fmap_find(buf, len);
 		for (area = bios_area; area->name; area++) {
 			/* We know this will work, too */
 			fmap_find_by_name(buf, len, fmap, area->name, &ah);
@@ -238,7 +267,8 @@ int futil_traverse(uint8_t *buf, uint32_t len,
 
 	case FILE_TYPE_OLD_BIOS_IMAGE:
 		/* We've already checked, so we know this will work. */
-		fmap = fmap_find(buf, len);
+		if (!fmap)
+			fmap = fmap_find(buf, len);
 		for (area = old_bios_area; area->name; area++) {
 			/* We know this will work, too */
 			fmap_find_by_name(buf, len, fmap, area->name, &ah);
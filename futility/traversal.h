@@ -12,6 +12,7 @@
 enum futil_op_type {
 	FUTIL_OP_SHOW,
 	FUTIL_OP_SIGN,
+	FUTIL_OP_INDEX,
 
 	NUM_FUTIL_OPS
 };
@@ -93,5 +94,11 @@ int futil_cb_create_kernel_part(struct futil_traverse_state_s *state);
 int futil_cb_sign_begin(struct futil_traverse_state_s *state);
 int futil_cb_sign_end(struct futil_traverse_state_s *state);
 
+int futil_cb_index_pubkey(struct futil_traverse_state_s *state);
+int futil_cb_index_gbb(struct futil_traverse_state_s *state);
+int futil_cb_index_keyblock(struct futil_traverse_state_s *state);
+int futil_cb_index_fw_preamble(struct futil_traverse_state_s *state);
+int futil_cb_index_kernel_preamble(struct futil_traverse_state_s *state);
+
 
 #endif /* VBOOT_REFERENCE_FUTILITY_TRAVERSAL_H_ */
@@ -6,6 +6,7 @@
 
 #include <errno.h>
 #include <inttypes.h>		/* For PRIu64 */
+#include <lzma.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
@@ -34,6 +35,8 @@ static VbKeyBlockHeader *g_keyblock;
 static VbKernelPreambleHeader *g_preamble;
 static uint8_t *g_kernel_blob_data;
 static uint64_t g_kernel_blob_size;
+/* Decompressed copy of a compressed kernel blob, if any */
+static uint8_t *g_uncompressed_blob_data;
 
 /* These refer to individual parts within the kernel blob. */
 static uint8_t *g_kernel_data;
@@ -287,6 +290,13 @@ int UpdateKernelBlobConfig(uint8_t *kblob_data, uint64_t kblob_size,
 		return -1;
 	}
 
+	/* The config lives in the decompressed copy, which isn't signed */
+	if (g_uncompressed_blob_data) {
+		fprintf(stderr,
+			"Can't change the config of a compressed kernel\n");
+		return -1;
+	}
+
 	Memset(g_config_data, 0, g_config_size);
 	Memcpy(g_config_data, config_data, config_size);
 
@@ -305,7 +315,9 @@ uint8_t *UnpackKPart(uint8_t *kpart_data, uint64_t kpart_size,
 	uint64_t vmlinuz_header_size = 0;
 	uint64_t vmlinuz_header_address = 0;
 	uint64_t now = 0;
+	uint64_t body_size;
 	uint32_t flags = 0;
+	uint32_t compression;
 
 	/* Sanity-check the keyblock */
 	keyblock = (VbKeyBlockHeader *)kpart_data;
@@ -381,8 +393,33 @@ uint8_t *UnpackKPart(uint8_t *kpart_data, uint64_t kpart_size,
 			"Warning: kernel file only has 0x%" PRIx64 " bytes\n",
 			g_kernel_blob_size);
 
+	if (VbKernelGetCompression(preamble, &compression, &body_size)
+	    != VBOOT_SUCCESS) {
+		fprintf(stderr, "Unknown kernel body compression\n");
+		return NULL;
+	}
+
+	free(g_uncompressed_blob_data);
+	g_uncompressed_blob_data = NULL;
+	if (compression != COMPRESS_NONE) {
+		Debug(" body_compression = %d\n", compression);
+		Debug(" body_uncompressed_size = 0x%" PRIx64 "\n", body_size);
+		if (now + g_kernel_blob_size > kpart_size) {
+			fprintf(stderr,
+				"Compressed kernel body is truncated\n");
+			return NULL;
+		}
+		g_uncompressed_blob_data =
+			DecompressKernelBlob(g_kernel_blob_data,
+					     g_kernel_blob_size,
+					     compression, body_size);
+		if (!g_uncompressed_blob_data)
+			return NULL;
+	}
+
 	/* Update the blob pointers */
-	UnpackKernelBlob(g_kernel_blob_data);
+	UnpackKernelBlob(g_uncompressed_blob_data ? g_uncompressed_blob_data
+			 : g_kernel_blob_data);
 
 	if (keyblock_ptr)
 		*keyblock_ptr = keyblock;
@@ -398,9 +435,12 @@ uint8_t *SignKernelBlob(uint8_t *kernel_blob, uint64_t kernel_size,
 			uint64_t padding,
 			int version, uint64_t kernel_body_load_address,
 			VbKeyBlockHeader *keyblock, VbPrivateKey *signpriv_key,
-			uint32_t flags, uint64_t *vblock_size_ptr)
+			uint32_t flags, uint32_t chunk_size,
+			uint32_t compression, uint64_t uncompressed_size,
+			uint64_t *vblock_size_ptr)
 {
 	VbSignature *body_sig;
+	VbSignature *chunk_hashes = NULL;
 	VbKernelPreambleHeader *preamble;
 	uint64_t min_size = padding > keyblock->key_block_size
 		? padding - keyblock->key_block_size : 0;
@@ -414,6 +454,24 @@ uint8_t *SignKernelBlob(uint8_t *kernel_blob, uint64_t kernel_size,
 		return NULL;
 	}
 
+	if (uncompressed_size > UINT32_MAX) {
+		fprintf(stderr, "Uncompressed kernel body is too large\n");
+		free(body_sig);
+		return NULL;
+	}
+
+	/* Hash the kernel data in chunks too, if asked */
+	if (chunk_size) {
+		chunk_hashes = CalculateChunkHashes(kernel_blob, kernel_size,
+						    chunk_size,
+						    signpriv_key->algorithm);
+		if (!chunk_hashes) {
+			fprintf(stderr, "Error calculating body chunk hashes\n");
+			free(body_sig);
+			return NULL;
+		}
+	}
+
 	/* Create preamble */
 	preamble = CreateKernelPreamble(version,
 					kernel_body_load_address,
@@ -423,8 +481,13 @@ uint8_t *SignKernelBlob(uint8_t *kernel_blob, uint64_t kernel_size,
 					g_ondisk_vmlinuz_header_addr,
 					g_vmlinuz_header_size,
 					flags,
+					chunk_size,
+					chunk_hashes,
+					compression,
+					uncompressed_size,
 					min_size,
 					signpriv_key);
+	free(chunk_hashes);
 	if (!preamble) {
 		fprintf(stderr, "Error creating preamble.\n");
 		return 0;
@@ -442,6 +505,99 @@ uint8_t *SignKernelBlob(uint8_t *kernel_blob, uint64_t kernel_size,
 	return outbuf;
 }
 
+uint8_t *CompressKernelBlob(const uint8_t *kernel_blob, uint64_t kernel_size,
+			   uint32_t compression, uint64_t *out_size_ptr)
+{
+	lzma_stream stream = LZMA_STREAM_INIT;
+	lzma_options_lzma options;
+	uint8_t *outbuf;
+	uint64_t outsize;
+
+	if (compression != COMPRESS_LZMA1) {
+		fprintf(stderr, "Unsupported kernel compression %d\n",
+			compression);
+		return NULL;
+	}
+
+	/* Same LZMA1 (.lzma "alone") format the firmware already unpacks
+	 * for bitmaps; see bmpblk_utility. */
+	if (lzma_lzma_preset(&options, LZMA_PRESET_DEFAULT)) {
+		fprintf(stderr, "Unable to set LZMA options\n");
+		return NULL;
+	}
+	if (lzma_alone_encoder(&stream, &options) != LZMA_OK) {
+		fprintf(stderr, "Unable to init LZMA encoder\n");
+		return NULL;
+	}
+
+	outsize = lzma_stream_buffer_bound(kernel_size);
+	outbuf = malloc(outsize);
+	if (!outbuf) {
+		lzma_end(&stream);
+		return NULL;
+	}
+
+	stream.next_in = kernel_blob;
+	stream.avail_in = kernel_size;
+	stream.next_out = outbuf;
+	stream.avail_out = outsize;
+	if (lzma_code(&stream, LZMA_FINISH) != LZMA_STREAM_END) {
+		fprintf(stderr, "Unable to compress kernel blob\n");
+		lzma_end(&stream);
+		free(outbuf);
+		return NULL;
+	}
+
+	Debug("compressed 0x%" PRIx64 " bytes to 0x%" PRIx64 "\n",
+	      kernel_size, (uint64_t)stream.total_out);
+	if (out_size_ptr)
+		*out_size_ptr = stream.total_out;
+	lzma_end(&stream);
+	return outbuf;
+}
+
+uint8_t *DecompressKernelBlob(const uint8_t *data, uint64_t size,
+			     uint32_t compression, uint64_t uncompressed_size)
+{
+	lzma_stream stream = LZMA_STREAM_INIT;
+	lzma_ret ret;
+	uint8_t *outbuf;
+
+	if (compression != COMPRESS_LZMA1) {
+		fprintf(stderr, "Unsupported kernel compression %d\n",
+			compression);
+		return NULL;
+	}
+
+	if (lzma_alone_decoder(&stream, UINT64_MAX) != LZMA_OK) {
+		fprintf(stderr, "Unable to init LZMA decoder\n");
+		return NULL;
+	}
+
+	outbuf = malloc(uncompressed_size);
+	if (!outbuf) {
+		lzma_end(&stream);
+		return NULL;
+	}
+
+	stream.next_in = data;
+	stream.avail_in = size;
+	stream.next_out = outbuf;
+	stream.avail_out = uncompressed_size;
+	ret = lzma_code(&stream, LZMA_FINISH);
+	if (ret != LZMA_STREAM_END || stream.total_out != uncompressed_size) {
+		fprintf(stderr, "Unable to decompress kernel blob"
+			" (ret %d, got 0x%" PRIx64 " of 0x%" PRIx64 " bytes)\n",
+			ret, (uint64_t)stream.total_out, uncompressed_size);
+		lzma_end(&stream);
+		free(outbuf);
+		return NULL;
+	}
+
+	lzma_end(&stream);
+	return outbuf;
+}
+
 /* Returns zero on success */
 int WriteSomeParts(const char *outfile,
 		   void *part1_data, uint64_t part1_size,
@@ -498,6 +654,10 @@ int VerifyKernelBlob(uint8_t *kernel_blob,
 	int rv = -1;
 	uint64_t vmlinuz_header_size = 0;
 	uint64_t vmlinuz_header_address = 0;
+	const uint8_t *chunk_hashes;
+	uint32_t chunk_size;
+	uint32_t compression;
+	uint64_t body_size;
 
 	if (0 != KeyBlockVerify(g_keyblock, g_keyblock->key_block_size,
 				signpub_key, (0 == signpub_key))) {
@@ -602,6 +762,23 @@ int VerifyKernelBlob(uint8_t *kernel_blob,
 		printf("  Flags          :       0x%" PRIx32 "\n",
 		       g_preamble->flags);
 
+	if (VbKernelGetChunkHashes(g_preamble, data_key->algorithm,
+				   &chunk_hashes, &chunk_size) ==
+	    VBOOT_SUCCESS)
+		printf("  Body chunk size:     0x%" PRIx32 "\n", chunk_size);
+	else
+		chunk_hashes = NULL;
+
+	if (VbKernelGetCompression(g_preamble, &compression, &body_size) !=
+	    VBOOT_SUCCESS) {
+		fprintf(stderr, "Unknown kernel body compression.\n");
+		goto done;
+	}
+	if (compression != COMPRESS_NONE) {
+		printf("  Body compression:    %" PRIu32 "\n", compression);
+		printf("  Uncompressed size:   0x%" PRIx64 "\n", body_size);
+	}
+
 	if (g_preamble->kernel_version < (min_version & 0xFFFF)) {
 		fprintf(stderr,
 			"Kernel version %" PRIu64 " is lower than minimum %"
@@ -616,9 +793,20 @@ int VerifyKernelBlob(uint8_t *kernel_blob,
 		fprintf(stderr, "Error verifying kernel body.\n");
 		goto done;
 	}
+	if (chunk_hashes &&
+	    0 != VerifyChunkHashes(kernel_blob,
+				   g_preamble->body_signature.data_size,
+				   chunk_size, data_key->algorithm,
+				   chunk_hashes)) {
+		fprintf(stderr, "Error verifying kernel body chunks.\n");
+		goto done;
+	}
 	printf("Body verification succeeded.\n");
 
-	printf("Config:\n%s\n", kernel_blob + KernelCmdLineOffset(g_preamble));
+	/* UnpackKPart() has already decompressed the body, if needed */
+	printf("Config:\n%s\n",
+	       (g_uncompressed_blob_data ? g_uncompressed_blob_data
+		: kernel_blob) + KernelCmdLineOffset(g_preamble));
 
 	rv = 0;
 done:
@@ -755,7 +943,8 @@ enum futil_file_type recognize_privkey(uint8_t *buf, uint32_t len)
 	VbPrivateKey key;
 	const unsigned char *start;
 
-	if (len < sizeof(key.algorithm))
+	/* The DER encoding starts with a SEQUENCE, so don't bother if not */
+	if (len <= sizeof(key.algorithm) || buf[sizeof(key.algorithm)] != 0x30)
 		return FILE_TYPE_UNKNOWN;
 
 	key.algorithm = *(typeof(key.algorithm) *)buf;
@@ -18,7 +18,19 @@ uint8_t *SignKernelBlob(uint8_t *kernel_blob, uint64_t kernel_size,
 			uint64_t padding,
 			int version, uint64_t kernel_body_load_address,
 			VbKeyBlockHeader *keyblock, VbPrivateKey *signpriv_key,
-			uint32_t flags, uint64_t *vblock_size_ptr);
+			uint32_t flags, uint32_t chunk_size,
+			uint32_t compression, uint64_t uncompressed_size,
+			uint64_t *vblock_size_ptr);
+
+/* Compress a kernel blob with [compression] (only COMPRESS_LZMA1 is
+ * supported). Returns a malloc'd buffer, or NULL on error. */
+uint8_t *CompressKernelBlob(const uint8_t *kernel_blob, uint64_t kernel_size,
+			   uint32_t compression, uint64_t *out_size_ptr);
+
+/* Decompress a kernel blob which must expand to exactly [uncompressed_size]
+ * bytes. Returns a malloc'd buffer, or NULL on error. */
+uint8_t *DecompressKernelBlob(const uint8_t *data, uint64_t size,
+			     uint32_t compression, uint64_t uncompressed_size);
 
 int WriteSomeParts(const char *outfile,
 		   void *part1_data, uint64_t part1_size,
@@ -319,6 +319,8 @@ VbSharedDataHeader* VbSharedDataRead(void) {
    * Check supported old versions first. */
   if (1 == sh->struct_version)
     expect_size = VB_SHARED_DATA_HEADER_SIZE_V1;
+  else if (2 == sh->struct_version)
+    expect_size = VB_SHARED_DATA_HEADER_SIZE_V2;
   else {
     /* There'd better be enough data for the current header size. */
     expect_size = sizeof(VbSharedDataHeader);
@@ -18,6 +18,8 @@ typedef struct CgptCreateParams {
   uint64_t drive_size;
   int zap;
   uint64_t padding;
+  int discard;
+  uint32_t sector_bytes;
 } CgptCreateParams;
 
 typedef struct CgptAddParams {
@@ -43,6 +45,9 @@ typedef struct CgptAddParams {
   int set_raw;
 } CgptAddParams;
 
+#define CGPT_SHOW_MAX_ITEMS 16
+#define CGPT_SHOW_MAX_PARTITIONS 128
+
 typedef struct CgptShowParams {
   char *drive_name;
   uint64_t drive_size;
@@ -53,6 +58,15 @@ typedef struct CgptShowParams {
   int single_item;
   int debug;
   int num_partitions;
+  int json;
+  int binary;
+  /* Multi-query: print each of items[] for each of partitions[], in order.
+   * If num_items or num_query_partitions is zero, single_item or partition is
+   * used instead. */
+  char items[CGPT_SHOW_MAX_ITEMS];
+  int num_items;
+  uint32_t partitions[CGPT_SHOW_MAX_PARTITIONS];
+  int num_query_partitions;
 } CgptShowParams;
 
 typedef struct CgptRepairParams {
@@ -103,6 +117,8 @@ typedef struct CgptFindParams {
    * to print the device name. so this parameter is here to properly show the
    * correct device name in that special case. */
   CgptFindShowFn show_fn;
+  /* Set by CgptFind() while it's searching; callers needn't touch it. */
+  const uint16_t *label_utf16;
 } CgptFindParams;
 
 typedef struct CgptLegacyParams {
@@ -12,6 +12,10 @@ extern "C" {
 
 #include <stddef.h>
 
+/* These may be called from several threads at once.  Reads and writes of
+ * the nvram-backed properties are serialized within the process, but not
+ * against other processes such as another crossystem run. */
+
 /* Recommended size for string property buffers used with
  * VbGetSystemPropertyString(). */
 #define VB_MAX_STRING_PROPERTY     ((size_t) 8192)
@@ -3,6 +3,11 @@
  * found in the LICENSE file.
  *
  * vboot-related functions exported for use by userspace programs
+ *
+ * Thread safety: the functions here keep no state of their own between
+ * calls, so different threads may call them at the same time as long as
+ * each uses its own params struct and they don't work on the same drive.
+ * Access to the same drive, or to the TPM, must be serialized by the caller.
  */
 
 #ifndef VBOOT_HOST_H_
@@ -3,6 +3,7 @@
  * found in the LICENSE file.
  */
 
+#include <pthread.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <string.h>
@@ -48,7 +49,11 @@ typedef enum VdatIntField {
   VDAT_INT_KERNEL_KEY_VERIFIED,      /* Kernel key verified using
                                       * signature, not just hash */
   VDAT_INT_RECOVERY_REASON,          /* Recovery reason for current boot */
-  VDAT_INT_FW_BOOT2                  /* Firmware selection by vboot2 */
+  VDAT_INT_FW_BOOT2,                 /* Firmware selection by vboot2 */
+  VDAT_INT_TPM_ROLLBACK_WRITES,      /* TPM rollback space writes issued
+                                      * this boot */
+  VDAT_INT_TPM_ROLLBACK_WRITES_ELIDED /* TPM rollback space writes skipped
+                                      * this boot */
 } VdatIntField;
 
 
@@ -80,33 +85,36 @@ int FwidStartsWith(const char *start) {
   return 0 == strncmp(fwid, start, strlen(start));
 }
 
+/* The NV storage cache, and the lock that serializes access to it and to the
+ * NV storage itself.  Only this process's threads are kept out; other
+ * processes can still get in. */
+static pthread_mutex_t vnc_lock = PTHREAD_MUTEX_INITIALIZER;
+static VbNvContext cached_vnc;
 static int vnc_read;
 
 int VbGetNvStorage(VbNvParam param) {
-  uint32_t value;
-  int retval;
-  static VbNvContext cached_vnc;
+  uint32_t value = 0;
+  int retval = -1;
 
-  /* TODO: locking around NV access */
+  pthread_mutex_lock(&vnc_lock);
   if (!vnc_read) {
     if (0 != VbReadNvStorage(&cached_vnc))
-      return -1;
+      goto VbGetNvCleanup;
     vnc_read = 1;
   }
 
   if (0 != VbNvSetup(&cached_vnc))
-    return -1;
+    goto VbGetNvCleanup;
   retval = VbNvGet(&cached_vnc, param, &value);
   if (0 != VbNvTeardown(&cached_vnc))
-    return -1;
-  if (0 != retval)
-    return -1;
+    retval = -1;
 
   /* TODO: If vnc.raw_changed, attempt to reopen NVRAM for write and
    * save the new defaults.  If we're able to, log. */
-  /* TODO: release lock */
 
-  return (int)value;
+VbGetNvCleanup:
+  pthread_mutex_unlock(&vnc_lock);
+  return 0 == retval ? (int)value : -1;
 }
 
 
@@ -115,8 +123,9 @@ int VbSetNvStorage(VbNvParam param, int value) {
   int retval = -1;
   int i;
 
+  pthread_mutex_lock(&vnc_lock);
   if (0 != VbReadNvStorage(&vnc))
-    return -1;
+    goto VbSetNvCleanup;
 
   if (0 != VbNvSetup(&vnc))
     goto VbSetNvCleanup;
@@ -136,7 +145,7 @@ int VbSetNvStorage(VbNvParam param, int value) {
   retval = 0;
 
 VbSetNvCleanup:
-  /* TODO: release lock */
+  pthread_mutex_unlock(&vnc_lock);
   return retval;
 }
 
@@ -434,6 +443,20 @@ int GetVdatInt(VdatIntField field) {
     }
   }
 
+  /* Fields added in struct version 3 */
+  if (sh->struct_version >= 3) {
+    switch(field) {
+      case VDAT_INT_TPM_ROLLBACK_WRITES:
+        value = (int)sh->tpm_rollback_writes;
+        break;
+      case VDAT_INT_TPM_ROLLBACK_WRITES_ELIDED:
+        value = (int)sh->tpm_rollback_writes_elided;
+        break;
+      default:
+        break;
+    }
+  }
+
   free(sh);
   return value;
 }
@@ -518,6 +541,10 @@ int VbGetSystemPropertyInt(const char* name) {
     value = GetVdatInt(VDAT_INT_FW_VERSION_TPM);
   } else if (!strcasecmp(name,"tpm_kernver")) {
     value = GetVdatInt(VDAT_INT_KERNEL_VERSION_TPM);
+  } else if (!strcasecmp(name,"tpm_rollback_writes")) {
+    value = GetVdatInt(VDAT_INT_TPM_ROLLBACK_WRITES);
+  } else if (!strcasecmp(name,"tpm_rollback_writes_elided")) {
+    value = GetVdatInt(VDAT_INT_TPM_ROLLBACK_WRITES_ELIDED);
   } else if (!strcasecmp(name,"tried_fwb")) {
     value = GetVdatInt(VDAT_INT_TRIED_FIRMWARE_B);
   } else if (!strcasecmp(name,"recovery_reason")) {
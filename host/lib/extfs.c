@@ -0,0 +1,838 @@
+/*
+ * Copyright 2015 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Minimal ext2/3/4 filesystem access.  This only understands enough of the
+ * on-disk format to find and read files: the superblock, group descriptors,
+ * inodes, linear directories (htree directories can be read linearly too),
+ * block maps and extent trees.  It never allocates or frees anything, so
+ * writes are limited to overwriting blocks a file already owns.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "extfs.h"
+
+/* Superblock, at byte 1024 of the filesystem */
+#define SB_OFFSET		1024
+#define SB_SIZE			1024
+#define SB_INODES_COUNT		0x00
+#define SB_BLOCKS_COUNT_LO	0x04
+#define SB_FIRST_DATA_BLOCK	0x14
+#define SB_LOG_BLOCK_SIZE	0x18
+#define SB_INODES_PER_GROUP	0x28
+#define SB_MAGIC		0x38
+#define SB_REV_LEVEL		0x4c
+#define SB_INODE_SIZE		0x58
+#define SB_FEATURE_INCOMPAT	0x60
+#define SB_DESC_SIZE		0xfe
+#define SB_BLOCKS_COUNT_HI	0x150
+
+#define EXT2_MAGIC		0xef53
+#define EXT2_GOOD_OLD_INODE_SIZE 128
+#define EXT2_MIN_DESC_SIZE	32
+#define EXT4_MIN_DESC_SIZE_64BIT 64
+#define MAX_BLOCK_SIZE		65536
+
+/* Incompatible features; anything we don't list here, we can't read */
+#define INCOMPAT_FILETYPE	0x0002
+#define INCOMPAT_RECOVER	0x0004
+#define INCOMPAT_EXTENTS	0x0040
+#define INCOMPAT_64BIT		0x0080
+#define INCOMPAT_MMP		0x0100
+#define INCOMPAT_FLEX_BG	0x0200
+#define INCOMPAT_CSUM_SEED	0x2000
+#define INCOMPAT_LARGEDIR	0x4000
+#define INCOMPAT_INLINE_DATA	0x8000
+#define INCOMPAT_SUPPORTED (INCOMPAT_FILETYPE | INCOMPAT_RECOVER |	\
+			    INCOMPAT_EXTENTS | INCOMPAT_64BIT |		\
+			    INCOMPAT_MMP | INCOMPAT_FLEX_BG |		\
+			    INCOMPAT_CSUM_SEED | INCOMPAT_LARGEDIR |	\
+			    INCOMPAT_INLINE_DATA)
+
+/* Group descriptor */
+#define BG_INODE_TABLE_LO	0x08
+#define BG_INODE_TABLE_HI	0x28
+
+/* Inode */
+#define INODE_MODE		0x00
+#define INODE_SIZE_LO		0x04
+#define INODE_FLAGS		0x20
+#define INODE_BLOCK		0x28
+#define INODE_SIZE_HIGH		0x6c
+#define INODE_BLOCK_LEN		60
+#define INODE_NDIR_BLOCKS	12
+#define INODE_FLAG_ENCRYPT	0x00000800
+#define INODE_FLAG_EXTENTS	0x00080000
+#define INODE_FLAG_INLINE_DATA	0x10000000
+#define ROOT_INO		2
+
+/* Extent tree nodes */
+#define EXTENT_MAGIC		0xf30a
+#define EXTENT_ENTRY_SIZE	12
+#define EXTENT_MAX_DEPTH	5
+#define EXTENT_INIT_MAX_LEN	32768
+
+/* Directory entries */
+#define DIRENT_HEADER_SIZE	8
+
+/* How many symlinks to follow before giving up, as Linux does */
+#define MAX_SYMLINKS		40
+
+/* Returned by directory callbacks to stop early; not an extfs_error */
+#define STOP_ITERATION		(-1)
+
+struct extfs {
+	int fd;
+	uint64_t offset;
+	int writable;
+	uint32_t incompat;
+	uint32_t block_size;
+	uint64_t blocks_count;
+	uint32_t inodes_count;
+	uint32_t inodes_per_group;
+	uint32_t inode_size;
+	uint32_t desc_size;
+	uint64_t gdt_block;
+};
+
+struct inode {
+	uint32_t ino;
+	uint16_t mode;
+	uint32_t flags;
+	uint64_t size;
+	uint8_t block[INODE_BLOCK_LEN];
+};
+
+/* Called for each run of contiguous blocks in a file */
+typedef int (*run_cb)(struct extfs *fs, uint64_t lblk, uint64_t pblk,
+		      uint64_t count, int uninit, void *arg);
+
+static uint16_t get16(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+const char *extfs_strerror(int err)
+{
+	switch (err) {
+	case EXTFS_SUCCESS:
+		return "Success";
+	case EXTFS_ERROR_IO:
+		return "I/O error";
+	case EXTFS_ERROR_NOT_EXTFS:
+		return "Not an ext2/3/4 filesystem";
+	case EXTFS_ERROR_CORRUPT:
+		return "Filesystem is corrupt";
+	case EXTFS_ERROR_UNSUPPORTED:
+		return "Unsupported filesystem feature";
+	case EXTFS_ERROR_NOT_FOUND:
+		return "No such file or directory";
+	case EXTFS_ERROR_NOT_DIR:
+		return "Not a directory";
+	case EXTFS_ERROR_NOT_FILE:
+		return "Not a regular file";
+	case EXTFS_ERROR_SYMLINK_LOOP:
+		return "Too many levels of symbolic links";
+	case EXTFS_ERROR_SIZE:
+		return "Wrong file size";
+	case EXTFS_ERROR_READ_ONLY:
+		return "Filesystem opened read-only";
+	}
+	return "Unknown error";
+}
+
+static int read_at(struct extfs *fs, uint64_t pos, void *buf, size_t len)
+{
+	uint8_t *p = buf;
+	ssize_t n;
+
+	while (len) {
+		n = pread(fs->fd, p, len, fs->offset + pos);
+		if (n <= 0)
+			return EXTFS_ERROR_IO;
+		p += n;
+		pos += n;
+		len -= n;
+	}
+	return EXTFS_SUCCESS;
+}
+
+static int write_at(struct extfs *fs, uint64_t pos, const void *buf,
+		    size_t len)
+{
+	const uint8_t *p = buf;
+	ssize_t n;
+
+	while (len) {
+		n = pwrite(fs->fd, p, len, fs->offset + pos);
+		if (n <= 0)
+			return EXTFS_ERROR_IO;
+		p += n;
+		pos += n;
+		len -= n;
+	}
+	return EXTFS_SUCCESS;
+}
+
+int extfs_open(struct extfs **fs_ptr, int fd, uint64_t offset, int writable)
+{
+	uint8_t sb[SB_SIZE];
+	struct extfs *fs;
+	uint32_t log_block_size;
+	uint32_t groups;
+	int rv;
+
+	*fs_ptr = NULL;
+
+	fs = calloc(1, sizeof(*fs));
+	if (!fs)
+		return EXTFS_ERROR_IO;
+	fs->fd = fd;
+	fs->offset = offset;
+	fs->writable = writable;
+
+	rv = read_at(fs, SB_OFFSET, sb, sizeof(sb));
+	if (rv)
+		goto bad;
+	rv = EXTFS_ERROR_NOT_EXTFS;
+	if (get16(sb + SB_MAGIC) != EXT2_MAGIC)
+		goto bad;
+
+	rv = EXTFS_ERROR_UNSUPPORTED;
+	fs->incompat = get32(sb + SB_FEATURE_INCOMPAT);
+	if (fs->incompat & ~INCOMPAT_SUPPORTED)
+		goto bad;
+
+	rv = EXTFS_ERROR_CORRUPT;
+	log_block_size = get32(sb + SB_LOG_BLOCK_SIZE);
+	if (log_block_size > 6)
+		goto bad;
+	fs->block_size = 1024 << log_block_size;
+
+	fs->blocks_count = get32(sb + SB_BLOCKS_COUNT_LO);
+	if (fs->incompat & INCOMPAT_64BIT)
+		fs->blocks_count |=
+			(uint64_t)get32(sb + SB_BLOCKS_COUNT_HI) << 32;
+	fs->inodes_count = get32(sb + SB_INODES_COUNT);
+	fs->inodes_per_group = get32(sb + SB_INODES_PER_GROUP);
+	if (!fs->inodes_per_group || fs->inodes_count < ROOT_INO)
+		goto bad;
+
+	fs->inode_size = EXT2_GOOD_OLD_INODE_SIZE;
+	if (get32(sb + SB_REV_LEVEL) > 0)
+		fs->inode_size = get16(sb + SB_INODE_SIZE);
+	if (fs->inode_size < EXT2_GOOD_OLD_INODE_SIZE ||
+	    fs->inode_size > fs->block_size ||
+	    (fs->inode_size & (fs->inode_size - 1)))
+		goto bad;
+
+	fs->desc_size = EXT2_MIN_DESC_SIZE;
+	if (fs->incompat & INCOMPAT_64BIT) {
+		fs->desc_size = get16(sb + SB_DESC_SIZE);
+		if (fs->desc_size < EXT4_MIN_DESC_SIZE_64BIT ||
+		    fs->desc_size > fs->block_size)
+			goto bad;
+	}
+
+	/* The descriptors must fit between the superblock and the end */
+	groups = (fs->inodes_count - 1) / fs->inodes_per_group + 1;
+	fs->gdt_block = get32(sb + SB_FIRST_DATA_BLOCK) + 1;
+	if (fs->gdt_block + ((uint64_t)groups * fs->desc_size - 1) /
+	    fs->block_size >= fs->blocks_count)
+		goto bad;
+
+	*fs_ptr = fs;
+	return EXTFS_SUCCESS;
+
+bad:
+	free(fs);
+	return rv;
+}
+
+void extfs_close(struct extfs *fs)
+{
+	free(fs);
+}
+
+static int read_inode(struct extfs *fs, uint32_t ino, struct inode *inode)
+{
+	uint8_t desc[EXT4_MIN_DESC_SIZE_64BIT];
+	uint8_t raw[INODE_SIZE_HIGH + 4];
+	uint32_t group, index;
+	uint64_t table;
+	int rv;
+
+	if (!ino || ino > fs->inodes_count)
+		return EXTFS_ERROR_CORRUPT;
+	group = (ino - 1) / fs->inodes_per_group;
+	index = (ino - 1) % fs->inodes_per_group;
+
+	rv = read_at(fs, fs->gdt_block * fs->block_size +
+		     (uint64_t)group * fs->desc_size,
+		     desc, fs->desc_size < sizeof(desc) ?
+		     fs->desc_size : sizeof(desc));
+	if (rv)
+		return rv;
+	table = get32(desc + BG_INODE_TABLE_LO);
+	if (fs->desc_size >= EXT4_MIN_DESC_SIZE_64BIT)
+		table |= (uint64_t)get32(desc + BG_INODE_TABLE_HI) << 32;
+	if (!table || table >= fs->blocks_count)
+		return EXTFS_ERROR_CORRUPT;
+
+	rv = read_at(fs, table * fs->block_size +
+		     (uint64_t)index * fs->inode_size, raw, sizeof(raw));
+	if (rv)
+		return rv;
+
+	inode->ino = ino;
+	inode->mode = get16(raw + INODE_MODE);
+	inode->flags = get32(raw + INODE_FLAGS);
+	inode->size = get32(raw + INODE_SIZE_LO) |
+		((uint64_t)get32(raw + INODE_SIZE_HIGH) << 32);
+	memcpy(inode->block, raw + INODE_BLOCK, INODE_BLOCK_LEN);
+	return EXTFS_SUCCESS;
+}
+
+static void fill_stat(const struct inode *inode, struct extfs_stat *st)
+{
+	st->ino = inode->ino;
+	st->mode = inode->mode;
+	st->size = inode->size;
+}
+
+/* Walk an extent tree node, which must be at the given depth */
+static int walk_extents(struct extfs *fs, const uint8_t *node, size_t len,
+			int depth, run_cb cb, void *arg)
+{
+	const uint8_t *e;
+	uint8_t *child;
+	uint64_t start, count;
+	uint32_t entries;
+	uint32_t i;
+	int uninit;
+	int rv;
+
+	if (len < EXTENT_ENTRY_SIZE || get16(node) != EXTENT_MAGIC ||
+	    get16(node + 6) != depth || depth > EXTENT_MAX_DEPTH)
+		return EXTFS_ERROR_CORRUPT;
+	entries = get16(node + 2);
+	if (EXTENT_ENTRY_SIZE * (entries + 1) > len)
+		return EXTFS_ERROR_CORRUPT;
+
+	for (i = 0; i < entries; i++) {
+		e = node + EXTENT_ENTRY_SIZE * (i + 1);
+
+		if (depth) {
+			start = get32(e + 4) | ((uint64_t)get16(e + 8) << 32);
+			if (start >= fs->blocks_count)
+				return EXTFS_ERROR_CORRUPT;
+			child = malloc(fs->block_size);
+			if (!child)
+				return EXTFS_ERROR_IO;
+			rv = read_at(fs, start * fs->block_size, child,
+				     fs->block_size);
+			if (!rv)
+				rv = walk_extents(fs, child, fs->block_size,
+						  depth - 1, cb, arg);
+			free(child);
+		} else {
+			count = get16(e + 4);
+			uninit = count > EXTENT_INIT_MAX_LEN;
+			if (uninit)
+				count -= EXTENT_INIT_MAX_LEN;
+			start = get32(e + 8) | ((uint64_t)get16(e + 6) << 32);
+			if (start + count > fs->blocks_count)
+				return EXTFS_ERROR_CORRUPT;
+			rv = cb(fs, get32(e), start, count, uninit, arg);
+		}
+		if (rv)
+			return rv;
+	}
+	return EXTFS_SUCCESS;
+}
+
+/* Adjacent blocks from an indirect block map, merged into one run */
+struct block_run {
+	run_cb cb;
+	void *arg;
+	uint64_t lblk;
+	uint64_t pblk;
+	uint64_t count;
+};
+
+static int flush_run(struct extfs *fs, struct block_run *run)
+{
+	int rv = EXTFS_SUCCESS;
+
+	if (run->count)
+		rv = run->cb(fs, run->lblk, run->pblk, run->count, 0,
+			     run->arg);
+	run->count = 0;
+	return rv;
+}
+
+/*
+ * Walk <num> block pointers at the given level of an ext2/3 block map, where
+ * level 0 points at data and higher levels point at indirect blocks.
+ * *<lblk> tracks the file block we're at; stop at <end>.
+ */
+static int walk_block_map(struct extfs *fs, const uint8_t *ptrs, uint32_t num,
+			  int level, uint64_t *lblk, uint64_t end,
+			  struct block_run *run)
+{
+	uint32_t per_block = fs->block_size / 4;
+	uint64_t span = 1;
+	uint8_t *child;
+	uint32_t blk;
+	uint32_t i;
+	int rv;
+
+	for (i = 0; i < level; i++)
+		span *= per_block;
+
+	for (i = 0; i < num && *lblk < end; i++) {
+		blk = get32(ptrs + 4 * i);
+		if (blk >= fs->blocks_count)
+			return EXTFS_ERROR_CORRUPT;
+
+		if (!blk) {
+			/* Hole */
+			*lblk += span;
+			continue;
+		}
+
+		if (!level) {
+			if (run->count && run->lblk + run->count == *lblk &&
+			    run->pblk + run->count == blk) {
+				run->count++;
+			} else {
+				rv = flush_run(fs, run);
+				if (rv)
+					return rv;
+				run->lblk = *lblk;
+				run->pblk = blk;
+				run->count = 1;
+			}
+			(*lblk)++;
+			continue;
+		}
+
+		child = malloc(fs->block_size);
+		if (!child)
+			return EXTFS_ERROR_IO;
+		rv = read_at(fs, (uint64_t)blk * fs->block_size, child,
+			     fs->block_size);
+		if (!rv)
+			rv = walk_block_map(fs, child, per_block, level - 1,
+					    lblk, end, run);
+		free(child);
+		if (rv)
+			return rv;
+	}
+	return EXTFS_SUCCESS;
+}
+
+/* Call <cb> for each run of blocks holding the file's data */
+static int walk_blocks(struct extfs *fs, const struct inode *inode,
+		       run_cb cb, void *arg)
+{
+	struct block_run run = { .cb = cb, .arg = arg };
+	uint64_t end = (inode->size + fs->block_size - 1) / fs->block_size;
+	uint64_t lblk = 0;
+	int level;
+	int rv;
+
+	if (inode->flags & (INODE_FLAG_INLINE_DATA | INODE_FLAG_ENCRYPT))
+		return EXTFS_ERROR_UNSUPPORTED;
+
+	if (inode->flags & INODE_FLAG_EXTENTS)
+		return walk_extents(fs, inode->block, INODE_BLOCK_LEN,
+				    get16(inode->block + 6), cb, arg);
+
+	rv = walk_block_map(fs, inode->block, INODE_NDIR_BLOCKS, 0,
+			    &lblk, end, &run);
+	for (level = 1; !rv && level <= 3; level++)
+		rv = walk_block_map(fs, inode->block +
+				    4 * (INODE_NDIR_BLOCKS + level - 1), 1,
+				    level, &lblk, end, &run);
+	if (!rv)
+		rv = flush_run(fs, &run);
+	return rv;
+}
+
+struct file_buf {
+	uint8_t *data;
+	uint64_t size;
+};
+
+static int read_run(struct extfs *fs, uint64_t lblk, uint64_t pblk,
+		    uint64_t count, int uninit, void *arg)
+{
+	struct file_buf *buf = arg;
+	uint64_t start = lblk * fs->block_size;
+	uint64_t len = count * fs->block_size;
+
+	/* Uninitialized extents read as zeroes, which the buffer already is */
+	if (uninit || start >= buf->size)
+		return EXTFS_SUCCESS;
+	if (len > buf->size - start)
+		len = buf->size - start;
+	return read_at(fs, pblk * fs->block_size, buf->data + start, len);
+}
+
+/* Read the data of an inode into a buffer the caller must free */
+static int read_inode_data(struct extfs *fs, const struct inode *inode,
+			   uint8_t **data)
+{
+	struct file_buf buf;
+	int rv;
+
+	*data = NULL;
+	if (inode->size >= SIZE_MAX)
+		return EXTFS_ERROR_SIZE;
+
+	/* Fast symlinks keep their target in the block map */
+	if (S_ISLNK(inode->mode) && inode->size < INODE_BLOCK_LEN &&
+	    !(inode->flags & (INODE_FLAG_EXTENTS | INODE_FLAG_INLINE_DATA))) {
+		*data = malloc(inode->size + 1);
+		if (!*data)
+			return EXTFS_ERROR_IO;
+		memcpy(*data, inode->block, inode->size);
+		return EXTFS_SUCCESS;
+	}
+
+	/* One extra byte so callers can null-terminate symlinks */
+	buf.size = inode->size;
+	buf.data = calloc(1, buf.size + 1);
+	if (!buf.data)
+		return EXTFS_ERROR_IO;
+
+	rv = walk_blocks(fs, inode, read_run, &buf);
+	if (rv) {
+		free(buf.data);
+		return rv;
+	}
+	*data = buf.data;
+	return EXTFS_SUCCESS;
+}
+
+/* Called for each directory entry; non-zero return stops the iteration */
+typedef int (*dirent_cb)(struct extfs *fs, const char *name,
+			 uint32_t name_len, uint32_t ino, void *arg);
+
+static int iterate_dir(struct extfs *fs, const struct inode *dir,
+		       dirent_cb cb, void *arg)
+{
+	uint8_t *data, *d;
+	uint32_t ino, rec_len, name_len;
+	uint64_t pos;
+	int rv;
+
+	if (!S_ISDIR(dir->mode))
+		return EXTFS_ERROR_NOT_DIR;
+
+	rv = read_inode_data(fs, dir, &data);
+	if (rv)
+		return rv;
+
+	for (pos = 0; pos + DIRENT_HEADER_SIZE <= dir->size; pos += rec_len) {
+		d = data + pos;
+		ino = get32(d);
+		rec_len = get16(d + 4);
+		/* 64KB blocks don't fit in 16 bits */
+		if (fs->block_size == MAX_BLOCK_SIZE &&
+		    (rec_len == 0 || rec_len == MAX_BLOCK_SIZE - 1))
+			rec_len = MAX_BLOCK_SIZE;
+		if (fs->incompat & INCOMPAT_FILETYPE)
+			name_len = d[6];
+		else
+			name_len = get16(d + 6);
+
+		if (rec_len < DIRENT_HEADER_SIZE || (rec_len & 3) ||
+		    rec_len > dir->size - pos ||
+		    name_len > rec_len - DIRENT_HEADER_SIZE) {
+			rv = EXTFS_ERROR_CORRUPT;
+			break;
+		}
+
+		/* Unused entries (and htree index blocks) have no inode */
+		if (!ino)
+			continue;
+
+		rv = cb(fs, (const char *)d + DIRENT_HEADER_SIZE, name_len,
+			ino, arg);
+		if (rv)
+			break;
+	}
+
+	free(data);
+	return rv;
+}
+
+struct find_entry {
+	const char *name;
+	uint32_t name_len;
+	uint32_t ino;
+};
+
+static int match_entry(struct extfs *fs, const char *name, uint32_t name_len,
+		       uint32_t ino, void *arg)
+{
+	struct find_entry *find = arg;
+
+	if (name_len != find->name_len || memcmp(name, find->name, name_len))
+		return 0;
+	find->ino = ino;
+	return STOP_ITERATION;
+}
+
+static int find_entry(struct extfs *fs, const struct inode *dir,
+		      const char *name, uint32_t name_len, uint32_t *ino)
+{
+	struct find_entry find = { .name = name, .name_len = name_len };
+	int rv;
+
+	rv = iterate_dir(fs, dir, match_entry, &find);
+	if (rv == STOP_ITERATION) {
+		*ino = find.ino;
+		return EXTFS_SUCCESS;
+	}
+	return rv ? rv : EXTFS_ERROR_NOT_FOUND;
+}
+
+/*
+ * Resolve <path> relative to directory <cwd>, or to the root if it starts
+ * with '/'.  Symlinks in the path are followed, and so is the last
+ * component if <follow> is set.  *<links> counts symlinks followed so far.
+ */
+static int resolve(struct extfs *fs, const struct inode *cwd,
+		   const char *path, int follow, int *links,
+		   struct inode *result)
+{
+	struct inode dir, child;
+	const char *name;
+	uint32_t name_len;
+	uint32_t ino;
+	uint8_t *target;
+	int rv;
+
+	if (*path == '/' || !cwd) {
+		rv = read_inode(fs, ROOT_INO, &dir);
+		if (rv)
+			return rv;
+	} else {
+		dir = *cwd;
+	}
+
+	while (1) {
+		while (*path == '/')
+			path++;
+		if (!*path)
+			break;
+
+		name = path;
+		while (*path && *path != '/')
+			path++;
+		name_len = path - name;
+
+		rv = find_entry(fs, &dir, name, name_len, &ino);
+		if (rv)
+			return rv;
+		rv = read_inode(fs, ino, &child);
+		if (rv)
+			return rv;
+
+		while (*path == '/')
+			path++;
+		if (S_ISLNK(child.mode) && (*path || follow)) {
+			if (++*links > MAX_SYMLINKS)
+				return EXTFS_ERROR_SYMLINK_LOOP;
+			rv = read_inode_data(fs, &child, &target);
+			if (rv)
+				return rv;
+			target[child.size] = '\0';
+			rv = resolve(fs, &dir, (const char *)target, 1, links,
+				     &child);
+			free(target);
+			if (rv)
+				return rv;
+		}
+		dir = child;
+	}
+
+	*result = dir;
+	return EXTFS_SUCCESS;
+}
+
+static int lookup(struct extfs *fs, const char *path, struct inode *inode)
+{
+	int links = 0;
+
+	return resolve(fs, NULL, path, 1, &links, inode);
+}
+
+int extfs_stat(struct extfs *fs, const char *path, struct extfs_stat *st)
+{
+	struct inode inode;
+	int rv;
+
+	rv = lookup(fs, path, &inode);
+	if (rv)
+		return rv;
+	fill_stat(&inode, st);
+	return EXTFS_SUCCESS;
+}
+
+int extfs_read_file(struct extfs *fs, const char *path,
+		    uint8_t **data, uint64_t *size)
+{
+	struct inode inode;
+	int rv;
+
+	rv = lookup(fs, path, &inode);
+	if (rv)
+		return rv;
+	if (!S_ISREG(inode.mode))
+		return EXTFS_ERROR_NOT_FILE;
+
+	rv = read_inode_data(fs, &inode, data);
+	if (rv)
+		return rv;
+	*size = inode.size;
+	return EXTFS_SUCCESS;
+}
+
+struct write_buf {
+	const uint8_t *data;
+	uint8_t *unmapped;	/* Copy of data, with the mapped parts zeroed */
+	uint64_t size;
+};
+
+/* Clip a run to the file size; return zero if it's entirely past the end */
+static uint64_t run_bytes(struct extfs *fs, uint64_t lblk, uint64_t count,
+			  uint64_t size)
+{
+	uint64_t start = lblk * fs->block_size;
+	uint64_t len = count * fs->block_size;
+
+	if (start >= size)
+		return 0;
+	return len < size - start ? len : size - start;
+}
+
+static int check_run(struct extfs *fs, uint64_t lblk, uint64_t pblk,
+		     uint64_t count, int uninit, void *arg)
+{
+	struct write_buf *buf = arg;
+	uint64_t len = run_bytes(fs, lblk, count, buf->size);
+
+	/* Writing to an uninitialized extent would need a metadata update */
+	if (!uninit && len)
+		memset(buf->unmapped + lblk * fs->block_size, 0, len);
+	return EXTFS_SUCCESS;
+}
+
+static int write_run(struct extfs *fs, uint64_t lblk, uint64_t pblk,
+		     uint64_t count, int uninit, void *arg)
+{
+	struct write_buf *buf = arg;
+	uint64_t len = run_bytes(fs, lblk, count, buf->size);
+
+	if (uninit || !len)
+		return EXTFS_SUCCESS;
+	return write_at(fs, pblk * fs->block_size,
+			buf->data + lblk * fs->block_size, len);
+}
+
+int extfs_write_file(struct extfs *fs, const char *path,
+		     const uint8_t *data, uint64_t size)
+{
+	struct write_buf buf = { .data = data, .size = size };
+	struct inode inode;
+	uint64_t i;
+	int rv;
+
+	if (!fs->writable)
+		return EXTFS_ERROR_READ_ONLY;
+	/* The journal may hold newer copies of blocks than the disk does */
+	if (fs->incompat & INCOMPAT_RECOVER)
+		return EXTFS_ERROR_UNSUPPORTED;
+
+	rv = lookup(fs, path, &inode);
+	if (rv)
+		return rv;
+	if (!S_ISREG(inode.mode))
+		return EXTFS_ERROR_NOT_FILE;
+	if (inode.size != size || size >= SIZE_MAX)
+		return EXTFS_ERROR_SIZE;
+
+	/*
+	 * Make sure every non-zero byte has a block to go to before writing
+	 * anything, so we never leave a half-written file behind.
+	 */
+	buf.unmapped = malloc(size + 1);
+	if (!buf.unmapped)
+		return EXTFS_ERROR_IO;
+	memcpy(buf.unmapped, data, size);
+	rv = walk_blocks(fs, &inode, check_run, &buf);
+	for (i = 0; !rv && i < size; i++)
+		if (buf.unmapped[i])
+			rv = EXTFS_ERROR_UNSUPPORTED;
+	free(buf.unmapped);
+	if (rv)
+		return rv;
+
+	return walk_blocks(fs, &inode, write_run, &buf);
+}
+
+struct list_dir {
+	extfs_dir_cb cb;
+	void *arg;
+};
+
+static int list_entry(struct extfs *fs, const char *name, uint32_t name_len,
+		      uint32_t ino, void *arg)
+{
+	struct list_dir *list = arg;
+	struct extfs_stat st;
+	struct inode inode;
+	char buf[256];
+	int rv;
+
+	if ((name_len == 1 && name[0] == '.') ||
+	    (name_len == 2 && name[0] == '.' && name[1] == '.'))
+		return 0;
+	if (name_len >= sizeof(buf))
+		return EXTFS_ERROR_CORRUPT;
+	memcpy(buf, name, name_len);
+	buf[name_len] = '\0';
+
+	rv = read_inode(fs, ino, &inode);
+	if (rv)
+		return rv;
+	fill_stat(&inode, &st);
+	return list->cb(buf, &st, list->arg);
+}
+
+int extfs_list_dir(struct extfs *fs, const char *path,
+		   extfs_dir_cb cb, void *arg)
+{
+	struct list_dir list = { .cb = cb, .arg = arg };
+	struct inode inode;
+	int rv;
+
+	rv = lookup(fs, path, &inode);
+	if (rv)
+		return rv;
+	return iterate_dir(fs, &inode, list_entry, &list);
+}
@@ -9,7 +9,7 @@
 
 #include "fmap.h"
 
-static int is_fmap(uint8_t *ptr)
+static int is_fmap(uint8_t *ptr, int *warned)
 {
 	FmapHeader *fmap_header = (FmapHeader *)ptr;
 
@@ -19,8 +19,12 @@ static int is_fmap(uint8_t *ptr)
 	if (fmap_header->fmap_ver_major == FMAP_VER_MAJOR)
 		return 1;
 
-	fprintf(stderr, "Found FMAP, but major version is %u instead of %u\n",
-		fmap_header->fmap_ver_major, FMAP_VER_MAJOR);
+	/* Only complain once, in case the image is full of these */
+	if (!*warned)
+		fprintf(stderr,
+			"Found FMAP, but major version is %u instead of %u\n",
+			fmap_header->fmap_ver_major, FMAP_VER_MAJOR);
+	*warned = 1;
 	return 0;
 }
 
@@ -29,15 +33,23 @@ FmapHeader *fmap_find(uint8_t *ptr, size_t size)
 {
 	ssize_t offset, align;
 	ssize_t lim = size - sizeof(FmapHeader);
+	int warned = 0;
 
-	if (lim >= 0 && is_fmap(ptr))
+	if (lim < 0)
+		return NULL;
+
+	/* Most images without an FMAP don't have the signature anywhere */
+	if (!memmem(ptr, size, FMAP_SIGNATURE, FMAP_SIGNATURE_SIZE))
+		return NULL;
+
+	if (is_fmap(ptr, &warned))
 		return (FmapHeader *)ptr;
 
 	/* Search large alignments before small ones to find "right" FMAP. */
 	for (align = FMAP_SEARCH_STRIDE; align <= lim; align *= 2);
 	for (; align >= FMAP_SEARCH_STRIDE; align /= 2)
 		for (offset = align; offset <= lim; offset += align * 2)
-			if (is_fmap(ptr + offset))
+			if (is_fmap(ptr + offset, &warned))
 				return (FmapHeader *)(ptr + offset);
 
 	return NULL;
@@ -79,14 +79,21 @@ VbKernelPreambleHeader *CreateKernelPreamble(
 	uint64_t vmlinuz_header_address,
 	uint64_t vmlinuz_header_size,
 	uint32_t flags,
+	uint32_t body_chunk_size,
+	const VbSignature *body_chunk_hashes,
+	uint32_t body_compression,
+	uint32_t body_uncompressed_size,
 	uint64_t desired_size,
 	const VbPrivateKey *signing_key)
 {
 	VbKernelPreambleHeader *h;
+	uint64_t chunk_hashes_size = (body_chunk_hashes ?
+				      body_chunk_hashes->sig_size : 0);
 	uint64_t signed_size = (sizeof(VbKernelPreambleHeader) +
-				body_signature->sig_size);
+				body_signature->sig_size + chunk_hashes_size);
 	uint64_t block_size = signed_size + siglen_map[signing_key->algorithm];
 	uint8_t *body_sig_dest;
+	uint8_t *chunk_hashes_dest;
 	uint8_t *block_sig_dest;
 	VbSignature *sigtmp;
 
@@ -101,7 +108,8 @@ VbKernelPreambleHeader *CreateKernelPreamble(
 
 	Memset(h, 0, block_size);
 	body_sig_dest = (uint8_t *)(h + 1);
-	block_sig_dest = body_sig_dest + body_signature->sig_size;
+	chunk_hashes_dest = body_sig_dest + body_signature->sig_size;
+	block_sig_dest = chunk_hashes_dest + chunk_hashes_size;
 
 	h->header_version_major = KERNEL_PREAMBLE_HEADER_VERSION_MAJOR;
 	h->header_version_minor = KERNEL_PREAMBLE_HEADER_VERSION_MINOR;
@@ -119,6 +127,22 @@ VbKernelPreambleHeader *CreateKernelPreamble(
 		      body_signature->sig_size, 0);
 	SignatureCopy(&h->body_signature, body_signature);
 
+	/* Copy body chunk digests, if any */
+	SignatureInit(&h->body_chunk_hashes, chunk_hashes_dest,
+		      chunk_hashes_size, 0);
+	if (body_chunk_hashes) {
+		h->body_chunk_size = body_chunk_size;
+		SignatureCopy(&h->body_chunk_hashes, body_chunk_hashes);
+	}
+
+	/* Older firmware can't boot compressed bodies, so must reject them */
+	if (body_compression != COMPRESS_NONE) {
+		h->header_version_major =
+			KERNEL_PREAMBLE_COMPRESSED_VERSION_MAJOR;
+		h->body_compression = body_compression;
+		h->body_uncompressed_size = body_uncompressed_size;
+	}
+
 	/* Set up signature struct so we can calculate the signature */
 	SignatureInit(&h->preamble_signature, block_sig_dest,
 		      siglen_map[signing_key->algorithm], signed_size);
@@ -7,9 +7,12 @@
 
 /* TODO: change all 'return 0', 'return 1' into meaningful return codes */
 
+#include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "cryptolib.h"
@@ -24,35 +27,160 @@ char* StrCopy(char* dest, const char* src, int dest_size) {
 }
 
 
+/* Runs of zeroes at least this long, and aligned to it, become holes when
+ * writing a file. */
+#define SPARSE_BLOCK_SIZE 4096
+
+/* Read exactly [count] bytes at [offset] of [fd]. Returns 0 if success. */
+static int PreadAll(int fd, uint8_t* buf, uint64_t count, uint64_t offset) {
+  while (count) {
+    ssize_t n = pread(fd, buf, count, offset);
+    if (n <= 0) {
+      if (n < 0 && errno == EINTR)
+        continue;
+      return 1;
+    }
+    buf += n;
+    offset += n;
+    count -= n;
+  }
+  return 0;
+}
+
+/* Write exactly [count] bytes at [offset] of [fd]. Returns 0 if success. */
+static int PwriteAll(int fd, const uint8_t* buf, uint64_t count,
+                     uint64_t offset) {
+  while (count) {
+    ssize_t n = pwrite(fd, buf, count, offset);
+    if (n <= 0) {
+      if (n < 0 && errno == EINTR)
+        continue;
+      return 1;
+    }
+    buf += n;
+    offset += n;
+    count -= n;
+  }
+  return 0;
+}
+
+/* Write all of [buf] to [fd] at its current position. Returns 0 if success. */
+static int WriteAll(int fd, const uint8_t* buf, uint64_t count) {
+  while (count) {
+    ssize_t n = write(fd, buf, count);
+    if (n <= 0) {
+      if (n < 0 && errno == EINTR)
+        continue;
+      return 1;
+    }
+    buf += n;
+    count -= n;
+  }
+  return 0;
+}
+
+static int IsZero(const uint8_t* buf, uint64_t size) {
+  return !size || (!buf[0] && !memcmp(buf, buf + 1, size - 1));
+}
+
+
+int ReadSparse(int fd, uint8_t* buf, uint64_t size) {
+  uint64_t offset = 0;
+
+  while (offset < size) {
+    uint64_t data = offset, hole = size;
+#ifdef SEEK_DATA
+    off_t pos = lseek(fd, offset, SEEK_DATA);
+    if (pos == -1 && errno == ENXIO)
+      break;  /* Nothing but a hole from here to the end of the file */
+    if (pos != -1) {
+      data = pos;
+      pos = lseek(fd, data, SEEK_HOLE);
+      if (pos != -1 && pos < size)
+        hole = pos;
+    }
+    /* Otherwise SEEK_DATA isn't supported, so read everything */
+#endif
+    if (data >= size)
+      break;
+    if (PreadAll(fd, buf + data, hole - data, data))
+      return 1;
+    offset = hole;
+  }
+  return 0;
+}
+
+
+int WriteSparse(int fd, const uint8_t* buf, uint64_t size) {
+  struct stat sb;
+  uint64_t offset = 0;
+
+  if (fstat(fd, &sb) || !S_ISREG(sb.st_mode))
+    return WriteAll(fd, buf, size);
+
+  while (offset < size) {
+    uint64_t len = size - offset, end;
+
+    if (len > SPARSE_BLOCK_SIZE)
+      len = SPARSE_BLOCK_SIZE;
+    if (IsZero(buf + offset, len)) {
+      offset += len;
+      continue;
+    }
+
+    /* Write everything up to the next block of zeroes at once */
+    for (end = offset + len; end < size; end += len) {
+      len = size - end;
+      if (len > SPARSE_BLOCK_SIZE)
+        len = SPARSE_BLOCK_SIZE;
+      if (IsZero(buf + end, len))
+        break;
+    }
+    if (PwriteAll(fd, buf + offset, end - offset, offset))
+      return 1;
+    offset = end;
+  }
+
+  /* Zeroes at the end only exist once the file is extended over them */
+  return ftruncate(fd, size) ? 1 : 0;
+}
+
+
 uint8_t* ReadFile(const char* filename, uint64_t* sizeptr) {
-  FILE* f;
+  off_t end;
   uint8_t* buf;
   uint64_t size;
+  int fd;
 
-  f = fopen(filename, "rb");
-  if (!f) {
+  fd = open(filename, O_RDONLY);
+  if (fd < 0) {
     VBDEBUG(("Unable to open file %s\n", filename));
     return NULL;
   }
 
-  fseek(f, 0, SEEK_END);
-  size = ftell(f);
-  rewind(f);
+  end = lseek(fd, 0, SEEK_END);
+  if (end < 0) {
+    VBDEBUG(("Unable to seek in file %s\n", filename));
+    close(fd);
+    return NULL;
+  }
+  size = end;
 
-  buf = malloc(size);
+  /* Holes in a sparse file are left as the zeroes calloc() gives us */
+  buf = calloc(1, size ? size : 1);
   if (!buf) {
-    fclose(f);
+    close(fd);
     return NULL;
   }
 
-  if(1 != fread(buf, size, 1, f)) {
+  if (ReadSparse(fd, buf, size)) {
     VBDEBUG(("Unable to read from file %s\n", filename));
-    fclose(f);
+    close(fd);
     free(buf);
     return NULL;
   }
 
-  fclose(f);
+  close(fd);
   if (sizeptr)
     *sizeptr = size;
   return buf;
@@ -98,19 +226,23 @@ int ReadFileBit(const char* filename, int bitmask) {
 
 
 int WriteFile(const char* filename, const void *data, uint64_t size) {
-  FILE *f = fopen(filename, "wb");
-  if (!f) {
+  int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (fd < 0) {
     VBDEBUG(("Unable to open file %s\n", filename));
     return 1;
   }
 
-  if (1 != fwrite(data, size, 1, f)) {
+  if (WriteSparse(fd, data, size)) {
     VBDEBUG(("Unable to write to file %s\n", filename));
-    fclose(f);
+    close(fd);
     unlink(filename);  /* Delete any partial file */
     return 1;
   }
 
-  fclose(f);
+  if (close(fd)) {
+    VBDEBUG(("Unable to close file %s\n", filename));
+    unlink(filename);
+    return 1;
+  }
   return 0;
 }
@@ -9,6 +9,7 @@
 
 #include <openssl/rsa.h>
 
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/types.h>
@@ -101,6 +102,151 @@ VbSignature* CalculateHash(const uint8_t* data, uint64_t size,
   return sig;
 }
 
+/* Work for one chunk hashing thread: chunks [first, last) of the data. */
+struct chunk_hash_job {
+  const uint8_t* data;
+  uint64_t size;
+  uint32_t chunk_size;
+  unsigned int algorithm;
+  uint8_t* hashes;      /* Table to fill in, or NULL to check [expect] */
+  const uint8_t* expect;
+  uint64_t first;
+  uint64_t last;
+  int error;
+};
+
+/* Hashes [size] bytes of [data] into [digest], which must have room for the
+ * digest for signature algorithm [algorithm].  This doesn't use DigestBuf(),
+ * since VbExMalloc() may not be thread-safe.
+ *
+ * Returns 0 if success, non-zero if error. */
+static int ChunkDigest(const uint8_t* data, uint64_t size,
+                       unsigned int algorithm, uint8_t* digest) {
+  switch (hash_type_map[algorithm]) {
+    case SHA1_DIGEST_ALGORITHM:
+      internal_SHA1(data, size, digest);
+      return 0;
+    case SHA256_DIGEST_ALGORITHM:
+      internal_SHA256(data, size, digest);
+      return 0;
+    case SHA512_DIGEST_ALGORITHM:
+      internal_SHA512(data, size, digest);
+      return 0;
+  }
+  return 1;
+}
+
+static void* ChunkHashWorker(void* arg) {
+  struct chunk_hash_job* job = (struct chunk_hash_job*)arg;
+  int digest_size = hash_size_map[job->algorithm];
+  uint8_t digest[SHA512_DIGEST_SIZE];
+  uint64_t i, offset, n;
+
+  for (i = job->first; i < job->last && !job->error; i++) {
+    offset = i * job->chunk_size;
+    n = job->size - offset;
+    if (n > job->chunk_size)
+      n = job->chunk_size;
+
+    if (ChunkDigest(job->data + offset, n, job->algorithm, digest)) {
+      job->error = 1;
+    } else if (job->hashes) {
+      Memcpy(job->hashes + i * digest_size, digest, digest_size);
+    } else if (SafeMemcmp(digest, job->expect + i * digest_size,
+                          digest_size)) {
+      VBDEBUG(("Body chunk at 0x%x doesn't match.\n", (int)offset));
+      job->error = 1;
+    }
+  }
+  return NULL;
+}
+
+/* Splits the chunks between up to one thread per online CPU.  Fills in
+ * [hashes] if it's not NULL, else checks the chunks against [expect].
+ * Returns 0 if success, non-zero if error. */
+static int HashChunks(const uint8_t* data, uint64_t size, uint32_t chunk_size,
+                      unsigned int algorithm, uint8_t* hashes,
+                      const uint8_t* expect) {
+  uint64_t num_chunks = (size + chunk_size - 1) / chunk_size;
+  struct chunk_hash_job* jobs;
+  pthread_t* threads;
+  int* started;
+  long num_jobs = sysconf(_SC_NPROCESSORS_ONLN);
+  long i;
+  int rv = 0;
+
+  if (num_jobs < 1)
+    num_jobs = 1;
+  if (num_jobs > num_chunks)
+    num_jobs = num_chunks ? num_chunks : 1;
+
+  jobs = calloc(num_jobs, sizeof(*jobs));
+  threads = calloc(num_jobs, sizeof(*threads));
+  started = calloc(num_jobs, sizeof(*started));
+  if (!jobs || !threads || !started) {
+    rv = 1;
+    goto out;
+  }
+
+  for (i = 0; i < num_jobs; i++) {
+    jobs[i].data = data;
+    jobs[i].size = size;
+    jobs[i].chunk_size = chunk_size;
+    jobs[i].algorithm = algorithm;
+    jobs[i].hashes = hashes;
+    jobs[i].expect = expect;
+    jobs[i].first = num_chunks * i / num_jobs;
+    jobs[i].last = num_chunks * (i + 1) / num_jobs;
+    /* The first share is ours; a thread we can't start is ours too */
+    if (i)
+      started[i] = !pthread_create(&threads[i], NULL, ChunkHashWorker,
+                                   &jobs[i]);
+  }
+  for (i = 0; i < num_jobs; i++) {
+    if (started[i])
+      pthread_join(threads[i], NULL);
+    else
+      ChunkHashWorker(&jobs[i]);
+    rv |= jobs[i].error;
+  }
+
+out:
+  free(started);
+  free(threads);
+  free(jobs);
+  return rv;
+}
+
+VbSignature* CalculateChunkHashes(const uint8_t* data, uint64_t size,
+                                  uint32_t chunk_size,
+                                  unsigned int algorithm) {
+  uint64_t num_chunks;
+  VbSignature* sig;
+
+  if (!chunk_size || algorithm >= (unsigned int)kNumAlgorithms)
+    return NULL;
+  num_chunks = (size + chunk_size - 1) / chunk_size;
+
+  sig = SignatureAlloc(num_chunks * hash_size_map[algorithm], size);
+  if (!sig)
+    return NULL;
+
+  if (HashChunks(data, size, chunk_size, algorithm,
+                 GetSignatureData(sig), NULL)) {
+    free(sig);
+    return NULL;
+  }
+  return sig;
+}
+
+int VerifyChunkHashes(const uint8_t* data, uint64_t size,
+                      uint32_t chunk_size, unsigned int algorithm,
+                      const uint8_t* hashes) {
+  if (!chunk_size || algorithm >= (unsigned int)kNumAlgorithms)
+    return 1;
+  return HashChunks(data, size, chunk_size, algorithm, NULL, hashes);
+}
+
 VbSignature* CalculateSignature(const uint8_t* data, uint64_t size,
                                 const VbPrivateKey* key) {
 
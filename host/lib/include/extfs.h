@@ -0,0 +1,87 @@
+/*
+ * Copyright 2015 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Minimal ext2/3/4 filesystem access, so that tools can read (and patch in
+ * place) files in a rootfs image without loop-mounting it.
+ */
+
+#ifndef VBOOT_REFERENCE_EXTFS_H_
+#define VBOOT_REFERENCE_EXTFS_H_
+
+#include <stdint.h>
+
+enum extfs_error {
+	EXTFS_SUCCESS = 0,
+	EXTFS_ERROR_IO,			/* Can't read or write the image */
+	EXTFS_ERROR_NOT_EXTFS,		/* No ext2/3/4 superblock */
+	EXTFS_ERROR_CORRUPT,		/* Inconsistent metadata */
+	EXTFS_ERROR_UNSUPPORTED,	/* Filesystem or file feature */
+	EXTFS_ERROR_NOT_FOUND,		/* No such file or directory */
+	EXTFS_ERROR_NOT_DIR,		/* Path component isn't a directory */
+	EXTFS_ERROR_NOT_FILE,		/* Not a regular file */
+	EXTFS_ERROR_SYMLINK_LOOP,	/* Too many levels of symlinks */
+	EXTFS_ERROR_SIZE,		/* Size change or file too big */
+	EXTFS_ERROR_READ_ONLY,		/* Opened without write access */
+};
+
+/* Return a human-readable description of an enum extfs_error. */
+const char *extfs_strerror(int err);
+
+/* Open filesystem, from extfs_open() */
+struct extfs;
+
+/* What extfs_stat() and extfs_list_dir() report about a file */
+struct extfs_stat {
+	uint32_t ino;
+	uint16_t mode;			/* st_mode-compatible type and perms */
+	uint64_t size;
+};
+
+/**
+ * Open the filesystem which starts <offset> bytes into <fd>.
+ *
+ * The file descriptor stays owned by the caller, and must stay open until
+ * extfs_close().  Unless <writable> is non-zero, extfs_write_file() will
+ * refuse to change anything.  On success, stores the handle in *<fs>.
+ */
+int extfs_open(struct extfs **fs, int fd, uint64_t offset, int writable);
+
+/* Free a handle from extfs_open(). */
+void extfs_close(struct extfs *fs);
+
+/**
+ * Look up <path>, relative to the root of the filesystem.  Symlinks are
+ * followed, including the last component, as they would be if the
+ * filesystem were mounted at /.
+ */
+int extfs_stat(struct extfs *fs, const char *path, struct extfs_stat *st);
+
+/**
+ * Read the whole of the regular file at <path>.  On success, *<data> points
+ * to a malloc()ed buffer of *<size> bytes which the caller must free().
+ */
+int extfs_read_file(struct extfs *fs, const char *path,
+		    uint8_t **data, uint64_t *size);
+
+/**
+ * Overwrite the contents of the regular file at <path>, which must already
+ * be exactly <size> bytes.  Only data blocks are written; no metadata
+ * (timestamps, block maps, checksums) changes.  Fails if the new contents
+ * would need blocks the file doesn't have, such as non-zero data in a hole.
+ */
+int extfs_write_file(struct extfs *fs, const char *path,
+		     const uint8_t *data, uint64_t size);
+
+/**
+ * Call <cb> for each entry of the directory at <path>, other than "." and
+ * "..", in on-disk order.  Stops early if <cb> returns non-zero, and
+ * returns that value.
+ */
+typedef int (*extfs_dir_cb)(const char *name, const struct extfs_stat *st,
+			    void *arg);
+int extfs_list_dir(struct extfs *fs, const char *path,
+		   extfs_dir_cb cb, void *arg);
+
+#endif  /* VBOOT_REFERENCE_EXTFS_H_ */
@@ -40,6 +40,14 @@ VbFirmwarePreambleHeader *CreateFirmwarePreamble(
 /**
  * Create a kernel preamble, signed with [signing_key].
  *
+ * If [body_chunk_hashes] is not NULL, it is the table of digests for each
+ * [body_chunk_size] bytes of the body (see CalculateChunkHashes()), and is
+ * included in the signed part of the preamble.
+ *
+ * If [body_compression] is not COMPRESS_NONE, the body (and so
+ * [body_signature] and [body_chunk_hashes]) is compressed, and is
+ * [body_uncompressed_size] bytes once decompressed.
+ *
  * Caller owns the returned pointer, and must free it with Free().
  *
  * Returns NULL if error.
@@ -53,6 +61,10 @@ VbKernelPreambleHeader *CreateKernelPreamble(
 	uint64_t vmlinuz_header_address,
 	uint64_t vmlinuz_header_size,
 	uint32_t flags,
+	uint32_t body_chunk_size,
+	const VbSignature *body_chunk_hashes,
+	uint32_t body_compression,
+	uint32_t body_uncompressed_size,
 	uint64_t desired_size,
 	const VbPrivateKey *signing_key);
 
@@ -22,6 +22,18 @@ char* StrCopy(char* dest, const char* src, int dest_size);
  * error. */
 uint8_t* ReadFile(const char* filename, uint64_t* size);
 
+/* Read [size] bytes from the start of [fd] into [buf], which the caller must
+ * have zeroed. Holes in a sparse file are skipped rather than read.
+ *
+ * Returns 0 if success, 1 if error. */
+int ReadSparse(int fd, uint8_t* buf, uint64_t size);
+
+/* Write [size] bytes of [buf] to the start of [fd], which must be empty.
+ * Blocks of zeroes in a regular file are left as holes rather than written.
+ *
+ * Returns 0 if success, 1 if error. */
+int WriteSparse(int fd, const uint8_t* buf, uint64_t size);
+
 /* Read a string from a file.  Passed the destination, dest size, and
  * filename to read.
  *
@@ -43,6 +43,24 @@ VbSignature* CalculateChecksum(const uint8_t* data, uint64_t size);
 VbSignature* CalculateHash(const uint8_t* data, uint64_t size,
                            const VbPrivateKey* key);
 
+/* Calculates a table of digests for each [chunk_size] bytes of the data (the
+ * last chunk may be shorter), using the hash for signature algorithm
+ * [algorithm].  The chunks are hashed in parallel, on up to one thread per
+ * online CPU.
+ * Caller owns the returned pointer, and must free it with Free().
+ *
+ * Returns NULL on error. */
+VbSignature* CalculateChunkHashes(const uint8_t* data, uint64_t size,
+                                  uint32_t chunk_size, unsigned int algorithm);
+
+/* Checks the data against a table of chunk digests made by
+ * CalculateChunkHashes(), hashing the chunks in parallel.
+ *
+ * Returns 0 if all the chunks match, non-zero if error or mismatch. */
+int VerifyChunkHashes(const uint8_t* data, uint64_t size,
+                      uint32_t chunk_size, unsigned int algorithm,
+                      const uint8_t* hashes);
+
 /* Calculates a signature for the data using the specified key.
  * Caller owns the returned pointer, and must free it with Free().
  *
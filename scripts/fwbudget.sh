@@ -0,0 +1,223 @@
+#!/bin/bash
+#
+# Copyright 2015 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+#
+# Report the code size of each symbol and the worst-case stack depth of each
+# function in a firmware library, and check them against a budget file.
+#
+# The objects must have been built with -fstack-usage -fcallgraph-info=su
+# (make STACK_REPORT=1), so that there's a .ci call graph next to each one.
+#
+# Usage: fwbudget.sh BUDGET_FILE REPORT_DIR LIBRARY OBJECT...
+
+set -e
+
+if [ $# -lt 4 ]; then
+	echo "Usage: $0 BUDGET_FILE REPORT_DIR LIBRARY OBJECT..." 1>&2
+	exit 1
+fi
+
+budgets="$1"
+reportdir="$2"
+lib="$3"
+shift 3
+
+libname="${lib##*/}"
+report="${reportdir}/${libname%.a}.txt"
+mkdir -p "${reportdir}"
+
+callgraphs=()
+for obj in "$@"; do
+	ci="${obj%.o}.ci"
+	if [ ! -f "${ci}" ]; then
+		echo "$0: no call graph for ${obj}; rebuild it with" \
+			"STACK_REPORT=1 (from clean)" 1>&2
+		exit 1
+	fi
+	callgraphs+=("${ci}")
+done
+
+# Code size: text (including read-only data) plus initialized data
+code=$(size -t "$@" | awk 'END { print $1 + $2 }')
+
+# Per-symbol sizes, and the stack depth of everything in the call graph
+nm -S -t d "$@" 2>/dev/null | \
+	awk 'NF == 4 { print "size", $2 + 0, $3, $4 }' > "${report}.sizes"
+cat "${callgraphs[@]}" | awk '
+# Titles are "file:name" for static functions, and just "name" otherwise.
+# Only functions defined in the library have a "N bytes" line in the label.
+function field(line, key,    s) {
+	s = line
+	if (!sub(".*" key ": \"", "", s))
+		return ""
+	sub(/".*/, "", s)
+	return s
+}
+
+/^node:/ {
+	t = field($0, "title")
+	label = field($0, "label")
+	n = split(label, part, /\\n/)
+	name[t] = part[1]
+	if (n >= 3 && part[3] ~ / bytes/) {
+		defined[t] = 1
+		own[t] = part[3] + 0
+		if (part[3] ~ /dynamic/ && part[3] !~ /bounded/)
+			dynamic[t] = 1
+	}
+	next
+}
+
+/^edge:/ {
+	s = field($0, "sourcename")
+	t = field($0, "targetname")
+	if (t == "__indirect_call") {
+		indirect[s] = 1
+		next
+	}
+	if (!((s, t) in seen)) {
+		seen[s, t] = 1
+		ncallee[s]++
+		callee[s, ncallee[s]] = t
+	}
+	next
+}
+
+# Deepest stack starting at <f>. Calls out of the library count as zero;
+# recursion and unbounded dynamic allocation make the depth unbounded.
+function depth(f,    i, c, d, best) {
+	if (f in memo)
+		return memo[f]
+	if (!(f in defined)) {
+		external[f] = 1
+		return 0
+	}
+	if (f in active) {
+		unbounded[f] = "recursive"
+		return 0
+	}
+	active[f] = 1
+	best = 0
+	for (i = 1; i <= ncallee[f]; i++) {
+		c = callee[f, i]
+		d = depth(c)
+		if ((c in unbounded) && !(f in unbounded))
+			unbounded[f] = "calls " name[c]
+		if (d > best || !(f in deepest)) {
+			best = d
+			deepest[f] = c
+		}
+	}
+	delete active[f]
+	if (f in dynamic)
+		unbounded[f] = "dynamic stack"
+	memo[f] = own[f] + best
+	return memo[f]
+}
+
+END {
+	for (f in defined) {
+		d = depth(f)
+		path = name[f]
+		for (g = deepest[f]; g != ""; g = deepest[g]) {
+			path = path " > " name[g]
+			if (!(g in defined))
+				break
+		}
+		flags = ""
+		if (f in unbounded)
+			flags = flags " [unbounded: " unbounded[f] "]"
+		if (f in indirect)
+			flags = flags " [indirect calls]"
+		printf "stack %d %d %s%s: %s\n", d, own[f], name[f], flags,
+			path
+		if (f in unbounded)
+			printf "unbounded %s\n", name[f]
+	}
+	for (f in external)
+		printf "external %s\n", name[f]
+}' > "${report}.stack"
+
+# Now the human-readable report
+{
+	echo "${libname}: ${code} bytes of code and data"
+	echo
+	echo "Worst-case stack depth (bytes), own frame, function, deepest path"
+	grep '^stack ' "${report}.stack" | sort -k2,2nr -k4 | cut -d' ' -f2-
+	echo
+	echo "Calls out of the library, counted as using no stack:"
+	grep '^external ' "${report}.stack" | cut -d' ' -f2 | sort -u | \
+		tr '\n' ' ' | fold -s -w 72 | sed 's/^/  /'
+	echo
+	echo
+	echo "Symbol sizes (bytes), type, name"
+	sort -k2,2nr "${report}.sizes" | cut -d' ' -f2-
+} > "${report}"
+
+# Check the budgets for this library. Lines are
+#   LIBRARY code - LIMIT
+#   LIBRARY stack - LIMIT          (deepest of any function)
+#   LIBRARY stack FUNCTION LIMIT
+#   LIBRARY size SYMBOL LIMIT
+errors=0
+checked=0
+while read -r blib what sym limit; do
+	case "${blib}" in
+		"#"*|"") continue ;;
+	esac
+	[ "${blib}" = "${libname}" ] || continue
+	checked=$((checked + 1))
+
+	case "${what}" in
+	code)
+		value="${code}"
+		;;
+	stack)
+		if [ "${sym}" = "-" ]; then
+			line=$(grep '^stack ' "${report}.stack" | \
+				sort -k2,2nr | head -1)
+		else
+			line=$(grep "^stack [0-9]* [0-9]* ${sym}[: ]" \
+				"${report}.stack" | sort -k2,2nr | head -1)
+		fi
+		if [ -z "${line}" ]; then
+			echo "${libname}: no function ${sym}" 1>&2
+			errors=$((errors + 1))
+			continue
+		fi
+		value=$(echo "${line}" | cut -d' ' -f2)
+		func=$(echo "${line}" | cut -d' ' -f4)
+		func="${func%:}"
+		if grep -q "^unbounded ${func}\$" "${report}.stack"; then
+			echo "${libname}: stack of ${func} is unbounded;" \
+				"see ${report}" 1>&2
+			errors=$((errors + 1))
+			continue
+		fi
+		;;
+	size)
+		value=$(awk -v s="${sym}" '$4 == s { n += $2 } END { print n + 0 }' \
+			"${report}.sizes")
+		;;
+	*)
+		echo "${budgets}: unknown budget \"${what}\"" 1>&2
+		errors=$((errors + 1))
+		continue
+		;;
+	esac
+
+	if [ "${value}" -gt "${limit}" ]; then
+		echo "${libname}: ${what} ${sym} is ${value}, over budget" \
+			"(${limit})" 1>&2
+		errors=$((errors + 1))
+	fi
+done < "${budgets}"
+
+rm -f "${report}.sizes" "${report}.stack"
+
+worst=$(sed -n '/^Worst-case/{n;p}' "${report}")
+echo "${libname}: ${code} bytes, deepest stack ${worst%% *} bytes" \
+	"(${checked} budgets checked); see ${report}"
+[ "${errors}" -eq 0 ]
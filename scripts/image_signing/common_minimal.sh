@@ -136,6 +136,13 @@ partsize() {
   sudo $GPT show -s -i $2 $1
 }
 
+# Read GPT table once to find both the location and size of a partition.
+# Args: DEVICE PARTNUM
+# Returns: "offset size" (in sectors) of partition PARTNUM
+partoffsetsize() {
+  sudo $GPT show -b -s -i $2 $1
+}
+
 # Tags a file system as "needs to be resigned".
 # Args: MOUNTDIRECTORY
 tag_as_needs_to_be_resigned() {
@@ -210,6 +217,33 @@ mount_image_partition_ro() {
   _mount_image_partition_retry "$@" "ro"
 }
 
+# Copy files from an ext2/3/4 partition of an image into a local directory,
+# keeping their paths, without mounting the partition (so without root).
+# Files which aren't in the image aren't created; directories are created
+# empty.  Fails if the partition can't be read at all.
+# Args: IMAGE PARTNUM DIRECTORY FILE...
+extract_image_partition_files() {
+  local image=$1
+  local partnum=$2
+  local dir=$3
+  local extfs="${FUTILITY:-futility} extfs -p ${partnum} ${image}"
+  local file
+  shift 3
+
+  ${extfs} ls / > /dev/null || return 1
+  for file in "$@"; do
+    file=${file#/}
+    mkdir -p "${dir}/$(dirname "${file}")"
+    if ${extfs} cat "/${file}" > "${dir}/${file}" 2>/dev/null; then
+      continue
+    fi
+    rm -f "${dir}/${file}"
+    if ${extfs} ls "/${file}" > /dev/null 2>&1; then
+      mkdir -p "${dir}/${file}"
+    fi
+  done
+}
+
 # Mount a partition from an image into a local directory
 # Args: IMAGE PARTNUM MOUNTDIRECTORY
 mount_image_partition() {
@@ -226,8 +260,10 @@ extract_image_partition() {
   local image=$1
   local partnum=$2
   local output_file=$3
-  local offset=$(partoffset "$image" "$partnum")
-  local size=$(partsize "$image" "$partnum")
+  local offset size
+  read offset size <<EOF
+$(partoffsetsize "$image" "$partnum")
+EOF
   dd if=$image of=$output_file bs=512 skip=$offset count=$size \
     conv=notrunc 2>/dev/null
 }
@@ -238,8 +274,10 @@ replace_image_partition() {
   local image=$1
   local partnum=$2
   local input_file=$3
-  local offset=$(partoffset "$image" "$partnum")
-  local size=$(partsize "$image" "$partnum")
+  local offset size
+  read offset size <<EOF
+$(partoffsetsize "$image" "$partnum")
+EOF
   dd if=$input_file of=$image bs=512 seek=$offset count=$size \
     conv=notrunc 2>/dev/null
 }
@@ -339,7 +377,12 @@ ensure_files_exist() {
 # Args: rootfs
 no_chronos_password() {
   local rootfs=$1
-  sudo grep -q '^chronos:\*:' "$rootfs/etc/shadow"
+  local sudo
+
+  if [ ! -r "$rootfs/etc/shadow" ]; then
+    sudo="sudo"
+  fi
+  ${sudo} grep -q '^chronos:\*:' "$rootfs/etc/shadow"
 }
 
 trap "cleanup_temps_and_mounts" EXIT
@@ -38,7 +38,8 @@ main() {
     . "$configfile" || return 1
 
     local rootfs=$(make_temp_dir)
-    mount_image_partition_ro "$image" 3 "$rootfs"
+    extract_image_partition_files "$image" 3 "$rootfs" \
+        "${RELEASE_FILE_BLACKLIST[@]}" /etc/chrome_dev.conf
 
     for file in ${RELEASE_FILE_BLACKLIST[@]}; do
         if [ -e "$rootfs/$file" ]; then
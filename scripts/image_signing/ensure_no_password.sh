@@ -17,7 +17,7 @@ fi
 
 IMAGE=$1
 ROOTFS=$(make_temp_dir)
-mount_image_partition_ro "$IMAGE" 3 "$ROOTFS"
+extract_image_partition_files "$IMAGE" 3 "$ROOTFS" /etc/shadow
 
 if ! no_chronos_password $ROOTFS; then
     die "chronos password is set! Shouldn't be for release builds."
@@ -129,7 +129,7 @@ main() {
   echo "Done."
 
   local rootfs=$(make_temp_dir)
-  mount_image_partition_ro "$image" 3 "$rootfs"
+  extract_image_partition_files "$image" 3 "$rootfs" "$LSB_FILE"
   local lsb="$rootfs/$LSB_FILE"
 
   # Basic syntax check first.
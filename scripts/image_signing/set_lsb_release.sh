@@ -50,7 +50,7 @@ EOF
 
   # If there are no key/value pairs to process, we don't need write access.
   if [[ $# -eq 0 ]]; then
-    mount_image_partition_ro "${image}" 3 "${rootfs}"
+    extract_image_partition_files "${image}" 3 "${rootfs}" /etc/lsb-release
   else
     mount_image_partition "${image}" 3 "${rootfs}"
     touch "${image}"  # Updates the image modification time.
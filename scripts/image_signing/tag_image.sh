@@ -201,9 +201,12 @@ if [[ -z "${IMAGE}" || ! -f "${IMAGE}" ]]; then
   exit 1
 fi
 
-# First round, mount as read-only and check if we need any modifications.
+# First round, copy out the files we look at and check if we need any
+# modifications.  This doesn't need root, so only mount if we do.
 rootfs=$(make_temp_dir)
-mount_image_partition_ro "${IMAGE}" 3 "${rootfs}"
+extract_image_partition_files "${IMAGE}" 3 "${rootfs}" \
+  /root/.dev_mode /root/.force_update_firmware /root/.leave_firmware_alone \
+  /root/.leave_core /usr/bin/crosh-workarounds /etc/lsb-release
 
 # we don't have tags in stateful partition yet...
 # stateful_dir=$(make_temp_dir)
@@ -213,8 +216,7 @@ process_all_tags "${rootfs}" ${FLAGS_FALSE}
 process_all_lsb_mods "${rootfs}" ${FLAGS_FALSE}
 
 if [ ${g_modified} = ${FLAGS_TRUE} ]; then
-  # remount as RW (we can't use mount -o rw,remount because of loop device)
-  sudo umount "${rootfs}"
+  # mount RW over the copies from the first round
   mount_image_partition "${IMAGE}" 3 "${rootfs}"
 
   # second round, apply the modification to image.
@@ -0,0 +1,823 @@
+/* Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Host-side boot flow simulator.
+ *
+ * Runs VbInit() and VbSelectAndLoadKernel() against disk image files, a
+ * simulated TPM and NV storage, with a configurable cost for each firmware
+ * operation.  Time is simulated, so results are reproducible and a 30-second
+ * developer screen takes no real time.  Optionally, host CPU time spent in
+ * vboot itself is scaled and added to the simulated clock.
+ */
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "gbb_header.h"
+#include "gpt.h"
+#include "host_common.h"
+#include "rollback_index.h"
+#include "test_common.h"
+#include "vboot_api.h"
+#include "vboot_common.h"
+#include "vboot_struct.h"
+
+#define MAX_DISKS 8
+#define MAX_KEYS 16
+#define KERNEL_BUFFER_SIZE (16 * 1024 * 1024)
+
+/* Simulated disks */
+struct sim_disk {
+	const char *name;
+	uint8_t *data;
+	uint64_t size;
+	uint32_t bytes_per_lba;
+	uint64_t lba_count;
+	uint32_t flags;
+};
+static struct sim_disk disks[MAX_DISKS];
+static int num_disks;
+
+/* Scripted key presses */
+struct sim_key {
+	uint64_t usec;
+	uint32_t key;
+};
+static struct sim_key keys[MAX_KEYS];
+static int num_keys;
+static int next_key;
+
+/* Cost of each operation */
+static struct {
+	uint32_t disk_cmd_us;	/* Per disk command */
+	uint32_t disk_kbps;	/* Disk transfer rate */
+	uint32_t spi_kbps;	/* SPI flash read rate */
+	uint32_t tpm_us;	/* Per TPM command */
+	uint32_t nv_us;		/* Per NV storage access */
+	uint32_t display_us;	/* Per screen drawn */
+	double cpu_scale;	/* Multiplier for host CPU time */
+} cost = {
+	.disk_cmd_us = 200,
+	.disk_kbps = 50 * 1024,
+	.spi_kbps = 5 * 1024,
+	.tpm_us = 10000,
+	.nv_us = 100,
+	.display_us = 30000,
+	.cpu_scale = 0.0,
+};
+
+/* Where simulated time goes */
+enum sim_category {
+	SIM_DISK,
+	SIM_SPI,
+	SIM_TPM,
+	SIM_NV,
+	SIM_DISPLAY,
+	SIM_WAIT,
+	SIM_CPU,
+	SIM_NUM_CATEGORIES
+};
+static const char * const category_name[SIM_NUM_CATEGORIES] = {
+	"disk", "spi", "tpm", "nv", "display", "wait", "cpu",
+};
+static struct {
+	uint32_t ops;
+	uint64_t bytes;
+	uint64_t usec;
+} stats[SIM_NUM_CATEGORIES];
+
+static uint64_t sim_usec;
+static uint64_t timeout_usec = 120 * 1000000ULL;
+static int trace;
+static uint32_t sector_bytes;	/* 0 to guess from each image */
+static uint64_t last_cpu_nsec;
+
+/* Simulated TPM and NV storage state, kept across runs */
+static struct {
+	uint32_t fw_version;
+	uint32_t kernel_version;
+	int virt_dev;
+	uint8_t backup[BACKUP_NV_SIZE];
+} tpm;
+static uint8_t nv_raw[VBNV_BLOCK_SIZE];
+
+static uint64_t CpuNsec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Account for host CPU time used since the last firmware call. */
+static void SimSyncCpu(void)
+{
+	uint64_t now = CpuNsec();
+	uint64_t usec = (uint64_t)((now - last_cpu_nsec) / 1000 *
+				   cost.cpu_scale);
+
+	stats[SIM_CPU].usec += usec;
+	sim_usec += usec;
+	last_cpu_nsec = now;
+}
+
+/* Advance the simulated clock for an operation, and trace it. */
+static void SimCharge(enum sim_category cat, uint64_t usec, uint64_t bytes,
+		      const char *format, ...)
+{
+	va_list ap;
+
+	SimSyncCpu();
+	stats[cat].ops++;
+	stats[cat].bytes += bytes;
+	stats[cat].usec += usec;
+
+	if (trace) {
+		printf("%10.3f ms  %-7s +%8.3f ms  ", sim_usec / 1000.0,
+		       category_name[cat], usec / 1000.0);
+		va_start(ap, format);
+		vprintf(format, ap);
+		va_end(ap);
+		printf("\n");
+	}
+	sim_usec += usec;
+
+	/* Don't charge our own bookkeeping to vboot */
+	last_cpu_nsec = CpuNsec();
+}
+
+static uint64_t TransferUsec(uint64_t bytes, uint32_t kbps)
+{
+	return bytes * 1000000ULL / (kbps * 1024ULL);
+}
+
+/* Timer and user interaction */
+
+uint64_t VbExGetTimer(void)
+{
+	SimSyncCpu();
+	return sim_usec;
+}
+
+void VbExSleepMs(uint32_t msec)
+{
+	SimCharge(SIM_WAIT, msec * 1000ULL, 0, "sleep %u ms", msec);
+}
+
+VbError_t VbExBeep(uint32_t msec, uint32_t frequency)
+{
+	SimCharge(SIM_WAIT, msec * 1000ULL, 0, "beep %u Hz for %u ms",
+		  frequency, msec);
+	return VBERROR_SUCCESS;
+}
+
+VbError_t VbExDisplayScreen(uint32_t screen_type)
+{
+	SimCharge(SIM_DISPLAY, cost.display_us, 0, "screen 0x%x",
+		  screen_type);
+	return VBERROR_SUCCESS;
+}
+
+VbError_t VbExDisplayImage(uint32_t x, uint32_t y,
+                           void *buffer, uint32_t buffersize)
+{
+	SimCharge(SIM_DISPLAY, cost.display_us, buffersize,
+		  "image at (%u,%u)", x, y);
+	return VBERROR_SUCCESS;
+}
+
+uint32_t VbExKeyboardRead(void)
+{
+	SimSyncCpu();
+	if (next_key < num_keys && keys[next_key].usec <= sim_usec) {
+		uint32_t key = keys[next_key++].key;
+
+		if (trace)
+			printf("%10.3f ms  key 0x%x\n", sim_usec / 1000.0, key);
+		return key;
+	}
+	return 0;
+}
+
+uint32_t VbExKeyboardReadWithFlags(uint32_t *flags_ptr)
+{
+	if (flags_ptr)
+		*flags_ptr = 0;
+	return VbExKeyboardRead();
+}
+
+/* Wakes as soon as a key arrives, like firmware waiting for an interrupt */
+uint32_t VbExKeyboardWait(uint32_t msec)
+{
+	uint64_t usec = msec * 1000ULL;
+
+	SimSyncCpu();
+	if (next_key < num_keys && keys[next_key].usec < sim_usec + usec)
+		usec = keys[next_key].usec > sim_usec ?
+			keys[next_key].usec - sim_usec : 0;
+	if (usec) {
+		stats[SIM_WAIT].usec += usec;
+		sim_usec += usec;
+	}
+	return VbExKeyboardRead();
+}
+
+uint32_t VbExIsShutdownRequested(void)
+{
+	return VbExGetTimer() >= timeout_usec;
+}
+
+/* NV storage */
+
+VbError_t VbExNvStorageRead(uint8_t *buf)
+{
+	SimCharge(SIM_NV, cost.nv_us, sizeof(nv_raw), "nvstorage read");
+	memcpy(buf, nv_raw, sizeof(nv_raw));
+	return VBERROR_SUCCESS;
+}
+
+VbError_t VbExNvStorageWrite(const uint8_t *buf)
+{
+	SimCharge(SIM_NV, cost.nv_us, sizeof(nv_raw), "nvstorage write");
+	memcpy(nv_raw, buf, sizeof(nv_raw));
+	return VBERROR_SUCCESS;
+}
+
+VbError_t VbExRegionRead(VbCommonParams *cparams,
+			 enum vb_firmware_region region, uint32_t offset,
+			 uint32_t size, void *buf)
+{
+	if (region != VB_REGION_GBB)
+		return VBERROR_REGION_READ_INVALID;
+	if (offset > cparams->gbb_size || size > cparams->gbb_size - offset)
+		return VBERROR_REGION_READ_FAILED;
+
+	SimCharge(SIM_SPI, TransferUsec(size, cost.spi_kbps), size,
+		  "gbb read 0x%x+0x%x", offset, size);
+	memcpy(buf, (uint8_t *)cparams->gbb_data + offset, size);
+	return VBERROR_SUCCESS;
+}
+
+/* Disks */
+
+VbError_t VbExDiskGetInfo(VbDiskInfo **infos_ptr, uint32_t *count,
+                          uint32_t disk_flags)
+{
+	VbDiskInfo *infos;
+	int i;
+
+	SimCharge(SIM_DISK, cost.disk_cmd_us, 0, "get info flags 0x%x",
+		  disk_flags);
+
+	*infos_ptr = NULL;
+	*count = 0;
+	infos = calloc(num_disks ? num_disks : 1, sizeof(*infos));
+	if (!infos)
+		return VBERROR_UNKNOWN;
+
+	for (i = 0; i < num_disks; i++) {
+		VbDiskInfo *d = infos + *count;
+
+		if (!(disks[i].flags & disk_flags))
+			continue;
+		d->handle = (VbExDiskHandle_t)&disks[i];
+		d->bytes_per_lba = disks[i].bytes_per_lba;
+		d->lba_count = disks[i].lba_count;
+		d->flags = disks[i].flags;
+		d->name = disks[i].name;
+		(*count)++;
+	}
+
+	*infos_ptr = infos;
+	return VBERROR_SUCCESS;
+}
+
+VbError_t VbExDiskFreeInfo(VbDiskInfo *infos,
+                           VbExDiskHandle_t preserve_handle)
+{
+	free(infos);
+	return VBERROR_SUCCESS;
+}
+
+static struct sim_disk *DiskFromHandle(VbExDiskHandle_t handle,
+				       uint64_t lba_start, uint64_t lba_count)
+{
+	struct sim_disk *d = (struct sim_disk *)handle;
+
+	if (d < disks || d >= disks + num_disks)
+		return NULL;
+	if (lba_start > d->lba_count || lba_count > d->lba_count - lba_start)
+		return NULL;
+	return d;
+}
+
+VbError_t VbExDiskRead(VbExDiskHandle_t handle, uint64_t lba_start,
+		       uint64_t lba_count, void *buffer)
+{
+	struct sim_disk *d = DiskFromHandle(handle, lba_start, lba_count);
+	uint64_t bytes;
+
+	if (!d)
+		return VBERROR_UNKNOWN;
+
+	bytes = lba_count * d->bytes_per_lba;
+	SimCharge(SIM_DISK, cost.disk_cmd_us +
+		  TransferUsec(bytes, cost.disk_kbps), bytes,
+		  "read %s %" PRIu64 "+%" PRIu64, d->name, lba_start,
+		  lba_count);
+	memcpy(buffer, d->data + lba_start * d->bytes_per_lba, bytes);
+	return VBERROR_SUCCESS;
+}
+
+VbError_t VbExDiskWrite(VbExDiskHandle_t handle, uint64_t lba_start,
+			uint64_t lba_count, const void *buffer)
+{
+	struct sim_disk *d = DiskFromHandle(handle, lba_start, lba_count);
+	uint64_t bytes;
+
+	if (!d)
+		return VBERROR_UNKNOWN;
+
+	/* Writes only change the in-memory copy, not the image file */
+	bytes = lba_count * d->bytes_per_lba;
+	SimCharge(SIM_DISK, cost.disk_cmd_us +
+		  TransferUsec(bytes, cost.disk_kbps), bytes,
+		  "write %s %" PRIu64 "+%" PRIu64, d->name, lba_start,
+		  lba_count);
+	memcpy(d->data + lba_start * d->bytes_per_lba, buffer, bytes);
+	return VBERROR_SUCCESS;
+}
+
+/*
+ * Simulated TPM.  Host builds of the firmware library don't talk to a TPM,
+ * so replace the rollback functions with ones that keep their spaces in
+ * memory and charge for the TPM commands the real ones would send.
+ */
+
+uint32_t RollbackFirmwareSetup(int is_hw_dev,
+                               int disable_dev_request,
+                               int clear_tpm_owner_request,
+                               int *is_virt_dev, uint32_t *version)
+{
+	/* Startup, self test, physical presence, flags, read firmware space */
+	SimCharge(SIM_TPM, 5 * cost.tpm_us, 0, "firmware setup");
+	if (disable_dev_request)
+		tpm.virt_dev = 0;
+	*is_virt_dev = tpm.virt_dev;
+	*version = tpm.fw_version;
+	return TPM_SUCCESS;
+}
+
+uint32_t SetVirtualDevMode(int val)
+{
+	SimCharge(SIM_TPM, 2 * cost.tpm_us, 0, "set virtual dev mode %d",
+		  val);
+	tpm.virt_dev = val;
+	return TPM_SUCCESS;
+}
+
+uint32_t RollbackKernelRead(uint32_t *version)
+{
+	/* Read kernel space, get its permissions */
+	SimCharge(SIM_TPM, 2 * cost.tpm_us, 0, "kernel read 0x%x",
+		  tpm.kernel_version);
+	*version = tpm.kernel_version;
+	return TPM_SUCCESS;
+}
+
+uint32_t RollbackKernelWrite(uint32_t version)
+{
+	/* The real one reuses what RollbackKernelRead() found */
+	if (version == tpm.kernel_version)
+		return TPM_SUCCESS;
+
+	/* Write the kernel space, and read it back */
+	SimCharge(SIM_TPM, 2 * cost.tpm_us, 0, "kernel write 0x%x",
+		  version);
+	tpm.kernel_version = version;
+	return TPM_SUCCESS;
+}
+
+uint32_t RollbackKernelLock(int recovery_mode)
+{
+	if (!recovery_mode)
+		SimCharge(SIM_TPM, cost.tpm_us, 0, "kernel lock");
+	return TPM_SUCCESS;
+}
+
+uint32_t RollbackBackupRead(uint8_t *raw)
+{
+	SimCharge(SIM_TPM, cost.tpm_us, 0, "backup read");
+	memcpy(raw, tpm.backup, sizeof(tpm.backup));
+	return TPM_SUCCESS;
+}
+
+uint32_t RollbackBackupWrite(uint8_t *raw)
+{
+	SimCharge(SIM_TPM, cost.tpm_us, 0, "backup write");
+	memcpy(tpm.backup, raw, sizeof(tpm.backup));
+	return TPM_SUCCESS;
+}
+
+/* Command line */
+
+static const struct {
+	const char *name;
+	uint32_t key;
+} key_names[] = {
+	{"ctrl-d", 0x04},
+	{"ctrl-l", 0x0c},
+	{"ctrl-u", 0x15},
+	{"enter", '\r'},
+	{"esc", 0x1b},
+	{"space", ' '},
+	{"tab", '\t'},
+};
+
+static int ParseKey(const char *arg)
+{
+	char *e;
+	uint64_t msec = strtoull(arg, &e, 0);
+	uint32_t key = 0;
+	int i;
+
+	if (e == arg || *e != ':' || num_keys >= MAX_KEYS)
+		return -1;
+	arg = e + 1;
+
+	for (i = 0; i < ARRAY_SIZE(key_names); i++) {
+		if (!strcasecmp(arg, key_names[i].name))
+			key = key_names[i].key;
+	}
+	if (!key) {
+		key = strtoul(arg, &e, 0);
+		if (!*arg || *e || !key)
+			return -1;
+	}
+
+	/* Keep the script sorted by time */
+	for (i = num_keys; i > 0 && keys[i - 1].usec > msec * 1000; i--)
+		keys[i] = keys[i - 1];
+	keys[i].usec = msec * 1000;
+	keys[i].key = key;
+	num_keys++;
+	return 0;
+}
+
+static int AddDisk(const char *name, uint32_t flags)
+{
+	if (num_disks >= MAX_DISKS)
+		return -1;
+	disks[num_disks].data = ReadFile(name, &disks[num_disks].size);
+	if (!disks[num_disks].data)
+		return -1;
+	disks[num_disks].name = name;
+	disks[num_disks].flags = flags;
+	num_disks++;
+	return 0;
+}
+
+/*
+ * Guess the sector size of a disk image from where its primary GPT header
+ * lives: LBA 1 is at byte 512 on 512-byte drives and byte 4096 on 4Kn drives.
+ */
+static uint32_t DetectSectorBytes(const uint8_t *buf, uint64_t size)
+{
+	uint32_t bytes;
+
+	for (bytes = 512; bytes <= 4096; bytes *= 2) {
+		if (size < bytes + GPT_HEADER_SIGNATURE_SIZE)
+			break;
+		if (!memcmp(buf + bytes, GPT_HEADER_SIGNATURE,
+			    GPT_HEADER_SIGNATURE_SIZE) ||
+		    !memcmp(buf + bytes, GPT_HEADER_SIGNATURE2,
+			    GPT_HEADER_SIGNATURE_SIZE))
+			return bytes;
+	}
+	return 512;
+}
+
+static void PrintStats(uint64_t start_usec)
+{
+	int i;
+
+	printf("Simulated time:     %.3f ms\n",
+	       (sim_usec - start_usec) / 1000.0);
+	printf("  %-8s %8s %12s %12s\n", "", "ops", "bytes", "ms");
+	for (i = 0; i < SIM_NUM_CATEGORIES; i++) {
+		if (!stats[i].ops && !stats[i].usec)
+			continue;
+		printf("  %-8s %8u %12" PRIu64 " %12.3f\n", category_name[i],
+		       stats[i].ops, stats[i].bytes, stats[i].usec / 1000.0);
+	}
+}
+
+enum {
+	OPT_DISK_CMD = 1000,
+	OPT_DISK_KBPS,
+	OPT_SPI_KBPS,
+	OPT_TPM,
+	OPT_NV,
+	OPT_DISPLAY,
+	OPT_CPU_SCALE,
+	OPT_VERIFY_CACHE,
+};
+
+static const struct option long_opts[] = {
+	{"fixed", 1, NULL, 'f'},
+	{"removable", 1, NULL, 'r'},
+	{"key", 1, NULL, 'k'},
+	{"mode", 1, NULL, 'm'},
+	{"gbb-flags", 1, NULL, 'g'},
+	{"press", 1, NULL, 'p'},
+	{"runs", 1, NULL, 'n'},
+	{"timeout", 1, NULL, 'T'},
+	{"trace", 0, NULL, 't'},
+	{"sector-size", 1, NULL, 'b'},
+	{"disk-cmd-us", 1, NULL, OPT_DISK_CMD},
+	{"disk-kbps", 1, NULL, OPT_DISK_KBPS},
+	{"spi-kbps", 1, NULL, OPT_SPI_KBPS},
+	{"tpm-us", 1, NULL, OPT_TPM},
+	{"nv-us", 1, NULL, OPT_NV},
+	{"display-us", 1, NULL, OPT_DISPLAY},
+	{"cpu-scale", 1, NULL, OPT_CPU_SCALE},
+	{"verify-cache", 0, NULL, OPT_VERIFY_CACHE},
+	{NULL, 0, NULL, 0}
+};
+
+static void print_help(const char *progname)
+{
+	printf("\nUsage: %s [OPTIONS] -k KEY.vbpubk -f DISK [-f DISK ...]\n"
+	       "\n"
+	       "Simulate VbInit() and VbSelectAndLoadKernel() on disk images.\n"
+	       "\n"
+	       "Options:\n"
+	       "  -f, --fixed=FILE      Add a fixed disk image\n"
+	       "  -r, --removable=FILE  Add a removable disk image\n"
+	       "  -k, --key=FILE        Kernel subkey, also used as the\n"
+	       "                          recovery key\n"
+	       "  -m, --mode=MODE       normal (default), dev or rec\n"
+	       "  -g, --gbb-flags=NUM   GBB flags\n"
+	       "  -p, --press=MS:KEY    Press KEY at MS msecs; KEY is a\n"
+	       "                          number or one of ctrl-d, ctrl-l,\n"
+	       "                          ctrl-u, enter, esc, space, tab\n"
+	       "  -n, --runs=NUM        Boot NUM times, keeping NV, TPM and\n"
+	       "                          disk state between boots\n"
+	       "  -T, --timeout=MS      Request shutdown after MS msecs\n"
+	       "                          (default %" PRIu64 ")\n"
+	       "  -t, --trace           Print each firmware operation\n"
+	       "  -b, --sector-size=N   Bytes per sector of every disk\n"
+	       "                          (default: from each GPT)\n"
+	       "  --verify-cache        Pass a kernel verification cache\n"
+	       "\n"
+	       "Costs (defaults in brackets):\n"
+	       "  --disk-cmd-us=N       Per disk command [%u]\n"
+	       "  --disk-kbps=N         Disk transfer rate [%u]\n"
+	       "  --spi-kbps=N          SPI flash read rate [%u]\n"
+	       "  --tpm-us=N            Per TPM command [%u]\n"
+	       "  --nv-us=N             Per NV storage access [%u]\n"
+	       "  --display-us=N        Per screen drawn [%u]\n"
+	       "  --cpu-scale=X         Add host CPU time times X [%g]\n"
+	       "\n",
+	       progname, timeout_usec / 1000, cost.disk_cmd_us,
+	       cost.disk_kbps, cost.spi_kbps, cost.tpm_us, cost.nv_us,
+	       cost.display_us, cost.cpu_scale);
+}
+
+static int ParseUint32(const char *arg, uint32_t *val)
+{
+	char *e;
+
+	*val = strtoul(arg, &e, 0);
+	return (!*arg || *e) ? -1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+	VbCommonParams cparams;
+	VbInitParams iparams;
+	VbSelectAndLoadKernelParams kparams;
+	VbKernelVerifyCache verify_cache;
+	GoogleBinaryBlockHeader *gbb;
+	VbSharedDataHeader *shared;
+	VbPublicKey *key = NULL;
+	const char *mode = "normal";
+	uint32_t gbb_flags = 0;
+	uint32_t init_flags = 0;
+	uint32_t runs = 1;
+	int use_verify_cache = 0;
+	uint32_t run;
+	uint64_t ms;
+	int errorcnt = 0;
+	VbError_t rv = VBERROR_SUCCESS;
+	int i;
+
+	while ((i = getopt_long(argc, argv, ":f:r:k:m:g:p:n:T:tb:", long_opts,
+				NULL)) != -1) {
+		switch (i) {
+		case 'f':
+		case 'r':
+			if (AddDisk(optarg, i == 'f' ? VB_DISK_FLAG_FIXED :
+				    VB_DISK_FLAG_REMOVABLE)) {
+				fprintf(stderr, "Can't add disk %s\n", optarg);
+				errorcnt++;
+			}
+			break;
+		case 'k':
+			key = PublicKeyRead(optarg);
+			if (!key) {
+				fprintf(stderr, "Can't read key file %s\n",
+					optarg);
+				errorcnt++;
+			}
+			break;
+		case 'm':
+			mode = optarg;
+			break;
+		case 'g':
+			errorcnt += ParseUint32(optarg, &gbb_flags) ? 1 : 0;
+			break;
+		case 'p':
+			if (ParseKey(optarg)) {
+				fprintf(stderr, "Bad key press: %s\n", optarg);
+				errorcnt++;
+			}
+			break;
+		case 'n':
+			if (ParseUint32(optarg, &runs) || !runs)
+				errorcnt++;
+			break;
+		case 'T':
+			ms = strtoull(optarg, NULL, 0);
+			timeout_usec = ms * 1000;
+			break;
+		case 't':
+			trace = 1;
+			break;
+		case 'b':
+			if (ParseUint32(optarg, &sector_bytes) ||
+			    !sector_bytes ||
+			    (sector_bytes & (sector_bytes - 1))) {
+				fprintf(stderr, "Bad sector size: %s\n",
+					optarg);
+				errorcnt++;
+			}
+			break;
+		case OPT_DISK_CMD:
+			errorcnt += ParseUint32(optarg, &cost.disk_cmd_us) ?
+				1 : 0;
+			break;
+		case OPT_DISK_KBPS:
+			if (ParseUint32(optarg, &cost.disk_kbps) ||
+			    !cost.disk_kbps)
+				errorcnt++;
+			break;
+		case OPT_SPI_KBPS:
+			if (ParseUint32(optarg, &cost.spi_kbps) ||
+			    !cost.spi_kbps)
+				errorcnt++;
+			break;
+		case OPT_TPM:
+			errorcnt += ParseUint32(optarg, &cost.tpm_us) ? 1 : 0;
+			break;
+		case OPT_NV:
+			errorcnt += ParseUint32(optarg, &cost.nv_us) ? 1 : 0;
+			break;
+		case OPT_DISPLAY:
+			errorcnt += ParseUint32(optarg, &cost.display_us) ?
+				1 : 0;
+			break;
+		case OPT_CPU_SCALE:
+			cost.cpu_scale = strtod(optarg, NULL);
+			break;
+		case OPT_VERIFY_CACHE:
+			use_verify_cache = 1;
+			break;
+		case '?':
+			fprintf(stderr, "Unrecognized option: %s\n",
+				argv[optind - 1]);
+			errorcnt++;
+			break;
+		case ':':
+			fprintf(stderr, "Missing argument to %s\n",
+				argv[optind - 1]);
+			errorcnt++;
+			break;
+		}
+	}
+
+	if (!strcmp(mode, "dev")) {
+		init_flags = VB_INIT_FLAG_DEV_SWITCH_ON;
+	} else if (!strcmp(mode, "rec")) {
+		init_flags = VB_INIT_FLAG_REC_BUTTON_PRESSED;
+	} else if (strcmp(mode, "normal")) {
+		fprintf(stderr, "Unknown mode %s\n", mode);
+		errorcnt++;
+	}
+
+	if (errorcnt || !key || !num_disks || optind != argc) {
+		print_help(argv[0]);
+		return 1;
+	}
+
+	for (i = 0; i < num_disks; i++) {
+		disks[i].bytes_per_lba = sector_bytes ? sector_bytes :
+			DetectSectorBytes(disks[i].data, disks[i].size);
+		disks[i].lba_count = disks[i].size / disks[i].bytes_per_lba;
+	}
+
+	/* The stub streams only know one sector size */
+	for (i = 1; i < num_disks; i++) {
+		if (disks[i].bytes_per_lba != disks[0].bytes_per_lba) {
+			fprintf(stderr, "%s and %s have different sector "
+				"sizes\n", disks[0].name, disks[i].name);
+			return 1;
+		}
+	}
+	vboot_api_stub_set_sector_bytes(disks[0].bytes_per_lba);
+
+	/* GBB with the key as the recovery key */
+	Memset(&cparams, 0, sizeof(cparams));
+	cparams.gbb_size = sizeof(*gbb) + key->key_offset + key->key_size;
+	cparams.gbb_data = calloc(1, cparams.gbb_size);
+	gbb = (GoogleBinaryBlockHeader *)cparams.gbb_data;
+	Memcpy(gbb->signature, GBB_SIGNATURE, GBB_SIGNATURE_SIZE);
+	gbb->major_version = GBB_MAJOR_VER;
+	gbb->minor_version = GBB_MINOR_VER;
+	gbb->header_size = sizeof(*gbb);
+	gbb->flags = gbb_flags;
+	gbb->recovery_key_offset = gbb->header_size;
+	gbb->recovery_key_size = key->key_offset + key->key_size;
+	Memcpy((uint8_t *)gbb + gbb->recovery_key_offset, key,
+	       gbb->recovery_key_size);
+
+	cparams.shared_data_size = VB_SHARED_DATA_REC_SIZE;
+	cparams.shared_data_blob = malloc(cparams.shared_data_size);
+	shared = (VbSharedDataHeader *)cparams.shared_data_blob;
+
+	Memset(&verify_cache, 0, sizeof(verify_cache));
+	Memset(&kparams, 0, sizeof(kparams));
+	kparams.kernel_buffer_size = KERNEL_BUFFER_SIZE;
+	kparams.kernel_buffer = malloc(kparams.kernel_buffer_size);
+	if (!cparams.gbb_data || !shared || !kparams.kernel_buffer) {
+		fprintf(stderr, "Can't allocate buffers\n");
+		return 1;
+	}
+
+	for (run = 0; run < runs; run++) {
+		uint64_t start_usec;
+
+		Memset(stats, 0, sizeof(stats));
+		sim_usec = start_usec = 0;
+		next_key = 0;
+		last_cpu_nsec = CpuNsec();
+		if (runs > 1)
+			printf("Boot %u of %u\n", run + 1, runs);
+
+		/* Firmware reads the GBB out of flash before calling vboot */
+		SimCharge(SIM_SPI, TransferUsec(cparams.gbb_size,
+						cost.spi_kbps),
+			  cparams.gbb_size, "gbb load");
+
+		Memset(&iparams, 0, sizeof(iparams));
+		iparams.flags = init_flags;
+		if (use_verify_cache)
+			iparams.flags |= VB_INIT_FLAG_KERNEL_VERIFY_CACHE;
+		rv = VbInit(&cparams, &iparams);
+		if (rv != VBERROR_SUCCESS) {
+			printf("VbInit() returned 0x%x\n", rv);
+			break;
+		}
+		printf("VbInit() done at   %.3f ms\n", VbExGetTimer() / 1000.0);
+
+		/* Normally VbSelectFirmware() would find this in the RW FW */
+		VbSharedDataSetKernelKey(shared, key);
+
+		kparams.verify_cache = use_verify_cache ? &verify_cache : NULL;
+		rv = VbSelectAndLoadKernel(&cparams, &kparams);
+		SimSyncCpu();
+		verify_cache.flags &= ~VB_KERNEL_VERIFY_CACHE_FLAG_DIRTY;
+
+		printf("VbSelectAndLoadKernel() returned 0x%x\n", rv);
+		if (rv == VBERROR_SUCCESS)
+			printf("Booting %s partition %u\n",
+			       ((struct sim_disk *)kparams.disk_handle)->name,
+			       kparams.partition_number);
+		PrintStats(start_usec);
+	}
+
+	free(kparams.kernel_buffer);
+	free(cparams.shared_data_blob);
+	free(cparams.gbb_data);
+	for (i = 0; i < num_disks; i++)
+		free(disks[i].data);
+	free(key);
+
+	return rv == VBERROR_SUCCESS ? 0 : 1;
+}
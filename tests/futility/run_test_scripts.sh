@@ -42,7 +42,11 @@ export OUTDIR
 TESTS="
 ${SCRIPTDIR}/test_create.sh
 ${SCRIPTDIR}/test_dump_fmap.sh
+${SCRIPTDIR}/test_extfs.sh
+${SCRIPTDIR}/test_file_types.sh
+${SCRIPTDIR}/test_flash_plan.sh
 ${SCRIPTDIR}/test_gbb_utility.sh
+${SCRIPTDIR}/test_index.sh
 ${SCRIPTDIR}/test_load_fmap.sh
 ${SCRIPTDIR}/test_main.sh
 ${SCRIPTDIR}/test_show_kernel.sh
@@ -0,0 +1,109 @@
+#!/bin/bash -eux
+# Copyright 2015 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+me=${0##*/}
+TMP="$me.tmp"
+
+# Work in scratch directory
+cd "$OUTDIR"
+
+# We need mke2fs to make the filesystems to look at
+if ! type mke2fs > /dev/null 2>&1; then
+  echo "$me: mke2fs not found; skipping" 1>&2
+  exit 0
+fi
+
+DIR=${TMP}.dir
+rm -rf ${TMP}*
+mkdir -p ${DIR}/etc ${DIR}/usr/share/big ${DIR}/empty
+echo "CHROMEOS_RELEASE_BOARD=link" > ${DIR}/etc/lsb-release
+echo 'chronos:*:16000::::::' > ${DIR}/etc/shadow
+dd if=/dev/urandom of=${DIR}/usr/share/big/blob bs=1024 count=300
+ln -s usr/share ${DIR}/share
+ln -s ../etc/lsb-release ${DIR}/usr/lsb-link
+ln -s loop ${DIR}/loop
+for i in $(seq 1 200); do
+  touch ${DIR}/usr/share/big/file_with_a_longish_name_$i
+done
+chmod 644 ${DIR}/etc/* ${DIR}/usr/share/big/blob
+
+# Check the filesystem in $1 has what we put in it
+check_fs() {
+  local img=$1
+  shift
+
+  ${FUTILITY} extfs "$@" ${img} cat /etc/lsb-release > ${TMP}.out
+  cmp ${DIR}/etc/lsb-release ${TMP}.out
+  ${FUTILITY} extfs "$@" ${img} cat usr/share/big/blob > ${TMP}.out
+  cmp ${DIR}/usr/share/big/blob ${TMP}.out
+
+  # Symlinks, relative and through directories
+  ${FUTILITY} extfs "$@" ${img} cat /share/big/blob > ${TMP}.out
+  cmp ${DIR}/usr/share/big/blob ${TMP}.out
+  ${FUTILITY} extfs "$@" ${img} cat /usr/lsb-link > ${TMP}.out
+  cmp ${DIR}/etc/lsb-release ${TMP}.out
+
+  ${FUTILITY} extfs "$@" ${img} ls /usr/share/big > ${TMP}.out
+  [ "$(wc -l < ${TMP}.out)" = 201 ]
+  grep -q '^100644     307200 blob$' ${TMP}.out
+  grep -q ' file_with_a_longish_name_200$' ${TMP}.out
+  ${FUTILITY} extfs "$@" ${img} ls /empty > ${TMP}.out
+  [ ! -s ${TMP}.out ]
+  ${FUTILITY} extfs "$@" ${img} ls /etc/shadow > ${TMP}.out
+  grep -q '^100644         22 /etc/shadow$' ${TMP}.out
+
+  # Things that aren't there, or aren't files
+  if ${FUTILITY} extfs "$@" ${img} cat /etc/passwd; then false; fi
+  if ${FUTILITY} extfs "$@" ${img} cat /etc/shadow/x; then false; fi
+  if ${FUTILITY} extfs "$@" ${img} cat /usr; then false; fi
+  if ${FUTILITY} extfs "$@" ${img} cat /loop; then false; fi
+
+  # Same-size replacement works and only changes that file
+  sed 's/link/peppy/' ${DIR}/etc/lsb-release > ${TMP}.lsb
+  if ${FUTILITY} extfs "$@" ${img} replace /etc/lsb-release ${TMP}.lsb; then
+    false
+  fi
+  sed 's/link/lonk/' ${DIR}/etc/lsb-release > ${TMP}.lsb
+  ${FUTILITY} extfs "$@" ${img} replace /etc/lsb-release ${TMP}.lsb
+  ${FUTILITY} extfs "$@" ${img} cat /etc/lsb-release > ${TMP}.out
+  cmp ${TMP}.lsb ${TMP}.out
+  head -c 307200 /dev/urandom > ${TMP}.blob
+  ${FUTILITY} extfs "$@" ${img} replace /share/big/blob ${TMP}.blob
+  ${FUTILITY} extfs "$@" ${img} cat /usr/share/big/blob > ${TMP}.out
+  cmp ${TMP}.blob ${TMP}.out
+  ${FUTILITY} extfs "$@" ${img} cat /etc/shadow > ${TMP}.out
+  cmp ${DIR}/etc/shadow ${TMP}.out
+}
+
+# The rootfs is ext2 (block maps); also try ext4 (extents, 64-bit)
+for fs in "ext2 -b 1024" "ext4 -b 4096 -O 64bit"; do
+  set -- ${fs}
+  mke2fs -q -F -t "$@" -d ${DIR} ${TMP}.fs 8M
+  check_fs ${TMP}.fs
+  if type e2fsck > /dev/null 2>&1; then
+    e2fsck -fn ${TMP}.fs
+  fi
+done
+
+# A filesystem inside partition 3 of a disk image
+mke2fs -q -F -t ext2 -d ${DIR} ${TMP}.fs 8M
+dd if=/dev/zero of=${TMP}.disk bs=1M count=12
+${BINDIR}/cgpt create ${TMP}.disk
+${BINDIR}/cgpt add -i 1 -b 64 -s 64 -t data -l STATE ${TMP}.disk
+${BINDIR}/cgpt add -i 3 -b 2048 -s 16384 -t rootfs -l ROOT-A ${TMP}.disk
+dd if=${TMP}.fs of=${TMP}.disk bs=512 seek=2048 conv=notrunc
+check_fs ${TMP}.disk -p 3
+if ${FUTILITY} extfs -p 1 ${TMP}.disk ls /; then false; fi
+if ${FUTILITY} extfs -p 2 ${TMP}.disk ls /; then false; fi
+if ${FUTILITY} extfs ${TMP}.disk ls /; then false; fi
+
+# Bad args
+if ${FUTILITY} extfs ${TMP}.fs; then false; fi
+if ${FUTILITY} extfs ${TMP}.fs frob /; then false; fi
+if ${FUTILITY} extfs -p 0 ${TMP}.fs ls /; then false; fi
+
+# cleanup
+rm -rf ${TMP}*
+exit 0
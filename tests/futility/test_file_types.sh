@@ -0,0 +1,63 @@
+#!/bin/bash -eux
+# Copyright 2015 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+me=${0##*/}
+TMP="$me.tmp"
+
+# Work in scratch directory
+cd "$OUTDIR"
+
+DATADIR="${SCRIPTDIR}/data"
+KEYDIR="${SRCDIR}/tests/devkeys"
+
+# Pull some pieces out of a BIOS image
+${FUTILITY} dump_fmap -x ${DATADIR}/bios_link_mp.bin GBB VBLOCK_A FW_MAIN_A
+
+# Something with an FMAP that isn't a BIOS image, and a BIOS image that
+# doesn't start at the beginning of the file.
+dd if=/dev/zero of=${TMP}.fmap bs=4096 count=4
+printf '__FMAP__\001\000' | dd of=${TMP}.fmap bs=4096 seek=1 conv=notrunc
+dd if=/dev/zero bs=4096 count=1 > ${TMP}.offset
+cat ${DATADIR}/bios_link_mp.bin >> ${TMP}.offset
+
+# A kernel partition with a GPT in front of it, and an empty GPT disk
+cat ${DATADIR}/rec_kernel_part.bin > ${TMP}.kpart
+dd if=/dev/zero of=${TMP}.disk bs=512 count=200
+${BINDIR}/cgpt create ${TMP}.disk
+
+# Files that look a bit like something, but aren't
+echo -n '$GBB' > ${TMP}.gbb_magic
+echo -n 'CHROMEOS' > ${TMP}.kb_magic
+printf '\001\000\000\000\000\000\000\000\060' > ${TMP}.not_privkey
+
+# Expected output, one file per line
+cat > ${TMP}.expect <<END
+${DATADIR}/bios_link_mp.bin:	Chrome OS BIOS image
+${DATADIR}/bios_mario_mp.bin:	Cr-48 Chrome OS BIOS image
+${DATADIR}/bios_zgb_mp.bin:	Chrome OS BIOS image
+${DATADIR}/rec_kernel_part.bin:	VbKernelPreamble
+${DATADIR}/vmlinuz-amd64.bin:	unknown
+GBB:	GBB
+VBLOCK_A:	VbFirmwarePreamble
+FW_MAIN_A:	unknown
+${KEYDIR}/firmware.keyblock:	VbKeyBlock
+${KEYDIR}/root_key.vbpubk:	VbPublicKey
+${KEYDIR}/root_key.vbprivk:	VbPrivateKey
+${TMP}.fmap:	unknown
+${TMP}.offset:	Chrome OS BIOS image
+${TMP}.kpart:	VbKernelPreamble
+${TMP}.disk:	chromiumos disk image
+${TMP}.gbb_magic:	unknown
+${TMP}.kb_magic:	unknown
+${TMP}.not_privkey:	unknown
+${KEYDIR}:	directory
+END
+
+${FUTILITY} show -t $(cut -f 1 ${TMP}.expect | sed 's/:$//') > ${TMP}.out
+diff ${TMP}.expect ${TMP}.out
+
+# cleanup
+rm -rf ${TMP}* GBB VBLOCK_A FW_MAIN_A
+exit 0
@@ -0,0 +1,121 @@
+#!/bin/bash -eux
+# Copyright 2015 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+me=${0##*/}
+TMP="$me.tmp"
+
+# Work in scratch directory
+cd "$OUTDIR"
+
+OLD=${SCRIPTDIR}/data/bios_peppy_mp.bin
+NEW=${TMP}.new.bin
+
+# Poke a few bytes into NEW at offset $1
+poke() {
+  echo -n "futility was here" |
+    dd of=${NEW} bs=1 seek=$(($1)) conv=notrunc 2>/dev/null
+}
+
+# Replace all of VBLOCK_A, and change a little bit of a few other areas.
+cp ${OLD} ${NEW}
+${FUTILITY} load_fmap ${NEW} VBLOCK_A:/dev/urandom
+poke 0x211010
+poke 0x300000
+poke 0x611000
+poke 0x621ff0
+
+# In address order
+${FUTILITY} flash_plan ${OLD} ${NEW} > ${TMP}.layout
+cat > ${TMP}.expect <<END
+00200000:0020ffff VBLOCK_A
+00211000:00211fff FW_MAIN_A
+00300000:00300fff FW_MAIN_B
+00611000:00611fff GBB_1
+00621000:00622fff GBB_2
+END
+diff ${TMP}.expect ${TMP}.layout
+
+# Safe order for A/B updates: slot A's VBLOCK after FW_MAIN_A, and so on
+${FUTILITY} flash_plan --ab_order -o ${TMP}.layout ${OLD} ${NEW} \
+  > ${TMP}.summary
+cat > ${TMP}.expect <<END
+00611000:00611fff GBB_1
+00621000:00622fff GBB_2
+00211000:00211fff FW_MAIN_A
+00200000:0020ffff VBLOCK_A
+00300000:00300fff FW_MAIN_B
+END
+diff ${TMP}.expect ${TMP}.layout
+grep -q '^21 of 2048 erase blocks (0x15000 of 0x800000 bytes) changed, in 5' \
+  ${TMP}.summary
+
+# flashrom writes each run's regions in address order, which would put
+# VBLOCK_A before FW_MAIN_A, so each slot's VBLOCK is a step of its own
+grep '^step' ${TMP}.summary > ${TMP}.steps
+cat > ${TMP}.expect <<END
+step 1: -i GBB_1 -i GBB_2
+step 2: -i FW_MAIN_A
+step 3: -i VBLOCK_A
+step 4: -i FW_MAIN_B
+END
+diff ${TMP}.expect ${TMP}.steps
+
+# Flash it one step at a time, each step in address order like flashrom.
+# Until its own step, VBLOCK_A must still be the old one.
+cp ${OLD} ${TMP}.updated
+while read word step args; do
+  names=$(echo ${args} | sed 's/-i //g')
+  sort ${TMP}.layout | while read range name; do
+    echo " ${names} " | grep -q " ${name} " || continue
+    start=$((0x${range%:*}))
+    end=$((0x${range#*:}))
+    dd if=${NEW} of=${TMP}.updated bs=1 skip=${start} seek=${start} \
+      count=$((end - start + 1)) conv=notrunc 2>/dev/null
+  done
+  if [ "${step}" = "2:" ]; then
+    cmp -n $((0x10000)) -i $((0x200000)) ${OLD} ${TMP}.updated
+  fi
+done < ${TMP}.steps
+cmp ${NEW} ${TMP}.updated
+
+# The steps are what make the order safe, so they're required
+if ${FUTILITY} flash_plan --ab_order ${OLD} ${NEW}; then false; fi
+
+# Bigger erase blocks. The first GBB block starts in the FMAP area.
+${FUTILITY} flash_plan -b 0x10000 ${OLD} ${NEW} > ${TMP}.layout
+cat > ${TMP}.expect <<END
+00200000:0020ffff VBLOCK_A
+00210000:0021ffff FW_MAIN_A
+00300000:0030ffff FW_MAIN_B
+00610000:0061ffff FMAP
+00620000:0062ffff GBB
+END
+diff ${TMP}.expect ${TMP}.layout
+
+# Writing just the planned regions over the old image must give the new one
+cp ${OLD} ${TMP}.updated
+while read range name; do
+  start=$((0x${range%:*}))
+  end=$((0x${range#*:}))
+  dd if=${NEW} of=${TMP}.updated bs=1 skip=${start} seek=${start} \
+    count=$((end - start + 1)) conv=notrunc 2>/dev/null
+done < ${TMP}.layout
+cmp ${NEW} ${TMP}.updated
+
+# Nothing to do
+${FUTILITY} flash_plan ${OLD} ${OLD} > ${TMP}.layout
+[ ! -s ${TMP}.layout ]
+
+# Things that won't work
+head -c 4096 ${OLD} > ${TMP}.short
+if ${FUTILITY} flash_plan ${OLD} ${TMP}.short; then false; fi
+dd if=/dev/zero of=${TMP}.nofmap bs=4096 count=2048
+if ${FUTILITY} flash_plan ${OLD} ${TMP}.nofmap; then false; fi
+if ${FUTILITY} flash_plan -b 3000 ${OLD} ${NEW}; then false; fi
+if ${FUTILITY} flash_plan ${OLD}; then false; fi
+
+# cleanup
+rm -rf ${TMP}*
+exit 0
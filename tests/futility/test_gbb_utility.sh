@@ -230,6 +230,22 @@ ${FUTILITY} gbb_utility -g --digest ${TMP}.blob.bad | grep 'invalid'
 cat ${TMP}.blob | ${REPLACE} 0x84 0x70 0x71 0x72 > ${TMP}.blob.bad
 ${FUTILITY} gbb_utility -g --digest ${TMP}.blob.bad | grep 'invalid'
 
+# Writing to a new file leaves the original alone.
+cp ${TMP}.blob ${TMP}.blob.orig
+${FUTILITY} gbb_utility -s --flags=0x1234 ${TMP}.blob ${TMP}.blob.new
+cmp ${TMP}.blob ${TMP}.blob.orig
+${FUTILITY} gbb_utility -g --flags ${TMP}.blob.new | grep -i 0x00001234
+
+# A failed update doesn't create the new file or leave temp files behind...
+if ${FUTILITY} gbb_utility -s --hwid="0123456789ABCDEF" \
+    ${TMP}.blob ${TMP}.blob.none; then false; fi
+[ ! -e ${TMP}.blob.none ]
+[ -z "$(ls ${TMP}.blob.none.* 2>/dev/null)" ]
+# ...and doesn't change anything when updating in place.
+if ${FUTILITY} gbb_utility -s --flags=0x5 --hwid="0123456789ABCDEF" \
+    ${TMP}.blob; then false; fi
+cmp ${TMP}.blob ${TMP}.blob.orig
+
 # cleanup
 rm -f ${TMP}*
 exit 0
@@ -0,0 +1,75 @@
+#!/bin/bash -eux
+# Copyright 2015 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+me=${0##*/}
+TMP="$me.tmp"
+
+# Work in scratch directory
+cd "$OUTDIR"
+
+DIR=${TMP}.dir
+INDEX=${TMP}.index
+rm -rf ${DIR} ${INDEX}
+mkdir -p ${DIR}/keys
+
+cp ${SCRIPTDIR}/data/bios_link_mp.bin ${DIR}
+cp ${SCRIPTDIR}/data/rec_kernel_part.bin ${DIR}
+cp ${SRCDIR}/tests/devkeys/kernel.keyblock ${DIR}/keys
+cp ${SRCDIR}/tests/devkeys/root_key.vbpubk ${DIR}/keys
+
+# Everything is parsed the first time
+${FUTILITY} index -i ${INDEX} ${DIR} > ${TMP}.out
+grep -q '^4 files: 0 unchanged, 0 reused, 4 parsed, 0 kept, 0 gone$' ${TMP}.out
+
+# Nothing is the second time
+${FUTILITY} index -i ${INDEX} ${DIR} > ${TMP}.out
+grep -q '^4 files: 4 unchanged, 0 reused, 0 parsed, 0 kept, 0 gone$' ${TMP}.out
+
+# Copied or touched files are hashed but not parsed again
+cp ${DIR}/keys/kernel.keyblock ${DIR}/keys/copy.keyblock
+touch -d '2001-01-01' ${DIR}/rec_kernel_part.bin
+${FUTILITY} index -i ${INDEX} ${DIR} > ${TMP}.out
+grep -q '^5 files: 3 unchanged, 2 reused, 0 parsed, 0 kept, 0 gone$' ${TMP}.out
+
+# New contents are parsed, deleted files are dropped
+rm ${DIR}/keys/copy.keyblock
+cp ${SRCDIR}/tests/devkeys/firmware.keyblock ${DIR}/keys
+${FUTILITY} index -i ${INDEX} ${DIR} > ${TMP}.out
+grep -q '^5 files: 4 unchanged, 0 reused, 1 parsed, 0 kept, 1 gone$' ${TMP}.out
+
+# The same tree by another name is still the same files
+${FUTILITY} index -i ${INDEX} ./${DIR}/ > ${TMP}.out
+grep -q '^5 files: 5 unchanged, 0 reused, 0 parsed, 0 kept, 0 gone$' ${TMP}.out
+${FUTILITY} index -i ${INDEX} ${DIR} ${DIR}/keys > ${TMP}.out
+grep -q '^5 files: 5 unchanged, 0 reused, 0 parsed, 0 kept, 0 gone$' ${TMP}.out
+
+# Indexing another tree keeps what's known about this one, even if it's
+# changed since
+DIR2=${TMP}.dir2
+rm -rf ${DIR2}
+mkdir -p ${DIR2}
+cp ${SRCDIR}/tests/devkeys/recovery_kernel.keyblock ${DIR2}
+rm ${DIR}/keys/root_key.vbpubk
+${FUTILITY} index -i ${INDEX} ${DIR2} > ${TMP}.out
+grep -q '^6 files: 0 unchanged, 0 reused, 1 parsed, 5 kept, 0 gone$' ${TMP}.out
+grep -q "^F	$(pwd -P)/${DIR}/keys/root_key.vbpubk	" ${INDEX}
+
+# Until that tree is indexed again
+${FUTILITY} index -i ${INDEX} ${DIR}/keys > ${TMP}.out
+grep -q '^5 files: 2 unchanged, 0 reused, 0 parsed, 3 kept, 1 gone$' ${TMP}.out
+
+# Queries don't need to look at the files
+${FUTILITY} index -i ${INDEX} --max firmware > ${TMP}.out
+grep -q "^firmware	.*	key_version=1	version=4	rollback=0x00010004	$(pwd -P)/${DIR}/bios_link_mp.bin:VBLOCK_A$" ${TMP}.out
+${FUTILITY} index -i ${INDEX} --max kernel > ${TMP}.out
+grep -q "^kernel	.*	key_version=1	version=1	rollback=0x00010001	$(pwd -P)/${DIR}/rec_kernel_part.bin$" ${TMP}.out
+
+# Bad args
+if ${FUTILITY} index -i ${INDEX} --max foo; then false; fi
+if ${FUTILITY} index; then false; fi
+
+# cleanup
+rm -rf ${TMP}*
+exit 0
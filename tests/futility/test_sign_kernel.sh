@@ -303,6 +303,103 @@ try_arch () {
 try_arch amd64
 try_arch arm
 
+# Body chunk digests, the old way and the new way
+echo -n "chunks " 1>&3
+${FUTILITY} vbutil_kernel \
+  --pack ${TMP}.chunk1 \
+  --keyblock ${DEVKEYS}/recovery_kernel.keyblock \
+  --signprivate ${DEVKEYS}/recovery_kernel_data_key.vbprivk \
+  --version 1 \
+  --config ${TMP}.config.txt \
+  --bootloader ${TMP}.bootloader.bin \
+  --vmlinuz ${SCRIPTDIR}/data/vmlinuz-amd64.bin \
+  --arch amd64 \
+  --pad ${padding} \
+  --chunksize 65536
+${FUTILITY} vbutil_kernel --verify ${TMP}.chunk1 \
+  --pad ${padding} \
+  --signpubkey ${DEVKEYS}/recovery_key.vbpubk > ${TMP}.verify.chunk1
+grep -q "Body chunk size: *0x10000" ${TMP}.verify.chunk1
+
+${FUTILITY} sign \
+  --keyblock ${DEVKEYS}/recovery_kernel.keyblock \
+  --signprivate ${DEVKEYS}/recovery_kernel_data_key.vbprivk \
+  --version 1 \
+  --config ${TMP}.config.txt \
+  --bootloader ${TMP}.bootloader.bin \
+  --vmlinuz ${SCRIPTDIR}/data/vmlinuz-amd64.bin \
+  --arch amd64 \
+  --pad ${padding} \
+  --chunksize 65536 \
+  --outfile ${TMP}.chunk2
+cmp ${TMP}.chunk1 ${TMP}.chunk2
+
+# Re-signing keeps the chunk size unless told otherwise
+${FUTILITY} sign \
+  --signprivate ${DEVKEYS}/recovery_kernel_data_key.vbprivk \
+  --pad ${padding} \
+  --version 2 \
+  ${TMP}.chunk2
+${FUTILITY} show --pad ${padding} ${TMP}.chunk2 > ${TMP}.show.chunk2
+grep -q "Body chunk size: *0x10000" ${TMP}.show.chunk2
+grep -q "Body verification succeeded" ${TMP}.show.chunk2
+${FUTILITY} sign \
+  --signprivate ${DEVKEYS}/recovery_kernel_data_key.vbprivk \
+  --pad ${padding} \
+  --chunksize 0 \
+  ${TMP}.chunk2
+${FUTILITY} show --pad ${padding} ${TMP}.chunk2 > ${TMP}.show.chunk2
+if grep -q "Body chunk size" ${TMP}.show.chunk2; then false; fi
+
+# Chunks must be whole sectors
+if ${FUTILITY} sign \
+  --signprivate ${DEVKEYS}/recovery_kernel_data_key.vbprivk \
+  --chunksize 1000 \
+  ${TMP}.chunk2; then false; fi
+
+# Compressed kernel bodies
+echo -n "compress " 1>&3
+${FUTILITY} vbutil_kernel \
+  --pack ${TMP}.lzma1 \
+  --keyblock ${DEVKEYS}/recovery_kernel.keyblock \
+  --signprivate ${DEVKEYS}/recovery_kernel_data_key.vbprivk \
+  --version 1 \
+  --config ${TMP}.config.txt \
+  --bootloader ${TMP}.bootloader.bin \
+  --vmlinuz ${SCRIPTDIR}/data/vmlinuz-amd64.bin \
+  --arch amd64 \
+  --pad ${padding} \
+  --chunksize 65536 \
+  --compress lzma
+${FUTILITY} vbutil_kernel --verify ${TMP}.lzma1 \
+  --pad ${padding} \
+  --signpubkey ${DEVKEYS}/recovery_key.vbpubk > ${TMP}.verify.lzma1
+grep -q "Header version: *3.4" ${TMP}.verify.lzma1
+grep -q "Body compression: *2" ${TMP}.verify.lzma1
+grep -q "$(cat ${TMP}.config.txt)" ${TMP}.verify.lzma1
+
+# Re-signing keeps the body compressed
+${FUTILITY} sign \
+  --signprivate ${DEVKEYS}/recovery_kernel_data_key.vbprivk \
+  --pad ${padding} \
+  --version 2 \
+  ${TMP}.lzma1
+${FUTILITY} show --pad ${padding} ${TMP}.lzma1 > ${TMP}.show.lzma1
+grep -q "Body compression: *2" ${TMP}.show.lzma1
+grep -q "Body verification succeeded" ${TMP}.show.lzma1
+grep -q "$(cat ${TMP}.config.txt)" ${TMP}.show.lzma1
+
+# But it can't change the config or extract the vmlinuz
+if ${FUTILITY} vbutil_kernel \
+  --repack ${TMP}.lzma2 \
+  --oldblob ${TMP}.lzma1 \
+  --signprivate ${DEVKEYS}/recovery_kernel_data_key.vbprivk \
+  --pad ${padding} \
+  --config ${TMP}.config.txt; then false; fi
+if ${FUTILITY} vbutil_kernel --get-vmlinuz ${TMP}.lzma1 \
+  --pad ${padding} \
+  --vmlinuz-out ${TMP}.lzma1.vmlinuz; then false; fi
+
 # cleanup
 rm -rf ${TMP}*
 exit 0
@@ -62,6 +62,12 @@ function generate_fuzzing_images {
   # TODO(gauravsh): Also test with (optional) padding.
   cp ${TESTKEY_DIR}/key_rsa4096.sha512.vbpubk \
     ${TESTCASE_DIR}/firmware_key.vbpubk
+
+  echo "Generating GPT test image..."
+  dd if=/dev/zero of=${TESTCASE_DIR}/gpt.img bs=512 count=256
+  ${BIN_DIR}/cgpt create ${TESTCASE_DIR}/gpt.img
+  ${BIN_DIR}/cgpt add -b 64 -s 64 -t kernel -l KERN-A \
+    ${TESTCASE_DIR}/gpt.img
 }
 
 function pre_work {
@@ -0,0 +1,124 @@
+/* Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests for host misc library file functions
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "host_common.h"
+#include "host_misc.h"
+#include "test_common.h"
+
+#define TEST_SIZE (1024 * 1024)
+
+static const char *testfile = "host_misc_tests.dat";
+
+/* Bytes actually allocated to the test file */
+static uint64_t allocated(void)
+{
+	struct stat sb;
+
+	if (stat(testfile, &sb))
+		return -1;
+	return (uint64_t)sb.st_blocks * 512;
+}
+
+static void file_tests(void)
+{
+	const uint8_t test_data[] = "Some test data";
+	uint8_t *read_data;
+	uint64_t read_size;
+
+	unlink(testfile);
+
+	TEST_PTR_EQ(ReadFile(testfile, &read_size), NULL, "ReadFile() missing");
+	TEST_EQ(WriteFile("no/such/dir", test_data, sizeof(test_data)), 1,
+		"WriteFile() open");
+
+	TEST_EQ(WriteFile(testfile, test_data, sizeof(test_data)), 0,
+		"WriteFile() good");
+	read_data = ReadFile(testfile, &read_size);
+	TEST_PTR_NEQ(read_data, NULL, "ReadFile() good");
+	TEST_EQ(read_size, sizeof(test_data), "  data size");
+	TEST_EQ(memcmp(read_data, test_data, read_size), 0, "  data");
+	free(read_data);
+
+	TEST_EQ(WriteFile(testfile, test_data, 0), 0, "WriteFile() empty");
+	read_data = ReadFile(testfile, &read_size);
+	TEST_PTR_NEQ(read_data, NULL, "ReadFile() empty");
+	TEST_EQ(read_size, 0, "  data size");
+	free(read_data);
+
+	unlink(testfile);
+}
+
+static void sparse_tests(void)
+{
+	uint8_t *data = calloc(1, TEST_SIZE);
+	uint8_t *read_data;
+	uint64_t read_size;
+	int fd;
+
+	/* Only blocks with data in them are written */
+	data[0] = 0x11;
+	data[TEST_SIZE / 2 + 100] = 0x22;
+	data[TEST_SIZE - 1] = 0x33;
+	TEST_EQ(WriteFile(testfile, data, TEST_SIZE), 0, "WriteFile() sparse");
+	TEST_TRUE(allocated() <= 64 * 1024, "  stays sparse");
+	read_data = ReadFile(testfile, &read_size);
+	TEST_PTR_NEQ(read_data, NULL, "ReadFile() sparse");
+	TEST_EQ(read_size, TEST_SIZE, "  data size");
+	TEST_EQ(memcmp(read_data, data, TEST_SIZE), 0, "  data");
+	free(read_data);
+
+	/* Trailing zeroes still count towards the size */
+	memset(data, 0, TEST_SIZE);
+	data[10] = 0x44;
+	TEST_EQ(WriteFile(testfile, data, TEST_SIZE - 3), 0,
+		"WriteFile() zero tail");
+	read_data = ReadFile(testfile, &read_size);
+	TEST_EQ(read_size, TEST_SIZE - 3, "  data size");
+	TEST_EQ(memcmp(read_data, data, TEST_SIZE - 3), 0, "  data");
+	free(read_data);
+
+	/* Holes made by someone else read back as zeroes */
+	unlink(testfile);
+	fd = open(testfile, O_RDWR | O_CREAT, 0666);
+	TEST_EQ(ftruncate(fd, TEST_SIZE), 0, "Make sparse file");
+	TEST_EQ(pwrite(fd, "abc", 3, TEST_SIZE / 4), 3, "  write data");
+	close(fd);
+	memset(data, 0, TEST_SIZE);
+	memcpy(data + TEST_SIZE / 4, "abc", 3);
+	read_data = ReadFile(testfile, &read_size);
+	TEST_EQ(read_size, TEST_SIZE, "ReadFile() holes");
+	TEST_EQ(memcmp(read_data, data, TEST_SIZE), 0, "  data");
+	free(read_data);
+
+	/* Overwriting a file replaces everything in it */
+	memset(data, 0xff, TEST_SIZE);
+	TEST_EQ(WriteFile(testfile, data, TEST_SIZE), 0, "WriteFile() dense");
+	memset(data, 0, TEST_SIZE);
+	TEST_EQ(WriteFile(testfile, data, TEST_SIZE), 0, "WriteFile() zeroes");
+	TEST_TRUE(allocated() < 4096 * 2, "  no data");
+	read_data = ReadFile(testfile, &read_size);
+	TEST_EQ(memcmp(read_data, data, TEST_SIZE), 0, "  data");
+	free(read_data);
+
+	unlink(testfile);
+	free(data);
+}
+
+int main(int argc, char *argv[])
+{
+	file_tests();
+	sparse_tests();
+
+	return gTestSuccess ? 0 : 255;
+}
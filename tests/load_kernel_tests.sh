@@ -73,3 +73,47 @@ ${BUILD_RUN}/tests/verify_kernel disk.test \
     ${SCRIPT_DIR}/devkeys/kernel_subkey.vbpubk
 
 happy 'Image verification succeeded'
+
+# Same kernel on a native 4K-sector disk: GPT and partition sizes in 4K LBAs
+echo 'Creating 4Kn test disk image'
+dd if=/dev/zero of=disk4k.test bs=4096 count=1024
+${CGPT} create -B 4096 disk4k.test
+${CGPT} add -i 1 -S 1 -P 1 -b 64 -s 512 -t kernel -l kernelA disk4k.test
+${CGPT} show disk4k.test
+dd if=kernel.test of=disk4k.test bs=4096 seek=64 conv=notrunc
+
+echo 'Verifying 4Kn test disk image'
+${BUILD_RUN}/tests/verify_kernel disk4k.test \
+    ${SCRIPT_DIR}/devkeys/kernel_subkey.vbpubk
+
+happy '4Kn image verification succeeded'
+
+# Boot it in the simulator, normally and skipping the dev screen with Ctrl+D
+echo 'Simulating boot from test disk image'
+${BUILD_RUN}/tests/boot_sim -f disk.test \
+    -k ${SCRIPT_DIR}/devkeys/kernel_subkey.vbpubk > boot_sim.out
+grep -q "^Booting disk.test partition 1" boot_sim.out
+
+${BUILD_RUN}/tests/boot_sim -f disk.test -m dev -p 2000:ctrl-d \
+    -k ${SCRIPT_DIR}/devkeys/kernel_subkey.vbpubk > boot_sim.out
+grep -q "^Booting disk.test partition 1" boot_sim.out
+# Ctrl+D should cut the 30 second dev screen short
+awk '/^Simulated time:/ { exit !($3 < 3000) }' boot_sim.out
+
+# The 4Kn disk, with the sector size taken from its GPT and given explicitly
+${BUILD_RUN}/tests/boot_sim -f disk4k.test \
+    -k ${SCRIPT_DIR}/devkeys/kernel_subkey.vbpubk > boot_sim.out
+grep -q "^Booting disk4k.test partition 1" boot_sim.out
+
+${BUILD_RUN}/tests/boot_sim -f disk4k.test -b 4096 \
+    -k ${SCRIPT_DIR}/devkeys/kernel_subkey.vbpubk > boot_sim.out
+grep -q "^Booting disk4k.test partition 1" boot_sim.out
+
+# Firmware skips disks with sectors bigger than cgptlib handles
+if ${BUILD_RUN}/tests/boot_sim -f disk4k.test -b 8192 \
+    -k ${SCRIPT_DIR}/devkeys/kernel_subkey.vbpubk > boot_sim.out; then
+  false
+fi
+if grep -q "^Booting" boot_sim.out; then false; fi
+
+happy 'Boot simulation succeeded'
@@ -0,0 +1,174 @@
+/* Copyright 2015 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Run a command and report how much memory it needed: its peak RSS, plus
+ * the heap allocations and bytes copied that memory_counter.so counts.
+ * If the budget file has a line for this benchmark, fail when any of the
+ * numbers is over budget.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* What we measure, and what the budget file limits, in this order */
+enum {
+	STAT_RSS_KB,
+	STAT_ALLOCS,
+	STAT_PEAK_HEAP_KB,
+	STAT_COPIED_KB,
+	NUM_STATS
+};
+
+static const char * const stat_name[NUM_STATS] = {
+	"rss_kb", "allocs", "peak_heap_kb", "copied_kb",
+};
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s COUNTER_SO BUDGET_FILE NAME COMMAND [ARGS...]\n"
+		"\n"
+		"Runs COMMAND with COUNTER_SO preloaded and its stdout\n"
+		"discarded, then prints what it used. Lines in BUDGET_FILE\n"
+		"are\n"
+		"\n"
+		"  NAME RSS_KB ALLOCS PEAK_HEAP_KB COPIED_KB\n"
+		"\n"
+		"where \"-\" means no limit.\n", prog);
+}
+
+/* Find the limits for <name>. Returns 0 if found, -1 if there aren't any. */
+static int read_budget(const char *filename, const char *name,
+		       long long budget[NUM_STATS])
+{
+	char line[256], field[NUM_STATS + 1][64];
+	FILE *fp;
+	int i, rv = -1;
+
+	fp = fopen(filename, "r");
+	if (!fp) {
+		fprintf(stderr, "Can't open %s: %s\n", filename,
+			strerror(errno));
+		return -1;
+	}
+
+	while (rv && fgets(line, sizeof(line), fp)) {
+		if (line[0] == '#')
+			continue;
+		if (sscanf(line, "%63s %63s %63s %63s %63s", field[0],
+			   field[1], field[2], field[3], field[4]) !=
+		    NUM_STATS + 1)
+			continue;
+		if (strcmp(field[0], name))
+			continue;
+		for (i = 0; i < NUM_STATS; i++)
+			budget[i] = strcmp(field[i + 1], "-") ?
+				strtoll(field[i + 1], NULL, 0) : -1;
+		rv = 0;
+	}
+
+	fclose(fp);
+	return rv;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long long counted[4] = {0, 0, 0, 0};
+	long long stat[NUM_STATS], budget[NUM_STATS];
+	char buf[128], fdstr[16];
+	struct rusage ru;
+	int fd[2], status, len, i;
+	int errorcnt = 0;
+	pid_t pid;
+
+	if (argc < 5) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (pipe(fd)) {
+		perror("pipe");
+		return 1;
+	}
+
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return 1;
+	}
+	if (!pid) {
+		close(fd[0]);
+		snprintf(fdstr, sizeof(fdstr), "%d", fd[1]);
+		setenv("MEMORY_COUNTER_FD", fdstr, 1);
+		setenv("LD_PRELOAD", argv[1], 1);
+		i = open("/dev/null", O_WRONLY);
+		if (i >= 0)
+			dup2(i, 1);
+		execvp(argv[4], argv + 4);
+		fprintf(stderr, "Can't run %s: %s\n", argv[4],
+			strerror(errno));
+		_exit(127);
+	}
+
+	close(fd[1]);
+	len = 0;
+	while (len < sizeof(buf) - 1) {
+		i = read(fd[0], buf + len, sizeof(buf) - 1 - len);
+		if (i <= 0)
+			break;
+		len += i;
+	}
+	buf[len] = '\0';
+	close(fd[0]);
+
+	if (wait4(pid, &status, 0, &ru) != pid) {
+		perror("wait4");
+		return 1;
+	}
+
+	if (sscanf(buf, "%llu %llu %llu %llu", &counted[0], &counted[1],
+		   &counted[2], &counted[3]) != 4) {
+		/* Without them the heap and copy budgets would always pass */
+		fprintf(stderr, "%s: no counts from %s\n", argv[3], argv[1]);
+		errorcnt++;
+	}
+
+	stat[STAT_RSS_KB] = ru.ru_maxrss;	/* Linux reports KiB */
+	stat[STAT_ALLOCS] = counted[0];
+	stat[STAT_PEAK_HEAP_KB] = counted[2] / 1024;
+	stat[STAT_COPIED_KB] = counted[3] / 1024;
+
+	printf("%-24s", argv[3]);
+	for (i = 0; i < NUM_STATS; i++)
+		printf(" %s=%lld", stat_name[i], stat[i]);
+	printf(" alloc_kb=%llu\n", counted[1] / 1024);
+
+	if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+		fprintf(stderr, "%s: command failed\n", argv[3]);
+		errorcnt++;
+	}
+
+	if (read_budget(argv[2], argv[3], budget)) {
+		printf("%-24s no budget\n", argv[3]);
+	} else {
+		for (i = 0; i < NUM_STATS; i++)
+			if (budget[i] >= 0 && stat[i] > budget[i]) {
+				printf("%-24s OVER BUDGET: %s=%lld > %lld\n",
+				       argv[3], stat_name[i], stat[i],
+				       budget[i]);
+				errorcnt++;
+			}
+	}
+
+	return !!errorcnt;
+}
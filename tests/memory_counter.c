@@ -0,0 +1,155 @@
+/* Copyright 2015 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * LD_PRELOAD shim used by memory_benchmark. Counts heap allocations, the
+ * most heap in use at once, and the bytes moved by memcpy() and memmove(),
+ * and writes the totals to the file descriptor in $MEMORY_COUNTER_FD when
+ * the program exits.
+ *
+ * Only calls that go through the dynamic linker are seen, so copies that
+ * the compiler inlines, and copies inside libc itself, aren't counted.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE			/* for RTLD_NEXT */
+#endif
+#include <dlfcn.h>
+#include <malloc.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* glibc's own entry points, so we don't have to dlsym() them */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static uint64_t allocs, alloc_bytes, heap_bytes, peak_heap_bytes;
+static uint64_t copied_bytes;
+
+static void *(*real_memcpy)(void *, const void *, size_t);
+static void *(*real_memmove)(void *, const void *, size_t);
+
+static void count_alloc(void *ptr)
+{
+	uint64_t size, heap;
+
+	if (!ptr)
+		return;
+	size = malloc_usable_size(ptr);
+	__atomic_add_fetch(&allocs, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&alloc_bytes, size, __ATOMIC_RELAXED);
+	heap = __atomic_add_fetch(&heap_bytes, size, __ATOMIC_RELAXED);
+	/* Good enough; the tools we measure are single-threaded */
+	if (heap > peak_heap_bytes)
+		peak_heap_bytes = heap;
+}
+
+static void count_free(void *ptr)
+{
+	if (ptr)
+		__atomic_sub_fetch(&heap_bytes, malloc_usable_size(ptr),
+				   __ATOMIC_RELAXED);
+}
+
+void *malloc(size_t size)
+{
+	void *ptr = __libc_malloc(size);
+
+	count_alloc(ptr);
+	return ptr;
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	void *ptr = __libc_calloc(nmemb, size);
+
+	count_alloc(ptr);
+	return ptr;
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	void *newptr;
+
+	count_free(ptr);
+	newptr = __libc_realloc(ptr, size);
+	if (newptr) {
+		count_alloc(newptr);
+	} else if (ptr && size) {
+		/* The old block is still there */
+		__atomic_add_fetch(&heap_bytes, malloc_usable_size(ptr),
+				   __ATOMIC_RELAXED);
+	}
+	return newptr;
+}
+
+void free(void *ptr)
+{
+	count_free(ptr);
+	__libc_free(ptr);
+}
+
+/* Used before the constructor has found the real functions */
+static void slow_copy(void *dest, const void *src, size_t n)
+{
+	volatile uint8_t *d = dest;
+	const volatile uint8_t *s = src;
+	size_t i;
+
+	if (d < s) {
+		for (i = 0; i < n; i++)
+			d[i] = s[i];
+	} else {
+		for (i = n; i > 0; i--)
+			d[i - 1] = s[i - 1];
+	}
+}
+
+void *memcpy(void *dest, const void *src, size_t n)
+{
+	__atomic_add_fetch(&copied_bytes, n, __ATOMIC_RELAXED);
+	if (!real_memcpy) {
+		slow_copy(dest, src, n);
+		return dest;
+	}
+	return real_memcpy(dest, src, n);
+}
+
+void *memmove(void *dest, const void *src, size_t n)
+{
+	__atomic_add_fetch(&copied_bytes, n, __ATOMIC_RELAXED);
+	if (!real_memmove) {
+		slow_copy(dest, src, n);
+		return dest;
+	}
+	return real_memmove(dest, src, n);
+}
+
+static void __attribute__((constructor)) counter_init(void)
+{
+	real_memcpy = dlsym(RTLD_NEXT, "memcpy");
+	real_memmove = dlsym(RTLD_NEXT, "memmove");
+}
+
+static void __attribute__((destructor)) counter_report(void)
+{
+	const char *fdstr = getenv("MEMORY_COUNTER_FD");
+	char buf[128];
+	int len;
+
+	if (!fdstr)
+		return;
+
+	len = snprintf(buf, sizeof(buf), "%llu %llu %llu %llu\n",
+		       (unsigned long long)allocs,
+		       (unsigned long long)alloc_bytes,
+		       (unsigned long long)peak_heap_bytes,
+		       (unsigned long long)copied_bytes);
+	if (write(atoi(fdstr), buf, len) != len)
+		return;
+}
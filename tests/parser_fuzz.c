@@ -0,0 +1,463 @@
+/* Copyright 2015 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Fuzz harness for the parsers which look at untrusted images: keyblocks and
+ * preambles (old and new style), GPT headers and entries, FMAP and GBB.
+ *
+ * LLVMFuzzerTestOneInput() is the libFuzzer entry point; build with
+ * "make FUZZER=1" (using clang) to get a libFuzzer binary.
+ *
+ * Otherwise this builds as a standalone runner, which is also how AFL should
+ * invoke it (with @@ as the only input). The runner feeds each input, and a
+ * fixed set of mutations of it, through the parsers and times each run. Any
+ * run which uses more CPU time than the budget is a failure. The slowest small
+ * inputs seen can be saved with -o, to grow the corpus of worst cases in
+ * tests/fuzz_corpus.
+ */
+
+#include <dirent.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "2sysincludes.h"
+#include "2api.h"
+#include "2common.h"
+#include "2rsa.h"
+#include "cgptlib.h"
+#include "cgptlib_internal.h"
+#include "fmap.h"
+#include "futility.h"
+#include "gbb_header.h"
+#include "gpt.h"
+#include "host_common.h"
+#include "host_misc.h"
+#include "timer_utils.h"
+#include "vb2_common.h"
+#include "vb2_struct.h"
+#include "vboot_common.h"
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+/* Enough space for every vb2 verification we do */
+static uint8_t workbuf[VB2_WORKBUF_RECOMMENDED_SIZE]
+	__attribute__ ((aligned (VB2_WORKBUF_ALIGN)));
+
+static void fuzz_vb1(uint8_t *buf, uint32_t size)
+{
+	VbKeyBlockHeader *block = (VbKeyBlockHeader *)buf;
+	RSAPublicKey *rsa;
+
+	if (VBOOT_SUCCESS != KeyBlockVerify(block, size, NULL, 1))
+		return;
+
+	/* Whatever follows is checked against the data key */
+	rsa = PublicKeyToRSA(&block->data_key);
+	if (!rsa)
+		return;
+	VerifyFirmwarePreamble((VbFirmwarePreambleHeader *)
+			       (buf + block->key_block_size),
+			       size - block->key_block_size, rsa);
+	VerifyKernelPreamble((VbKernelPreambleHeader *)
+			     (buf + block->key_block_size),
+			     size - block->key_block_size, rsa);
+	RSAPublicKeyFree(rsa);
+}
+
+static void fuzz_vb21(uint8_t *buf, uint32_t size)
+{
+	struct vb2_struct_common *c = (struct vb2_struct_common *)buf;
+	struct vb2_public_key key = {
+		.sig_alg = VB2_SIG_NONE,
+		.hash_alg = VB2_HASH_SHA256,
+		.guid = vb2_hash_guid(VB2_HASH_SHA256),
+	};
+	struct vb2_workbuf wb;
+
+	if (size < sizeof(*c))
+		return;
+
+	/* Hash-only signatures are fully checked; others are skipped */
+	vb2_workbuf_init(&wb, workbuf, sizeof(workbuf));
+	switch (c->magic) {
+	case VB2_MAGIC_KEYBLOCK:
+		vb2_verify_keyblock((struct vb2_keyblock *)buf, size,
+				    &key, &wb);
+		break;
+	case VB2_MAGIC_FW_PREAMBLE:
+		vb2_verify_fw_preamble((struct vb2_fw_preamble *)buf, size,
+				       &key, &wb);
+		break;
+	case VB2_MAGIC_PACKED_KEY:
+		vb2_unpack_key(&key, buf, size);
+		break;
+	case VB2_MAGIC_SIGNATURE:
+		vb2_verify_signature((struct vb2_signature *)buf, size);
+		break;
+	}
+}
+
+/* Treat the input as the start of a disk, with the backup GPT at its end */
+static void fuzz_gpt(const uint8_t *data, uint32_t size)
+{
+	const uint32_t entries_size =
+		MAX_NUMBER_OF_ENTRIES * sizeof(GptEntry);
+	uint32_t sectors = 2 * (2 + entries_size / 512) + 1;
+	GptData gpt;
+	uint8_t *disk;
+
+	if (size > sectors * 512)
+		sectors = size / 512;
+	disk = calloc(sectors, 512);
+	if (!disk)
+		return;
+	memcpy(disk, data, size < sectors * 512 ? size : sectors * 512);
+
+	memset(&gpt, 0, sizeof(gpt));
+	gpt.sector_bytes = 512;
+	gpt.streaming_drive_sectors = sectors;
+	gpt.gpt_drive_sectors = sectors;
+	gpt.primary_header = disk + 512;
+	gpt.primary_entries = disk + 2 * 512;
+	gpt.secondary_header = disk + (sectors - 1) * 512;
+	gpt.secondary_entries = gpt.secondary_header - entries_size;
+
+	if (GPT_SUCCESS == GptInit(&gpt))
+		GptSanityCheck(&gpt);
+	free(disk);
+}
+
+static void fuzz_fmap_gbb(uint8_t *buf, uint32_t size)
+{
+	GoogleBinaryBlockHeader *gbb = (GoogleBinaryBlockHeader *)buf;
+	uint32_t maxlen;
+
+	fmap_find(buf, size);
+	futil_valid_gbb_header(gbb, size, &maxlen);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	uint8_t *buf;
+
+	if (size > UINT32_MAX)
+		return 0;
+
+	/* Exactly sized, so sanitizers can catch overreads */
+	buf = malloc(size ? size : 1);
+	if (!buf)
+		return 0;
+	memcpy(buf, data, size);
+
+	fuzz_vb1(buf, size);
+	fuzz_vb21(buf, size);
+	fuzz_fmap_gbb(buf, size);
+	fuzz_gpt(data, size);
+
+	free(buf);
+	return 0;
+}
+
+#ifndef LIBFUZZER
+
+#define DEFAULT_BUDGET_MSECS 100
+#define DEFAULT_MUTATIONS 64
+#define NUM_WORST 8
+#define DEFAULT_WORST_MAX_SIZE 65536
+
+/* One timed run */
+struct run_s {
+	char name[256];
+	uint64_t usecs;
+	uint8_t *buf;
+	uint32_t size;
+};
+
+static struct run_s worst[NUM_WORST];
+static uint64_t budget_usecs = DEFAULT_BUDGET_MSECS * 1000;
+static int num_mutations = DEFAULT_MUTATIONS;
+static uint32_t worst_max_size = DEFAULT_WORST_MAX_SIZE;
+static int num_runs, num_slow;
+
+/* Small deterministic PRNG, so every run tries the same mutations */
+static uint32_t prng_state;
+
+static uint32_t prng(void)
+{
+	prng_state ^= prng_state << 13;
+	prng_state ^= prng_state >> 17;
+	prng_state ^= prng_state << 5;
+	return prng_state;
+}
+
+/*
+ * Keep a copy of the input if it's one of the slowest so far.  Big inputs are
+ * always slow, so they're left out; the corpus is for small ones which aren't.
+ */
+static void record_worst(const char *name, uint64_t usecs,
+			 const uint8_t *buf, uint32_t size)
+{
+	int i = NUM_WORST - 1;
+
+	if (size > worst_max_size)
+		return;
+	if (worst[i].buf && worst[i].usecs >= usecs)
+		return;
+
+	free(worst[i].buf);
+	worst[i].buf = malloc(size ? size : 1);
+	if (!worst[i].buf)
+		return;
+	memcpy(worst[i].buf, buf, size);
+	worst[i].size = size;
+	worst[i].usecs = usecs;
+	snprintf(worst[i].name, sizeof(worst[i].name), "%s", name);
+
+	/* Bubble it into place */
+	for (; i > 0 && (!worst[i - 1].buf ||
+			 worst[i - 1].usecs < worst[i].usecs); i--) {
+		struct run_s tmp = worst[i - 1];
+		worst[i - 1] = worst[i];
+		worst[i] = tmp;
+	}
+}
+
+static void timed_run(const char *name, const uint8_t *buf, uint32_t size)
+{
+	ClockTimerState ct;
+	uint64_t usecs;
+
+	/* CPU time, so a busy machine doesn't make a fast parser look slow */
+	StartCpuTimer(&ct);
+	LLVMFuzzerTestOneInput(buf, size);
+	StopCpuTimer(&ct);
+	usecs = GetDurationUsecs(&ct);
+
+	num_runs++;
+	if (usecs > budget_usecs) {
+		fprintf(stderr, "SLOW: %s took %llu us (budget %llu us)\n",
+			name, (unsigned long long)usecs,
+			(unsigned long long)budget_usecs);
+		num_slow++;
+	}
+	record_worst(name, usecs, buf, size);
+}
+
+/* Run the input, then mutations of it which stress the size fields */
+static void run_input(const char *name, const uint8_t *data, uint32_t size)
+{
+	static const uint32_t extremes[] = {
+		0, 1, 0x7fffffff, 0x80000000, 0xfffffffc, 0xffffffff,
+	};
+	char mname[256];
+	uint8_t *buf;
+	int i, j;
+
+	timed_run(name, data, size);
+	if (size < sizeof(uint32_t))
+		return;
+
+	buf = malloc(size);
+	if (!buf)
+		return;
+
+	prng_state = 0x1234567 ^ size;
+	for (i = 0; i < num_mutations; i++) {
+		memcpy(buf, data, size);
+		for (j = 0; j < 1 + (i & 3); j++) {
+			/* Headers are near the start, so favor that */
+			uint32_t lim = (i & 4 || size < 256) ? size : 256;
+			uint32_t off = prng() % (lim - sizeof(uint32_t) + 1);
+			uint32_t val = (i & 8) ? prng() :
+				extremes[prng() % ARRAY_SIZE(extremes)];
+
+			off &= ~(sizeof(uint32_t) - 1);
+			memcpy(buf + off, &val, sizeof(val));
+		}
+		snprintf(mname, sizeof(mname), "%s#%d", name, i);
+		timed_run(mname, buf, size);
+	}
+
+	free(buf);
+}
+
+static int run_path(const char *path)
+{
+	char subpath[PATH_MAX];
+	struct dirent *ent;
+	struct stat sb;
+	uint64_t size;
+	uint8_t *data;
+	DIR *dir;
+
+	if (stat(path, &sb)) {
+		fprintf(stderr, "Can't stat %s\n", path);
+		return 1;
+	}
+
+	if (!S_ISDIR(sb.st_mode)) {
+		data = ReadFile(path, &size);
+		if (!data)
+			return 1;
+		if (size <= UINT32_MAX)
+			run_input(path, data, size);
+		free(data);
+		return 0;
+	}
+
+	dir = opendir(path);
+	if (!dir) {
+		fprintf(stderr, "Can't open %s\n", path);
+		return 1;
+	}
+	while ((ent = readdir(dir))) {
+		if (ent->d_name[0] == '.')
+			continue;
+		snprintf(subpath, sizeof(subpath), "%s/%s", path, ent->d_name);
+		if (!stat(subpath, &sb) && S_ISREG(sb.st_mode))
+			run_path(subpath);
+	}
+	closedir(dir);
+	return 0;
+}
+
+/* Known worst cases for the scanning parsers, which no seed file covers */
+static void run_builtin(void)
+{
+	const uint32_t image_size = 8 * 1024 * 1024;
+	struct vb2_keyblock *kb;
+	struct vb2_packed_key *pk;
+	struct vb2_signature *sig;
+	FmapHeader *fmap;
+	uint32_t sig_size, off;
+	uint8_t *buf;
+
+	buf = calloc(1, image_size);
+	if (!buf)
+		return;
+
+	/* FMAP search of a whole BIOS-sized image which hasn't got one */
+	run_input("<no fmap>", buf, image_size);
+
+	/* FMAP signature everywhere, but never a usable FMAP */
+	for (off = 0; off + sizeof(*fmap) <= image_size; off += 8) {
+		fmap = (FmapHeader *)(buf + off);
+		memcpy(fmap->fmap_signature, FMAP_SIGNATURE,
+		       FMAP_SIGNATURE_SIZE);
+	}
+	timed_run("<bad fmaps>", buf, image_size);
+
+	/* vb21 keyblock with as many signatures as will fit in 1 MB */
+	memset(buf, 0, image_size);
+	kb = (struct vb2_keyblock *)buf;
+	kb->c.magic = VB2_MAGIC_KEYBLOCK;
+	kb->c.struct_version_major = VB2_KEYBLOCK_VERSION_MAJOR;
+	kb->c.fixed_size = sizeof(*kb);
+	kb->key_offset = sizeof(*kb);
+	pk = (struct vb2_packed_key *)(buf + kb->key_offset);
+	pk->c.magic = VB2_MAGIC_PACKED_KEY;
+	pk->c.fixed_size = pk->c.total_size = sizeof(*pk);
+	kb->sig_offset = kb->key_offset + sizeof(*pk);
+	sig_size = sizeof(*sig) + vb2_digest_size(VB2_HASH_SHA256);
+	for (off = kb->sig_offset; off + sig_size <= 1024 * 1024;
+	     off += sig_size) {
+		sig = (struct vb2_signature *)(buf + off);
+		sig->c.magic = VB2_MAGIC_SIGNATURE;
+		sig->c.struct_version_major = VB2_SIGNATURE_VERSION_MAJOR;
+		sig->c.fixed_size = sizeof(*sig);
+		sig->c.total_size = sig_size;
+		sig->sig_offset = sizeof(*sig);
+		sig->sig_size = vb2_digest_size(VB2_HASH_SHA256);
+		sig->sig_alg = VB2_SIG_NONE;
+		sig->hash_alg = VB2_HASH_SHA256;
+		kb->sig_count++;
+	}
+	kb->c.total_size = off;
+	timed_run("<many vb21 sigs>", buf, off);
+
+	free(buf);
+}
+
+static int save_worst(const char *outdir)
+{
+	char path[PATH_MAX];
+	int errorcnt = 0;
+	int i;
+
+	mkdir(outdir, 0755);
+	for (i = 0; i < NUM_WORST && worst[i].buf; i++) {
+		snprintf(path, sizeof(path), "%s/worst-%02d.bin", outdir, i);
+		if (WriteFile(path, worst[i].buf, worst[i].size)) {
+			fprintf(stderr, "Can't write %s\n", path);
+			errorcnt++;
+		}
+	}
+	return errorcnt;
+}
+
+static void print_help(const char *prog)
+{
+	printf("\nUsage: %s [OPTIONS] FILE|DIR...\n"
+	       "\n"
+	       "Times the image parsers on each input file (and the files in\n"
+	       "each DIR), and on mutations of them.\n"
+	       "\n"
+	       "Options:\n"
+	       "  -b MSECS   Fail if any run uses more CPU time (default %d)\n"
+	       "  -m COUNT   Mutations to try per input (default %d)\n"
+	       "  -o DIR     Save the %d slowest inputs in DIR\n"
+	       "  -s BYTES   Only list and save inputs up to this size\n"
+	       "             (default %d)\n"
+	       "\n", prog, DEFAULT_BUDGET_MSECS, DEFAULT_MUTATIONS, NUM_WORST,
+	       DEFAULT_WORST_MAX_SIZE);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *outdir = NULL;
+	int errorcnt = 0;
+	int i;
+
+	while ((i = getopt(argc, argv, "b:m:o:s:")) != -1) {
+		switch (i) {
+		case 'b':
+			budget_usecs = strtoull(optarg, NULL, 0) * 1000;
+			break;
+		case 'm':
+			num_mutations = strtol(optarg, NULL, 0);
+			break;
+		case 'o':
+			outdir = optarg;
+			break;
+		case 's':
+			worst_max_size = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			print_help(argv[0]);
+			return 1;
+		}
+	}
+
+	run_builtin();
+	for (i = optind; i < argc; i++)
+		errorcnt += run_path(argv[i]);
+
+	printf("%d runs, %d over the %llu us budget; slowest up to %u bytes:\n",
+	       num_runs, num_slow, (unsigned long long)budget_usecs,
+	       worst_max_size);
+	for (i = 0; i < NUM_WORST && worst[i].buf; i++)
+		printf("  %8llu us  %s\n",
+		       (unsigned long long)worst[i].usecs, worst[i].name);
+
+	if (outdir)
+		errorcnt += save_worst(outdir);
+
+	return (errorcnt || num_slow) ? 1 : 0;
+}
+
+#endif  /* LIBFUZZER */
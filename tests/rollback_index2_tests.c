@@ -851,6 +851,15 @@ static void RollbackFirmwareTest(void)
 	TEST_EQ(RollbackFirmwareWrite(123), TPM_E_IOERROR,
 		"RollbackFirmwareWrite() error");
 
+	/* Writing the version already stored is a no-op */
+	ResetMocks(0, 0);
+	mock_rsf.fw_versions = 0xBEAD1234;
+	TEST_EQ(RollbackFirmwareWrite(0xBEAD1234), 0,
+		"RollbackFirmwareWrite() same version");
+	TEST_STR_EQ(mock_calls,
+		    "TlclRead(0x1007, 10)\n",
+		    "tlcl calls");
+
 	/* Test setting virtual dev mode */
 	ResetMocks(0, 0);
 	TEST_EQ(SetVirtualDevMode(1), 0, "SetVirtualDevMode(1)");
@@ -861,6 +870,7 @@ static void RollbackFirmwareTest(void)
 		    "TlclRead(0x1007, 10)\n",
 		    "tlcl calls");
 	ResetMocks(0, 0);
+	mock_rsf.flags = FLAG_VIRTUAL_DEV_MODE_ON;
 	TEST_EQ(SetVirtualDevMode(0), 0, "SetVirtualDevMode(0)");
 	TEST_EQ(mock_rsf.flags, 0, "Virtual dev off");
 	TEST_STR_EQ(mock_calls,
@@ -869,6 +879,13 @@ static void RollbackFirmwareTest(void)
 		    "TlclRead(0x1007, 10)\n",
 		    "tlcl calls");
 
+	/* Setting it to what it already is shouldn't write */
+	ResetMocks(0, 0);
+	TEST_EQ(SetVirtualDevMode(0), 0, "SetVirtualDevMode(0) no-op");
+	TEST_STR_EQ(mock_calls,
+		    "TlclRead(0x1007, 10)\n",
+		    "tlcl calls");
+
 	/* Test lock */
 	ResetMocks(0, 0);
 	TEST_EQ(RollbackFirmwareLock(), 0, "RollbackFirmwareLock()");
@@ -888,6 +905,7 @@ static void RollbackKernelTest(void)
 {
 	RollbackSpaceFirmware rsf;
 	uint32_t version = 0;
+	uint32_t writes, elided;
 
 	/*
 	 * RollbackKernel*() functions use a global flag inside
@@ -944,6 +962,35 @@ static void RollbackKernelTest(void)
 	TEST_EQ(RollbackKernelWrite(123), TPM_E_IOERROR,
 		"RollbackKernelWrite() error");
 
+	/* After a read, writes reuse its contents and skip no-ops */
+	ResetMocks(0, 0);
+	mock_rsk.uid = ROLLBACK_SPACE_KERNEL_UID;
+	mock_permissions = TPM_NV_PER_PPWRITE;
+	mock_rsk.kernel_versions = 0x87654321;
+	RollbackGetWriteCounts(&writes, &elided);
+	TEST_EQ(RollbackKernelRead(&version), 0, "RollbackKernelRead()");
+	TEST_EQ(RollbackKernelWrite(0x87654321), 0,
+		"RollbackKernelWrite() same version");
+	TEST_EQ(RollbackKernelWrite(0x87654322), 0,
+		"RollbackKernelWrite() new version");
+	TEST_EQ(mock_rsk.kernel_versions, 0x87654322,
+		"RollbackKernelWrite() cached version");
+	TEST_EQ(mock_rsk.uid, ROLLBACK_SPACE_KERNEL_UID,
+		"RollbackKernelWrite() cached uid");
+	TEST_EQ(RollbackKernelWrite(0x87654322), 0,
+		"RollbackKernelWrite() same version again");
+	TEST_STR_EQ(mock_calls,
+		    "TlclRead(0x1008, 13)\n"
+		    "TlclGetPermissions(0x1008)\n"
+		    "TlclWrite(0x1008, 13)\n"
+		    "TlclRead(0x1008, 13)\n",
+		    "tlcl calls");
+	RollbackGetWriteCounts(&writes, &elided);
+	TEST_EQ(writes, 1, "Rollback writes");
+	TEST_EQ(elided, 2, "Rollback writes elided");
+	RollbackGetWriteCounts(&writes, &elided);
+	TEST_EQ(writes + elided, 0, "Rollback write counts reset");
+
 	/* Test lock (recovery off) */
 	ResetMocks(0, 0);
 	TEST_EQ(RollbackKernelLock(0), 0, "RollbackKernelLock()");
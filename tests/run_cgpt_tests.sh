@@ -118,6 +118,47 @@ X=$($CGPT show $MTD -b -i $RANDOM_NUM ${DEV})
 Y=$($CGPT show $MTD -s -i $RANDOM_NUM ${DEV})
 [ "$X $Y" = "$RANDOM_START $RANDOM_SIZE" ] || error
 
+echo "Query several fields of several partitions at once..."
+X=$($CGPT show $MTD -b -s -i $DATA_NUM -i $KERN_NUM ${DEV})
+[ "$X" = "$(printf '%s %s\n%s %s' $DATA_START $DATA_SIZE \
+            $KERN_START $KERN_SIZE)" ] || error
+X=$($CGPT show $MTD -l -i $KERN_NUM -b ${DEV})
+[ "$X" = "$KERN_LABEL $KERN_START" ] || error
+assert_fail $CGPT show $MTD -b -i $DATA_NUM -i 0 ${DEV}
+
+echo "Dump the whole table as JSON and as binary..."
+X=$($CGPT show $MTD -j ${DEV})
+echo "$X" | grep -q '"number": '$KERN_NUM', "start": '$KERN_START', "size": '$KERN_SIZE || error
+echo "$X" | grep -q '"type_name": "ChromeOS kernel", .*"label": "'"$KERN_LABEL"'"' || error
+[ "$(echo "$X" | grep -c '"number": ')" = "6" ] || error
+X=$($CGPT show $MTD -B ${DEV} | wc -c)
+[ "$X" = "$((512 + 128 * 128))" ] || error
+[ "$($CGPT show $MTD -B ${DEV} | head -c 8)" = "EFI PART" ] || error
+assert_fail $CGPT show $MTD -j -B ${DEV}
+assert_fail $CGPT show $MTD -j -i 1 ${DEV}
+
+
+echo "Find partitions by label..."
+X=$($CGPT find $MTD -n -l "${KERN_LABEL}" ${DEV})
+[ "$X" = "$KERN_NUM" ] || error
+X=$($CGPT find $MTD -n -l "${RANDOM_LABEL}" ${DEV})
+[ "$X" = "$RANDOM_NUM" ] || error
+assert_fail $CGPT find $MTD -l "kernel stuf" ${DEV}
+assert_fail $CGPT find $MTD -l "kernel stuffs" ${DEV}
+
+# Non-ASCII labels, and the longest label cgpt will store
+for label in "f\xc3\xbcture \xe2\x82\xac stuff \xf0\x9f\x98\x80" \
+    "abcdefghijklmnopqrstuvwxyz012345678"; do
+  label=$(printf "$label")
+  $CGPT add $MTD -i $FUTURE_NUM -l "$label" ${DEV}
+  [ "$($CGPT show $MTD -l -i $FUTURE_NUM ${DEV})" = "$label" ] || error
+  X=$($CGPT find $MTD -n -l "$label" ${DEV})
+  [ "$X" = "$FUTURE_NUM" ] || error
+  assert_fail $CGPT find $MTD -l "${label}x" ${DEV}
+done
+assert_fail $CGPT find $MTD -l "abcdefghijklmnopqrstuvwxyz01234567" ${DEV}
+$CGPT add $MTD -i $FUTURE_NUM -l "${FUTURE_LABEL}" ${DEV}
+
 
 echo "Change the beginning..."
 DATA_START=$((DATA_START + 10))
@@ -269,6 +310,28 @@ assert_pri 13 13 14 12 15 11 10 10  9  9  8  8 7 7 6 6 5 5 4 4 3 3 2 2 1 1 1 1 1
 $CGPT prioritize $MTD -i 1 -f ${DEV}
 assert_pri 15 15 13 12 14 11 10 10  9  9  8  8 7 7 6 6 5 5 4 4 3 3 2 2 1 1 1 1 1 1 0
 
+echo "Create a GPT on sparse images without filling them in..."
+SPARSE=sparse_dev.bin
+rm -f ${SPARSE}
+dd if=/dev/zero of=${SPARSE} bs=1 count=0 seek=1G 2>/dev/null
+# Zeroes are never written into holes
+$CGPT create ${SPARSE} 2>/dev/null
+[ "$(du -k ${SPARSE} | cut -f1)" -lt 32 ] || error
+$CGPT create -s ${SPARSE} 2>/dev/null
+[ "$(du -k ${SPARSE} | cut -f1)" -lt 32 ] || error
+$CGPT show ${SPARSE} 2>&1 | grep -q WARNING && error
+$CGPT create -s -z ${SPARSE}
+[ "$(du -k ${SPARSE} | cut -f1)" -le 4 ] || error
+# Old tables must be cleared, even though only the headers are written
+dd if=/dev/urandom of=${SPARSE} bs=512 count=64 conv=notrunc 2>/dev/null
+dd if=/dev/urandom of=${SPARSE} bs=512 seek=$((2 * 1024 * 1024 - 64)) \
+  count=64 conv=notrunc 2>/dev/null
+$CGPT create -s -p 8 ${SPARSE} 2>/dev/null
+$CGPT show ${SPARSE} 2>&1 | grep -q WARNING && error
+$CGPT add -b 100 -s 20 -t data ${SPARSE}
+[ "$($CGPT show -b -s -i 1 ${SPARSE})" = "100 20" ] || error
+rm -f ${SPARSE}
+
 # Now make sure that we don't need write access if we're just looking.
 echo "Test read vs read-write access..."
 chmod 0444 ${DEV}
@@ -317,6 +380,39 @@ assert_fail $CGPT add $MTD -b 2 -s 1 -t data ${DEV}
 # This fails because partition size is over the size of the device
 assert_fail $CGPT add $MTD -b 0 -s 3 -t data ${DEV}
 
+echo "Test writes through the MTD erase block cache..."
+# With CGPT_ERASE_SIZE set, image files are written through the same erase
+# block cache as MTD devices. The GPT entries span several blocks, and the
+# result must match writing the file directly, byte for byte.
+gpt_edits() {
+  $CGPT add -i 1 -b 100 -s 20 -t data -l "data stuff" \
+    -u "${DATA_GUID}" "$1"
+  $CGPT add -i 2 -b 200 -s 30 -t kernel -l "kernel stuff" \
+    -u "${KERN_GUID}" -P 3 -T 5 "$1"
+  $CGPT add -i 128 -b 300 -s 40 -t rootfs -l "last entry" \
+    -u "${ROOTFS_GUID}" "$1"
+  $CGPT prioritize -i 2 "$1"
+  $CGPT boot -p -i 2 "$1" >/dev/null
+  # Corrupt the primary entries, then put them back
+  dd if=/dev/zero of="$1" bs=512 seek=2 count=32 conv=notrunc 2>/dev/null
+  $CGPT repair "$1" >/dev/null 2>&1
+  $CGPT add -i 2 -S 1 "$1"
+}
+dd if=/dev/zero of=erase_ref.bin bs=512 count=1024 2>/dev/null
+$CGPT create erase_ref.bin
+for ERASE_SIZE in 1024 4096 65536; do
+  cp erase_ref.bin erase_direct.bin
+  cp erase_ref.bin erase_cached.bin
+  gpt_edits erase_direct.bin
+  CGPT_ERASE_SIZE=${ERASE_SIZE} gpt_edits erase_cached.bin
+  cmp erase_direct.bin erase_cached.bin || \
+    error "Erase block size ${ERASE_SIZE} wrote a different image"
+  CGPT_ERASE_SIZE=${ERASE_SIZE} $CGPT show erase_cached.bin >/dev/null
+done
+# The file must be a whole number of erase blocks
+CGPT_ERASE_SIZE=3000 assert_fail $CGPT show erase_ref.bin
+CGPT_ERASE_SIZE=junk assert_fail $CGPT show erase_ref.bin
+
 
 echo "Done."
 
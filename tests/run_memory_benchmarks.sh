@@ -0,0 +1,119 @@
+#!/bin/bash -u
+#
+# Copyright 2015 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+#
+# Run the host tools on large synthetic images and check their peak memory
+# use, heap allocations and bytes copied against tests/memory_budgets.txt.
+# Signing often happens in memory-limited containers, so this catches
+# changes that make the tools hold more copies of an image than they did.
+#
+
+# Load common constants and variables for tests.
+. "$(dirname "$0")/common.sh"
+
+DEVKEYS="${ROOT_DIR}/tests/devkeys"
+DATA_DIR="${SCRIPT_DIR}/futility/data"
+BUDGETS="${BUDGETS:-${SCRIPT_DIR}/memory_budgets.txt}"
+BENCH="${TEST_DIR}/memory_benchmark"
+COUNTER="${TEST_DIR}/memory_counter.so"
+CGPT="${BIN_DIR}/cgpt"
+TMPDIR="${TEST_DIR}/memory_benchmarks_dir"
+[ -d "${TMPDIR}" ] || mkdir -p "${TMPDIR}"
+
+# The synthetic images. The budgets are set for these sizes.
+VMLINUZ_MB=32
+DISK_GB=64
+PADDING=65536
+
+tests=0
+errs=0
+run() {
+  : $(( tests++ ))
+  "${BENCH}" "${COUNTER}" "${BUDGETS}" "$@" || : $(( errs++ ))
+}
+
+echo "Creating synthetic images..."
+dd if=/dev/urandom of="${TMPDIR}/vmlinuz.bin" bs=1M count=${VMLINUZ_MB} \
+  2>/dev/null
+echo "cros_secure console=" > "${TMPDIR}/config.txt"
+dd if=/dev/urandom of="${TMPDIR}/bootloader.bin" bs=1k count=64 2>/dev/null
+cp "${DATA_DIR}/bios_peppy_mp.bin" "${TMPDIR}/bios.bin"
+rm -f "${TMPDIR}/disk.bin"
+truncate -s ${DISK_GB}G "${TMPDIR}/disk.bin"
+
+# Kernel partitions
+run vbutil_kernel_pack "${FUTILITY}" vbutil_kernel \
+  --pack "${TMPDIR}/kern.bin" \
+  --keyblock "${DEVKEYS}/kernel.keyblock" \
+  --signprivate "${DEVKEYS}/kernel_data_key.vbprivk" \
+  --version 1 \
+  --config "${TMPDIR}/config.txt" \
+  --bootloader "${TMPDIR}/bootloader.bin" \
+  --vmlinuz "${TMPDIR}/vmlinuz.bin" \
+  --arch x86 \
+  --pad ${PADDING}
+run vbutil_kernel_verify "${FUTILITY}" vbutil_kernel \
+  --verify "${TMPDIR}/kern.bin" \
+  --pad ${PADDING} \
+  --signpubkey "${DEVKEYS}/kernel_subkey.vbpubk"
+run vbutil_kernel_repack "${FUTILITY}" vbutil_kernel \
+  --repack "${TMPDIR}/kern2.bin" \
+  --oldblob "${TMPDIR}/kern.bin" \
+  --keyblock "${DEVKEYS}/kernel.keyblock" \
+  --signprivate "${DEVKEYS}/kernel_data_key.vbprivk" \
+  --version 2 \
+  --pad ${PADDING}
+run sign_kernel "${FUTILITY}" sign \
+  --keyblock "${DEVKEYS}/kernel.keyblock" \
+  --signprivate "${DEVKEYS}/kernel_data_key.vbprivk" \
+  --version 1 \
+  --config "${TMPDIR}/config.txt" \
+  --bootloader "${TMPDIR}/bootloader.bin" \
+  --vmlinuz "${TMPDIR}/vmlinuz.bin" \
+  --arch x86 \
+  --pad ${PADDING} \
+  --outfile "${TMPDIR}/kern3.bin"
+run resign_kernel "${FUTILITY}" sign \
+  --keyblock "${DEVKEYS}/kernel.keyblock" \
+  --signprivate "${DEVKEYS}/kernel_data_key.vbprivk" \
+  --version 2 \
+  --pad ${PADDING} \
+  "${TMPDIR}/kern3.bin" "${TMPDIR}/kern4.bin"
+run show_kernel "${FUTILITY}" show --pad ${PADDING} "${TMPDIR}/kern4.bin"
+
+# Firmware images
+run sign_bios "${FUTILITY}" sign \
+  -s "${DEVKEYS}/firmware_data_key.vbprivk" \
+  -b "${DEVKEYS}/firmware.keyblock" \
+  -k "${DEVKEYS}/kernel_subkey.vbpubk" \
+  -v 2 \
+  "${TMPDIR}/bios.bin" "${TMPDIR}/bios2.bin"
+run show_bios "${FUTILITY}" show "${TMPDIR}/bios2.bin"
+run gbb_utility_get "${FUTILITY}" gbb_utility -g --hwid \
+  "${TMPDIR}/bios2.bin"
+run gbb_utility_set "${FUTILITY}" gbb_utility -s \
+  --hwid="BENCHMARK TEST 1234" \
+  "${TMPDIR}/bios2.bin" "${TMPDIR}/bios3.bin"
+run flash_plan "${FUTILITY}" flash_plan \
+  "${TMPDIR}/bios.bin" "${TMPDIR}/bios3.bin"
+
+# Partition tables on a big sparse disk
+run cgpt_create "${CGPT}" create "${TMPDIR}/disk.bin"
+run cgpt_add "${CGPT}" add -i 2 -b 4096 -s 65536 -t kernel \
+  -l KERN-A "${TMPDIR}/disk.bin"
+run cgpt_show "${CGPT}" show "${TMPDIR}/disk.bin"
+run cgpt_find "${CGPT}" find -l KERN-A "${TMPDIR}/disk.bin"
+
+rm -rf "${TMPDIR}"
+
+# Summary
+ME=$(basename "$0")
+if [ "$errs" -ne 0 ]; then
+  echo -e "${COL_RED}${ME}: ${errs}/${tests} benchmarks failed or were" \
+    "over budget${COL_STOP}"
+  exit 1
+fi
+happy "${ME}: All ${tests} benchmarks within budget"
+exit 0
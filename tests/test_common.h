@@ -7,6 +7,8 @@
 #ifndef VBOOT_REFERENCE_TEST_COMMON_H_
 #define VBOOT_REFERENCE_TEST_COMMON_H_
 
+#include <stdint.h>
+
 extern int gTestSuccess;
 
 /* Return 1 if result is equal to expected_result, else return 0.
@@ -57,4 +59,7 @@ int TEST_SUCC(int result, const char* testname);
 /* Check that all memory allocations were freed */
 int vboot_api_stub_check_memory(void);
 
+/* Set the disk sector size assumed by the stub stream implementation */
+void vboot_api_stub_set_sector_bytes(uint32_t bytes);
+
 #endif  /* VBOOT_REFERENCE_TEST_COMMON_H_ */
@@ -13,6 +13,14 @@ void StopTimer(ClockTimerState* ct) {
   clock_gettime(CLOCK_REALTIME, &ct->end_time);
 }
 
+void StartCpuTimer(ClockTimerState* ct) {
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ct->start_time);
+}
+
+void StopCpuTimer(ClockTimerState* ct) {
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ct->end_time);
+}
+
 uint32_t GetDurationMsecs(ClockTimerState* ct) {
   uint64_t start = ((uint64_t) ct->start_time.tv_sec * 1000000000 +
                     (uint64_t) ct->start_time.tv_nsec);
@@ -22,3 +30,11 @@ uint32_t GetDurationMsecs(ClockTimerState* ct) {
                                                         * Milliseconds. */
   return (uint32_t) duration_msecs;
 }
+
+uint64_t GetDurationUsecs(ClockTimerState* ct) {
+  uint64_t start = ((uint64_t) ct->start_time.tv_sec * 1000000000 +
+                    (uint64_t) ct->start_time.tv_nsec);
+  uint64_t end = ((uint64_t) ct->end_time.tv_sec * 1000000000 +
+                  (uint64_t) ct->end_time.tv_nsec);
+  return (end - start) / 1000U;  /* Nanoseconds -> Microseconds. */
+}
@@ -21,7 +21,16 @@ void StartTimer(ClockTimerState* ct);
 /* Stop timer and update [ct]. */
 void StopTimer(ClockTimerState* ct);
 
+/* Start timer and update [ct], counting only this thread's CPU time. */
+void StartCpuTimer(ClockTimerState* ct);
+
+/* Stop a timer started with StartCpuTimer() and update [ct]. */
+void StopCpuTimer(ClockTimerState* ct);
+
 /* Get duration in milliseconds. */
 uint32_t GetDurationMsecs(ClockTimerState* ct);
 
+/* Get duration in microseconds. */
+uint64_t GetDurationUsecs(ClockTimerState* ct);
+
 #endif  /* VBOOT_REFERENCE_TIMER_UTILS_H_ */
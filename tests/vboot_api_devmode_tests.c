@@ -239,6 +239,17 @@ uint32_t VbExKeyboardRead(void) {
   return 0;
 }
 
+uint32_t VbExKeyboardWait(uint32_t msec) {
+  uint32_t start = current_time;
+  uint32_t key;
+
+  /* Poll, so each read advances the mock clock */
+  do {
+    key = VbExKeyboardRead();
+  } while (!key && current_time - start < msec);
+  return key;
+}
+
 void VbExSleepMs(uint32_t msec) {
   current_ticks += (uint64_t)msec * TICKS_PER_MSEC;
   current_time = current_ticks / TICKS_PER_MSEC;
@@ -213,6 +213,11 @@ static void VbInitTest(void)
 	TestVbInit(0, 0, "  flags test EC slow update");
 	TEST_EQ(shared->flags, VBSD_EC_SLOW_UPDATE, "  shared flags");
 
+	ResetMocks();
+	iparams.flags = VB_INIT_FLAG_KERNEL_VERIFY_CACHE;
+	TestVbInit(0, 0, "  flags test kernel verify cache");
+	TEST_EQ(shared->flags, VBSD_KERNEL_VERIFY_CACHE, "  shared flags");
+
 	/* S3 resume */
 	ResetMocks();
 	iparams.flags = VB_INIT_FLAG_S3_RESUME;
@@ -124,6 +124,11 @@ uint32_t VbExKeyboardReadWithFlags(uint32_t *key_flags)
 		return 0;
 }
 
+uint32_t VbExKeyboardWait(uint32_t msec)
+{
+	return VbExKeyboardReadWithFlags(NULL);
+}
+
 uint32_t VbExGetSwitches(uint32_t request_mask)
 {
 	if (mock_switches_are_stuck)
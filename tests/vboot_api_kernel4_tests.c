@@ -32,7 +32,10 @@ static int ecsync_retval;
 static uint32_t rkr_version;
 static uint32_t new_version;
 static int rkr_retval, rkw_retval, rkl_retval;
+static uint32_t rkw_writes, rkw_elided;
 static VbError_t vbboot_retval;
+static VbKernelVerifyCache verify_cache;
+static VbKernelVerifyCache *boot_verify_cache;
 
 /* Reset mock data (for use before each test) */
 static void ResetMocks(void)
@@ -60,7 +63,9 @@ static void ResetMocks(void)
 	ecsync_retval = VBERROR_SUCCESS;
 	rkr_version = new_version = 0x10002;
 	rkr_retval = rkw_retval = rkl_retval = VBERROR_SUCCESS;
+	rkw_writes = rkw_elided = 0;
 	vbboot_retval = VBERROR_SUCCESS;
+	boot_verify_cache = NULL;
 }
 
 /* Mock functions */
@@ -91,10 +96,23 @@ uint32_t RollbackKernelRead(uint32_t *version)
 uint32_t RollbackKernelWrite(uint32_t version)
 {
 	TEST_EQ(version, new_version, "RollbackKernelWrite new version");
+	/* Like the real one, skip writes that wouldn't change anything */
+	if (version == rkr_version) {
+		rkw_elided++;
+		return rkw_retval;
+	}
 	rkr_version = version;
+	rkw_writes++;
 	return rkw_retval;
 }
 
+void RollbackGetWriteCounts(uint32_t *writes, uint32_t *elided)
+{
+	*writes = rkw_writes;
+	*elided = rkw_elided;
+	rkw_writes = rkw_elided = 0;
+}
+
 uint32_t RollbackKernelLock(int recovery_mode)
 {
 	return rkl_retval;
@@ -103,6 +121,7 @@ uint32_t RollbackKernelLock(int recovery_mode)
 VbError_t VbBootNormal(VbCommonParams *cparams, LoadKernelParams *p)
 {
 	shared->kernel_version_tpm = new_version;
+	boot_verify_cache = p->verify_cache;
 
 	if (vbboot_retval == -1)
 		return VBERROR_SIMULATED;
@@ -145,6 +164,9 @@ static void VbSlkTest(void)
 {
 	ResetMocks();
 	test_slk(0, 0, "Normal");
+	TEST_EQ(shared->tpm_rollback_writes, 0, "  rollback writes");
+	TEST_EQ(shared->tpm_rollback_writes_elided, 1,
+		"  rollback writes elided");
 
 	/* Software sync */
 	ResetMocks();
@@ -172,6 +194,9 @@ static void VbSlkTest(void)
 	new_version = 0x20003;
 	test_slk(0, 0, "Roll forward");
 	TEST_EQ(rkr_version, 0x20003, "  version");
+	TEST_EQ(shared->tpm_rollback_writes, 1, "  rollback writes");
+	TEST_EQ(shared->tpm_rollback_writes_elided, 0,
+		"  rollback writes elided");
 
 	ResetMocks();
 	new_version = 0x20003;
@@ -179,6 +204,8 @@ static void VbSlkTest(void)
 	shared->firmware_index = 1;
 	test_slk(0, 0, "Don't roll forward during try B");
 	TEST_EQ(rkr_version, 0x10002, "  version");
+	TEST_EQ(shared->tpm_rollback_writes +
+		shared->tpm_rollback_writes_elided, 0, "  rollback writes");
 
 	ResetMocks();
 	vbboot_retval = VBERROR_INVALID_KERNEL_FOUND;
@@ -205,6 +232,18 @@ static void VbSlkTest(void)
 	vbboot_retval = -1;
 	test_slk(VBERROR_SIMULATED, 0, "Normal boot bad");
 
+	/* Verify cache is only passed down if VbInit() was told about it */
+	ResetMocks();
+	kparams.verify_cache = &verify_cache;
+	test_slk(0, 0, "Verify cache ignored");
+	TEST_PTR_EQ(boot_verify_cache, NULL, "  cache");
+
+	ResetMocks();
+	shared->flags |= VBSD_KERNEL_VERIFY_CACHE;
+	kparams.verify_cache = &verify_cache;
+	test_slk(0, 0, "Verify cache");
+	TEST_PTR_EQ(boot_verify_cache, &verify_cache, "  cache");
+
 	/* Boot dev */
 	ResetMocks();
 	shared->flags |= VBSD_BOOT_DEV_SWITCH_ON;
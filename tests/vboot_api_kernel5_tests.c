@@ -0,0 +1,217 @@
+/* Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests for vboot_api_kernel, part 5 - developer screen timing
+ *
+ * Runs VbBootDeveloper() against a simulated clock, with the real audio code,
+ * and measures how often the loop wakes up and how long a key press waits
+ * before it is seen.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gbb_header.h"
+#include "host_common.h"
+#include "load_kernel_fw.h"
+#include "rollback_index.h"
+#include "test_common.h"
+#include "vboot_audio.h"
+#include "vboot_common.h"
+#include "vboot_kernel.h"
+#include "vboot_nvstorage.h"
+#include "vboot_struct.h"
+
+/* Simulated clock, in usecs; VbExGetTimer() ticks are also usecs */
+#define USEC_PER_MSEC 1000ULL
+
+/* Mock data */
+static VbCommonParams cparams;
+static uint8_t shared_data[VB_SHARED_DATA_MIN_SIZE];
+static VbSharedDataHeader *shared = (VbSharedDataHeader *)shared_data;
+static GoogleBinaryBlockHeader gbb;
+static LoadKernelParams lkp;
+
+static uint64_t sim_now;
+static uint64_t sim_start;
+static uint64_t boot_time;
+static int background_beep;
+static uint32_t mock_key;
+static uint64_t mock_key_time;
+static uint64_t key_latency;
+static uint32_t wakeups;
+
+/* Reset mock data (for use before each test) */
+static void ResetMocks(void)
+{
+	Memset(&cparams, 0, sizeof(cparams));
+	cparams.shared_data_size = sizeof(shared_data);
+	cparams.shared_data_blob = shared_data;
+	cparams.gbb_data = &gbb;
+	cparams.gbb = &gbb;
+
+	Memset(&gbb, 0, sizeof(gbb));
+	gbb.major_version = GBB_MAJOR_VER;
+	gbb.minor_version = GBB_MINOR_VER;
+	gbb.flags = 0;
+
+	Memset(VbApiKernelGetVnc(), 0, sizeof(VbNvContext));
+	VbNvSetup(VbApiKernelGetVnc());
+	VbNvTeardown(VbApiKernelGetVnc()); /* So CRC gets generated */
+
+	Memset(&shared_data, 0, sizeof(shared_data));
+	VbSharedDataInit(shared, sizeof(shared_data));
+
+	Memset(&lkp, 0, sizeof(lkp));
+
+	sim_now = sim_start = 1000000;
+	boot_time = 0;
+	background_beep = 1;
+	mock_key = 0;
+	mock_key_time = 0;
+	key_latency = 0;
+	wakeups = 0;
+}
+
+/* Mock functions */
+
+uint64_t VbExGetTimer(void)
+{
+	return sim_now;
+}
+
+void VbExSleepMs(uint32_t msec)
+{
+	sim_now += msec * USEC_PER_MSEC;
+}
+
+VbError_t VbExBeep(uint32_t msec, uint32_t frequency)
+{
+	sim_now += msec * USEC_PER_MSEC;
+	return background_beep ? VBERROR_SUCCESS : VBERROR_NO_BACKGROUND_SOUND;
+}
+
+uint32_t VbExKeyboardRead(void)
+{
+	uint32_t key;
+
+	if (!mock_key || sim_now < mock_key_time)
+		return 0;
+
+	key = mock_key;
+	key_latency = sim_now - mock_key_time;
+	mock_key = 0;
+	return key;
+}
+
+uint32_t VbExKeyboardReadWithFlags(uint32_t *key_flags)
+{
+	if (key_flags)
+		*key_flags = 0;
+	return VbExKeyboardRead();
+}
+
+/* Behaves like firmware which halts until a keyboard or timer interrupt */
+uint32_t VbExKeyboardWait(uint32_t msec)
+{
+	uint64_t deadline = sim_now + msec * USEC_PER_MSEC;
+
+	wakeups++;
+	if (mock_key && mock_key_time <= deadline) {
+		if (sim_now < mock_key_time)
+			sim_now = mock_key_time;
+	} else {
+		sim_now = deadline;
+	}
+	return VbExKeyboardRead();
+}
+
+uint32_t VbExIsShutdownRequested(void)
+{
+	return 0;
+}
+
+uint32_t VbExGetSwitches(uint32_t request_mask)
+{
+	return 0;
+}
+
+uint32_t VbTryLoadKernel(VbCommonParams *cparams, LoadKernelParams *p,
+                         uint32_t get_info_flags)
+{
+	boot_time = sim_now;
+	return 1000 + get_info_flags;
+}
+
+VbError_t VbDisplayScreen(VbCommonParams *cparams, uint32_t screen, int force,
+                          VbNvContext *vncptr)
+{
+	return VBERROR_SUCCESS;
+}
+
+/* Tests */
+
+static uint32_t ElapsedMs(void)
+{
+	return (uint32_t)((boot_time - sim_start) / USEC_PER_MSEC);
+}
+
+static void ReportTiming(const char *name)
+{
+	uint32_t ms = ElapsedMs();
+
+	printf("  %s: %u ms, %u wakeups (%u/sec), key latency %u us\n",
+	       name, ms, wakeups, ms ? (uint32_t)(wakeups * 1000ULL / ms) : 0,
+	       (uint32_t)key_latency);
+}
+
+static void DevScreenTimingTest(void)
+{
+	printf("Testing VbBootDeveloper() timing...\n");
+
+	/* Full countdown; 10 calibration msecs come before "zero" */
+	ResetMocks();
+	TEST_EQ(VbBootDeveloper(&cparams, &lkp), 1002, "Timeout");
+	TEST_EQ(ElapsedMs(), 30010, "  on time");
+	TEST_TRUE(wakeups <= 30000 / 100 + 10, "  sleeps between wakeups");
+	ReportTiming("timeout");
+
+	/* Short delay */
+	ResetMocks();
+	gbb.flags |= GBB_FLAG_DEV_SCREEN_SHORT_DELAY;
+	TEST_EQ(VbBootDeveloper(&cparams, &lkp), 1002, "Short delay");
+	TEST_EQ(ElapsedMs(), 2010, "  on time");
+	TEST_TRUE(wakeups <= 2000 / 100 + 2, "  sleeps between wakeups");
+	ReportTiming("short delay");
+
+	/* Ctrl+D is seen as soon as it arrives */
+	ResetMocks();
+	mock_key = 0x04;
+	mock_key_time = sim_start + 5432 * USEC_PER_MSEC + 17;
+	TEST_EQ(VbBootDeveloper(&cparams, &lkp), 1002, "Ctrl+D");
+	TEST_EQ(boot_time, mock_key_time, "  no delay");
+	TEST_EQ(key_latency, 0, "  latency");
+	ReportTiming("ctrl+d");
+
+	/* Same without background sound; notes block in VbExBeep() */
+	ResetMocks();
+	background_beep = 0;
+	TEST_EQ(VbBootDeveloper(&cparams, &lkp), 1002, "Blocking beeps");
+	TEST_EQ(ElapsedMs(), 30010, "  on time");
+	TEST_TRUE(wakeups <= 30000 / 100 + 10, "  sleeps between wakeups");
+	ReportTiming("blocking beeps");
+
+	printf("...done.\n");
+}
+
+int main(void)
+{
+	DevScreenTimingTest();
+
+	if (vboot_api_stub_check_memory())
+		return 255;
+
+	return gTestSuccess ? 0 : 255;
+}
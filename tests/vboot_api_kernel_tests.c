@@ -61,7 +61,7 @@ test_case_t test[] = {
 			/* too small */
 			{512,   10,  VB_DISK_FLAG_REMOVABLE, 0},
 			/* wrong LBA */
-			{2048, 100,  VB_DISK_FLAG_REMOVABLE, 0},
+			{520,  100,  VB_DISK_FLAG_REMOVABLE, 0},
 			/* wrong type */
 			{512,  100,  VB_DISK_FLAG_FIXED, 0},
 			/* wrong flags */
@@ -102,6 +102,25 @@ test_case_t test[] = {
 		.expected_to_load_disk = pickme,
 		.expected_return_val = VBERROR_SUCCESS
 	},
+	{
+		.name = "4Kn removable drive",
+		.want_flags = VB_DISK_FLAG_REMOVABLE,
+		.disks_to_provide = {
+			/* not a power of 2 */
+			{4608, 100,  VB_DISK_FLAG_REMOVABLE, 0},
+			/* bigger than cgptlib handles */
+			{8192, 100,  VB_DISK_FLAG_REMOVABLE, 0},
+			{4096, 100,  VB_DISK_FLAG_REMOVABLE, pickme},
+		},
+		.disk_count_to_return = DEFAULT_COUNT,
+		.diskgetinfo_return_val = VBERROR_SUCCESS,
+		.loadkernel_return_val = {0, 1, 1, 1, 1, 1, 1, 1, 1, 1,},
+
+		.expected_recovery_request_val = VBNV_RECOVERY_NOT_REQUESTED,
+		.expected_to_find_disk = pickme,
+		.expected_to_load_disk = pickme,
+		.expected_return_val = VBERROR_SUCCESS
+	},
 	{
 		.name = "first fixed drive",
 		.want_flags = VB_DISK_FLAG_FIXED,
@@ -109,7 +128,7 @@ test_case_t test[] = {
 			/* too small */
 			{512,   10,  VB_DISK_FLAG_FIXED, 0},
 			/* wrong LBA */
-			{2048, 100,  VB_DISK_FLAG_FIXED, 0},
+			{256,  100,  VB_DISK_FLAG_FIXED, 0},
 			/* wrong type */
 			{512,  100,  VB_DISK_FLAG_REMOVABLE, 0},
 			/* wrong flags */
@@ -152,7 +171,7 @@ test_case_t test[] = {
 			/* too small */
 			{512,   10,  VB_DISK_FLAG_FIXED, 0},
 			/* wrong LBA */
-			{2048, 100,  VB_DISK_FLAG_FIXED, 0},
+			{256,  100,  VB_DISK_FLAG_FIXED, 0},
 			/* wrong type */
 			{512,  100,  VB_DISK_FLAG_REMOVABLE, 0},
 			/* wrong flags */
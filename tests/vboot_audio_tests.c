@@ -50,6 +50,7 @@ static uint8_t notebuf[sizeof(good_header) +
 static VbDevMusic *use_hdr;
 static VbDevMusicNote *use_notes;
 static uint32_t use_size;
+static uint64_t mock_timer;	/* usecs */
 
 /* Set correct checksum for custom notes */
 void FixChecksum(VbDevMusic *hdr) {
@@ -73,6 +74,7 @@ static void ResetMocks(void) {
   Memcpy(use_notes, good_notes, sizeof(good_notes));
   FixChecksum(use_hdr);
   use_size = sizeof(notebuf);
+  mock_timer = 1000000;
 }
 
 /* Compare two sets of notes */
@@ -103,6 +105,14 @@ uint32_t VbExMaxMusicSize(void) {
   return use_size;
 }
 
+uint64_t VbExGetTimer(void) {
+  return mock_timer;
+}
+
+void VbExSleepMs(uint32_t msec) {
+  mock_timer += msec * 1000ULL;
+}
+
 
 /****************************************************************************/
 
@@ -215,11 +225,40 @@ static void VbAudioTest(void) {
   VbAudioClose(a);
 }
 
+static void VbAudioNextEventTest(void) {
+  VbAudioContext* a = 0;
+
+  ResetMocks();
+  a = VbAudioOpen(&cparams);
+  TEST_EQ(VbAudioNextEventMs(a), 0, "NextEvent( first note due now )");
+  TEST_TRUE(VbAudioLooping(a), "  looping");
+  TEST_EQ(VbAudioNextEventMs(a), 100, "  until end of first note");
+  mock_timer += 40500;
+  TEST_EQ(VbAudioNextEventMs(a), 60, "  rounds up");
+  mock_timer += 60000;
+  TEST_EQ(VbAudioNextEventMs(a), 0, "  second note due");
+  TEST_TRUE(VbAudioLooping(a), "  looping");
+  TEST_EQ(VbAudioNextEventMs(a), 100, "  until end of second note");
+  VbAudioClose(a);
+
+  /* Past the end of the delay there is nothing left to wait for */
+  ResetMocks();
+  use_hdr = 0;
+  gbb.flags = 0x00000001;
+  a = VbAudioOpen(&cparams);
+  TEST_TRUE(VbAudioLooping(a), "NextEvent( short )");
+  TEST_EQ(VbAudioNextEventMs(a), 2000, "  whole delay");
+  mock_timer += 2000000;
+  TEST_EQ(VbAudioNextEventMs(a), 0, "  expired");
+  TEST_EQ(VbAudioLooping(a), 0, "  done looping");
+  VbAudioClose(a);
+}
 
 int main(int argc, char* argv[]) {
   int error_code = 0;
 
   VbAudioTest();
+  VbAudioNextEventTest();
 
   if (!gTestSuccess)
     error_code = 255;
@@ -128,7 +128,8 @@ static void VerifyKernelPreambleTest(const VbPublicKey *public_key,
 
 	rsa = PublicKeyToRSA(public_key);
 	hdr = CreateKernelPreamble(0x1234, 0x100000, 0x300000, 0x4000, body_sig,
-				   0, 0, 0, 0, private_key);
+				   0, 0, 0, 0, NULL, COMPRESS_NONE, 0, 0,
+				   private_key);
 	TEST_NEQ(hdr && rsa, 0, "VerifyKernelPreamble() prerequisites");
 	if (!hdr)
 		return;
@@ -209,6 +210,183 @@ static void VerifyKernelPreambleTest(const VbPublicKey *public_key,
 	free(hdr);
 }
 
+/*
+ * What firmware from before compressed bodies (preamble 2.3 and older)
+ * checks: the major version and the signature, and nothing else.
+ */
+static int OldFirmwareAcceptsPreamble(const VbKernelPreambleHeader *h,
+				      uint64_t size, const RSAPublicKey *rsa)
+{
+	return h->header_version_major == 2 &&
+		!VerifyKernelPreamble(h, size, rsa);
+}
+
+static void CompressedKernelPreambleTest(const VbPublicKey *public_key,
+					 const VbPrivateKey *private_key)
+{
+	VbKernelPreambleHeader *hdr, *zhdr, *h;
+	RSAPublicKey *rsa;
+	unsigned hsize, zsize;
+
+	VbSignature *body_sig = SignatureAlloc(56, 78);
+
+	rsa = PublicKeyToRSA(public_key);
+	hdr = CreateKernelPreamble(0x1234, 0x100000, 0x300000, 0x4000, body_sig,
+				   0, 0, 0, 0, NULL, COMPRESS_NONE, 0, 0,
+				   private_key);
+	zhdr = CreateKernelPreamble(0x1234, 0x100000, 0x300000, 0x4000,
+				    body_sig, 0, 0, 0, 0, NULL, COMPRESS_LZMA1,
+				    0x80000, 0, private_key);
+	TEST_NEQ(hdr && zhdr && rsa, 0,
+		 "Compressed preamble prerequisites");
+	if (!hdr || !zhdr)
+		return;
+	hsize = (unsigned) hdr->preamble_size;
+	zsize = (unsigned) zhdr->preamble_size;
+
+	TEST_EQ(hdr->header_version_major, 2, "Uncompressed preamble is 2.x");
+	TEST_EQ(zhdr->header_version_major, 3, "Compressed preamble is 3.x");
+	TEST_EQ(zhdr->header_version_minor, 4, "Compressed preamble minor");
+	TEST_EQ(VerifyKernelPreamble(zhdr, zsize, rsa), 0,
+		"VerifyKernelPreamble() compressed ok");
+
+	/* Old firmware must not boot a body it can't decompress */
+	TEST_EQ(OldFirmwareAcceptsPreamble(hdr, hsize, rsa), 1,
+		"Old firmware accepts uncompressed kernel");
+	TEST_EQ(OldFirmwareAcceptsPreamble(zhdr, zsize, rsa), 0,
+		"Old firmware rejects compressed kernel");
+
+	/* Major version 3 only means compressed */
+	h = (VbKernelPreambleHeader *)malloc(zsize);
+	Memcpy(h, zhdr, zsize);
+	h->body_compression = COMPRESS_NONE;
+	ReSignKernelPreamble(h, private_key);
+	TEST_NEQ(VerifyKernelPreamble(h, zsize, rsa), 0,
+		 "VerifyKernelPreamble() 3.x not compressed");
+
+	Memcpy(h, zhdr, zsize);
+	h->header_version_minor = 3;
+	ReSignKernelPreamble(h, private_key);
+	TEST_NEQ(VerifyKernelPreamble(h, zsize, rsa), 0,
+		 "VerifyKernelPreamble() 3.3");
+
+	free(h);
+	RSAPublicKeyFree(rsa);
+	free(zhdr);
+	free(hdr);
+	free(body_sig);
+}
+
+static void KernelChunkHashesTest(const VbPublicKey *public_key,
+				  const VbPrivateKey *private_key)
+{
+	const uint64_t body_size = 10000;
+	const uint32_t chunk_size = 4096;
+	int digest_size = hash_size_map[private_key->algorithm];
+	uint8_t *body = malloc(body_size);
+	VbSignature *body_sig, *table;
+	VbKernelPreambleHeader *hdr, *h;
+	RSAPublicKey *rsa;
+	const uint8_t *hashes;
+	uint32_t got_size;
+	unsigned hsize;
+	uint64_t i;
+
+	for (i = 0; i < body_size; i++)
+		body[i] = (uint8_t)(i * 7);
+
+	/* One digest per chunk, with a short chunk at the end */
+	table = CalculateChunkHashes(body, body_size, chunk_size,
+				     private_key->algorithm);
+	TEST_PTR_NEQ(table, NULL, "CalculateChunkHashes()");
+	if (!table)
+		return;
+	TEST_EQ(table->sig_size, 3 * digest_size, "  table size");
+	TEST_EQ(table->data_size, body_size, "  data size");
+	TEST_PTR_EQ(CalculateChunkHashes(body, body_size, 0,
+					 private_key->algorithm), NULL,
+		    "CalculateChunkHashes() no chunk size");
+
+	TEST_EQ(VerifyChunkHashes(body, body_size, chunk_size,
+				  private_key->algorithm,
+				  GetSignatureData(table)), 0,
+		"VerifyChunkHashes() ok");
+	body[body_size - 1] ^= 0x5a;
+	TEST_NEQ(VerifyChunkHashes(body, body_size, chunk_size,
+				   private_key->algorithm,
+				   GetSignatureData(table)), 0,
+		 "VerifyChunkHashes() last chunk changed");
+	body[body_size - 1] ^= 0x5a;
+
+	/* The table goes in the signed part of the preamble */
+	rsa = PublicKeyToRSA(public_key);
+	body_sig = CalculateSignature(body, body_size, private_key);
+	hdr = CreateKernelPreamble(0x1234, 0x100000, 0x300000, 0x4000, body_sig,
+				   0, 0, 0, chunk_size, table, COMPRESS_NONE, 0,
+				   0, private_key);
+	TEST_NEQ(hdr && rsa, 0, "Chunked preamble prerequisites");
+	if (!hdr)
+		return;
+	hsize = (unsigned) hdr->preamble_size;
+	h = (VbKernelPreambleHeader *)malloc(hsize);
+
+	TEST_EQ(VerifyKernelPreamble(hdr, hsize, rsa), 0,
+		"VerifyKernelPreamble() with chunks");
+	TEST_EQ(VbKernelGetChunkHashes(hdr, private_key->algorithm,
+				       &hashes, &got_size), VBOOT_SUCCESS,
+		"VbKernelGetChunkHashes() ok");
+	TEST_EQ(got_size, chunk_size, "  chunk size");
+	TEST_EQ(memcmp(hashes, GetSignatureData(table), table->sig_size), 0,
+		"  digests");
+
+	Memcpy(h, hdr, hsize);
+	GetSignatureData(&h->body_chunk_hashes)[0] ^= 0x34;
+	TEST_NEQ(VerifyKernelPreamble(h, hsize, rsa), 0,
+		 "VerifyKernelPreamble() chunk table changed");
+
+	Memcpy(h, hdr, hsize);
+	h->body_chunk_hashes.sig_offset = hsize;
+	ReSignKernelPreamble(h, private_key);
+	TEST_NEQ(VerifyKernelPreamble(h, hsize, rsa), 0,
+		 "VerifyKernelPreamble() chunk table off end");
+
+	/* Tables which don't fit the body are ignored */
+	Memcpy(h, hdr, hsize);
+	h->body_chunk_hashes.sig_size -= 1;
+	TEST_EQ(VbKernelGetChunkHashes(h, private_key->algorithm,
+				       &hashes, &got_size),
+		VBOOT_KERNEL_PREAMBLE_NO_CHUNKS,
+		"VbKernelGetChunkHashes() table too small");
+
+	Memcpy(h, hdr, hsize);
+	h->body_chunk_hashes.data_size--;
+	TEST_EQ(VbKernelGetChunkHashes(h, private_key->algorithm,
+				       &hashes, &got_size),
+		VBOOT_KERNEL_PREAMBLE_NO_CHUNKS,
+		"VbKernelGetChunkHashes() body size mismatch");
+
+	Memcpy(h, hdr, hsize);
+	h->header_version_minor = 2;
+	TEST_EQ(VbKernelGetChunkHashes(h, private_key->algorithm,
+				       &hashes, &got_size),
+		VBOOT_KERNEL_PREAMBLE_NO_CHUNKS,
+		"VbKernelGetChunkHashes() header 2.2");
+
+	Memcpy(h, hdr, hsize);
+	h->body_chunk_size = 0;
+	TEST_EQ(VbKernelGetChunkHashes(h, private_key->algorithm,
+				       &hashes, &got_size),
+		VBOOT_KERNEL_PREAMBLE_NO_CHUNKS,
+		"VbKernelGetChunkHashes() no table");
+
+	free(h);
+	free(hdr);
+	free(body_sig);
+	RSAPublicKeyFree(rsa);
+	free(table);
+	free(body);
+}
+
 int test_algorithm(int key_algorithm, const char *keys_dir)
 {
 	char filename[1024];
@@ -237,6 +415,8 @@ int test_algorithm(int key_algorithm, const char *keys_dir)
 	VerifyDataTest(public_key, private_key);
 	VerifyDigestTest(public_key, private_key);
 	VerifyKernelPreambleTest(public_key, private_key);
+	CompressedKernelPreambleTest(public_key, private_key);
+	KernelChunkHashesTest(public_key, private_key);
 
 	if (public_key)
 		free(public_key);
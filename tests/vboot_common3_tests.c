@@ -33,6 +33,7 @@ static void KeyBlockVerifyTest(const VbPublicKey *public_key,
 {
 	VbKeyBlockHeader *hdr;
 	VbKeyBlockHeader *h;
+	RSAPublicKey *rsa;
 	unsigned hsize;
 
 	hdr = KeyBlockCreate(data_key, private_key, 0x1234);
@@ -120,6 +121,17 @@ static void KeyBlockVerifyTest(const VbPublicKey *public_key,
 	TEST_NEQ(KeyBlockVerify(h, hsize, public_key, 0), 0,
 		 "KeyBlockVerify() sig mismatch");
 
+	/* Same checks with a pre-unpacked key */
+	rsa = PublicKeyToRSA(public_key);
+	TEST_PTR_NEQ(rsa, NULL, "KeyBlockVerifyRSA() prerequisites");
+	TEST_EQ(KeyBlockVerifyRSA(hdr, hsize, rsa), 0,
+		"KeyBlockVerifyRSA() ok");
+	TEST_NEQ(KeyBlockVerifyRSA(hdr, hsize, NULL), 0,
+		 "KeyBlockVerifyRSA() missing key");
+	TEST_NEQ(KeyBlockVerifyRSA(h, hsize, rsa), 0,
+		 "KeyBlockVerifyRSA() sig mismatch");
+	RSAPublicKeyFree(rsa);
+
 	Memcpy(h, hdr, hsize);
 	h->key_block_checksum.data_size = h->key_block_size + 1;
 	TEST_NEQ(KeyBlockVerify(h, hsize, public_key, 1), 0,
@@ -11,6 +11,7 @@
 
 #include "test_common.h"
 #include "utility.h"
+#include "vboot_api.h"
 #include "vboot_common.h"
 
 /*
@@ -31,7 +32,7 @@ static void StructPackingTest(void)
 	TEST_EQ(EXPECTED_VBFIRMWAREPREAMBLEHEADER2_1_SIZE,
 		sizeof(VbFirmwarePreambleHeader),
 		"sizeof(VbFirmwarePreambleHeader)");
-	TEST_EQ(EXPECTED_VBKERNELPREAMBLEHEADER2_2_SIZE,
+	TEST_EQ(EXPECTED_VBKERNELPREAMBLEHEADER2_4_SIZE,
 		sizeof(VbKernelPreambleHeader),
 		"sizeof(VbKernelPreambleHeader)");
 
@@ -40,8 +41,12 @@ static void StructPackingTest(void)
 		"sizeof(VbSharedDataHeader) V1");
 
 	TEST_EQ(VB_SHARED_DATA_HEADER_SIZE_V2,
-		sizeof(VbSharedDataHeader),
+		(long)&((VbSharedDataHeader*)NULL)->tpm_rollback_writes,
 		"sizeof(VbSharedDataHeader) V2");
+
+	TEST_EQ(VB_SHARED_DATA_HEADER_SIZE_V3,
+		sizeof(VbSharedDataHeader),
+		"sizeof(VbSharedDataHeader) V3");
 }
 
 /* Test array size macro */
@@ -143,6 +148,39 @@ static void VerifyHelperFunctions(void)
 		TEST_EQ(VerifySignatureInside(&s, 99, &s), 1,
 			"SignatureInside offset too big");
 	}
+
+	{
+		VbKernelPreambleHeader h;
+		uint32_t compression;
+		uint64_t size;
+
+		Memset(&h, 0, sizeof(h));
+		h.header_version_major = 2;
+		h.header_version_minor = 4;
+		h.body_signature.data_size = 1000;
+		h.body_compression = COMPRESS_LZMA1;
+		h.body_uncompressed_size = 3000;
+		TEST_EQ(VbKernelGetCompression(&h, &compression, &size),
+			VBOOT_SUCCESS, "KernelGetCompression() 2.4");
+		TEST_EQ(compression, COMPRESS_NONE, "  not compressed");
+		TEST_EQ(size, 1000, "  body size");
+
+		h.header_version_major = 3;
+		TEST_EQ(VbKernelGetCompression(&h, &compression, &size),
+			VBOOT_SUCCESS, "KernelGetCompression() 3.4");
+		TEST_EQ(compression, COMPRESS_LZMA1, "  compressed");
+		TEST_EQ(size, 3000, "  uncompressed size");
+
+		h.body_compression = MAX_COMPRESS;
+		TEST_EQ(VbKernelGetCompression(&h, &compression, &size),
+			VBOOT_KERNEL_PREAMBLE_BAD_COMPRESSION,
+			"KernelGetCompression() unknown");
+
+		h.body_compression = COMPRESS_NONE;
+		TEST_EQ(VbKernelGetCompression(&h, &compression, &size),
+			VBOOT_KERNEL_PREAMBLE_BAD_COMPRESSION,
+			"KernelGetCompression() 3.4 not compressed");
+	}
 }
 
 /* Public key utility functions */
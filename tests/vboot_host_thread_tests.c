@@ -0,0 +1,185 @@
+/* Copyright 2015 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Tests for calling libvboot_host from several threads at once.  Build with
+ * TSAN=1 to have ThreadSanitizer check for races as well.
+ *
+ * The drive images go in a new directory under the one given on the command
+ * line (or /tmp), never in the current directory.
+ */
+
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <uuid/uuid.h>
+
+#include "test_common.h"
+#include "vboot_api.h"
+#include "vboot_host.h"
+
+#define NUM_THREADS 8
+#define NUM_LOOPS 20
+#define DRIVE_SIZE (1024 * 1024)
+#define NUM_ALLOCS 16
+
+int vboot_api_stub_check_memory(void);
+
+struct thread_data {
+	pthread_t thread;
+	char drive[PATH_MAX];
+	int failures;
+};
+
+static const Guid kernel_type = GPT_ENT_TYPE_CHROMEOS_KERNEL;
+
+/* Programs using the library supply this, as cgpt does */
+int GenerateGuid(Guid *newguid)
+{
+	uuid_generate(newguid->u.raw);
+	return CGPT_OK;
+}
+
+static void find_show(struct CgptFindParams *params, char *filename,
+		      int partnum, GptEntry *entry)
+{
+	/* Only interested in the hit count */
+}
+
+/* Each thread gets its own drive; returns the number of things that broke. */
+static int one_loop(struct thread_data *td, int loop)
+{
+	CgptCreateParams create;
+	CgptAddParams add;
+	CgptShowParams show;
+	CgptPrioritizeParams prio;
+	CgptFindParams find;
+	char label[16], guidstr[GUID_STRLEN];
+	Guid guid;
+	void *p[NUM_ALLOCS];
+	int failures = 0;
+	int i;
+
+	memset(&create, 0, sizeof(create));
+	create.drive_name = td->drive;
+	if (CgptCreate(&create))
+		return 1;
+
+	/* Two kernels with labels that differ per loop */
+	for (i = 1; i <= 2; i++) {
+		memset(&add, 0, sizeof(add));
+		add.drive_name = td->drive;
+		add.partition = i;
+		add.begin = 64 + (i - 1) * 256;
+		add.size = 256;
+		add.type_guid = kernel_type;
+		snprintf(label, sizeof(label), "KERN-%c-%d", 'A' + i - 1, loop);
+		add.label = label;
+		add.priority = i;
+		add.set_begin = add.set_size = add.set_type = 1;
+		add.set_priority = 1;
+		if (CgptAdd(&add))
+			failures++;
+	}
+
+	memset(&show, 0, sizeof(show));
+	show.drive_name = td->drive;
+	if (CgptGetNumNonEmptyPartitions(&show) || show.num_partitions != 2)
+		failures++;
+
+	memset(&prio, 0, sizeof(prio));
+	prio.drive_name = td->drive;
+	prio.set_partition = 1;
+	if (CgptPrioritize(&prio))
+		failures++;
+
+	memset(&add, 0, sizeof(add));
+	add.drive_name = td->drive;
+	add.partition = 1;
+	if (CgptGetPartitionDetails(&add) || add.priority <= 1 ||
+	    add.begin != 64 || add.size != 256)
+		failures++;
+
+	memset(&find, 0, sizeof(find));
+	find.drive_name = td->drive;
+	snprintf(label, sizeof(label), "KERN-B-%d", loop);
+	find.label = label;
+	find.set_label = 1;
+	find.show_fn = find_show;
+	CgptFind(&find);
+	if (find.hits != 1 || find.match_partnum != 2)
+		failures++;
+
+	GuidToStr(&kernel_type, guidstr, sizeof(guidstr));
+	if (StrToGuid(guidstr, &guid) || memcmp(&guid, &kernel_type,
+						sizeof(guid)))
+		failures++;
+
+	for (i = 0; i < NUM_ALLOCS; i++) {
+		p[i] = VbExMalloc(32 + i * 16);
+		memset(p[i], i, 32 + i * 16);
+	}
+	for (i = 0; i < NUM_ALLOCS; i++)
+		VbExFree(p[i]);
+
+	return failures;
+}
+
+static void *thread_main(void *arg)
+{
+	struct thread_data *td = arg;
+	int i;
+
+	for (i = 0; i < NUM_LOOPS; i++)
+		td->failures += one_loop(td, i);
+	return NULL;
+}
+
+static void thread_tests(const char *base_dir)
+{
+	struct thread_data td[NUM_THREADS];
+	char dir[PATH_MAX - 16];	/* Leaves room for the drive names */
+	int started = 0, failures = 0;
+	int fd, i;
+
+	snprintf(dir, sizeof(dir), "%s/vboot_host_thread_tests.XXXXXX",
+		 base_dir);
+	if (!TEST_PTR_NEQ(mkdtemp(dir), NULL, "Create drive directory"))
+		return;
+
+	for (i = 0; i < NUM_THREADS; i++) {
+		memset(&td[i], 0, sizeof(td[i]));
+		snprintf(td[i].drive, sizeof(td[i].drive), "%s/%d.dat", dir, i);
+		fd = open(td[i].drive, O_RDWR | O_CREAT | O_TRUNC, 0666);
+		TEST_NEQ(fd, -1, "Create drive");
+		TEST_EQ(ftruncate(fd, DRIVE_SIZE), 0, "  set size");
+		close(fd);
+	}
+
+	for (i = 0; i < NUM_THREADS; i++)
+		if (!pthread_create(&td[i].thread, NULL, thread_main, &td[i]))
+			started++;
+	TEST_EQ(started, NUM_THREADS, "Start threads");
+
+	for (i = 0; i < started; i++) {
+		pthread_join(td[i].thread, NULL);
+		failures += td[i].failures;
+	}
+	TEST_EQ(failures, 0, "No failures in any thread");
+	TEST_EQ(vboot_api_stub_check_memory(), 0, "No leaked memory");
+
+	for (i = 0; i < NUM_THREADS; i++)
+		unlink(td[i].drive);
+	rmdir(dir);
+}
+
+int main(int argc, char *argv[])
+{
+	thread_tests(argc > 1 ? argv[1] : "/tmp");
+
+	return gTestSuccess ? 0 : 255;
+}
@@ -5,6 +5,7 @@
  * Tests for vboot_kernel.c
  */
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -48,8 +49,15 @@ static int gpt_init_fail;
 static int key_block_verify_fail;  /* 0=ok, 1=sig, 2=hash */
 static int preamble_verify_fail;
 static int verify_data_fail;
+static int decompress_fail;
+static uint32_t decompress_in_size;
+static int prefetch_calls;
+static uint32_t prefetch_bytes;
+static int prefetch_fail;
+static RSAPublicKey mock_rsa_key;
 static RSAPublicKey *mock_data_key;
 static int mock_data_key_allocated;
+static int mock_data_key_unpacked;
 static int gpt_flag_external;
 
 static uint8_t gbb_data[sizeof(GoogleBinaryBlockHeader) + 2048];
@@ -61,6 +69,7 @@ static VbSharedDataHeader *shared = (VbSharedDataHeader *)shared_data;
 static LoadKernelParams lkp;
 static VbKeyBlockHeader kbh;
 static VbKernelPreambleHeader kph;
+static uint8_t mock_chunk_hashes[2 * SHA256_DIGEST_SIZE];
 static VbCommonParams cparams;
 static uint8_t mock_disk[MOCK_SECTOR_SIZE * MOCK_SECTOR_COUNT];
 static GptHeader *mock_gpt_primary =
@@ -74,6 +83,8 @@ static GptHeader *mock_gpt_secondary =
  */
 static void SetupGptHeader(GptHeader *h, int is_secondary)
 {
+	size_t entries_sectors;
+
 	Memset(h, '\0', MOCK_SECTOR_SIZE);
 
 	/* "EFI PART" */
@@ -84,18 +95,19 @@ static void SetupGptHeader(GptHeader *h, int is_secondary)
 	/* 16KB: 128 entries of 128 bytes */
 	h->size_of_entry = sizeof(GptEntry);
 	h->number_of_entries = MAX_NUMBER_OF_ENTRIES;
+	entries_sectors = CalculateEntriesSectors(h, MOCK_SECTOR_SIZE);
 
 	/* Set LBA pointers for primary or secondary header */
 	if (is_secondary) {
 		h->my_lba = MOCK_SECTOR_COUNT - GPT_HEADER_SECTORS;
-		h->entries_lba = h->my_lba - CalculateEntriesSectors(h);
+		h->entries_lba = h->my_lba - entries_sectors;
 	} else {
 		h->my_lba = GPT_PMBR_SECTORS;
 		h->entries_lba = h->my_lba + 1;
 	}
 
-	h->first_usable_lba = 2 + CalculateEntriesSectors(h);
-	h->last_usable_lba = MOCK_SECTOR_COUNT - 2 - CalculateEntriesSectors(h);
+	h->first_usable_lba = 2 + entries_sectors;
+	h->last_usable_lba = MOCK_SECTOR_COUNT - 2 - entries_sectors;
 
 	h->header_crc32 = HeaderCrc(h);
 }
@@ -123,9 +135,18 @@ static void ResetMocks(void)
 	key_block_verify_fail = 0;
 	preamble_verify_fail = 0;
 	verify_data_fail = 0;
+	decompress_fail = 0;
+	decompress_in_size = 0;
+
+	prefetch_calls = 0;
+	prefetch_bytes = 0;
+	prefetch_fail = 0;
 
-	mock_data_key = (RSAPublicKey *)"TestDataKey";
+	Memset(&mock_rsa_key, 0, sizeof(mock_rsa_key));
+	mock_rsa_key.algorithm = 4;  /* RSA2048 SHA256 */
+	mock_data_key = &mock_rsa_key;
 	mock_data_key_allocated = 0;
+	mock_data_key_unpacked = 0;
 
 	gpt_flag_external = 0;
 
@@ -182,6 +203,8 @@ static void ResetMocks(void)
 VbError_t VbExDiskRead(VbExDiskHandle_t handle, uint64_t lba_start,
                        uint64_t lba_count, void *buffer)
 {
+	int i;
+
 	LOGCALL("VbExDiskRead(h, %d, %d)\n", (int)lba_start, (int)lba_count);
 
 	if ((int)lba_start == disk_read_to_fail)
@@ -190,6 +213,28 @@ VbError_t VbExDiskRead(VbExDiskHandle_t handle, uint64_t lba_start,
 	memcpy(buffer, &mock_disk[lba_start * MOCK_SECTOR_SIZE],
 	       lba_count * MOCK_SECTOR_SIZE);
 
+	/*
+	 * LoadKernel() reads the key block and preamble sizes before verifying
+	 * them, so put the mock headers at the start of each partition.
+	 */
+	for (i = 0; i < MOCK_PART_COUNT && mock_parts[i].size; i++) {
+		uint64_t bytes = lba_count * MOCK_SECTOR_SIZE;
+
+		if (lba_start != mock_parts[i].start)
+			continue;
+		if (bytes >= sizeof(kbh))
+			memcpy(buffer, &kbh, sizeof(kbh));
+		if (bytes >= kbh.key_block_size + sizeof(kph))
+			memcpy((uint8_t *)buffer + kbh.key_block_size, &kph,
+			       sizeof(kph));
+		/* Body chunk digests follow the preamble header */
+		if (bytes >= kbh.key_block_size + sizeof(kph) +
+		    sizeof(mock_chunk_hashes))
+			memcpy((uint8_t *)buffer + kbh.key_block_size +
+			       sizeof(kph), mock_chunk_hashes,
+			       sizeof(mock_chunk_hashes));
+	}
+
 	return VBERROR_SUCCESS;
 }
 
@@ -207,6 +252,17 @@ VbError_t VbExDiskWrite(VbExDiskHandle_t handle, uint64_t lba_start,
 	return VBERROR_SUCCESS;
 }
 
+VbError_t VbExStreamPrefetch(VbExStream_t stream, uint32_t bytes)
+{
+	prefetch_calls++;
+	prefetch_bytes = bytes;
+
+	if (prefetch_fail)
+		return VBERROR_SIMULATED;
+
+	return VBERROR_SUCCESS;
+}
+
 int GptInit(GptData *gpt)
 {
 	return gpt_init_fail;
@@ -249,9 +305,20 @@ int KeyBlockVerify(const VbKeyBlockHeader *block, uint64_t size,
 	return VBERROR_SUCCESS;
 }
 
+int KeyBlockVerifyRSA(const VbKeyBlockHeader *block, uint64_t size,
+		      const RSAPublicKey *key) {
+
+	if (key_block_verify_fail >= 1)
+		return VBERROR_SIMULATED;
+
+	/* Use this as an opportunity to override the key block */
+	memcpy((void *)block, &kbh, sizeof(kbh));
+	return VBERROR_SUCCESS;
+}
+
 RSAPublicKey *PublicKeyToRSA(const VbPublicKey *key)
 {
-	TEST_EQ(mock_data_key_allocated, 0, "  mock data key not allocated");
+	mock_data_key_unpacked++;
 
 	if (mock_data_key)
 		mock_data_key_allocated++;
@@ -261,7 +328,7 @@ RSAPublicKey *PublicKeyToRSA(const VbPublicKey *key)
 
 void RSAPublicKeyFree(RSAPublicKey* key)
 {
-	TEST_EQ(mock_data_key_allocated, 1, "  mock data key allocated");
+	TEST_NEQ(mock_data_key_allocated, 0, "  mock data key allocated");
 	TEST_PTR_EQ(key, mock_data_key, "  data key ptr");
 	mock_data_key_allocated--;
 }
@@ -286,6 +353,73 @@ int VerifyData(const uint8_t *data, uint64_t size, const VbSignature *sig,
 	return VBERROR_SUCCESS;
 }
 
+int VerifyDigest(const uint8_t *digest, const VbSignature *sig,
+		 const RSAPublicKey *key)
+{
+	uint8_t *expect;
+	int rv;
+
+	if (verify_data_fail)
+		return VBERROR_SIMULATED;
+
+	/* Body must have been hashed in full, straight from the buffer */
+	expect = DigestBuf(kernel_buffer, sig->data_size, key->algorithm);
+	rv = memcmp(digest, expect, SHA256_DIGEST_SIZE) ? VBERROR_SIMULATED :
+		VBERROR_SUCCESS;
+	VbExFree(expect);
+	return rv;
+}
+
+VbError_t VbExDecompress(void *inbuf, uint32_t in_size,
+			 uint32_t compression_type,
+			 void *outbuf, uint32_t *out_size)
+{
+	LOGCALL("VbExDecompress(%d, %d)\n", (int)in_size,
+		(int)compression_type);
+
+	/* The body must not have been read straight into the kernel buffer */
+	TEST_PTR_NEQ(inbuf, kernel_buffer, "  compressed body buffer");
+	TEST_PTR_EQ(outbuf, kernel_buffer, "  decompress to kernel buffer");
+	decompress_in_size = in_size;
+	if (decompress_fail)
+		return VBERROR_SIMULATED;
+
+	/* Output is the size the preamble promised, unless told otherwise */
+	*out_size = kph.body_uncompressed_size + (decompress_fail < 0);
+	return VBERROR_SUCCESS;
+}
+
+/**
+ * Give the mock preamble a table of body chunk digests, matching the body on
+ * the mock disk.
+ */
+static void SetupChunkHashes(uint32_t chunk_size)
+{
+	const uint8_t *body = &mock_disk[(mock_parts[0].start + 8) *
+					 MOCK_SECTOR_SIZE];
+	uint32_t body_size = kph.body_signature.data_size;
+	uint32_t offset, n;
+	uint8_t *digest;
+	int i = 0;
+
+	memset(mock_chunk_hashes, 0, sizeof(mock_chunk_hashes));
+	for (offset = 0; offset < body_size; offset += n, i++) {
+		n = body_size - offset < chunk_size ? body_size - offset :
+			chunk_size;
+		digest = DigestBuf(body + offset, n, mock_rsa_key.algorithm);
+		memcpy(mock_chunk_hashes + i * SHA256_DIGEST_SIZE, digest,
+		       SHA256_DIGEST_SIZE);
+		VbExFree(digest);
+	}
+
+	kbh.data_key.algorithm = mock_rsa_key.algorithm;
+	kph.header_version_minor = 3;
+	kph.body_chunk_size = chunk_size;
+	kph.body_chunk_hashes.sig_offset = sizeof(kph) -
+		offsetof(VbKernelPreambleHeader, body_chunk_hashes);
+	kph.body_chunk_hashes.sig_size = i * SHA256_DIGEST_SIZE;
+	kph.body_chunk_hashes.data_size = body_size;
+}
 
 /**
  * Test reading/writing GPT
@@ -323,10 +457,10 @@ static void ReadWriteGptTest(void)
 	TEST_EQ(AllocAndReadGptData(handle, &g), 0,
 		"AllocAndRead primary invalid");
 	TEST_EQ(CheckHeader(mock_gpt_primary, 0, g.streaming_drive_sectors,
-                g.gpt_drive_sectors, 0),
+                g.gpt_drive_sectors, 0, g.sector_bytes),
                 1, "Primary header is invalid");
 	TEST_EQ(CheckHeader(mock_gpt_secondary, 1, g.streaming_drive_sectors,
-		g.gpt_drive_sectors, 0),
+		g.gpt_drive_sectors, 0, g.sector_bytes),
                 0, "Secondary header is valid");
 	TEST_CALLS("VbExDiskRead(h, 1, 1)\n"
 		   "VbExDiskRead(h, 1023, 1)\n"
@@ -342,10 +476,10 @@ static void ReadWriteGptTest(void)
 	TEST_EQ(AllocAndReadGptData(handle, &g), 0,
 		"AllocAndRead secondary invalid");
 	TEST_EQ(CheckHeader(mock_gpt_primary, 0, g.streaming_drive_sectors,
-		g.gpt_drive_sectors, 0),
+		g.gpt_drive_sectors, 0, g.sector_bytes),
                 0, "Primary header is valid");
 	TEST_EQ(CheckHeader(mock_gpt_secondary, 1, g.streaming_drive_sectors,
-		g.gpt_drive_sectors, 0),
+		g.gpt_drive_sectors, 0, g.sector_bytes),
                 1, "Secondary header is invalid");
 	TEST_CALLS("VbExDiskRead(h, 1, 1)\n"
 		   "VbExDiskRead(h, 2, 32)\n"
@@ -362,10 +496,10 @@ static void ReadWriteGptTest(void)
 	TEST_EQ(AllocAndReadGptData(handle, &g), 1,
 		"AllocAndRead primary and secondary invalid");
 	TEST_EQ(CheckHeader(mock_gpt_primary, 0, g.streaming_drive_sectors,
-		g.gpt_drive_sectors, 0),
+		g.gpt_drive_sectors, 0, g.sector_bytes),
                 1, "Primary header is invalid");
 	TEST_EQ(CheckHeader(mock_gpt_secondary, 1, g.streaming_drive_sectors,
-		g.gpt_drive_sectors, 0),
+		g.gpt_drive_sectors, 0, g.sector_bytes),
                 1, "Secondary header is invalid");
 	TEST_CALLS("VbExDiskRead(h, 1, 1)\n"
 		   "VbExDiskRead(h, 1023, 1)\n");
@@ -393,7 +527,7 @@ static void ReadWriteGptTest(void)
 		   "VbExDiskWrite(h, 1, 1)\n"
 		   "VbExDiskWrite(h, 2, 32)\n");
 	TEST_EQ(CheckHeader(mock_gpt_primary, 0, g.streaming_drive_sectors,
-		g.gpt_drive_sectors, 0),
+		g.gpt_drive_sectors, 0, g.sector_bytes),
                 0, "Fix Primary GPT: Primary header is valid");
 
 	/*
@@ -418,7 +552,7 @@ static void ReadWriteGptTest(void)
 		   "VbExDiskWrite(h, 1023, 1)\n"
 		   "VbExDiskWrite(h, 991, 32)\n");
 	TEST_EQ(CheckHeader(mock_gpt_secondary, 1, g.streaming_drive_sectors,
-		g.gpt_drive_sectors, 0),
+		g.gpt_drive_sectors, 0, g.sector_bytes),
                 0, "Fix Secondary GPT: Secondary header is valid");
 
 	/* Data which is changed is written */
@@ -682,6 +816,9 @@ static void LoadKernelTest(void)
 	TEST_EQ(LoadKernel(&lkp, &cparams), 0, "Two kernels roll forward");
 	TEST_EQ(mock_part_next, 2, "  read both");
 	TEST_EQ(shared->kernel_version_tpm, 0x30001, "  shared version");
+	/* Subkey and the shared data key are each unpacked only once */
+	TEST_EQ(mock_data_key_unpacked, 2, "  keys unpacked once");
+	TEST_EQ(mock_data_key_allocated, 0, "  keys freed");
 
 	ResetMocks();
 	kbh.data_key.key_version = 1;
@@ -698,6 +835,15 @@ static void LoadKernelTest(void)
 	TEST_EQ(LoadKernel(&lkp, &cparams), VBERROR_INVALID_KERNEL_FOUND,
 		"Bad data key");
 
+	ResetMocks();
+	verify_data_fail = 1;
+	mock_parts[1].start = 300;
+	mock_parts[1].size = 150;
+	TEST_EQ(LoadKernel(&lkp, &cparams), VBERROR_INVALID_KERNEL_FOUND,
+		"Two bad kernels");
+	TEST_EQ(mock_data_key_unpacked, 2, "  keys unpacked once");
+	TEST_EQ(mock_data_key_allocated, 0, "  keys freed");
+
 	ResetMocks();
 	preamble_verify_fail = 1;
 	TEST_EQ(LoadKernel(&lkp, &cparams), VBERROR_INVALID_KERNEL_FOUND,
@@ -725,9 +871,75 @@ static void LoadKernelTest(void)
 
 	ResetMocks();
 	kph.preamble_size += 65536;
+	TEST_EQ(LoadKernel(&lkp, &cparams), VBERROR_INVALID_KERNEL_FOUND,
+		"Kernel body offset past end of partition");
+
+	ResetMocks();
+	kph.preamble_size += 0x10000000;
+	mock_parts[0].size = 800;
 	TEST_EQ(LoadKernel(&lkp, &cparams), VBERROR_INVALID_KERNEL_FOUND,
 		"Kernel body offset huge");
 
+	/* Vblocks bigger than 64 KB are fine as long as they fit */
+	ResetMocks();
+	kph.preamble_size += 65536;
+	mock_parts[0].size = 300;
+	TEST_EQ(LoadKernel(&lkp, &cparams), 0, "Kernel body offset > 64 KB");
+
+	/* Small vblocks are read with a single header read */
+	ResetMocks();
+	ResetCallLog();
+	kph.body_signature.data_size = 8192;
+	TEST_EQ(LoadKernel(&lkp, &cparams), 0, "Small vblock");
+	TEST_TRUE(strstr(call_log, "VbExDiskRead(h, 100, 8)\n"
+			 "VbExDiskRead(h, 108, 16)\n") != NULL,
+		  "  read header then body");
+
+	/* Big bodies are read and hashed in chunks */
+	ResetMocks();
+	ResetCallLog();
+	TEST_EQ(LoadKernel(&lkp, &cparams), 0, "Chunked body");
+	TEST_TRUE(strstr(call_log, "VbExDiskRead(h, 100, 8)\n"
+			 "VbExDiskRead(h, 108, 128)\n"
+			 "VbExDiskRead(h, 236, 9)\n") != NULL,
+		  "  read header then body chunks");
+
+	/* The rest of the body is prefetched while the headers are checked */
+	ResetMocks();
+	TEST_EQ(LoadKernel(&lkp, &cparams), 0, "Prefetch body");
+	TEST_EQ(prefetch_calls, 1, "  prefetched once");
+	TEST_EQ(prefetch_bytes, 70144, "  body after vblock");
+
+	ResetMocks();
+	mock_parts[0].size = 130;
+	LoadKernel(&lkp, &cparams);
+	TEST_EQ(prefetch_bytes, 130 * 512 - 4096,
+		"Prefetch clamped to partition");
+
+	ResetMocks();
+	kph.body_signature.data_size = 0xffffffff;
+	LoadKernel(&lkp, &cparams);
+	TEST_EQ(prefetch_bytes, 150 * 512 - 4096,
+		"Prefetch of huge body clamped to partition");
+
+	ResetMocks();
+	kph.preamble_size = 0xfffff000;
+	LoadKernel(&lkp, &cparams);
+	TEST_EQ(prefetch_bytes, 150 * 512 - 4096,
+		"Prefetch of huge preamble clamped to partition");
+
+	ResetMocks();
+	prefetch_fail = 1;
+	TEST_EQ(LoadKernel(&lkp, &cparams), 0, "Prefetch failure ignored");
+	TEST_EQ(prefetch_calls, 1, "  prefetched");
+
+	ResetMocks();
+	mock_parts[1].start = 300;
+	mock_parts[1].size = 150;
+	key_block_verify_fail = 1;
+	LoadKernel(&lkp, &cparams);
+	TEST_EQ(prefetch_calls, 2, "Prefetch each candidate partition");
+
 	/* Check getting kernel load address from header */
 	ResetMocks();
 	kph.body_load_address = (size_t)kernel_buffer;
@@ -746,13 +958,15 @@ static void LoadKernelTest(void)
 	mock_parts[0].size = 130;
 	TEST_EQ(LoadKernel(&lkp, &cparams), VBERROR_INVALID_KERNEL_FOUND,
 		"Kernel too big for partition");
+	TEST_EQ(shared->lk_calls[0].parts[0].check_result,
+		VBSD_LKP_CHECK_BODY_EXCEEDS_PART, "  check result");
 
 	ResetMocks();
 	kph.body_signature.data_size = 8192;
 	TEST_EQ(LoadKernel(&lkp, &cparams), 0, "Kernel tiny");
 
 	ResetMocks();
-	disk_read_to_fail = 228;
+	disk_read_to_fail = 108;
 	TEST_EQ(LoadKernel(&lkp, &cparams), VBERROR_INVALID_KERNEL_FOUND,
 		"Fail reading kernel data");
 
@@ -760,6 +974,132 @@ static void LoadKernelTest(void)
 	verify_data_fail = 1;
 	TEST_EQ(LoadKernel(&lkp, &cparams), VBERROR_INVALID_KERNEL_FOUND,	"Bad data");
 
+	/* Bodies with chunk digests are checked a chunk at a time */
+	ResetMocks();
+	SetupChunkHashes(65536);
+	verify_data_fail = 1;
+	TEST_EQ(LoadKernel(&lkp, &cparams), 0, "Body chunks");
+
+	ResetMocks();
+	mock_disk[108 * MOCK_SECTOR_SIZE + 70000] = 0x12;
+	SetupChunkHashes(65536);
+	mock_disk[108 * MOCK_SECTOR_SIZE + 70000] = 0x34;
+	TEST_EQ(LoadKernel(&lkp, &cparams), VBERROR_INVALID_KERNEL_FOUND,
+		"Bad body chunk");
+	TEST_EQ(shared->lk_calls[0].parts[0].check_result,
+		VBSD_LKP_CHECK_VERIFY_DATA, "  check result");
+
+	ResetMocks();
+	SetupChunkHashes(65536);
+	kph.body_chunk_size += 100;
+	verify_data_fail = 1;
+	TEST_EQ(LoadKernel(&lkp, &cparams), VBERROR_INVALID_KERNEL_FOUND,
+		"Partial-sector chunks use the body signature");
+
+	/* Compressed bodies are verified, then decompressed */
+	ResetMocks();
+	ResetCallLog();
+	kph.header_version_major = 3;
+	kph.header_version_minor = 4;
+	kph.body_compression = COMPRESS_LZMA1;
+	kph.body_uncompressed_size = 75000;
+	TEST_EQ(LoadKernel(&lkp, &cparams), 0, "Compressed body");
+	TEST_EQ(decompress_in_size, 70144, "  compressed size");
+	TEST_TRUE(strstr(call_log, "VbExDecompress(70144, 2)\n") != NULL,
+		  "  decompressed");
+
+	ResetMocks();
+	kph.header_version_major = 3;
+	kph.header_version_minor = 4;
+	kph.body_compression = COMPRESS_LZMA1;
+	kph.body_uncompressed_size = 75000;
+	kph.body_load_address = (size_t)kernel_buffer;
+	lkp.kernel_buffer = NULL;
+	TEST_EQ(LoadKernel(&lkp, &cparams), 0,
+		"Compressed body load address from preamble");
+	TEST_EQ(lkp.kernel_buffer_size, 75000, "  uncompressed size");
+
+	ResetMocks();
+	kph.header_version_major = 3;
+	kph.header_version_minor = 4;
+	kph.body_compression = COMPRESS_LZMA1;
+	kph.body_uncompressed_size = sizeof(kernel_buffer) + 1;
+	TEST_EQ(LoadKernel(&lkp, &cparams), VBERROR_INVALID_KERNEL_FOUND,
+		"Decompressed kernel too big for buffer");
+	TEST_EQ(decompress_in_size, 0, "  not read");
+
+	/* Compressed body sizes are checked before allocating a buffer */
+	ResetMocks();
+	kph.header_version_major = 3;
+	kph.header_version_minor = 4;
+	kph.body_compression = COMPRESS_LZMA1;
+	kph.body_uncompressed_size = 75000;
+	kph.body_signature.data_size = 0xfffff000;
+	TEST_EQ(LoadKernel(&lkp, &cparams), VBERROR_INVALID_KERNEL_FOUND,
+		"Compressed body bigger than partition");
+	TEST_EQ(shared->lk_calls[0].parts[0].check_result,
+		VBSD_LKP_CHECK_BODY_EXCEEDS_PART, "  check result");
+	TEST_EQ(decompress_in_size, 0, "  not read");
+
+	ResetMocks();
+	kph.header_version_major = 3;
+	kph.header_version_minor = 4;
+	kph.body_compression = COMPRESS_LZMA1;
+	kph.body_uncompressed_size = 65536;
+	lkp.kernel_buffer_size = 65536;
+	TEST_EQ(LoadKernel(&lkp, &cparams), VBERROR_INVALID_KERNEL_FOUND,
+		"Compressed body bigger than kernel buffer");
+	TEST_EQ(shared->lk_calls[0].parts[0].check_result,
+		VBSD_LKP_CHECK_BODY_EXCEEDS_MEM, "  check result");
+	TEST_EQ(decompress_in_size, 0, "  not read");
+
+	ResetMocks();
+	kph.header_version_major = 3;
+	kph.header_version_minor = 4;
+	kph.body_compression = MAX_COMPRESS;
+	kph.body_uncompressed_size = 75000;
+	TEST_EQ(LoadKernel(&lkp, &cparams), VBERROR_INVALID_KERNEL_FOUND,
+		"Unknown compression");
+	TEST_EQ(shared->lk_calls[0].parts[0].check_result,
+		VBSD_LKP_CHECK_DECOMPRESS, "  check result");
+
+	ResetMocks();
+	kph.header_version_major = 2;
+	kph.header_version_minor = 4;
+	kph.body_compression = MAX_COMPRESS;
+	TEST_EQ(LoadKernel(&lkp, &cparams), 0,
+		"Compression ignored in header 2.x");
+
+	ResetMocks();
+	kph.header_version_major = 3;
+	kph.header_version_minor = 4;
+	kph.body_compression = COMPRESS_LZMA1;
+	kph.body_uncompressed_size = 75000;
+	verify_data_fail = 1;
+	TEST_EQ(LoadKernel(&lkp, &cparams), VBERROR_INVALID_KERNEL_FOUND,
+		"Compressed body bad data");
+	TEST_EQ(decompress_in_size, 0, "  not decompressed");
+
+	ResetMocks();
+	kph.header_version_major = 3;
+	kph.header_version_minor = 4;
+	kph.body_compression = COMPRESS_LZMA1;
+	kph.body_uncompressed_size = 75000;
+	decompress_fail = 1;
+	TEST_EQ(LoadKernel(&lkp, &cparams), VBERROR_INVALID_KERNEL_FOUND,
+		"Decompress fails");
+	TEST_EQ(shared->lk_calls[0].parts[0].check_result,
+		VBSD_LKP_CHECK_DECOMPRESS, "  check result");
+
+	ResetMocks();
+	kph.header_version_major = 3;
+	kph.header_version_minor = 4;
+	kph.body_compression = COMPRESS_LZMA1;
+	kph.body_uncompressed_size = 75000;
+	decompress_fail = -1;
+	TEST_EQ(LoadKernel(&lkp, &cparams), VBERROR_INVALID_KERNEL_FOUND,
+		"Decompressed size mismatch");
+
 	/* Check that EXTERNAL_GPT flag makes it down */
 	ResetMocks();
 	lkp.boot_flags |= BOOT_FLAG_EXTERNAL_GPT;
@@ -767,11 +1107,115 @@ static void LoadKernelTest(void)
 	TEST_EQ(gpt_flag_external, 1, "GPT was external");
 }
 
+/**
+ * Test the kernel verification cache
+ */
+static void VerifyCacheTest(void)
+{
+	VbKernelVerifyCache cache;
+
+	memset(&cache, 0, sizeof(cache));
+	ResetMocks();
+	kbh.data_key.algorithm = mock_rsa_key.algorithm;
+	lkp.verify_cache = &cache;
+	TEST_EQ(LoadKernel(&lkp, &cparams), 0, "Verify cache miss");
+	TEST_EQ(cache.struct_version, VB_KERNEL_VERIFY_CACHE_VERSION,
+		"  cache saved");
+	TEST_EQ(cache.flags, VB_KERNEL_VERIFY_CACHE_FLAG_DIRTY,
+		"  cache dirty");
+	TEST_EQ(cache.sector_start, 100, "  cache start");
+	TEST_EQ(cache.sector_count, 150, "  cache count");
+	TEST_EQ(cache.body_digest_size, SHA256_DIGEST_SIZE,
+		"  cache digest size");
+
+	cache.flags = 0;
+	ResetMocks();
+	kbh.data_key.algorithm = mock_rsa_key.algorithm;
+	lkp.verify_cache = &cache;
+	key_block_verify_fail = 1;
+	preamble_verify_fail = 1;
+	verify_data_fail = 1;
+	TEST_EQ(LoadKernel(&lkp, &cparams), 0, "Verify cache hit");
+	TEST_EQ(mock_data_key_unpacked, 0, "  no keys unpacked");
+	TEST_EQ(cache.flags, 0, "  cache not dirty");
+	TEST_EQ(shared->lk_calls[0].parts[0].flags,
+		VBSD_LKP_FLAG_KEY_BLOCK_VALID |
+		VBSD_LKP_FLAG_VERIFY_CACHE_HIT, "  part flags");
+
+	ResetMocks();
+	kbh.data_key.algorithm = mock_rsa_key.algorithm;
+	lkp.verify_cache = &cache;
+	kph.kernel_version = 0;
+	TEST_EQ(LoadKernel(&lkp, &cparams),
+		VBERROR_INVALID_KERNEL_FOUND,
+		"Verify cache hit still checks versions");
+
+	ResetMocks();
+	kbh.data_key.algorithm = mock_rsa_key.algorithm;
+	lkp.verify_cache = &cache;
+	kph.bootloader_size++;
+	key_block_verify_fail = 1;
+	TEST_EQ(LoadKernel(&lkp, &cparams),
+		VBERROR_INVALID_KERNEL_FOUND,
+		"Verify cache vblock mismatch");
+
+	ResetMocks();
+	kbh.data_key.algorithm = mock_rsa_key.algorithm;
+	lkp.verify_cache = &cache;
+	cache.body_digest[0] ^= 1;
+	TEST_EQ(LoadKernel(&lkp, &cparams),
+		VBERROR_INVALID_KERNEL_FOUND,
+		"Verify cache body mismatch");
+	cache.body_digest[0] ^= 1;
+
+	/* A body that doesn't decompress isn't cached */
+	memset(&cache, 0, sizeof(cache));
+	ResetMocks();
+	kbh.data_key.algorithm = mock_rsa_key.algorithm;
+	kph.header_version_major = 3;
+	kph.header_version_minor = 4;
+	kph.body_compression = COMPRESS_LZMA1;
+	kph.body_uncompressed_size = 75000;
+	decompress_fail = 1;
+	lkp.verify_cache = &cache;
+	TEST_EQ(LoadKernel(&lkp, &cparams),
+		VBERROR_INVALID_KERNEL_FOUND,
+		"Verify cache decompress fails");
+	TEST_EQ(cache.struct_version, 0, "  cache not saved");
+	TEST_EQ(cache.flags, 0, "  cache not dirty");
+
+	/* Chunked bodies are checked against the table on a cache hit */
+	memset(&cache, 0, sizeof(cache));
+	ResetMocks();
+	SetupChunkHashes(65536);
+	lkp.verify_cache = &cache;
+	TEST_EQ(LoadKernel(&lkp, &cparams), 0, "Verify cache chunked miss");
+	TEST_EQ(cache.body_digest_size, 0, "  no body digest");
+
+	ResetMocks();
+	SetupChunkHashes(65536);
+	lkp.verify_cache = &cache;
+	key_block_verify_fail = 1;
+	preamble_verify_fail = 1;
+	verify_data_fail = 1;
+	TEST_EQ(LoadKernel(&lkp, &cparams), 0, "Verify cache chunked hit");
+
+	ResetMocks();
+	kbh.data_key.algorithm = mock_rsa_key.algorithm;
+	lkp.verify_cache = &cache;
+	lkp.boot_flags |= BOOT_FLAG_RECOVERY;
+	key_block_verify_fail = 1;
+	TEST_EQ(LoadKernel(&lkp, &cparams),
+		VBERROR_INVALID_KERNEL_FOUND,
+		"Verify cache ignored in recovery");
+}
+
 int main(void)
 {
 	ReadWriteGptTest();
 	InvalidParamsTest();
 	LoadKernelTest();
+	VerifyCacheTest();
 
 	if (vboot_api_stub_check_memory())
 		return 255;
@@ -9,13 +9,16 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "gpt.h"
 #include "host_common.h"
+#include "test_common.h"
 #include "util_misc.h"
 #include "vboot_common.h"
 #include "vboot_api.h"
 #include "vboot_kernel.h"
 
 static uint8_t *diskbuf;
+static uint32_t sector_bytes = 512;
 
 static uint8_t shared_data[VB_SHARED_DATA_MIN_SIZE];
 static VbSharedDataHeader *shared = (VbSharedDataHeader *)shared_data;
@@ -34,7 +37,7 @@ VbError_t VbExDiskRead(VbExDiskHandle_t handle, uint64_t lba_start,
 	if (lba_start + lba_count > params.streaming_lba_count)
 		return VBERROR_UNKNOWN;
 
-	memcpy(buffer, diskbuf + lba_start * 512, lba_count * 512);
+	memcpy(buffer, diskbuf + lba_start * sector_bytes, lba_count * sector_bytes);
 	return VBERROR_SUCCESS;
 }
 
@@ -48,10 +51,31 @@ VbError_t VbExDiskWrite(VbExDiskHandle_t handle, uint64_t lba_start,
 	if (lba_start + lba_count > params.streaming_lba_count)
 		return VBERROR_UNKNOWN;
 
-	memcpy(diskbuf + lba_start * 512, buffer, lba_count * 512);
+	memcpy(diskbuf + lba_start * sector_bytes, buffer,
+	       lba_count * sector_bytes);
 	return VBERROR_SUCCESS;
 }
 
+/*
+ * Guess the sector size of a disk image from where its primary GPT header
+ * lives: LBA 1 is at byte 512 on 512-byte drives and byte 4096 on 4Kn drives.
+ */
+static uint32_t detect_sector_bytes(const uint8_t *buf, uint64_t size)
+{
+	uint32_t bytes;
+
+	for (bytes = 512; bytes <= 4096; bytes *= 2) {
+		if (size < bytes + GPT_HEADER_SIGNATURE_SIZE)
+			break;
+		if (!memcmp(buf + bytes, GPT_HEADER_SIGNATURE,
+			    GPT_HEADER_SIGNATURE_SIZE) ||
+		    !memcmp(buf + bytes, GPT_HEADER_SIGNATURE2,
+			    GPT_HEADER_SIGNATURE_SIZE))
+			return bytes;
+	}
+	return 512;
+}
+
 static void print_help(const char *progname)
 {
 	printf("\nUsage: %s <disk_image> <kernel.vbpubk>\n\n",
@@ -93,8 +117,10 @@ int main(int argc, char *argv[])
 	params.shared_data_blob = shared_data;
 	params.shared_data_size = sizeof(shared_data);
 	params.disk_handle = (VbExDiskHandle_t)1;
-	params.bytes_per_lba = 512;
-	params.streaming_lba_count = disk_bytes / 512;
+	sector_bytes = detect_sector_bytes(diskbuf, disk_bytes);
+	vboot_api_stub_set_sector_bytes(sector_bytes);
+	params.bytes_per_lba = sector_bytes;
+	params.streaming_lba_count = disk_bytes / sector_bytes;
 	params.gpt_lba_count = params.streaming_lba_count;
 
 	params.kernel_buffer_size = 16 * 1024 * 1024;
@@ -87,6 +87,10 @@ const Param sys_param_list[] = {
    "Firmware write protect software setting enabled at boot"},
   {"tpm_fwver", 0, "Firmware version stored in TPM", "0x%08x"},
   {"tpm_kernver", 0, "Kernel version stored in TPM", "0x%08x"},
+  {"tpm_rollback_writes", 0,
+   "TPM firmware and kernel space writes by firmware this boot"},
+  {"tpm_rollback_writes_elided", 0,
+   "TPM firmware and kernel space writes skipped as no-ops this boot"},
   {"tried_fwb", 0, "Tried firmware B before A this boot"},
   {"vdat_flags", 0, "Flags from VbSharedData", "0x%08x"},
   {"vdat_lfdebug", IS_STRING|NO_PRINT_ALL,
@@ -8,6 +8,7 @@
  */
 
 #include <inttypes.h>  /* For PRIu64 macro */
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -76,6 +77,164 @@ VbError_t VbExDiskWrite(VbExDiskHandle_t handle, uint64_t lba_start,
 }
 
 
+/* Stream implementation which can read ahead on a background thread, so
+ * prefetch hints from LoadKernel() overlap disk reads with verification. */
+struct prefetch_stream {
+  VbExDiskHandle_t handle;
+  uint64_t sector;        /* Next sector the caller will read */
+  uint64_t sectors_left;  /* Sectors left in the partition */
+
+  /* Read-ahead state; the buffer holds data starting at [sector] */
+  pthread_t thread;
+  int thread_running;
+  uint8_t *buf;
+  uint64_t buf_sectors;   /* Sectors requested / read into buf */
+  uint64_t buf_used;      /* Sectors of buf already returned to the caller */
+  VbError_t buf_rv;
+};
+
+static void *prefetch_thread(void *arg) {
+  struct prefetch_stream *s = (struct prefetch_stream *)arg;
+  size_t bytes = s->buf_sectors * lkp.bytes_per_lba;
+
+  /* Use pread() so we don't disturb the stdio file position used by
+   * VbExDiskRead() on the main thread. */
+  if (pread(fileno(image_file), s->buf, bytes,
+            s->sector * lkp.bytes_per_lba) != (ssize_t)bytes)
+    s->buf_rv = VBERROR_UNKNOWN;
+  else
+    s->buf_rv = VBERROR_SUCCESS;
+  return NULL;
+}
+
+/* Wait for any read-ahead in progress. */
+static void prefetch_wait(struct prefetch_stream *s) {
+  if (s->thread_running) {
+    pthread_join(s->thread, NULL);
+    s->thread_running = 0;
+  }
+}
+
+/* Drop any read-ahead data. */
+static void prefetch_discard(struct prefetch_stream *s) {
+  prefetch_wait(s);
+  free(s->buf);
+  s->buf = NULL;
+  s->buf_sectors = s->buf_used = 0;
+}
+
+VbError_t VbExStreamOpen(VbExDiskHandle_t handle, uint64_t lba_start,
+                         uint64_t lba_count, VbExStream_t *stream) {
+  struct prefetch_stream *s;
+
+  if (!handle) {
+    *stream = NULL;
+    return VBERROR_UNKNOWN;
+  }
+
+  s = calloc(1, sizeof(*s));
+  if (!s)
+    return VBERROR_UNKNOWN;
+  s->handle = handle;
+  s->sector = lba_start;
+  s->sectors_left = lba_count;
+
+  *stream = (VbExStream_t)s;
+  return VBERROR_SUCCESS;
+}
+
+VbError_t VbExStreamPrefetch(VbExStream_t stream, uint32_t bytes) {
+  struct prefetch_stream *s = (struct prefetch_stream *)stream;
+  uint64_t sectors;
+
+  if (!s)
+    return VBERROR_UNKNOWN;
+
+  /* Only one read-ahead at a time; drop any stale one */
+  prefetch_discard(s);
+
+  sectors = (bytes + lkp.bytes_per_lba - 1) / lkp.bytes_per_lba;
+  if (sectors > s->sectors_left)
+    sectors = s->sectors_left;
+  if (!sectors)
+    return VBERROR_SUCCESS;
+
+  s->buf = malloc(sectors * lkp.bytes_per_lba);
+  if (!s->buf)
+    return VBERROR_SUCCESS;  /* Just a hint, so not an error */
+  s->buf_sectors = sectors;
+
+  printf("Prefetch(%" PRIu64 ", %" PRIu64 ")\n", s->sector, sectors);
+  if (pthread_create(&s->thread, NULL, prefetch_thread, s)) {
+    prefetch_discard(s);
+    return VBERROR_SUCCESS;
+  }
+  s->thread_running = 1;
+  return VBERROR_SUCCESS;
+}
+
+VbError_t VbExStreamRead(VbExStream_t stream, uint32_t bytes, void *buffer) {
+  struct prefetch_stream *s = (struct prefetch_stream *)stream;
+  uint8_t *dest = (uint8_t *)buffer;
+  uint64_t sectors;
+  VbError_t rv;
+
+  if (!s)
+    return VBERROR_UNKNOWN;
+
+  /* Require reads to be a multiple of the LBA size */
+  if (bytes % lkp.bytes_per_lba)
+    return VBERROR_UNKNOWN;
+
+  sectors = bytes / lkp.bytes_per_lba;
+  if (sectors > s->sectors_left)
+    return VBERROR_UNKNOWN;
+
+  /* Use read-ahead data first, if we have any */
+  if (s->buf) {
+    uint64_t n = s->buf_sectors - s->buf_used;
+
+    prefetch_wait(s);
+    if (s->buf_rv != VBERROR_SUCCESS) {
+      /* Fall back to reading synchronously */
+      prefetch_discard(s);
+    } else {
+      if (n > sectors)
+        n = sectors;
+      Memcpy(dest, s->buf + s->buf_used * lkp.bytes_per_lba,
+             n * lkp.bytes_per_lba);
+      s->buf_used += n;
+      if (s->buf_used == s->buf_sectors)
+        prefetch_discard(s);
+      dest += n * lkp.bytes_per_lba;
+      s->sector += n;
+      s->sectors_left -= n;
+      sectors -= n;
+    }
+  }
+
+  if (sectors) {
+    rv = VbExDiskRead(s->handle, s->sector, sectors, dest);
+    if (rv != VBERROR_SUCCESS)
+      return rv;
+    s->sector += sectors;
+    s->sectors_left -= sectors;
+  }
+
+  return VBERROR_SUCCESS;
+}
+
+void VbExStreamClose(VbExStream_t stream) {
+  struct prefetch_stream *s = (struct prefetch_stream *)stream;
+
+  if (!s)
+    return;
+
+  prefetch_discard(s);
+  free(s);
+}
+
+
 /* Main routine */
 int main(int argc, char* argv[]) {
 
@@ -90,6 +249,8 @@ int main(int argc, char* argv[]) {
   char *e = 0;
 
   Memset(&lkp, 0, sizeof(LoadKernelParams));
+  /* Any non-NULL handle will do; there's only one disk */
+  lkp.disk_handle = (VbExDiskHandle_t)1;
   lkp.bytes_per_lba = LBA_BYTES;
   lkp.boot_flags = BOOT_FLAG_RECOVERY;
   Memset(&vnc, 0, sizeof(VbNvContext));